@@ -0,0 +1,139 @@
+#include "baldr/alt_landmarks.h"
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr char kMagic[8] = {'v', 'a', 'l', 'h', 'a', 'l', 't', '\0'};
+constexpr uint32_t kVersion = 1;
+
+struct alt_header_t {
+  char magic[8];
+  uint32_t version;
+  uint32_t landmark_count;
+  uint64_t tile_count;
+  uint64_t node_count;
+};
+
+// everything in the file starts at a multiple of 8 bytes
+size_t padded(size_t size) {
+  return (size + 7) & ~size_t(7);
+}
+
+template <typename T> void write(std::ofstream& out, const std::vector<T>& values) {
+  out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+  const size_t bytes = values.size() * sizeof(T);
+  const char zeros[8] = {};
+  out.write(zeros, padded(bytes) - bytes);
+}
+
+} // namespace
+
+namespace valhalla {
+namespace baldr {
+
+AltLandmarks::AltLandmarks(const std::string& file) {
+  const auto size = std::filesystem::file_size(file);
+  if (size < sizeof(alt_header_t)) {
+    throw std::runtime_error(file + " has no landmark distances");
+  }
+  memory_.map(file, size, POSIX_MADV_NORMAL, true);
+
+  alt_header_t header;
+  std::memcpy(&header, memory_.get(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) || header.version != kVersion) {
+    throw std::runtime_error(file + " has no landmark distances of version " +
+                             std::to_string(kVersion));
+  }
+  landmark_count_ = header.landmark_count;
+  tile_count_ = header.tile_count;
+
+  const char* data = memory_.get() + sizeof(header);
+  const char* end = memory_.get() + size;
+  auto section = [&data, end, &file]<typename T>(const T*& pointer, size_t count) {
+    if (static_cast<size_t>(end - data) < padded(count * sizeof(T))) {
+      throw std::runtime_error(file + " is truncated");
+    }
+    pointer = reinterpret_cast<const T*>(data);
+    data += padded(count * sizeof(T));
+  };
+  section(tiles_, tile_count_);
+  section(tile_offsets_, tile_count_ + 1);
+  section(landmarks_, landmark_count_);
+  section(distances_, header.node_count * 2 * landmark_count_);
+  if (data != end || tile_offsets_[tile_count_] != header.node_count) {
+    throw std::runtime_error(file + " has trailing data");
+  }
+}
+
+void AltLandmarks::Write(const std::string& file, const table_t& table) {
+  const auto node_count = table.tile_offsets.empty() ? 0 : table.tile_offsets.back();
+  if (table.tile_offsets.size() != table.tiles.size() + 1 ||
+      table.distances.size() != node_count * 2 * table.landmarks.size() ||
+      !std::is_sorted(table.tiles.begin(), table.tiles.end())) {
+    throw std::logic_error("Inconsistent landmark distances");
+  }
+
+  // write to a temporary file and move it in place so a running service never maps half a file
+  const auto parent = std::filesystem::path(file).parent_path();
+  if (!parent.empty()) {
+    std::filesystem::create_directories(parent);
+  }
+  const auto tmp = file + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      throw std::runtime_error("Could not open " + tmp);
+    }
+    alt_header_t header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.landmark_count = table.landmarks.size();
+    header.tile_count = table.tiles.size();
+    header.node_count = node_count;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write(out, table.tiles);
+    write(out, table.tile_offsets);
+    write(out, table.landmarks);
+    write(out, table.distances);
+    if (!out) {
+      throw std::runtime_error("Could not write " + tmp);
+    }
+  }
+  std::filesystem::rename(tmp, file);
+}
+
+std::string AltLandmarks::FileName(const boost::property_tree::ptree& mjolnir) {
+  auto file = mjolnir.get<std::string>("alt.file", "");
+  if (file.empty()) {
+    const auto tile_dir = mjolnir.get<std::string>("tile_dir", "");
+    if (!tile_dir.empty()) {
+      file = (std::filesystem::path(tile_dir) / "alt.bin").string();
+    }
+  }
+  return file;
+}
+
+const float* AltLandmarks::distances(const GraphId& node) const {
+  const uint64_t tile = node.tile_base().value;
+  const auto* end = tiles_ + tile_count_;
+  const auto* found = std::lower_bound(tiles_, end, tile);
+  if (found == end || *found != tile) {
+    return nullptr;
+  }
+  const auto index = found - tiles_;
+  const auto first = tile_offsets_[index];
+  if (node.id() >= tile_offsets_[index + 1] - first) {
+    return nullptr;
+  }
+  return distances_ + (first + node.id()) * 2 * landmark_count_;
+}
+
+} // namespace baldr
+} // namespace valhalla
@@ -0,0 +1,162 @@
+#include "baldr/contraction_hierarchy.h"
+#include "proto/options.pb.h"
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr char kMagic[8] = {'v', 'a', 'l', 'h', 'a', 'c', 'h', '\0'};
+constexpr uint32_t kVersion = 3;
+
+struct ch_header_t {
+  char magic[8];
+  uint32_t version;
+  uint32_t costing;
+  uint64_t node_count;
+  uint64_t forward_count;
+  uint64_t backward_count;
+  uint64_t options_size;
+};
+
+// everything in the file starts at a multiple of 8 bytes
+size_t padded(size_t size) {
+  return (size + 7) & ~size_t(7);
+}
+
+template <typename T> void write(std::ofstream& out, const std::vector<T>& values) {
+  out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+  const size_t bytes = values.size() * sizeof(T);
+  const char zeros[8] = {};
+  out.write(zeros, padded(bytes) - bytes);
+}
+
+} // namespace
+
+namespace valhalla {
+namespace baldr {
+
+ContractionHierarchy::ContractionHierarchy(const std::string& file) {
+  const auto size = std::filesystem::file_size(file);
+  if (size < sizeof(ch_header_t)) {
+    throw std::runtime_error(file + " is not a contraction hierarchy");
+  }
+  memory_.map(file, size, POSIX_MADV_NORMAL, true);
+
+  ch_header_t header;
+  std::memcpy(&header, memory_.get(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) || header.version != kVersion) {
+    throw std::runtime_error(file + " is not a contraction hierarchy of version " +
+                             std::to_string(kVersion));
+  }
+  costing_ = header.costing;
+  node_count_ = header.node_count;
+
+  const char* data = memory_.get() + sizeof(header);
+  options_ = std::string_view(data, header.options_size);
+  data += padded(header.options_size);
+  edges_ = reinterpret_cast<const uint64_t*>(data);
+  data += padded(node_count_ * sizeof(uint64_t));
+  nodes_ = reinterpret_cast<const ch_node_t*>(data);
+  data += padded(node_count_ * sizeof(ch_node_t));
+  forward_offsets_ = reinterpret_cast<const uint64_t*>(data);
+  data += padded((node_count_ + 1) * sizeof(uint64_t));
+  forward_ = reinterpret_cast<const ch_arc_t*>(data);
+  data += padded(header.forward_count * sizeof(ch_arc_t));
+  backward_offsets_ = reinterpret_cast<const uint64_t*>(data);
+  data += padded((node_count_ + 1) * sizeof(uint64_t));
+  backward_ = reinterpret_cast<const ch_arc_t*>(data);
+  data += padded(header.backward_count * sizeof(ch_arc_t));
+  order_ = reinterpret_cast<const uint32_t*>(data);
+  data += padded(node_count_ * sizeof(uint32_t));
+  if (data != memory_.get() + size) {
+    throw std::runtime_error(file + " is truncated");
+  }
+}
+
+void ContractionHierarchy::Write(const std::string& file,
+                                 uint32_t costing,
+                                 const std::string& options,
+                                 const std::vector<uint64_t>& edges,
+                                 const std::vector<ch_node_t>& nodes,
+                                 const std::vector<uint64_t>& forward_offsets,
+                                 const std::vector<ch_arc_t>& forward,
+                                 const std::vector<uint64_t>& backward_offsets,
+                                 const std::vector<ch_arc_t>& backward,
+                                 const std::vector<uint32_t>& order) {
+  if (nodes.size() != edges.size() || order.size() != edges.size() ||
+      forward_offsets.size() != edges.size() + 1 || backward_offsets.size() != edges.size() + 1 ||
+      forward_offsets.back() != forward.size() || backward_offsets.back() != backward.size()) {
+    throw std::logic_error("Inconsistent contraction hierarchy");
+  }
+
+  // write to a temporary file and move it in place so a running service never maps half a file
+  const auto parent = std::filesystem::path(file).parent_path();
+  if (!parent.empty()) {
+    std::filesystem::create_directories(parent);
+  }
+  const auto tmp = file + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      throw std::runtime_error("Could not open " + tmp);
+    }
+    ch_header_t header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.costing = costing;
+    header.node_count = edges.size();
+    header.forward_count = forward.size();
+    header.backward_count = backward.size();
+    header.options_size = options.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write(out, std::vector<char>(options.begin(), options.end()));
+    write(out, edges);
+    write(out, nodes);
+    write(out, forward_offsets);
+    write(out, forward);
+    write(out, backward_offsets);
+    write(out, backward);
+    write(out, order);
+    if (!out) {
+      throw std::runtime_error("Could not write " + tmp);
+    }
+  }
+  std::filesystem::rename(tmp, file);
+}
+
+std::string ContractionHierarchy::SerializeOptions(const Costing& costing) {
+  auto options = costing.options();
+  options.clear_hierarchy_limits();
+  return options.SerializeAsString();
+}
+
+std::string ContractionHierarchy::FileName(const std::string& dir, const std::string& costing) {
+  return (std::filesystem::path(dir) / (costing + ".ch")).string();
+}
+
+std::string ContractionHierarchy::Directory(const boost::property_tree::ptree& mjolnir) {
+  auto dir = mjolnir.get<std::string>("contraction_hierarchy.dir", "");
+  if (dir.empty()) {
+    const auto tile_dir = mjolnir.get<std::string>("tile_dir", "");
+    if (!tile_dir.empty()) {
+      dir = (std::filesystem::path(tile_dir) / "ch").string();
+    }
+  }
+  return dir;
+}
+
+uint32_t ContractionHierarchy::node(const GraphId& edgeid) const {
+  const auto* end = edges_ + node_count_;
+  const auto* found = std::lower_bound(edges_, end, static_cast<uint64_t>(edgeid.value));
+  return found != end && *found == edgeid.value ? static_cast<uint32_t>(found - edges_)
+                                                : kInvalidCHNode;
+}
+
+} // namespace baldr
+} // namespace valhalla
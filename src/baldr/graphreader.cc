@@ -8,6 +8,7 @@
 
 #include <sys/stat.h>
 
+#include <algorithm>
 #include <filesystem>
 #include <span>
 #include <string>
@@ -540,6 +541,31 @@ GraphReader::GraphReader(const boost::property_tree::ptree& pt,
   }
 }
 
+uint64_t GraphReader::LastTrafficUpdate() const {
+  // the traffic is updated in place while the extract is mapped, the headers have to be read again
+  uint64_t last_update = 0;
+  for (const auto& [tile_id, memory] : tile_extract_->traffic_tiles) {
+    if (memory.second >= sizeof(TrafficTileHeader)) {
+      const auto* header = reinterpret_cast<const volatile TrafficTileHeader*>(memory.first);
+      const uint64_t tile_update = header->last_update;
+      last_update = std::max(last_update, tile_update);
+    }
+  }
+  return last_update;
+}
+
+uint64_t GraphReader::TileBuild(const GraphId& graphid) {
+  auto tile = GetGraphTile(graphid);
+  if (!tile) {
+    return 0;
+  }
+  const auto* header = tile->header();
+  size_t build = header->checksum();
+  hash_combine(build, header->dataset_id());
+  hash_combine(build, header->date_created());
+  return build;
+}
+
 // Method to test if tile exists
 bool GraphReader::DoesTileExist(const GraphId& graphid) const {
   if (!graphid.is_valid() || graphid.level() > TileHierarchy::get_max_level()) {
@@ -872,6 +898,14 @@ GraphId GraphReader::GetShortcut(const GraphId& id) {
 
 // Unpack edges for a given shortcut edge
 std::vector<GraphId> GraphReader::RecoverShortcut(const GraphId& shortcut_id) {
+  // tiles built with the edges of their shortcuts have them at hand
+  auto tile = GetGraphTile(shortcut_id);
+  if (tile) {
+    auto edges = tile->GetShortcutEdges(shortcut_id.id());
+    if (!edges.empty()) {
+      return {edges.begin(), edges.end()};
+    }
+  }
   return shortcut_recovery_t::get_instance().get(shortcut_id, *this);
 }
 
@@ -11,6 +11,7 @@
 #include "midgard/tiles.h"
 #include "midgard/util.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <filesystem>
@@ -404,10 +405,26 @@ void GraphTile::Initialize(const GraphId& graphid) {
   textlist_ = tile_ptr + header_->textlist_offset();
   textlist_size_ = header_->lane_connectivity_offset() - header_->textlist_offset();
 
-  // Start of lane connections and their size
+  // Start of lane connections and their size, up to the shortcut edges if the tile has them
   lane_connectivity_ =
       reinterpret_cast<LaneConnectivity*>(tile_ptr + header_->lane_connectivity_offset());
-  lane_connectivity_size_ = header_->predictedspeeds_offset() - header_->lane_connectivity_offset();
+  const uint32_t lane_connectivity_end =
+      header_->shortcut_edges_offset() > 0 ? header_->shortcut_edges_offset()
+      : header_->predictedspeeds_count() > 0 ? header_->predictedspeeds_offset()
+                                             : header_->end_offset();
+  lane_connectivity_size_ = lane_connectivity_end - header_->lane_connectivity_offset();
+
+  // Start of the shortcut edges: the shortcut count, the shortcut indexes, where the edges of each
+  // shortcut start (one extra entry at the end) and then the edges
+  if (header_->shortcut_edges_offset() > 0) {
+    const auto* count =
+        reinterpret_cast<const uint32_t*>(tile_ptr + header_->shortcut_edges_offset());
+    shortcut_count_ = *count;
+    shortcut_indexes_ = count + 1;
+    shortcut_edges_begin_ = shortcut_indexes_ + shortcut_count_;
+    shortcut_edges_ =
+        reinterpret_cast<const GraphId*>(shortcut_edges_begin_ + shortcut_count_ + 1);
+  }
 
   // Start of predicted speed data.
   if (header_->predictedspeeds_count() > 0) {
@@ -415,10 +432,6 @@ void GraphTile::Initialize(const GraphId& graphid) {
     char* ptr2 = ptr1 + (header_->directededgecount() * sizeof(int32_t));
     predictedspeeds_.set_offset(reinterpret_cast<uint32_t*>(ptr1));
     predictedspeeds_.set_profiles(reinterpret_cast<int16_t*>(ptr2));
-
-    lane_connectivity_size_ = header_->predictedspeeds_offset() - header_->lane_connectivity_offset();
-  } else {
-    lane_connectivity_size_ = header_->end_offset() - header_->lane_connectivity_offset();
   }
 
   // For reference - how to use the end offset to set size of an object (that
@@ -432,6 +445,9 @@ void GraphTile::Initialize(const GraphId& graphid) {
     AssociateOneStopIds(graphid);
   }
 
+  // Index the departures of each transit line
+  IndexDepartures();
+
   // `base_ll()` has some non-trivial calculations, so cache it
   base_ll_ = header_->base_ll();
 }
@@ -1014,139 +1030,195 @@ std::span<LaneConnectivity> GraphTile::GetLaneConnectivity(const uint32_t idx) c
   return std::span<LaneConnectivity>(lane_connectivity_ + start, lane_connectivity_ + found);
 }
 
-// Get the next departure given the directed line Id and the current
-// time (seconds from midnight).
-const TransitDeparture* GraphTile::GetNextDeparture(const uint32_t lineid,
-                                                    const uint32_t current_time,
-                                                    const uint32_t day,
-                                                    const uint32_t dow,
-                                                    bool date_before_tile,
-                                                    bool wheelchair,
-                                                    bool bicycle) const {
-  uint32_t count = header_->departurecount();
+// Get the edges a shortcut supersedes.
+std::span<const GraphId> GraphTile::GetShortcutEdges(const uint32_t idx) const {
+  const auto* end = shortcut_indexes_ + shortcut_count_;
+  const auto* found = std::lower_bound(shortcut_indexes_, end, idx);
+  if (found == end || *found != idx) {
+    return {};
+  }
+  const auto i = found - shortcut_indexes_;
+  return std::span<const GraphId>(shortcut_edges_ + shortcut_edges_begin_[i],
+                                  shortcut_edges_ + shortcut_edges_begin_[i + 1]);
+}
+
+// Index the departures of each transit line. They are sorted by line Id, schedule type and
+// departure time so the departures of a line are a contiguous range, its fixed departures first.
+void GraphTile::IndexDepartures() {
+  const uint32_t count = header_->departurecount();
   if (count == 0) {
-    return nullptr;
+    return;
   }
 
-  // Departures are sorted by edge Id and then by departure time.
-  // Binary search to find a departure with matching line Id.
-  int32_t low = 0;
-  int32_t high = count - 1;
-  int32_t mid;
-  auto found = count;
-  while (low <= high) {
-    mid = (low + high) / 2;
-    const auto& dep = departures_[mid];
-    // matching lineid and a workable time
-    if (lineid == dep.lineid() &&
-        ((current_time <= dep.departure_time() && dep.type() == kFixedSchedule) ||
-         (current_time <= dep.end_time() && dep.type() == kFrequencySchedule))) {
-      found = mid;
-      high = mid - 1;
-    } // need a smaller lineid
-    else if (lineid < dep.lineid()) {
-      high = mid - 1;
-    } // either need a bigger lineid or a later time
-    else {
-      low = mid + 1;
+  const uint32_t line_count = departures_[count - 1].lineid() + 1;
+  line_departures_.assign(line_count + 1, count);
+  uint32_t lineid = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    for (; lineid <= departures_[i].lineid(); ++lineid) {
+      line_departures_[lineid] = i;
     }
   }
 
-  // Iterate through departures until one is found with valid date, dow or
-  // calendar date, and does not have a calendar exception.
-  for (; found < count && departures_[found].lineid() == lineid; ++found) {
-    // Make sure it falls within the schedule and departure props are valid
-    const auto& d = departures_[found];
-    if ((wheelchair && !d.wheelchair_accessible()) || (bicycle && !d.bicycle_accessible()) ||
-        !GetTransitSchedule(d.schedule_index())->IsValid(day, dow, date_before_tile)) {
-      continue;
+  line_frequencies_.assign(line_departures_.begin() + 1, line_departures_.end());
+  for (uint32_t i = count; i > 0; --i) {
+    const auto& d = departures_[i - 1];
+    if (d.type() == kFrequencySchedule) {
+      line_frequencies_[d.lineid()] = i - 1;
     }
+  }
+}
 
-    if (d.type() == kFixedSchedule) {
-      return &d;
-    } else {
-      // TODO: this is for now only respecting frequencies.txt exact_times=true, e.g.
-      // auto departure_time = kFrequencySchedule ? d.departure_time() : d.departure_time() +
-      // (d.frequency() * 0.5f);
-      auto departure_time = d.departure_time();
-      const auto end_time = d.end_time();
-      const auto frequency = d.frequency();
-      // make sure the departure time is after the current_time for a frequency based trip
-      while (departure_time < current_time && departure_time < end_time) {
-        departure_time += frequency;
-      }
+// Get the next departure of a line at or after the current time with a schedule that valid
+// accepts. A fixed departure is found with a binary search on the departure times of the line,
+// frequency departures run until their end time so they are checked one by one.
+template <typename schedule_check_t>
+const TransitDeparture* GraphTile::FindNextDeparture(const uint32_t lineid,
+                                                     const uint32_t current_time,
+                                                     const schedule_check_t& valid,
+                                                     bool wheelchair,
+                                                     bool bicycle) const {
+  if (lineid + 1 >= line_departures_.size()) {
+    return nullptr;
+  }
+
+  // Make sure the departure props are valid and it falls within the schedule
+  const auto runs = [&](const TransitDeparture& d) {
+    return (!wheelchair || d.wheelchair_accessible()) && (!bicycle || d.bicycle_accessible()) &&
+           valid(d.schedule_index());
+  };
 
-      // make a new departure with a guess for departure time          ;
-      return new TransitDeparture(d.lineid(), d.tripid(), d.routeindex(), d.blockid(),
-                                  d.headsign_offset(), departure_time, d.end_time(), d.frequency(),
-                                  d.elapsed_time(), d.schedule_index(), d.wheelchair_accessible(),
-                                  d.bicycle_accessible());
+  // The first fixed departure at or after the current time that runs
+  const auto* begin = departures_ + line_departures_[lineid];
+  const auto* frequencies = departures_ + line_frequencies_[lineid];
+  const auto* end = departures_ + line_departures_[lineid + 1];
+  const TransitDeparture* next = nullptr;
+  for (auto* d = std::partition_point(begin, frequencies,
+                                      [current_time](const TransitDeparture& d) {
+                                        return d.departure_time() < current_time;
+                                      });
+       d != frequencies; ++d) {
+    if (runs(*d)) {
+      next = d;
+      break;
+    }
+  }
+
+  // A frequency trip leaving earlier replaces it
+  // TODO: this is for now only respecting frequencies.txt exact_times=true
+  const TransitDeparture* frequency = nullptr;
+  uint32_t frequency_time = 0;
+  for (const auto* d = frequencies; d != end; ++d) {
+    if (current_time > d->end_time() || !runs(*d)) {
+      continue;
+    }
+    // make sure the departure time is after the current_time for a frequency based trip
+    auto departure_time = d->departure_time();
+    while (departure_time < current_time && departure_time < d->end_time()) {
+      departure_time += d->frequency();
+    }
+    if ((next == nullptr || departure_time < next->departure_time()) &&
+        (frequency == nullptr || departure_time < frequency_time)) {
+      frequency = d;
+      frequency_time = departure_time;
     }
   }
+  if (frequency != nullptr) {
+    // make a new departure with a guess for departure time
+    const auto& d = *frequency;
+    return new TransitDeparture(d.lineid(), d.tripid(), d.routeindex(), d.blockid(),
+                                d.headsign_offset(), frequency_time, d.end_time(), d.frequency(),
+                                d.elapsed_time(), d.schedule_index(), d.wheelchair_accessible(),
+                                d.bicycle_accessible());
+  }
 
   // TODO - maybe wrap around, try next day?
-  LOG_DEBUG("No more departures found for lineid = " + std::to_string(lineid) +
-            " current_time = " + std::to_string(current_time));
-  return nullptr;
+  if (next == nullptr) {
+    LOG_DEBUG("No more departures found for lineid = " + std::to_string(lineid) +
+              " current_time = " + std::to_string(current_time));
+  }
+  return next;
+}
+
+// Get the next departure given the directed line Id and the current
+// time (seconds from midnight).
+const TransitDeparture* GraphTile::GetNextDeparture(const uint32_t lineid,
+                                                    const uint32_t current_time,
+                                                    const uint32_t day,
+                                                    const uint32_t dow,
+                                                    bool date_before_tile,
+                                                    bool wheelchair,
+                                                    bool bicycle) const {
+  // Valid date, dow or calendar date, and does not have a calendar exception.
+  return FindNextDeparture(
+      lineid, current_time,
+      [&](const uint32_t idx) {
+        return GetTransitSchedule(idx)->IsValid(day, dow, date_before_tile);
+      },
+      wheelchair, bicycle);
+}
+
+// Get the next departure given the directed line Id and the current
+// time (seconds from midnight) with the schedules active on the day.
+const TransitDeparture* GraphTile::GetNextDeparture(const uint32_t lineid,
+                                                    const uint32_t current_time,
+                                                    const std::vector<bool>& active_schedules,
+                                                    bool wheelchair,
+                                                    bool bicycle) const {
+  return FindNextDeparture(
+      lineid, current_time,
+      [&active_schedules](const uint32_t idx) {
+        return idx < active_schedules.size() && active_schedules[idx];
+      },
+      wheelchair, bicycle);
+}
+
+// Get which of the transit schedules run on the day.
+std::vector<bool>
+GraphTile::GetActiveSchedules(const uint32_t day, const uint32_t dow, bool date_before_tile) const {
+  std::vector<bool> active(header_->schedulecount());
+  for (uint32_t i = 0; i < header_->schedulecount(); ++i) {
+    active[i] = transit_schedules_[i].IsValid(day, dow, date_before_tile);
+  }
+  return active;
 }
 
 // Get the departure given the line Id and tripid
 const TransitDeparture* GraphTile::GetTransitDeparture(const uint32_t lineid,
                                                        const uint32_t tripid,
                                                        const uint32_t current_time) const {
-  uint32_t count = header_->departurecount();
-  if (count == 0) {
+  if (lineid + 1 >= line_departures_.size()) {
     return nullptr;
   }
 
-  // Departures are sorted by edge Id and then by departure time.
-  // Binary search to find a departure with matching line Id.
-  int32_t low = 0;
-  int32_t high = count - 1;
-  int32_t mid;
-  auto found = count;
-  while (low <= high) {
-    mid = (low + high) / 2;
-    const auto& dep = departures_[mid];
-    // find the first matching lineid in the list
-    if (lineid == dep.lineid() &&
-        ((current_time <= dep.departure_time() && dep.type() == kFixedSchedule) ||
-         (current_time <= dep.end_time() && dep.type() == kFrequencySchedule))) {
-      found = mid;
-      high = mid - 1;
-    } // need a smaller lineid
-    else if (lineid < dep.lineid()) {
-      high = mid - 1;
-    } // need a bigger lineid
-    else {
-      low = mid + 1;
+  // Only the departures of the line at or after the current time are searched, the fixed ones
+  // sorted by departure time and the frequency ones that have not ended yet
+  const auto* begin = departures_ + line_departures_[lineid];
+  const auto* frequencies = departures_ + line_frequencies_[lineid];
+  const auto* end = departures_ + line_departures_[lineid + 1];
+  for (const auto* d = std::partition_point(begin, frequencies,
+                                            [current_time](const TransitDeparture& d) {
+                                              return d.departure_time() < current_time;
+                                            });
+       d != end; ++d) {
+    if (d->tripid() != tripid) {
+      continue;
+    }
+    if (d->type() == kFixedSchedule) {
+      return d;
     }
-  }
-
-  // Iterate through departures until one is found with matching trip id
-  for (; found < count && departures_[found].lineid() == lineid; ++found) {
-    if (departures_[found].tripid() == tripid) {
-
-      if (departures_[found].type() == kFixedSchedule) {
-        return &departures_[found];
-      }
 
-      uint32_t departure_time = departures_[found].departure_time();
-      uint32_t end_time = departures_[found].end_time();
-      uint32_t frequency = departures_[found].frequency();
-      while (departure_time < current_time && departure_time < end_time) {
-        departure_time += frequency;
-      }
+    uint32_t departure_time = d->departure_time();
+    uint32_t end_time = d->end_time();
+    uint32_t frequency = d->frequency();
+    while (departure_time < current_time && departure_time < end_time) {
+      departure_time += frequency;
+    }
 
-      if (departure_time >= current_time && departure_time < end_time) {
-        const auto& d = departures_[found];
-        const TransitDeparture* dep =
-            new TransitDeparture(d.lineid(), d.tripid(), d.routeindex(), d.blockid(),
-                                 d.headsign_offset(), departure_time, d.end_time(), d.frequency(),
-                                 d.elapsed_time(), d.schedule_index(), d.wheelchair_accessible(),
-                                 d.bicycle_accessible());
-        return dep;
-      }
+    if (departure_time >= current_time && departure_time < end_time) {
+      return new TransitDeparture(d->lineid(), d->tripid(), d->routeindex(), d->blockid(),
+                                  d->headsign_offset(), departure_time, d->end_time(),
+                                  d->frequency(), d->elapsed_time(), d->schedule_index(),
+                                  d->wheelchair_accessible(), d->bicycle_accessible());
     }
   }
 
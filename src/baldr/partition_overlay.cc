@@ -0,0 +1,228 @@
+#include "baldr/partition_overlay.h"
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr char kMagic[8] = {'v', 'a', 'l', 'h', 'a', 'o', 'v', '\0'};
+constexpr uint32_t kVersion = 1;
+
+struct overlay_header_t {
+  char magic[8];
+  uint32_t version;
+  uint32_t level_count;
+  uint64_t node_count;
+  uint64_t arc_count;
+  uint64_t entry_count;
+  uint64_t exit_count;
+};
+
+// everything in the file starts at a multiple of 8 bytes
+size_t padded(size_t size) {
+  return (size + 7) & ~size_t(7);
+}
+
+template <typename T> void write(std::ofstream& out, const std::vector<T>& values) {
+  out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+  const size_t bytes = values.size() * sizeof(T);
+  const char zeros[8] = {};
+  out.write(zeros, padded(bytes) - bytes);
+}
+
+// the entries or exits of every cell on every level and the position of each node among them
+struct boundary_t {
+  std::vector<uint64_t> offsets;
+  std::vector<uint32_t> nodes;
+  std::vector<uint32_t> index;
+};
+
+/**
+ * Finds the nodes of every cell that are the head (entries) or the tail (exits) of an arc which
+ * crosses into or out of the cell.
+ */
+boundary_t Boundary(const valhalla::baldr::PartitionOverlay::graph_t& graph, const bool entries) {
+  using namespace valhalla::baldr;
+  const auto node_count = graph.edges.size();
+  boundary_t boundary;
+  boundary.index.resize(graph.cell_counts.size() * node_count, kInvalidOverlayNode);
+  for (size_t level = 0; level < graph.cell_counts.size(); ++level) {
+    const auto* cells = graph.cells.data() + level * node_count;
+    auto* index = boundary.index.data() + level * node_count;
+    std::vector<bool> crossing(node_count, false);
+    for (uint32_t node = 0; node < node_count; ++node) {
+      for (auto a = graph.arc_offsets[node]; a < graph.arc_offsets[node + 1]; ++a) {
+        const uint32_t head = graph.arcs[a].node;
+        if (cells[node] != cells[head]) {
+          crossing[entries ? head : node] = true;
+        }
+      }
+    }
+
+    // counting sort of the crossing nodes by their cell
+    std::vector<uint64_t> offsets(graph.cell_counts[level] + 1, 0);
+    for (uint32_t node = 0; node < node_count; ++node) {
+      if (crossing[node]) {
+        index[node] = offsets[cells[node] + 1]++;
+      }
+    }
+    for (size_t cell = 0; cell < graph.cell_counts[level]; ++cell) {
+      offsets[cell + 1] += offsets[cell];
+    }
+    const auto first = boundary.nodes.size();
+    boundary.nodes.resize(first + offsets.back());
+    for (uint32_t node = 0; node < node_count; ++node) {
+      if (crossing[node]) {
+        boundary.nodes[first + offsets[cells[node]] + index[node]] = node;
+      }
+    }
+    for (auto& offset : offsets) {
+      boundary.offsets.push_back(first + offset);
+    }
+  }
+  return boundary;
+}
+
+} // namespace
+
+namespace valhalla {
+namespace baldr {
+
+PartitionOverlay::PartitionOverlay(const std::string& file) {
+  const auto size = std::filesystem::file_size(file);
+  if (size < sizeof(overlay_header_t)) {
+    throw std::runtime_error(file + " is not a partition overlay");
+  }
+  memory_.map(file, size, POSIX_MADV_NORMAL, true);
+
+  overlay_header_t header;
+  std::memcpy(&header, memory_.get(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) || header.version != kVersion) {
+    throw std::runtime_error(file + " is not a partition overlay of version " +
+                             std::to_string(kVersion));
+  }
+  level_count_ = header.level_count;
+  node_count_ = header.node_count;
+
+  const char* data = memory_.get() + sizeof(header);
+  const char* end = memory_.get() + size;
+  auto section = [&data, end, &file]<typename T>(const T*& pointer, size_t count) {
+    if (static_cast<size_t>(end - data) < padded(count * sizeof(T))) {
+      throw std::runtime_error(file + " is truncated");
+    }
+    pointer = reinterpret_cast<const T*>(data);
+    data += padded(count * sizeof(T));
+  };
+  section(edges_, node_count_);
+  section(arc_offsets_, node_count_ + 1);
+  section(arcs_, header.arc_count);
+  section(reverse_offsets_, node_count_ + 1);
+  section(reverse_arcs_, header.arc_count);
+  section(cell_counts_, level_count_);
+  level_offsets_.push_back(0);
+  for (uint32_t level = 0; level < level_count_; ++level) {
+    level_offsets_.push_back(level_offsets_.back() + cell_counts_[level] + 1);
+  }
+  section(cells_, level_count_ * node_count_);
+  section(entry_offsets_, level_offsets_.back());
+  section(entries_, header.entry_count);
+  section(exit_offsets_, level_offsets_.back());
+  section(exits_, header.exit_count);
+  section(entry_index_, level_count_ * node_count_);
+  section(exit_index_, level_count_ * node_count_);
+  if (data != end) {
+    throw std::runtime_error(file + " has trailing data");
+  }
+}
+
+void PartitionOverlay::Write(const std::string& file, const graph_t& graph) {
+  const auto node_count = graph.edges.size();
+  if (graph.arc_offsets.size() != node_count + 1 || graph.arc_offsets.back() != graph.arcs.size() ||
+      graph.cells.size() != graph.cell_counts.size() * node_count) {
+    throw std::logic_error("Inconsistent partition overlay");
+  }
+
+  // the arcs by their head, keeping the index of the forward arc for its customized cost
+  std::vector<uint64_t> reverse_offsets(node_count + 1, 0);
+  for (const auto& arc : graph.arcs) {
+    ++reverse_offsets[arc.node + 1];
+  }
+  for (size_t node = 0; node < node_count; ++node) {
+    reverse_offsets[node + 1] += reverse_offsets[node];
+  }
+  std::vector<overlay_reverse_arc_t> reverse_arcs(graph.arcs.size());
+  auto fill = reverse_offsets;
+  for (uint32_t node = 0; node < node_count; ++node) {
+    for (auto a = graph.arc_offsets[node]; a < graph.arc_offsets[node + 1]; ++a) {
+      reverse_arcs[fill[graph.arcs[a].node]++] = {node, static_cast<uint32_t>(a)};
+    }
+  }
+
+  const auto entries = Boundary(graph, true);
+  const auto exits = Boundary(graph, false);
+
+  // write to a temporary file and move it in place so a running service never maps half a file
+  const auto parent = std::filesystem::path(file).parent_path();
+  if (!parent.empty()) {
+    std::filesystem::create_directories(parent);
+  }
+  const auto tmp = file + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      throw std::runtime_error("Could not open " + tmp);
+    }
+    overlay_header_t header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.level_count = graph.cell_counts.size();
+    header.node_count = node_count;
+    header.arc_count = graph.arcs.size();
+    header.entry_count = entries.nodes.size();
+    header.exit_count = exits.nodes.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write(out, graph.edges);
+    write(out, graph.arc_offsets);
+    write(out, graph.arcs);
+    write(out, reverse_offsets);
+    write(out, reverse_arcs);
+    write(out, graph.cell_counts);
+    write(out, graph.cells);
+    write(out, entries.offsets);
+    write(out, entries.nodes);
+    write(out, exits.offsets);
+    write(out, exits.nodes);
+    write(out, entries.index);
+    write(out, exits.index);
+    if (!out) {
+      throw std::runtime_error("Could not write " + tmp);
+    }
+  }
+  std::filesystem::rename(tmp, file);
+}
+
+std::string PartitionOverlay::FileName(const boost::property_tree::ptree& mjolnir) {
+  auto file = mjolnir.get<std::string>("overlay.file", "");
+  if (file.empty()) {
+    const auto tile_dir = mjolnir.get<std::string>("tile_dir", "");
+    if (!tile_dir.empty()) {
+      file = (std::filesystem::path(tile_dir) / "overlay.bin").string();
+    }
+  }
+  return file;
+}
+
+uint32_t PartitionOverlay::node(const GraphId& edgeid) const {
+  const auto* end = edges_ + node_count_;
+  const auto* found = std::lower_bound(edges_, end, static_cast<uint64_t>(edgeid.value));
+  return found != end && *found == edgeid.value ? static_cast<uint32_t>(found - edges_)
+                                                : kInvalidOverlayNode;
+}
+
+} // namespace baldr
+} // namespace valhalla
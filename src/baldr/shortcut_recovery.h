@@ -40,6 +40,9 @@ protected:
         // this shouldnt fail but garbled files could cause it
         auto tile = reader->GetGraphTile(tile_id);
         assert(tile);
+        // tiles storing the edges of their shortcuts dont need the cache
+        if (tile->header()->shortcut_edges_offset() > 0)
+          continue;
         // for each edge in the tile
         for (const auto& edge : tile->GetDirectedEdges()) {
           // skip non-shortcuts or the shortcut is one we wont use
@@ -4,6 +4,7 @@
 #include "baldr/rapidjson_utils.h"
 #include "baldr/tilehierarchy.h"
 #include "graph_utils_module.h"
+#include "loki/search.h"
 #include "midgard/aabb2.h"
 #include "midgard/boost_geom_types.h"
 #include "midgard/logging.h"
@@ -194,6 +195,27 @@ void init_graphid(nb::module_& m) {
 
             return result;
           },
-          nb::arg("edge_id"), nb::call_guard<nb::gil_scoped_release>());
+          nb::arg("edge_id"), nb::call_guard<nb::gil_scoped_release>())
+      .def(
+          "nearest_edges",
+          [](vb::GraphReader& self, double lon, double lat, size_t k, float search_cutoff)
+              -> std::vector<std::tuple<vb::GraphId, double, double, double, double>> {
+            check_coord(lon, lat, lon, lat);
+
+            valhalla::loki::Search search(self);
+            auto edges = search.nearest_edges(vm::PointLL(lon, lat), k, search_cutoff);
+
+            // Convert to list of (edge_id, lon, lat, distance, percent_along) tuples
+            std::vector<std::tuple<vb::GraphId, double, double, double, double>> result;
+            result.reserve(edges.size());
+            for (const auto& edge : edges) {
+              result.emplace_back(edge.id, edge.point.lng(), edge.point.lat(), edge.distance,
+                                  edge.percent_along);
+            }
+
+            return result;
+          },
+          nb::arg("lon"), nb::arg("lat"), nb::arg("k") = 1, nb::arg("search_cutoff") = 35000.f,
+          nb::call_guard<nb::gil_scoped_release>());
 }
 } // namespace pyvalhalla
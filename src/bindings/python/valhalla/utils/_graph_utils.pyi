@@ -133,3 +133,19 @@ class _GraphUtils:
         :returns: List of (lon, lat) tuples representing the edge geometry
         :raises RuntimeError: When the tile or edge is not found
         """
+
+    def nearest_edges(
+        self, lon: float, lat: float, k: int = 1, search_cutoff: float = 35000.0
+    ) -> List[Tuple[GraphId, float, float, float, float]]:
+        """Find the k edges closest to a coordinate, closest first. This is a bare snap without
+        any costing, reachability or heading considerations and only one direction of each edge
+        pair is returned.
+
+        :param lon: The longitude to snap.
+        :param lat: The latitude to snap.
+        :param k: The maximum number of edges to return.
+        :param search_cutoff: The maximum distance in meters an edge may be from the coordinate.
+        :returns: List of (edge_id, lon, lat, distance, percent_along) tuples where lon/lat is the
+                  closest point on the edge and percent_along is in the edge's direction
+        :raises ValueError: When the coord is invalid
+        """
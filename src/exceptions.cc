@@ -151,6 +151,8 @@ const std::unordered_map<int, std::string> warning_codes = {
   {213, R"(CostMatrix algorithm used, ignoring "matrix_locations")"},
   {214, R"(Distance exceeded max_timedep_distance for arrive_by, probably ignoring date_time)"},
   {215, R"(At least one location had no correlated edges, resorting to filtered edges)"},
+  {216, R"("accessibility" needs a contraction hierarchy built with the costing options and no date_time, ignoring accessibility)"},
+  {217, R"("profile_departures" needs a depart_at or current date_time on fewer sources than targets with the time dependent matrix, ignoring the profile)"},
   // 3xx is used when costing or location options were specified but we had to change them internally for some reason
   {300, R"(Many:Many CostMatrix was requested, but server only allows 1:Many TimeDistanceMatrix)"},
   {301, R"(1:Many TimeDistanceMatrix was requested, but server only allows Many:Many CostMatrix)"},
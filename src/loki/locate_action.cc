@@ -1,10 +1,107 @@
+#include "baldr/rapidjson_utils.h"
 #include "loki/search.h"
 #include "loki/worker.h"
 #include "tyr/serializers.h"
 
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 using namespace valhalla;
 using namespace valhalla::baldr;
 
+namespace {
+
+// a chunk of consecutive input lines and its position in the input
+struct batch_t {
+  size_t sequence = 0;
+  std::vector<std::string> lines;
+};
+
+// the locate request minus its opening brace so that each batch can put its locations in front of
+// it, eg {"costing":"auto"} becomes ,"costing":"auto"}
+std::string request_tail(const std::string& request) {
+  rapidjson::Document doc;
+  doc.Parse(request.empty() ? "{}" : request.c_str());
+  if (doc.HasParseError() || !doc.IsObject())
+    throw valhalla_exception_t{100};
+  if (doc.HasMember("locations"))
+    throw valhalla_exception_t{100, "locations come from the input stream, not the request"};
+
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  doc.Accept(writer);
+  std::string tail(buffer.GetString() + 1, buffer.GetSize() - 1);
+  return doc.ObjectEmpty() ? tail : "," + tail;
+}
+
+// correlates the locations in the range in one request, each line has to be a single location so
+// that neither more locations nor other parts of the request sneak in with it
+std::string locate_range(loki::loki_worker_t& worker,
+                         std::vector<std::string>::const_iterator begin,
+                         std::vector<std::string>::const_iterator end,
+                         const std::string& tail) {
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  writer.StartObject();
+  writer.Key("locations");
+  writer.StartArray();
+  for (auto line = begin; line != end; ++line) {
+    rapidjson::Document location;
+    location.Parse(line->c_str());
+    if (location.HasParseError() || !location.IsObject())
+      throw valhalla_exception_t{130};
+    location.Accept(writer);
+  }
+  writer.EndArray();
+  // the rest of the request is put on as it is, so the object isn't closed by the writer
+  std::string json(buffer.GetString(), buffer.GetSize());
+  json.append(tail);
+
+  Api request;
+  ParseApi(json, Options::locate, request);
+  return worker.locate_lines(request);
+}
+
+// a single line of output for a location that could not be correlated at all
+std::string error_line(const valhalla_exception_t& e) {
+  Api request;
+  auto line = serialize_error(e, request);
+  line.push_back('\n');
+  return line;
+}
+
+// correlates a whole batch at once, if that fails it falls back to one request per line so that only
+// the offending lines turn into errors and the output still lines up with the input
+std::string locate_batch(loki::loki_worker_t& worker,
+                         const std::vector<std::string>& lines,
+                         const std::string& tail) {
+  if (lines.size() > 1) {
+    try {
+      return locate_range(worker, lines.begin(), lines.end(), tail);
+    } catch (...) {}
+  }
+
+  std::string output;
+  for (auto line = lines.begin(); line != lines.end(); ++line) {
+    try {
+      output.append(locate_range(worker, line, line + 1, tail));
+    } catch (const valhalla_exception_t& e) {
+      output.append(error_line(e));
+    } catch (const std::exception& e) {
+      output.append(error_line(valhalla_exception_t{199, std::string(e.what())}));
+    }
+  }
+  return output;
+}
+
+} // namespace
+
 namespace valhalla {
 namespace loki {
 
@@ -16,10 +113,7 @@ void loki_worker_t::init_locate(Api& request) {
   parse_costing(request, true);
 }
 
-std::string loki_worker_t::locate(Api& request) {
-  // time this whole method and save that statistic
-  auto _ = measure_scope_time(request);
-
+void loki_worker_t::correlate_locate(Api& request) {
   // correlate the various locations to the underlying graph
   init_locate(request);
   auto* options = request.mutable_options();
@@ -41,8 +135,129 @@ std::string loki_worker_t::locate(Api& request) {
   } else {
     search_.search(*locations, mode_costing[static_cast<size_t>(mode)]);
   }
+}
+
+std::string loki_worker_t::locate(Api& request) {
+  // time this whole method and save that statistic
+  auto _ = measure_scope_time(request);
+
+  correlate_locate(request);
   return tyr::serializeLocate(request, *reader);
 }
 
+std::string loki_worker_t::locate_lines(Api& request) {
+  // time this whole method and save that statistic
+  auto _ = measure_scope_time(request);
+
+  correlate_locate(request);
+  return tyr::serializeLocateLines(request, *reader);
+}
+
+void locate_stream(const boost::property_tree::ptree& config,
+                   const std::string& request,
+                   std::istream& input,
+                   std::ostream& output,
+                   size_t concurrency,
+                   size_t batch_size) {
+  concurrency = std::max<size_t>(concurrency, 1);
+  batch_size = std::max<size_t>(batch_size, 1);
+  const auto tail = request_tail(request);
+
+  // workers are made up front so that a bad config throws here rather than in a thread
+  std::vector<std::unique_ptr<loki_worker_t>> workers;
+  for (size_t i = 0; i < concurrency; ++i)
+    workers.emplace_back(std::make_unique<loki_worker_t>(config));
+
+  // batches are numbered as they are read and written strictly in that order, the number of batches
+  // between those two points is capped so a slow batch cant let the rest of the input pile up
+  const size_t max_in_flight = concurrency * 2;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<batch_t> pending;
+  std::map<size_t, std::string> finished;
+  size_t next_read = 0, next_write = 0;
+  bool done_reading = false;
+
+  auto work = [&](loki_worker_t& worker) {
+    while (true) {
+      batch_t batch;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return !pending.empty() || done_reading; });
+        if (pending.empty())
+          return;
+        batch = std::move(pending.front());
+        pending.pop_front();
+      }
+      auto lines = locate_batch(worker, batch.lines, tail);
+      worker.cleanup();
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.emplace(batch.sequence, std::move(lines));
+      }
+      cv.notify_all();
+    }
+  };
+
+  // writes out every batch that is next in line, the writing itself happens outside of the lock
+  auto flush = [&](std::unique_lock<std::mutex>& lock) {
+    for (auto itr = finished.find(next_write); itr != finished.end();
+         itr = finished.find(next_write)) {
+      auto lines = std::move(itr->second);
+      finished.erase(itr);
+      ++next_write;
+      lock.unlock();
+      output << lines;
+      lock.lock();
+    }
+  };
+
+  // hands a batch to the workers once there is room for it
+  auto enqueue = [&](batch_t& batch) {
+    std::unique_lock<std::mutex> lock(mutex);
+    flush(lock);
+    while (next_read - next_write >= max_in_flight) {
+      cv.wait(lock, [&] { return finished.count(next_write) > 0; });
+      flush(lock);
+    }
+    batch.sequence = next_read++;
+    pending.emplace_back(std::move(batch));
+    batch = batch_t{};
+    lock.unlock();
+    cv.notify_all();
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(workers.size());
+  for (auto& worker : workers)
+    threads.emplace_back(work, std::ref(*worker));
+
+  batch_t batch;
+  std::string line;
+  while (std::getline(input, line)) {
+    if (std::all_of(line.begin(), line.end(), [](unsigned char c) { return std::isspace(c); }))
+      continue;
+    batch.lines.emplace_back(std::move(line));
+    if (batch.lines.size() == batch_size)
+      enqueue(batch);
+  }
+  if (!batch.lines.empty())
+    enqueue(batch);
+
+  // let the workers drain what is left and write it as it comes in
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    done_reading = true;
+    cv.notify_all();
+    while (next_write < next_read) {
+      cv.wait(lock, [&] { return finished.count(next_write) > 0; });
+      flush(lock);
+    }
+  }
+  for (auto& thread : threads)
+    thread.join();
+  output.flush();
+}
+
 } // namespace loki
 } // namespace valhalla
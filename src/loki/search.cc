@@ -266,6 +266,7 @@ struct bin_handler_t {
   cost_ptr_t costing;
   unsigned int max_reach_limit;
   std::vector<candidate_t> bin_candidates;
+  std::vector<PointLL> edge_shape;
   ankerl::unordered_dense::set<uint64_t> correlated_edges;
   Reach reach_finder;
 
@@ -595,35 +596,23 @@ struct bin_handler_t {
       // of the shape which are on the same side of h that p is. to make this fast we would need a
       // a trivial half plane test as maybe a single dot product and comparison?
 
-      // get some shape of the edge
+      // decode the shape of the edge once into a reusable buffer
       auto edge_info = tile->edgeinfo(edge);
       auto shape = edge_info.lazy_shape();
-      PointLL v;
-      if (!shape.empty()) {
-        v = shape.pop();
+      edge_shape.clear();
+      while (!shape.empty()) {
+        edge_shape.emplace_back(shape.pop());
       }
 
-      // iterate along this edges segments projecting each of the points
-      for (size_t i = 0; !shape.empty(); ++i) {
-        auto u = v;
-        v = shape.pop();
-        // for each input point
-        c_itr = bin_candidates.begin();
-        for (p_itr = begin; p_itr != end; ++p_itr, ++c_itr) {
-          // skip updating this candidate because it was prefiltered
-          if (c_itr->prefiltered) {
-            continue;
-          }
-          // how close is the input to this segment
-          auto point = p_itr->project(u, v);
-          auto sq_distance = p_itr->project.approx.DistanceSquared(point);
-          // do we want to keep it
-          if (sq_distance < c_itr->sq_distance) {
-            c_itr->sq_distance = sq_distance;
-            c_itr->point = std::move(point);
-            c_itr->index = i;
-          }
+      // for each input point find the closest point along all of this edges segments
+      c_itr = bin_candidates.begin();
+      for (p_itr = begin; p_itr != end; ++p_itr, ++c_itr) {
+        // skip updating this candidate because it was prefiltered
+        if (c_itr->prefiltered) {
+          continue;
         }
+        c_itr->sq_distance =
+            p_itr->project(edge_shape.data(), edge_shape.size(), c_itr->point, c_itr->index);
       }
 
       // if we already have a better reachable candidate we can just assume this one is reachable
@@ -762,6 +751,120 @@ struct bin_handler_t {
     finalize();
   }
 
+  // the k edges closest to the point, scanning bins closest first until no bin can hold anything
+  // closer than the kth best edge found so far
+  std::vector<EdgeCandidate> nearest_edges(const PointLL& point,
+                                           size_t k,
+                                           double search_cutoff,
+                                           const cost_ptr_t& costing) {
+    std::vector<EdgeCandidate> results;
+    if (k == 0) {
+      return results;
+    }
+
+    // the candidates are kept as a max heap on distance so the worst one is always at the front
+    struct nearest_t {
+      double sq_distance;
+      PointLL point;
+      size_t index;
+      GraphId edge_id;
+      bool operator<(const nearest_t& other) const {
+        return sq_distance < other.sq_distance;
+      }
+    };
+    std::vector<nearest_t> nearest;
+    nearest.reserve(k + 1);
+
+    // edges which span several bins show up in each of them
+    correlated_edges.clear();
+    projector_t project(point);
+    auto binner = make_binner(point);
+    const auto level = TileHierarchy::levels().back().level;
+    graph_tile_ptr bin_tile, tile;
+    while (true) {
+      int32_t tile_index;
+      unsigned short bin_index;
+      double distance;
+      std::tie(tile_index, bin_index, distance) = binner();
+      if (distance > search_cutoff ||
+          (nearest.size() == k && distance > std::sqrt(nearest.front().sq_distance))) {
+        break;
+      }
+      if (!reader.GetGraphTile(GraphId(tile_index, level, 0), bin_tile)) {
+        continue;
+      }
+
+      for (auto edge_id : bin_tile->GetBin(bin_index)) {
+        if (!reader.GetGraphTile(edge_id, tile)) {
+          continue;
+        }
+        // without costing we still never want shortcuts, otherwise use whichever direction of the
+        // edge the costing allows
+        const auto* edge = tile->directededge(edge_id);
+        if (costing ? !costing->Allowed(edge, tile, kDisallowShortcut) : edge->is_shortcut()) {
+          const DirectedEdge* opp_edge = nullptr;
+          graph_tile_ptr opp_tile = tile;
+          GraphId opp_edgeid;
+          if (!costing || !(opp_edgeid = reader.GetOpposingEdgeId(edge_id, opp_edge, opp_tile)) ||
+              !costing->Allowed(opp_edge, opp_tile, kDisallowShortcut)) {
+            continue;
+          }
+          edge_id = opp_edgeid;
+          edge = opp_edge;
+          tile = opp_tile;
+        }
+        if (!correlated_edges.insert(edge_id).second) {
+          continue;
+        }
+
+        // project onto the shape
+        auto shape = tile->edgeinfo(edge).lazy_shape();
+        edge_shape.clear();
+        while (!shape.empty()) {
+          edge_shape.emplace_back(shape.pop());
+        }
+        nearest_t candidate{0, {}, 0, edge_id};
+        candidate.sq_distance =
+            project(edge_shape.data(), edge_shape.size(), candidate.point, candidate.index);
+        if (candidate.sq_distance > square(search_cutoff) ||
+            (nearest.size() == k && !(candidate < nearest.front()))) {
+          continue;
+        }
+
+        // keep it and drop the worst one if we have too many
+        nearest.push_back(candidate);
+        std::push_heap(nearest.begin(), nearest.end());
+        if (nearest.size() > k) {
+          std::pop_heap(nearest.begin(), nearest.end());
+          nearest.pop_back();
+        }
+      }
+    }
+
+    // fill out the results closest first
+    std::sort_heap(nearest.begin(), nearest.end());
+    results.reserve(nearest.size());
+    for (const auto& candidate : nearest) {
+      auto tile = reader.GetGraphTile(candidate.edge_id);
+      const auto* edge = tile->directededge(candidate.edge_id);
+      const auto& shape = tile->edgeinfo(edge).shape();
+      // we need the ratio in the direction of the edge
+      double partial_length = 0;
+      for (size_t i = 0; i < candidate.index; ++i) {
+        partial_length += shape[i].Distance(shape[i + 1]);
+      }
+      partial_length += shape[candidate.index].Distance(candidate.point);
+      partial_length = std::min(partial_length, static_cast<double>(edge->length()));
+      double length_ratio = edge->length() ? partial_length / edge->length() : 0.;
+      if (!edge->forward()) {
+        length_ratio = 1. - length_ratio;
+      }
+      results.push_back(EdgeCandidate{candidate.edge_id, candidate.point,
+                                      candidate.point.Distance(point), length_ratio});
+    }
+    return results;
+  }
+
 private:
   // create the PathLocation corresponding to the best projection of the given candidate
   void finalize() {
@@ -872,5 +975,12 @@ void Search::search(google::protobuf::RepeatedPtrField<Location>& locations,
   handler_->search(locations, costing);
 }
 
+std::vector<EdgeCandidate> Search::nearest_edges(const midgard::PointLL& point,
+                                                 size_t k,
+                                                 float search_cutoff,
+                                                 const sif::cost_ptr_t& costing) {
+  return handler_->nearest_edges(point, k, search_cutoff, costing);
+}
+
 } // namespace loki
 } // namespace valhalla
@@ -219,6 +219,9 @@ void loki_worker_t::parse_costing(Api& api, bool allow_none) {
     options.set_alternates(max_alternates);
   if (options.action() == Options::trace_attributes && options.alternates() > max_trace_alternates)
     options.set_alternates(max_trace_alternates);
+  // same for the departures of a matrix profile
+  if (options.profile_departures() > max_profile_departures)
+    options.set_profile_departures(max_profile_departures);
 }
 
 loki_worker_t::loki_worker_t(const boost::property_tree::ptree& config,
@@ -290,7 +293,7 @@ loki_worker_t::loki_worker_t(const boost::property_tree::ptree& config,
         kv.first == "max_distance_disable_hierarchy_culling" || kv.first == "skadi" ||
         kv.first == "status" || kv.first == "allow_hard_exclusions" ||
         kv.first == "hierarchy_limits" || kv.first == "min_linear_cost_factor" ||
-        kv.first == "max_linear_cost_edges") {
+        kv.first == "max_linear_cost_edges" || kv.first == "max_profile_departures") {
       continue;
     }
     if (kv.first != "trace" && kv.first != "auto_pedestrian") {
@@ -358,6 +361,7 @@ loki_worker_t::loki_worker_t(const boost::property_tree::ptree& config,
   max_trace_alternates = config.get<unsigned int>("service_limits.trace.max_alternates");
   max_trace_alternates_shape = config.get<size_t>("service_limits.trace.max_alternates_shape");
   max_alternates = config.get<unsigned int>("service_limits.max_alternates");
+  max_profile_departures = config.get<unsigned int>("service_limits.max_profile_departures", 96);
   allow_verbose = config.get<bool>("service_limits.status.allow_verbose", false);
   max_timedep_dist_matrix = config.get<size_t>("service_limits.max_timedep_distance_matrix", 0);
   // assign max_distance_disable_hierarchy_culling
@@ -13,6 +13,11 @@
 #include <boost/archive/iterators/transform_width.hpp>
 #include <sys/stat.h>
 
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define VALHALLA_PROJECTOR_AVX2
+#include <immintrin.h>
+#endif
+
 #include <algorithm>
 #include <array>
 #include <cctype>
@@ -830,6 +835,143 @@ polygon_t to_boundary(const std::unordered_set<uint32_t>& region, const Tiles<Po
   return polygon;
 }
 
+namespace {
+
+// closest projection of p onto the segments [begin, count - 1) of the shape, one at a time
+double project_scalar(const projector_t& p,
+                      const PointLL* shape,
+                      size_t begin,
+                      size_t count,
+                      double best,
+                      PointLL& closest,
+                      size_t& index) {
+  for (size_t i = begin; i + 1 < count; ++i) {
+    auto point = p(shape[i], shape[i + 1]);
+    auto sq_distance = p.approx.DistanceSquared(point);
+    if (sq_distance < best) {
+      best = sq_distance;
+      closest = point;
+      index = i;
+    }
+  }
+  return best;
+}
+
+#ifdef VALHALLA_PROJECTOR_AVX2
+// same as above but 4 segments at a time. every operation mirrors the scalar one in the same order
+// and without fused multiply-adds so unless the compiler contracts the scalar code the results match.
+// only full registers are done here, the remaining segments are left for the scalar code which the
+// caller runs so that we dont jump into sse code without clearing the upper halves of the registers
+__attribute__((target("avx2"))) double project_avx2(const projector_t& p,
+                                                    const PointLL* shape,
+                                                    size_t count,
+                                                    size_t& end,
+                                                    PointLL& closest,
+                                                    size_t& index) {
+  const __m256d lon_scale = _mm256_set1_pd(p.lon_scale);
+  const __m256d lat = _mm256_set1_pd(p.lat);
+  const __m256d lng = _mm256_set1_pd(p.lng);
+  const __m256d m_per_lat = _mm256_set1_pd(kMetersPerDegreeLat);
+  const __m256d m_per_lng = _mm256_set1_pd(p.approx.GetMetersPerLngDegree());
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d four = _mm256_set1_pd(4);
+
+  __m256d best = _mm256_set1_pd(std::numeric_limits<double>::max());
+  __m256d best_x = zero, best_y = zero, best_i = zero;
+  __m256d i_vec = _mm256_set_pd(3, 2, 1, 0);
+
+  size_t i = 0;
+  for (; i + 4 < count; i += 4, i_vec = _mm256_add_pd(i_vec, four)) {
+    // deinterleave the lng,lat pairs of the segments end points
+    const double* s = &shape[i].first;
+    const __m256d u01 = _mm256_loadu_pd(s), u23 = _mm256_loadu_pd(s + 4);
+    const __m256d v01 = _mm256_loadu_pd(s + 2), v23 = _mm256_loadu_pd(s + 6);
+    const __m256d ux = _mm256_permute4x64_pd(_mm256_unpacklo_pd(u01, u23), 0xd8);
+    const __m256d uy = _mm256_permute4x64_pd(_mm256_unpackhi_pd(u01, u23), 0xd8);
+    const __m256d vx = _mm256_permute4x64_pd(_mm256_unpacklo_pd(v01, v23), 0xd8);
+    const __m256d vy = _mm256_permute4x64_pd(_mm256_unpackhi_pd(v01, v23), 0xd8);
+
+    // project onto the segments, see the scalar operator for an explanation
+    const __m256d bx = _mm256_sub_pd(vx, ux);
+    const __m256d by = _mm256_sub_pd(vy, uy);
+    const __m256d bx2 = _mm256_mul_pd(bx, lon_scale);
+    const __m256d sq = _mm256_add_pd(_mm256_mul_pd(bx2, bx2), _mm256_mul_pd(by, by));
+    const __m256d scale =
+        _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_sub_pd(lng, ux), lon_scale), bx2),
+                      _mm256_mul_pd(_mm256_sub_pd(lat, uy), by));
+    const __m256d t = _mm256_div_pd(scale, sq);
+    __m256d x = _mm256_add_pd(ux, _mm256_mul_pd(bx, t));
+    __m256d y = _mm256_add_pd(uy, _mm256_mul_pd(by, t));
+
+    // clamp to the end points, before u wins over after v which covers zero length segments
+    const __m256d after_v = _mm256_cmp_pd(scale, sq, _CMP_GE_OQ);
+    x = _mm256_blendv_pd(x, vx, after_v);
+    y = _mm256_blendv_pd(y, vy, after_v);
+    const __m256d before_u = _mm256_cmp_pd(scale, zero, _CMP_LE_OQ);
+    x = _mm256_blendv_pd(x, ux, before_u);
+    y = _mm256_blendv_pd(y, uy, before_u);
+
+    // approximate squared distance from the input point
+    const __m256d dy = _mm256_mul_pd(_mm256_sub_pd(y, lat), m_per_lat);
+    const __m256d dx = _mm256_mul_pd(_mm256_sub_pd(x, lng), m_per_lng);
+    const __m256d sq_distance = _mm256_add_pd(_mm256_mul_pd(dy, dy), _mm256_mul_pd(dx, dx));
+
+    // each lane keeps its first best
+    const __m256d better = _mm256_cmp_pd(sq_distance, best, _CMP_LT_OQ);
+    best = _mm256_blendv_pd(best, sq_distance, better);
+    best_x = _mm256_blendv_pd(best_x, x, better);
+    best_y = _mm256_blendv_pd(best_y, y, better);
+    best_i = _mm256_blendv_pd(best_i, i_vec, better);
+  }
+
+  end = i;
+
+  // reduce the lanes preferring the lowest segment index on ties
+  alignas(32) double lane_best[4], lane_x[4], lane_y[4], lane_i[4];
+  _mm256_store_pd(lane_best, best);
+  _mm256_store_pd(lane_x, best_x);
+  _mm256_store_pd(lane_y, best_y);
+  _mm256_store_pd(lane_i, best_i);
+  double result = std::numeric_limits<double>::max();
+  int best_lane = -1;
+  for (int lane = 0; lane < 4; ++lane) {
+    if (lane_best[lane] < result ||
+        (best_lane != -1 && lane_best[lane] == result && lane_i[lane] < lane_i[best_lane])) {
+      result = lane_best[lane];
+      best_lane = lane;
+    }
+  }
+  if (best_lane != -1) {
+    closest = PointLL(lane_x[best_lane], lane_y[best_lane]);
+    index = static_cast<size_t>(lane_i[best_lane]);
+  }
+
+  return result;
+}
+
+bool has_avx2() {
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+}
+#endif
+
+} // namespace
+
+double projector_t::operator()(const PointLL* shape,
+                               size_t count,
+                               PointLL& closest,
+                               size_t& index) const {
+#ifdef VALHALLA_PROJECTOR_AVX2
+  // not worth the setup unless we can fill at least one register
+  if (count > 4 && has_avx2()) {
+    size_t end;
+    double best = project_avx2(*this, shape, count, end, closest, index);
+    return project_scalar(*this, shape, end, count, best, closest, index);
+  }
+#endif
+  return project_scalar(*this, shape, 0, count, std::numeric_limits<double>::max(), closest, index);
+}
+
 constexpr char PADDING_ENCODED = '=';
 constexpr char ZERO_ENCODED = 'A';
 
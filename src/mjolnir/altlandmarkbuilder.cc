@@ -0,0 +1,291 @@
+#include "mjolnir/altlandmarkbuilder.h"
+#include "baldr/alt_landmarks.h"
+#include "baldr/graphconstants.h"
+#include "baldr/graphreader.h"
+#include "baldr/tilehierarchy.h"
+#include "midgard/logging.h"
+#include "scoped_timer.h"
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <string>
+#include <vector>
+
+using namespace valhalla::baldr;
+
+namespace {
+
+using table_t = AltLandmarks::table_t;
+
+constexpr uint32_t kInvalidNode = std::numeric_limits<uint32_t>::max();
+
+// Regions with fewer than this share of all nodes get no landmark, the crow flies distance does
+constexpr double kMinRegionShare = 0.001;
+
+struct arc_t {
+  uint32_t head;
+  float length;
+};
+
+// The road levels as a plain directed graph of nodes, in both directions
+struct graph_t {
+  std::vector<uint64_t> offsets;
+  std::vector<arc_t> arcs;
+  std::vector<uint64_t> reverse_offsets;
+  std::vector<arc_t> reverse_arcs;
+};
+
+/**
+ * Collects the nodes of the road levels and the edges any mode may take in their direction. A
+ * transition between levels is an arc of no length, so the distances hold on every level.
+ */
+void AddGraph(GraphReader& reader, table_t& table, graph_t& graph) {
+  for (const auto& level : TileHierarchy::levels()) {
+    for (const auto& tile_id : reader.GetTileSet(level.level)) {
+      table.tiles.push_back(tile_id.value);
+    }
+  }
+  std::sort(table.tiles.begin(), table.tiles.end());
+  table.tile_offsets.push_back(0);
+  for (const auto tile_id : table.tiles) {
+    auto tile = reader.GetGraphTile(GraphId(tile_id));
+    table.tile_offsets.push_back(table.tile_offsets.back() +
+                                 (tile ? tile->header()->nodecount() : 0));
+    if (reader.OverCommitted()) {
+      reader.Trim();
+    }
+  }
+
+  auto index = [&table](const GraphId& node) {
+    auto found = std::lower_bound(table.tiles.begin(), table.tiles.end(), node.tile_base().value);
+    if (found == table.tiles.end() || *found != node.tile_base().value) {
+      return kInvalidNode;
+    }
+    const auto i = found - table.tiles.begin();
+    return node.id() < table.tile_offsets[i + 1] - table.tile_offsets[i]
+               ? static_cast<uint32_t>(table.tile_offsets[i] + node.id())
+               : kInvalidNode;
+  };
+
+  const auto node_count = table.tile_offsets.back();
+  graph.offsets.reserve(node_count + 1);
+  for (size_t i = 0; i < table.tiles.size(); ++i) {
+    auto tile = reader.GetGraphTile(GraphId(table.tiles[i]));
+    const auto count = table.tile_offsets[i + 1] - table.tile_offsets[i];
+    for (uint32_t n = 0; n < count; ++n) {
+      graph.offsets.push_back(graph.arcs.size());
+      const auto* nodeinfo = tile->node(n);
+      for (uint32_t e = 0; e < nodeinfo->edge_count(); ++e) {
+        const auto* edge = tile->directededge(nodeinfo->edge_index() + e);
+        const auto head = index(edge->endnode());
+        if ((edge->forwardaccess() & kAllAccess) && head != kInvalidNode) {
+          graph.arcs.push_back({head, static_cast<float>(edge->length())});
+        }
+      }
+      for (const auto& trans : tile->GetNodeTransitions(nodeinfo)) {
+        const auto head = index(trans.endnode());
+        if (head != kInvalidNode) {
+          graph.arcs.push_back({head, 0.f});
+        }
+      }
+    }
+    if (reader.OverCommitted()) {
+      reader.Trim();
+    }
+  }
+  graph.offsets.push_back(graph.arcs.size());
+
+  graph.reverse_offsets.assign(node_count + 1, 0);
+  for (const auto& arc : graph.arcs) {
+    ++graph.reverse_offsets[arc.head + 1];
+  }
+  for (size_t node = 0; node < node_count; ++node) {
+    graph.reverse_offsets[node + 1] += graph.reverse_offsets[node];
+  }
+  graph.reverse_arcs.resize(graph.arcs.size());
+  auto fill = graph.reverse_offsets;
+  for (uint32_t node = 0; node < node_count; ++node) {
+    for (auto a = graph.offsets[node]; a < graph.offsets[node + 1]; ++a) {
+      graph.reverse_arcs[fill[graph.arcs[a].head]++] = {node, graph.arcs[a].length};
+    }
+  }
+}
+
+// shortest distances from a node along the arcs
+void Dijkstra(const std::vector<uint64_t>& offsets,
+              const std::vector<arc_t>& arcs,
+              const uint32_t source,
+              std::vector<float>& distances) {
+  distances.assign(offsets.size() - 1, kUnreachedLandmark);
+  using entry_t = std::pair<float, uint32_t>;
+  std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>> queue;
+  distances[source] = 0;
+  queue.emplace(0.f, source);
+  while (!queue.empty()) {
+    const auto [distance, node] = queue.top();
+    queue.pop();
+    if (distance > distances[node]) {
+      continue;
+    }
+    for (auto a = offsets[node]; a < offsets[node + 1]; ++a) {
+      const auto& arc = arcs[a];
+      if (distance + arc.length < distances[arc.head]) {
+        distances[arc.head] = distance + arc.length;
+        queue.emplace(distances[arc.head], arc.head);
+      }
+    }
+  }
+}
+
+// the weakly connected regions of the graph
+std::vector<uint32_t> Regions(const graph_t& graph) {
+  std::vector<uint32_t> parent(graph.offsets.size() - 1);
+  std::iota(parent.begin(), parent.end(), 0);
+  auto find = [&parent](uint32_t node) {
+    while (parent[node] != node) {
+      node = parent[node] = parent[parent[node]];
+    }
+    return node;
+  };
+  for (uint32_t node = 0; node < parent.size(); ++node) {
+    for (auto a = graph.offsets[node]; a < graph.offsets[node + 1]; ++a) {
+      parent[find(node)] = find(graph.arcs[a].head);
+    }
+  }
+  for (uint32_t node = 0; node < parent.size(); ++node) {
+    parent[node] = find(node);
+  }
+  return parent;
+}
+
+/**
+ * Picks the landmarks of every region the farthest first: the first one is the farthest node
+ * from somewhere in the region, every next one is the node farthest from all previous ones there
+ * and back. Landmarks on the periphery give the best bounds for the paths across the region.
+ */
+void SelectLandmarks(const graph_t& graph, const uint32_t landmark_count, table_t& table) {
+  const auto node_count = graph.offsets.size() - 1;
+  const auto regions = Regions(graph);
+  std::vector<uint32_t> sizes(node_count, 0);
+  for (const auto region : regions) {
+    ++sizes[region];
+  }
+  std::vector<uint32_t> order;
+  for (uint32_t region = 0; region < node_count; ++region) {
+    if (sizes[region] > 0 && sizes[region] >= kMinRegionShare * node_count) {
+      order.push_back(region);
+    }
+  }
+  std::sort(order.begin(), order.end(), [&sizes](uint32_t a, uint32_t b) {
+    return sizes[a] > sizes[b] || (sizes[a] == sizes[b] && a < b);
+  });
+
+  // as many landmarks per region as its share of the nodes, anything left to the largest
+  std::vector<uint32_t> quotas;
+  uint32_t remaining = landmark_count;
+  for (const auto region : order) {
+    const auto share = static_cast<double>(sizes[region]) * landmark_count / node_count;
+    quotas.push_back(std::min(remaining, std::max(1u, static_cast<uint32_t>(share + 0.5))));
+    remaining -= quotas.back();
+  }
+  if (!quotas.empty()) {
+    quotas.front() += remaining;
+  }
+
+  std::vector<std::vector<float>> from, to;
+  std::vector<float> distances, score;
+  for (size_t r = 0; r < order.size(); ++r) {
+    const auto region = order[r];
+    const auto start = static_cast<uint32_t>(
+        std::find(regions.begin(), regions.end(), region) - regions.begin());
+    Dijkstra(graph.offsets, graph.arcs, start, distances);
+    auto next = start;
+    for (uint32_t node = 0; node < node_count; ++node) {
+      if (distances[node] != kUnreachedLandmark && distances[node] > distances[next]) {
+        next = node;
+      }
+    }
+
+    score.assign(node_count, kUnreachedLandmark);
+    for (uint32_t i = 0; i < quotas[r] && next != kInvalidNode; ++i) {
+      table.landmarks.push_back(next);
+      Dijkstra(graph.offsets, graph.arcs, next, from.emplace_back());
+      Dijkstra(graph.reverse_offsets, graph.reverse_arcs, next, to.emplace_back());
+      LOG_INFO("Landmark " + std::to_string(table.landmarks.size()) + " reaches " +
+               std::to_string(std::count_if(from.back().begin(), from.back().end(),
+                                            [](float d) { return d != kUnreachedLandmark; })) +
+               " nodes");
+
+      // the next one is the farthest there and back from those so far
+      next = kInvalidNode;
+      float farthest = 0;
+      for (uint32_t node = 0; node < node_count; ++node) {
+        if (regions[node] != region || from.back()[node] == kUnreachedLandmark ||
+            to.back()[node] == kUnreachedLandmark) {
+          continue;
+        }
+        score[node] = std::min(score[node], from.back()[node] + to.back()[node]);
+        if (score[node] > farthest) {
+          farthest = score[node];
+          next = node;
+        }
+      }
+    }
+  }
+
+  // from node indices to node ids and from one column per landmark to the distances by node
+  const auto count = table.landmarks.size();
+  for (auto& landmark : table.landmarks) {
+    const auto tile = std::upper_bound(table.tile_offsets.begin(), table.tile_offsets.end(),
+                                       landmark) -
+                      table.tile_offsets.begin() - 1;
+    GraphId node(table.tiles[tile]);
+    node.set_id(landmark - table.tile_offsets[tile]);
+    landmark = node.value;
+  }
+  table.distances.resize(node_count * 2 * count);
+  for (size_t node = 0; node < node_count; ++node) {
+    for (size_t l = 0; l < count; ++l) {
+      table.distances[node * 2 * count + l] = from[l][node];
+      table.distances[node * 2 * count + count + l] = to[l][node];
+    }
+  }
+}
+
+} // namespace
+
+namespace valhalla {
+namespace mjolnir {
+
+void AltLandmarkBuilder::Build(const boost::property_tree::ptree& pt) {
+  SCOPED_TIMER();
+  const auto& mjolnir = pt.get_child("mjolnir");
+  const auto landmark_count = mjolnir.get<uint32_t>("alt.landmark_count", 0);
+  if (landmark_count == 0) {
+    LOG_INFO("No landmarks to build the distances for");
+    return;
+  }
+
+  GraphReader reader(mjolnir);
+  table_t table;
+  graph_t graph;
+  AddGraph(reader, table, graph);
+  reader.Clear();
+  LOG_INFO("Selecting " + std::to_string(landmark_count) + " landmarks among " +
+           std::to_string(table.tile_offsets.back()) + " nodes");
+  if (table.tile_offsets.back() == 0) {
+    return;
+  }
+
+  SelectLandmarks(graph, landmark_count, table);
+  AltLandmarks::Write(AltLandmarks::FileName(mjolnir), table);
+}
+
+} // namespace mjolnir
+} // namespace valhalla
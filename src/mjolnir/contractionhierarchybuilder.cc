@@ -0,0 +1,592 @@
+#include "mjolnir/contractionhierarchybuilder.h"
+#include "baldr/contraction_hierarchy.h"
+#include "baldr/graphreader.h"
+#include "baldr/rapidjson_utils.h"
+#include "baldr/tilehierarchy.h"
+#include "baldr/time_info.h"
+#include "midgard/logging.h"
+#include "proto_conversions.h"
+#include "scoped_timer.h"
+#include "sif/costfactory.h"
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace valhalla::baldr;
+using namespace valhalla::midgard;
+using namespace valhalla::sif;
+
+namespace {
+
+// How many nodes a witness search may settle and how many arcs the paths it follows may have
+// before it gives up and a shortcut is added. Higher values mean fewer shortcuts but a slower
+// build, giving up early never makes the result inexact
+constexpr uint32_t kWitnessSettleLimit = 256;
+constexpr uint8_t kWitnessHopLimit = 8;
+
+// How many nodes a thread takes at a time when the work of a round is spread over the threads
+constexpr size_t kParallelChunk = 256;
+
+constexpr float kInfinity = std::numeric_limits<float>::max();
+
+// The arcs of every node in one array. A node owns a block of it, which moves to the end of the
+// array with twice the room once an arc does not fit anymore, so adding shortcuts does not
+// allocate per node and the arcs of a node stay next to each other
+class adjacency_t {
+public:
+  void resize(const size_t node_count) {
+    blocks_.resize(node_count);
+  }
+
+  const ch_arc_t* begin(const uint32_t node) const {
+    return arcs_.data() + blocks_[node].begin;
+  }
+
+  const ch_arc_t* end(const uint32_t node) const {
+    return begin(node) + blocks_[node].size;
+  }
+
+  size_t size(const uint32_t node) const {
+    return blocks_[node].size;
+  }
+
+  ch_arc_t* find(const uint32_t node, const uint32_t to) {
+    auto* first = arcs_.data() + blocks_[node].begin;
+    auto* last = first + blocks_[node].size;
+    auto* found = std::find_if(first, last, [to](const ch_arc_t& a) { return a.node == to; });
+    return found == last ? nullptr : found;
+  }
+
+  void add(const uint32_t node, const ch_arc_t& arc) {
+    auto& block = blocks_[node];
+    if (block.size == block.capacity) {
+      const uint64_t begin = arcs_.size();
+      const uint32_t capacity = std::max<uint32_t>(4, block.capacity * 2);
+      arcs_.resize(begin + capacity);
+      std::copy_n(arcs_.begin() + block.begin, block.size, arcs_.begin() + begin);
+      block.begin = begin;
+      block.capacity = capacity;
+    }
+    arcs_[block.begin + block.size++] = arc;
+  }
+
+  void remove(const uint32_t node, const uint32_t to) {
+    auto& block = blocks_[node];
+    auto* first = arcs_.data() + block.begin;
+    auto* last = std::remove_if(first, first + block.size,
+                                [to](const ch_arc_t& a) { return a.node == to; });
+    block.size = static_cast<uint32_t>(last - first);
+  }
+
+  // the arcs of all nodes without the room left in the blocks, where each node's start and one
+  // more offset for the end of the last
+  void flatten(std::vector<uint64_t>& offsets, std::vector<ch_arc_t>& arcs) const {
+    offsets.reserve(blocks_.size() + 1);
+    for (uint32_t node = 0; node < blocks_.size(); ++node) {
+      offsets.push_back(arcs.size());
+      arcs.insert(arcs.end(), begin(node), end(node));
+    }
+    offsets.push_back(arcs.size());
+  }
+
+private:
+  struct block_t {
+    uint64_t begin = 0;
+    uint32_t size = 0;
+    uint32_t capacity = 0;
+  };
+  std::vector<ch_arc_t> arcs_;
+  std::vector<block_t> blocks_;
+};
+
+// The edge based graph while it is being contracted. Every node is a directed edge, an arc from
+// one to the other is the turn at the node between them plus the cost of the second edge
+struct graph_t {
+  std::vector<uint64_t> edges;
+  std::vector<ch_node_t> nodes;
+  adjacency_t out;
+  adjacency_t in;
+};
+
+/**
+ * Runs work(i, thread) for every i below count, the threads each taking the next chunk of them
+ * when they are done with one. Small counts run on the calling thread.
+ */
+void parallel_for(const size_t count,
+                  const uint32_t concurrency,
+                  const std::function<void(size_t, uint32_t)>& work) {
+  std::atomic<size_t> next(0);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto run = [&](const uint32_t thread) {
+    try {
+      for (auto begin = next.fetch_add(kParallelChunk); begin < count;
+           begin = next.fetch_add(kParallelChunk)) {
+        for (auto i = begin; i < std::min(count, begin + kParallelChunk); ++i) {
+          work(i, thread);
+        }
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+      next = count;
+    }
+  };
+
+  const auto threads_needed =
+      std::min<size_t>(concurrency, (count + kParallelChunk - 1) / kParallelChunk);
+  std::vector<std::thread> threads;
+  for (uint32_t thread = 1; thread < threads_needed; ++thread) {
+    threads.emplace_back(run, thread);
+  }
+  run(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+/**
+ * Collects the edges the costing has access to on the road levels, skipping shortcuts since the
+ * hierarchy replaces them. Their positions in the sorted result are the node ids.
+ */
+void AddNodes(GraphReader& reader, const cost_ptr_t& costing, graph_t& graph) {
+  for (const auto& level : TileHierarchy::levels()) {
+    for (const auto& tile_id : reader.GetTileSet(level.level)) {
+      auto tile = reader.GetGraphTile(tile_id);
+      if (!tile) {
+        continue;
+      }
+      GraphId edgeid = tile_id;
+      for (uint32_t i = 0; i < tile->header()->directededgecount(); ++i, ++edgeid) {
+        const auto* edge = tile->directededge(i);
+        if (!edge->is_shortcut() && costing->IsAccessible(edge)) {
+          graph.edges.push_back(edgeid.value);
+        }
+      }
+    }
+    reader.Trim();
+  }
+  std::sort(graph.edges.begin(), graph.edges.end());
+}
+
+/**
+ * Adds the costs of the nodes and the arcs between them, the same expansion the matrix does
+ * without a time: turns are only allowed if the costing allows them coming from the previous edge
+ * and u-turns only where nothing else is.
+ */
+void AddArcs(GraphReader& reader, const cost_ptr_t& costing, graph_t& graph) {
+  const auto node_count = graph.edges.size();
+  graph.nodes.resize(node_count);
+  graph.out.resize(node_count);
+  graph.in.resize(node_count);
+  auto find = [&graph](const GraphId& edgeid) {
+    auto found = std::lower_bound(graph.edges.begin(), graph.edges.end(), edgeid.value);
+    return found != graph.edges.end() && *found == edgeid.value
+               ? static_cast<uint32_t>(found - graph.edges.begin())
+               : kInvalidCHNode;
+  };
+  auto reader_getter = [&reader]() { return LimitedGraphReader(reader); };
+
+  for (uint32_t u = 0; u < node_count; ++u) {
+    const GraphId edgeid(graph.edges[u]);
+    graph_tile_ptr tile = reader.GetGraphTile(edgeid);
+    const auto* edge = tile->directededge(edgeid);
+    uint8_t flow_sources;
+    const auto cost = costing->EdgeCost(edge, edgeid, tile, TimeInfo::invalid(), flow_sources);
+    graph.nodes[u] = {cost.cost, cost.secs, edge->length()};
+
+    graph_tile_ptr end_tile = reader.GetGraphTile(edge->endnode(), tile);
+    if (!end_tile) {
+      continue;
+    }
+    const auto* nodeinfo = end_tile->node(edge->endnode());
+    EdgeLabel pred(kInvalidLabel, edgeid, edge, {}, 0, costing->travel_mode(), 0,
+                   kInvalidRestriction, false, false, InternalTurn::kNoTurn, 0,
+                   edge->destonly() || (costing->is_hgv() && edge->destonly_hgv()));
+
+    // tries the turn onto an edge leaving the end node or one of its copies on the other levels
+    auto expand = [&](const NodeInfo* node, const graph_tile_ptr& node_tile, GraphId to_id) {
+      const auto* to = node_tile->directededge(to_id);
+      const auto v = to->is_shortcut() ? kInvalidCHNode : find(to_id);
+      uint8_t restriction_idx = kInvalidRestriction;
+      uint8_t destonly_mask = 0;
+      if (v == kInvalidCHNode ||
+          !costing->Allowed(to, false, pred, node_tile, to_id, 0, 0, restriction_idx,
+                            destonly_mask)) {
+        return false;
+      }
+      // a loop back onto the same edge is never part of a shortest path
+      if (v == u) {
+        return true;
+      }
+      uint8_t flow;
+      auto arc_cost = costing->EdgeCost(to, to_id, node_tile, TimeInfo::invalid(), flow) +
+                      costing->TransitionCost(to, node, pred, node_tile, reader_getter);
+      // paths onto the last edge of a complex restriction are checked when they are searched
+      const bool restricted = to->end_restriction() & costing->access_mode();
+      graph.out.add(u, {v, arc_cost.cost, arc_cost.secs, to->length(), restricted});
+      graph.in.add(v, {u, arc_cost.cost, arc_cost.secs, to->length(), restricted});
+      return true;
+    };
+
+    // at a barrier the only way on is back
+    const GraphId opp_id = reader.GetOpposingEdgeId(edgeid);
+    if (!costing->Allowed(nodeinfo)) {
+      pred.set_deadend(true);
+      if (opp_id.is_valid()) {
+        expand(nodeinfo, end_tile, opp_id);
+      }
+      continue;
+    }
+
+    bool expanded = false;
+    GraphId to_id = end_tile->id();
+    to_id.set_id(nodeinfo->edge_index());
+    for (uint32_t i = 0; i < nodeinfo->edge_count(); ++i, ++to_id) {
+      expanded = (to_id != opp_id && expand(nodeinfo, end_tile, to_id)) || expanded;
+    }
+    for (const auto& trans : end_tile->GetNodeTransitions(nodeinfo)) {
+      auto trans_tile = reader.GetGraphTile(trans.endnode());
+      if (!trans_tile) {
+        continue;
+      }
+      const auto* trans_node = trans_tile->node(trans.endnode());
+      GraphId trans_id = trans_tile->id();
+      trans_id.set_id(trans_node->edge_index());
+      for (uint32_t i = 0; i < trans_node->edge_count(); ++i, ++trans_id) {
+        expanded = expand(trans_node, trans_tile, trans_id) || expanded;
+      }
+    }
+
+    // and at a dead end too
+    if (!expanded && opp_id.is_valid()) {
+      pred.set_deadend(true);
+      expand(nodeinfo, end_tile, opp_id);
+    }
+
+    if (reader.OverCommitted()) {
+      reader.Trim();
+    }
+  }
+}
+
+// Dijkstra on the remaining graph that looks for a path around the nodes being contracted. Each
+// thread has its own, only what the last search reached is reset before the next one
+class WitnessSearch {
+public:
+  explicit WitnessSearch(size_t node_count)
+      : cost_(node_count, kInfinity), hops_(node_count, 0), target_(node_count, false) {
+  }
+
+  /**
+   * Finds the cheapest paths from a node that do not pass the contracted nodes.
+   * @param graph        the graph
+   * @param source       where to start
+   * @param skip         the node being contracted
+   * @param contracting  the other nodes being contracted along with it
+   * @param targets      the arcs out of the contracted node, done once their heads are settled
+   * @param max_cost     no need to look for anything more expensive
+   */
+  void Run(const graph_t& graph,
+           const uint32_t source,
+           const uint32_t skip,
+           const std::vector<uint8_t>& contracting,
+           std::pair<const ch_arc_t*, const ch_arc_t*> targets,
+           const float max_cost) {
+    for (auto node : reached_) {
+      cost_[node] = kInfinity;
+      target_[node] = false;
+    }
+    reached_.clear();
+    queue_ = {};
+    uint32_t targets_left = 0;
+    for (const auto* arc = targets.first; arc != targets.second; ++arc) {
+      if (!target_[arc->node] && arc->node != source) {
+        target_[arc->node] = true;
+        reached_.push_back(arc->node);
+        ++targets_left;
+      }
+    }
+
+    cost_[source] = 0;
+    hops_[source] = 0;
+    reached_.push_back(source);
+    queue_.emplace(0.f, source);
+    uint32_t settled = 0;
+    while (!queue_.empty() && settled < kWitnessSettleLimit && targets_left > 0) {
+      const auto [cost, node] = queue_.top();
+      queue_.pop();
+      if (cost > cost_[node]) {
+        continue;
+      }
+      if (cost > max_cost) {
+        break;
+      }
+      ++settled;
+      if (target_[node]) {
+        target_[node] = false;
+        --targets_left;
+      }
+      if (hops_[node] >= kWitnessHopLimit) {
+        continue;
+      }
+      for (const auto* arc = graph.out.begin(node); arc != graph.out.end(node); ++arc) {
+        const auto next = cost + arc->cost;
+        if (arc->node != skip && !contracting[arc->node] && next < cost_[arc->node]) {
+          reached_.push_back(arc->node);
+          cost_[arc->node] = next;
+          hops_[arc->node] = hops_[node] + 1;
+          queue_.emplace(next, arc->node);
+        }
+      }
+    }
+  }
+
+  float cost(const uint32_t node) const {
+    return cost_[node];
+  }
+
+private:
+  using entry_t = std::pair<float, uint32_t>;
+  std::vector<float> cost_;
+  std::vector<uint8_t> hops_;
+  std::vector<bool> target_;
+  std::vector<uint32_t> reached_;
+  std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>> queue_;
+};
+
+// Adds an arc or makes the existing one cheaper
+void AddShortcut(graph_t& graph, uint32_t from, const ch_arc_t& arc) {
+  auto* existing = graph.out.find(from, arc.node);
+  if (!existing) {
+    graph.out.add(from, arc);
+    graph.in.add(arc.node, {from, arc.cost, arc.secs, arc.length, arc.restricted});
+    return;
+  }
+  if (arc.cost < existing->cost) {
+    *existing = arc;
+    *graph.in.find(arc.node, from) = {from, arc.cost, arc.secs, arc.length, arc.restricted};
+  }
+}
+
+using shortcut_t = std::pair<uint32_t, ch_arc_t>;
+
+/**
+ * Finds the shortcuts needed to contract a node, the pairs of arcs through it that have no other
+ * path at most as expensive around it and the nodes contracted along with it.
+ */
+void Shortcuts(const graph_t& graph,
+               WitnessSearch& witness,
+               uint32_t node,
+               const std::vector<uint8_t>& contracting,
+               std::vector<shortcut_t>& shortcuts) {
+  shortcuts.clear();
+  const std::pair out(graph.out.begin(node), graph.out.end(node));
+  float max_out = 0;
+  for (const auto* to = out.first; to != out.second; ++to) {
+    max_out = std::max(max_out, to->cost);
+  }
+  for (const auto* from = graph.in.begin(node); from != graph.in.end(node); ++from) {
+    witness.Run(graph, from->node, node, contracting, out, from->cost + max_out);
+    for (const auto* to = out.first; to != out.second; ++to) {
+      const float cost = from->cost + to->cost;
+      if (to->node != from->node && witness.cost(to->node) > cost) {
+        shortcuts.push_back({from->node,
+                             {to->node, cost, from->secs + to->secs,
+                              static_cast<uint32_t>(from->length + to->length),
+                              from->restricted || to->restricted}});
+      }
+    }
+  }
+}
+
+/**
+ * Contracts the nodes in rounds. Every round takes the nodes that add less to the graph than all
+ * of their neighbours, which are never next to each other so their shortcuts are found on all
+ * threads at once. The priorities are updated lazily, only for the nodes a round takes, and those
+ * that turn out to add more than one of their neighbours wait for a later round. Each node keeps
+ * the arcs to the nodes still there when it is contracted, which are the ones ranked higher, and
+ * the order goes from the last node contracted to the first.
+ */
+void Contract(graph_t& graph,
+              const uint32_t concurrency,
+              std::vector<uint64_t>& forward_offsets,
+              std::vector<ch_arc_t>& forward,
+              std::vector<uint64_t>& backward_offsets,
+              std::vector<ch_arc_t>& backward,
+              std::vector<uint32_t>& order) {
+  const auto node_count = static_cast<uint32_t>(graph.edges.size());
+  std::vector<WitnessSearch> witnesses(concurrency, WitnessSearch(node_count));
+  std::vector<uint32_t> contracted_neighbours(node_count, 0);
+  std::vector<uint8_t> contracting(node_count, 0);
+  std::vector<int64_t> priority(node_count, 0);
+  auto priority_of = [&](const uint32_t node, const std::vector<shortcut_t>& shortcuts) {
+    return static_cast<int64_t>(shortcuts.size()) -
+           static_cast<int64_t>(graph.in.size(node) + graph.out.size(node)) +
+           contracted_neighbours[node];
+  };
+  // ties go by a hash of the node so that the nodes of a round spread over the whole graph
+  auto before = [&priority](const uint32_t a, const uint32_t b) {
+    const auto hash_a = a * 2654435761u, hash_b = b * 2654435761u;
+    return priority[a] < priority[b] ||
+           (priority[a] == priority[b] && (hash_a < hash_b || (hash_a == hash_b && a < b)));
+  };
+  auto first_among_neighbours = [&](const uint32_t node) {
+    for (const auto* adjacency : {&graph.out, &graph.in}) {
+      for (const auto* arc = adjacency->begin(node); arc != adjacency->end(node); ++arc) {
+        if (arc->node != node && !before(node, arc->node)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  };
+
+  std::vector<std::vector<shortcut_t>> scratch(concurrency);
+  parallel_for(node_count, concurrency, [&](const size_t node, const uint32_t thread) {
+    Shortcuts(graph, witnesses[thread], node, contracting, scratch[thread]);
+    priority[node] = priority_of(node, scratch[thread]);
+  });
+
+  std::vector<uint32_t> remaining(node_count);
+  std::iota(remaining.begin(), remaining.end(), 0);
+  std::vector<uint8_t> selected;
+  std::vector<uint32_t> independent;
+  std::vector<std::vector<shortcut_t>> shortcuts;
+  size_t shortcut_count = 0, rounds = 0;
+  order.reserve(node_count);
+  while (!remaining.empty()) {
+    selected.assign(remaining.size(), 0);
+    parallel_for(remaining.size(), concurrency, [&](const size_t i, const uint32_t) {
+      selected[i] = first_among_neighbours(remaining[i]);
+    });
+    independent.clear();
+    for (size_t i = 0; i < remaining.size(); ++i) {
+      if (selected[i]) {
+        independent.push_back(remaining[i]);
+        contracting[remaining[i]] = 1;
+      }
+    }
+
+    // the witness searches go around all the nodes of the round, in case they are all contracted
+    shortcuts.resize(independent.size());
+    parallel_for(independent.size(), concurrency, [&](const size_t i, const uint32_t thread) {
+      Shortcuts(graph, witnesses[thread], independent[i], contracting, shortcuts[i]);
+      priority[independent[i]] = priority_of(independent[i], shortcuts[i]);
+    });
+
+    for (size_t i = 0; i < independent.size(); ++i) {
+      const auto node = independent[i];
+      contracting[node] = 0;
+      if (!first_among_neighbours(node)) {
+        shortcuts[i].clear();
+        continue;
+      }
+      for (const auto& [from, arc] : shortcuts[i]) {
+        AddShortcut(graph, from, arc);
+      }
+      shortcut_count += shortcuts[i].size();
+      shortcuts[i].clear();
+      order.push_back(node);
+      contracting[node] = 1;
+      for (const auto* arc = graph.out.begin(node); arc != graph.out.end(node); ++arc) {
+        graph.in.remove(arc->node, node);
+        ++contracted_neighbours[arc->node];
+      }
+      for (const auto* arc = graph.in.begin(node); arc != graph.in.end(node); ++arc) {
+        graph.out.remove(arc->node, node);
+        ++contracted_neighbours[arc->node];
+      }
+    }
+    remaining.erase(std::remove_if(remaining.begin(), remaining.end(),
+                                   [&contracting](const uint32_t node) { return contracting[node]; }),
+                    remaining.end());
+    for (const auto node : independent) {
+      contracting[node] = 0;
+    }
+    ++rounds;
+  }
+  LOG_INFO("Added " + std::to_string(shortcut_count) + " shortcuts in " + std::to_string(rounds) +
+           " rounds");
+  std::reverse(order.begin(), order.end());
+
+  // what is left of the arcs of a node when it was contracted are its arcs up the hierarchy
+  graph.out.flatten(forward_offsets, forward);
+  graph.out = {};
+  graph.in.flatten(backward_offsets, backward);
+  graph.in = {};
+}
+
+} // namespace
+
+namespace valhalla {
+namespace mjolnir {
+
+void ContractionHierarchyBuilder::Build(const boost::property_tree::ptree& pt) {
+  SCOPED_TIMER();
+  const auto& mjolnir = pt.get_child("mjolnir");
+  auto costings = mjolnir.get_child_optional("contraction_hierarchy.costings");
+  if (!costings || costings->empty()) {
+    LOG_INFO("No costings to build contraction hierarchies for");
+    return;
+  }
+  const auto dir = ContractionHierarchy::Directory(mjolnir);
+  const auto concurrency = std::max<uint32_t>(
+      1, mjolnir.get<uint32_t>("concurrency", std::thread::hardware_concurrency()));
+
+  GraphReader reader(mjolnir);
+  for (const auto& item : *costings) {
+    const auto name = item.second.get_value<std::string>();
+    Costing::Type type;
+    if (!Costing_Enum_Parse(name, &type)) {
+      throw std::runtime_error("Unknown costing for the contraction hierarchy: " + name);
+    }
+    LOG_INFO("Building the contraction hierarchy for " + name);
+
+    // the default options as a request without any gets them
+    rapidjson::Document doc;
+    doc.SetObject();
+    Costing costing_options;
+    google::protobuf::RepeatedPtrField<CodedDescription> warnings;
+    ParseCosting(doc, "/costing_options/" + name, &costing_options, warnings, type);
+    auto costing = CostFactory{}.Create(costing_options);
+    costing->set_allow_destination_only(false);
+
+    graph_t graph;
+    AddNodes(reader, costing, graph);
+    AddArcs(reader, costing, graph);
+    reader.Clear();
+    LOG_INFO("Contracting " + std::to_string(graph.edges.size()) + " edges on " +
+             std::to_string(concurrency) + " threads");
+
+    std::vector<uint64_t> forward_offsets, backward_offsets;
+    std::vector<ch_arc_t> forward, backward;
+    std::vector<uint32_t> order;
+    Contract(graph, concurrency, forward_offsets, forward, backward_offsets, backward, order);
+    ContractionHierarchy::Write(ContractionHierarchy::FileName(dir, name), type,
+                                ContractionHierarchy::SerializeOptions(costing_options), graph.edges,
+                                graph.nodes, forward_offsets, forward, backward_offsets, backward,
+                                order);
+  }
+}
+
+} // namespace mjolnir
+} // namespace valhalla
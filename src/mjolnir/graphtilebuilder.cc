@@ -255,6 +255,13 @@ GraphTileBuilder::GraphTileBuilder(const std::string& tile_dir,
   std::copy(lane_connectivity_, lane_connectivity_ + n,
             std::back_inserter(lane_connectivity_builder_));
 
+  // Shortcut edges
+  for (uint32_t i = 0; i < shortcut_count_; ++i) {
+    auto edges = GetShortcutEdges(shortcut_indexes_[i]);
+    shortcut_edges_builder_.emplace(shortcut_indexes_[i],
+                                    std::vector<GraphId>(edges.begin(), edges.end()));
+  }
+
   complex_restriction_forward_builder_ =
       DeserializeRestrictions(complex_restriction_forward_, complex_restriction_forward_size_);
   complex_restriction_reverse_builder_ =
@@ -417,9 +424,36 @@ void GraphTileBuilder::StoreTileData() {
     in_mem.write(reinterpret_cast<const char*>(lane_connectivity_builder_.data()),
                  lane_connectivity_builder_.size() * sizeof(LaneConnectivity));
 
+    // Write the shortcut edges: the shortcut count, the shortcut indexes, where the edges of each
+    // shortcut start (one extra entry at the end) and then the edges. That is an even number of
+    // 4 byte words so the edges stay aligned to 8 bytes.
+    uint32_t shortcut_edges_size = 0;
+    if (shortcut_edges_builder_.empty()) {
+      header_builder_.set_shortcut_edges_offset(0);
+    } else {
+      header_builder_.set_shortcut_edges_offset(
+          header_builder_.lane_connectivity_offset() +
+          (lane_connectivity_builder_.size() * sizeof(LaneConnectivity)));
+      std::vector<uint32_t> words{static_cast<uint32_t>(shortcut_edges_builder_.size())};
+      for (const auto& shortcut : shortcut_edges_builder_) {
+        words.push_back(shortcut.first);
+      }
+      words.push_back(0);
+      for (const auto& shortcut : shortcut_edges_builder_) {
+        words.push_back(words.back() + shortcut.second.size());
+      }
+      in_mem.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(uint32_t));
+      for (const auto& shortcut : shortcut_edges_builder_) {
+        in_mem.write(reinterpret_cast<const char*>(shortcut.second.data()),
+                     shortcut.second.size() * sizeof(GraphId));
+      }
+      shortcut_edges_size = words.size() * sizeof(uint32_t) + words.back() * sizeof(GraphId);
+    }
+
     // Set the end offset
     header_builder_.set_end_offset(header_builder_.lane_connectivity_offset() +
-                                   (lane_connectivity_builder_.size() * sizeof(LaneConnectivity)));
+                                   (lane_connectivity_builder_.size() * sizeof(LaneConnectivity)) +
+                                   shortcut_edges_size);
 
     // Sanity check for the end offset
     uint32_t curr =
@@ -624,6 +658,11 @@ void GraphTileBuilder::AddLaneConnectivity(std::vector<baldr::LaneConnectivity>&
   lane_connectivity_offset_ += sizeof(baldr::LaneConnectivity) * size;
 }
 
+// Set the edges a shortcut supersedes
+void GraphTileBuilder::SetShortcutEdges(const uint32_t idx, std::vector<GraphId>&& edges) {
+  shortcut_edges_builder_[idx] = std::move(edges);
+}
+
 void GraphTileBuilder::CopyLaneConnectivityFromTile(const baldr::graph_tile_ptr& tile,
                                                     uint32_t edge_id) {
   auto laneconnectivity_span = tile->GetLaneConnectivity(edge_id);
@@ -1219,6 +1258,9 @@ void GraphTileBuilder::AddBins(const std::string& tile_dir,
   header.set_edgeinfo_offset(header.edgeinfo_offset() + shift);
   header.set_textlist_offset(header.textlist_offset() + shift);
   header.set_lane_connectivity_offset(header.lane_connectivity_offset() + shift);
+  if (header.shortcut_edges_offset() > 0) {
+    header.set_shortcut_edges_offset(header.shortcut_edges_offset() + shift);
+  }
   header.set_end_offset(header.end_offset() + shift);
   // rewrite the tile
   std::filesystem::path filename{tile_dir};
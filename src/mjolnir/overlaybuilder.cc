@@ -0,0 +1,245 @@
+#include "mjolnir/overlaybuilder.h"
+#include "baldr/graphreader.h"
+#include "baldr/partition_overlay.h"
+#include "baldr/tilehierarchy.h"
+#include "midgard/logging.h"
+#include "midgard/pointll.h"
+#include "scoped_timer.h"
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace valhalla::baldr;
+using namespace valhalla::midgard;
+
+namespace {
+
+using graph_t = PartitionOverlay::graph_t;
+
+/**
+ * Collects the edges of the road levels, skipping shortcuts since the overlay replaces them, and
+ * the transitions from each to the edges leaving its end node on any level. Which of them a
+ * costing takes is up to the customization.
+ */
+void AddGraph(GraphReader& reader, graph_t& graph, std::vector<PointLL>& positions) {
+  for (const auto& level : TileHierarchy::levels()) {
+    for (const auto& tile_id : reader.GetTileSet(level.level)) {
+      auto tile = reader.GetGraphTile(tile_id);
+      if (!tile) {
+        continue;
+      }
+      GraphId edgeid = tile_id;
+      for (uint32_t i = 0; i < tile->header()->directededgecount(); ++i, ++edgeid) {
+        if (!tile->directededge(i)->is_shortcut()) {
+          graph.edges.push_back(edgeid.value);
+        }
+      }
+    }
+    reader.Trim();
+  }
+  std::sort(graph.edges.begin(), graph.edges.end());
+
+  auto find = [&graph](const GraphId& edgeid) {
+    auto found = std::lower_bound(graph.edges.begin(), graph.edges.end(), edgeid.value);
+    return found != graph.edges.end() && *found == edgeid.value
+               ? static_cast<uint32_t>(found - graph.edges.begin())
+               : kInvalidOverlayNode;
+  };
+  positions.reserve(graph.edges.size());
+  graph.arc_offsets.reserve(graph.edges.size() + 1);
+  for (const auto id : graph.edges) {
+    graph.arc_offsets.push_back(graph.arcs.size());
+    const GraphId edgeid(id);
+    graph_tile_ptr tile = reader.GetGraphTile(edgeid);
+    const auto* edge = tile->directededge(edgeid);
+    graph_tile_ptr end_tile = reader.GetGraphTile(edge->endnode(), tile);
+    if (!end_tile) {
+      positions.emplace_back(tile->header()->base_ll());
+      continue;
+    }
+    const auto* nodeinfo = end_tile->node(edge->endnode());
+    positions.emplace_back(nodeinfo->latlng(end_tile->header()->base_ll()));
+
+    const GraphId opp_id = reader.GetOpposingEdgeId(edgeid);
+    GraphId to_id = end_tile->id();
+    to_id.set_id(nodeinfo->edge_index());
+    for (uint32_t i = 0; i < nodeinfo->edge_count(); ++i, ++to_id) {
+      const auto v = find(to_id);
+      if (v != kInvalidOverlayNode) {
+        graph.arcs.push_back({v, to_id == opp_id});
+      }
+    }
+    for (const auto& trans : end_tile->GetNodeTransitions(nodeinfo)) {
+      auto trans_tile = reader.GetGraphTile(trans.endnode());
+      if (!trans_tile) {
+        continue;
+      }
+      const auto* trans_node = trans_tile->node(trans.endnode());
+      GraphId trans_id = trans_tile->id();
+      trans_id.set_id(trans_node->edge_index());
+      for (uint32_t i = 0; i < trans_node->edge_count(); ++i, ++trans_id) {
+        const auto v = find(trans_id);
+        if (v != kInvalidOverlayNode) {
+          graph.arcs.push_back({v, false});
+        }
+      }
+    }
+
+    if (reader.OverCommitted()) {
+      reader.Trim();
+    }
+  }
+  graph.arc_offsets.push_back(graph.arcs.size());
+}
+
+// Recursive bisection of the nodes by their position into the nested cells of every level
+class Partitioner {
+public:
+  Partitioner(graph_t& graph, const std::vector<PointLL>& positions, std::vector<uint32_t> sizes)
+      : graph_(graph), positions_(positions), sizes_(std::move(sizes)),
+        range_(graph.edges.size(), 0), side_(graph.edges.size(), false) {
+    const auto node_count = graph.edges.size();
+    graph_.cell_counts.assign(sizes_.size(), 0);
+    graph_.cells.assign(sizes_.size() * node_count, 0);
+    order_.resize(node_count);
+    for (uint32_t node = 0; node < node_count; ++node) {
+      order_[node] = node;
+    }
+    double lat = 0;
+    for (const auto& position : positions_) {
+      lat += position.lat();
+    }
+    lng_scale_ = std::cos((node_count ? lat / node_count : 0) * kRadPerDegD);
+  }
+
+  void Run() {
+    Bisect(0, order_.size(), sizes_.size());
+  }
+
+private:
+  /**
+   * Closes the cells of all levels the range fits into and splits it in half where the fewest
+   * arcs cross: along the meridians, the parallels or one of the diagonals.
+   * @param begin  first node of the range within order_
+   * @param end    one past the last
+   * @param open   the number of levels without a cell for the range yet, from the bottom
+   */
+  void Bisect(size_t begin, size_t end, size_t open) {
+    const auto size = end - begin;
+    while (open > 0 && size <= sizes_[open - 1]) {
+      --open;
+      const auto cell = graph_.cell_counts[open]++;
+      auto* cells = graph_.cells.data() + open * graph_.edges.size();
+      for (auto i = begin; i < end; ++i) {
+        cells[order_[i]] = cell;
+      }
+    }
+    if (open == 0) {
+      return;
+    }
+
+    // mark the range so the arcs within it can be told apart
+    const auto range = ++range_count_;
+    for (auto i = begin; i < end; ++i) {
+      range_[order_[i]] = range;
+    }
+
+    const auto middle = begin + size / 2;
+    const std::array<std::array<double, 2>, 4> directions = {{{1, 0}, {0, 1}, {1, 1}, {1, -1}}};
+    size_t best_cut = std::numeric_limits<size_t>::max();
+    std::array<double, 2> best_direction{};
+    for (const auto& direction : directions) {
+      Split(begin, middle, end, direction);
+      size_t cut = 0;
+      for (auto i = begin; i < end; ++i) {
+        const auto node = order_[i];
+        for (auto a = graph_.arc_offsets[node]; a < graph_.arc_offsets[node + 1]; ++a) {
+          const uint32_t head = graph_.arcs[a].node;
+          cut += range_[head] == range && side_[head] != side_[node];
+        }
+      }
+      if (cut < best_cut) {
+        best_cut = cut;
+        best_direction = direction;
+      }
+    }
+    Split(begin, middle, end, best_direction);
+
+    Bisect(begin, middle, open);
+    Bisect(middle, end, open);
+  }
+
+  // puts the nodes of the range in order along a direction, up to the middle and after
+  void Split(size_t begin, size_t middle, size_t end, const std::array<double, 2>& direction) {
+    auto projection = [this, &direction](uint32_t node) {
+      const auto& position = positions_[node];
+      return position.lng() * lng_scale_ * direction[0] + position.lat() * direction[1];
+    };
+    std::nth_element(order_.begin() + begin, order_.begin() + middle, order_.begin() + end,
+                     [&projection](uint32_t a, uint32_t b) {
+                       const auto pa = projection(a), pb = projection(b);
+                       return pa < pb || (pa == pb && a < b);
+                     });
+    for (auto i = begin; i < end; ++i) {
+      side_[order_[i]] = i >= middle;
+    }
+  }
+
+  graph_t& graph_;
+  const std::vector<PointLL>& positions_;
+  std::vector<uint32_t> sizes_;
+  std::vector<uint32_t> order_;
+  std::vector<uint32_t> range_;
+  std::vector<bool> side_;
+  uint32_t range_count_ = 0;
+  double lng_scale_;
+};
+
+} // namespace
+
+namespace valhalla {
+namespace mjolnir {
+
+void OverlayBuilder::Build(const boost::property_tree::ptree& pt) {
+  SCOPED_TIMER();
+  const auto& mjolnir = pt.get_child("mjolnir");
+  std::vector<uint32_t> sizes;
+  if (auto cell_sizes = mjolnir.get_child_optional("overlay.cell_sizes")) {
+    for (const auto& item : *cell_sizes) {
+      sizes.push_back(item.second.get_value<uint32_t>());
+    }
+  }
+  if (sizes.empty()) {
+    LOG_INFO("No cell sizes to build the partition overlay for");
+    return;
+  }
+  std::sort(sizes.begin(), sizes.end());
+  if (sizes.front() < 2) {
+    throw std::runtime_error("The cells of the partition overlay need room for 2 edges at least");
+  }
+
+  GraphReader reader(mjolnir);
+  graph_t graph;
+  std::vector<PointLL> positions;
+  AddGraph(reader, graph, positions);
+  reader.Clear();
+  LOG_INFO("Partitioning " + std::to_string(graph.edges.size()) + " edges with " +
+           std::to_string(graph.arcs.size()) + " transitions");
+
+  Partitioner(graph, positions, sizes).Run();
+  for (size_t level = 0; level < sizes.size(); ++level) {
+    LOG_INFO("Level " + std::to_string(level) + " has " + std::to_string(graph.cell_counts[level]) +
+             " cells");
+  }
+  PartitionOverlay::Write(PartitionOverlay::FileName(mjolnir), graph);
+}
+
+} // namespace mjolnir
+} // namespace valhalla
@@ -19,6 +19,7 @@
 
 #include <string>
 #include <tuple>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -67,6 +68,32 @@ struct EdgePairs {
   std::pair<GraphId, GraphId> edge2;
 };
 
+// An edge as its start node and its index among the regular edges leaving the node. The shortcuts
+// of a node go in front of its regular edges, so while the tiles are rebuilt the edge Ids change
+// but this does not, whether the tile of the node was already rebuilt or not.
+struct BaseEdge {
+  GraphId node;
+  uint32_t index;
+};
+
+// The edges each shortcut of a tile supersedes, by the index of the shortcut
+using ShortcutEdges = std::vector<std::pair<uint32_t, std::vector<BaseEdge>>>;
+
+// Number of shortcuts in front of the regular edges of a node
+uint32_t ShortcutCount(const graph_tile_ptr& tile, const NodeInfo* node) {
+  uint32_t count = 0;
+  while (count < node->edge_count() &&
+         tile->directededge(node->edge_index() + count)->is_shortcut()) {
+    ++count;
+  }
+  return count;
+}
+
+BaseEdge ToBaseEdge(const graph_tile_ptr& tile, const GraphId& node, const GraphId& edge_id) {
+  const NodeInfo* nodeinfo = tile->node(node);
+  return {node, edge_id.id() - nodeinfo->edge_index() - ShortcutCount(tile, nodeinfo)};
+}
+
 /**
  * Test if 2 edges have matching attributes such that they should be
  * considered for combining into a shortcut edge.
@@ -375,7 +402,8 @@ std::pair<uint32_t, uint32_t> AddShortcutEdges(GraphReader& reader,
                                                const GraphId& start_node,
                                                const uint32_t edge_index,
                                                const uint32_t edge_count,
-                                               std::unordered_map<uint32_t, uint32_t>& shortcuts) {
+                                               std::unordered_map<uint32_t, uint32_t>& shortcuts,
+                                               ShortcutEdges& shortcut_edges) {
   // Shortcut edges have to start at a node that is not contracted - return if
   // this node can be contracted.
   EdgePairs edgepairs;
@@ -448,6 +476,7 @@ std::pair<uint32_t, uint32_t> AddShortcutEdges(GraphReader& reader,
       // For turn duration calculation during contraction
       uint32_t opp_local_idx = directededge->opp_local_idx();
       GraphId next_edge_id = edge_id;
+      std::vector<BaseEdge> superseded{ToBaseEdge(tile, start_node, edge_id)};
       bool has_bridge = directededge->bridge();
       bool has_tunnel = directededge->tunnel();
       while (true) {
@@ -476,6 +505,7 @@ std::pair<uint32_t, uint32_t> AddShortcutEdges(GraphReader& reader,
         // end node in the new level). Keep track of the last restriction
         // on the connected shortcut - need to set that so turn restrictions
         // off of shortcuts work properly
+        superseded.push_back(ToBaseEdge(tile, end_node, next_edge_id));
         ConnectEdges(reader, end_node, next_edge_id, shape, end_node, opp_local_idx, rst,
                      average_density, total_duration, total_truck_duration, access_restrictions,
                      has_bridge, has_tunnel);
@@ -582,7 +612,8 @@ std::pair<uint32_t, uint32_t> AddShortcutEdges(GraphReader& reader,
       newedge.set_bridge(has_bridge);
       newedge.set_tunnel(has_tunnel);
 
-      // Add new directed edge to tile builder
+      // Add new directed edge to tile builder along with the edges it supersedes
+      shortcut_edges.emplace_back(tilebuilder.directededges().size(), std::move(superseded));
       tilebuilder.directededges().emplace_back(std::move(newedge));
       shortcut_count++;
       shortcut++;
@@ -600,9 +631,12 @@ std::pair<uint32_t, uint32_t> AddShortcutEdges(GraphReader& reader,
   return {shortcut_count, total_edge_count};
 }
 
-// Form shortcuts for tiles in this level.
+// Form shortcuts for tiles in this level, keeps the edges they supersede by tile Id.
 // Returns {shortcut_count, total_edge_count, exceeded_max_count}.
-std::tuple<uint32_t, uint32_t, uint32_t> FormShortcuts(GraphReader& reader, const TileLevel& level) {
+std::tuple<uint32_t, uint32_t, uint32_t>
+FormShortcuts(GraphReader& reader,
+              const TileLevel& level,
+              std::unordered_map<uint32_t, ShortcutEdges>& level_shortcut_edges) {
   // Iterate through the tiles at this level (TODO - can we mark the tiles
   // the tiles that shortcuts end within?)
   reader.Clear();
@@ -633,6 +667,7 @@ std::tuple<uint32_t, uint32_t, uint32_t> FormShortcuts(GraphReader& reader, cons
     }
 
     // Iterate through the nodes in the tile
+    ShortcutEdges shortcut_edges;
     GraphId node_id(tileid, tile_level, 0);
     for (uint32_t n = 0; n < tile->header()->nodecount(); n++, ++node_id) {
       // Get the node info, copy node index and count from old tile
@@ -652,7 +687,7 @@ std::tuple<uint32_t, uint32_t, uint32_t> FormShortcuts(GraphReader& reader, cons
       // Add shortcut edges first.
       std::unordered_map<uint32_t, uint32_t> shortcuts;
       auto stats = AddShortcutEdges(reader, tile, tilebuilder, node_id, old_edge_index,
-                                    old_edge_count, shortcuts);
+                                    old_edge_count, shortcuts, shortcut_edges);
       shortcut_count += stats.first;
       total_edge_count += stats.second;
       if (stats.first > kMaxShortcutsFromNode) {
@@ -747,6 +782,9 @@ std::tuple<uint32_t, uint32_t, uint32_t> FormShortcuts(GraphReader& reader, cons
 
     // Store the new tile
     tilebuilder.StoreTileData();
+    if (!shortcut_edges.empty()) {
+      level_shortcut_edges.emplace(tileid, std::move(shortcut_edges));
+    }
     LOG_DEBUG((boost::format("ShortcutBuilder created tile %1%: %2% bytes") % tile %
                tilebuilder.header_builder().end_offset())
                   .str());
@@ -759,6 +797,47 @@ std::tuple<uint32_t, uint32_t, uint32_t> FormShortcuts(GraphReader& reader, cons
   return {shortcut_count, total_edge_count, exceeded_max_count};
 }
 
+// Once every tile of the level has its shortcuts the Ids of the superseded edges are final, store
+// them with the shortcuts so recovering a shortcut does not have to walk the graph. Returns the
+// number of shortcuts whose edges could not be stored.
+uint32_t StoreShortcutEdges(GraphReader& reader,
+                            const TileLevel& level,
+                            std::unordered_map<uint32_t, ShortcutEdges>& level_shortcut_edges) {
+  reader.Clear();
+  uint32_t failed = 0;
+  for (auto& [tileid, shortcut_edges] : level_shortcut_edges) {
+    GraphTileBuilder tilebuilder(reader.tile_dir(), GraphId(tileid, level.level, 0), true);
+    for (auto& [shortcut_idx, superseded] : shortcut_edges) {
+      std::vector<GraphId> edges;
+      edges.reserve(superseded.size());
+      for (const auto& base_edge : superseded) {
+        auto tile = reader.GetGraphTile(base_edge.node);
+        if (!tile) {
+          break;
+        }
+        const NodeInfo* nodeinfo = tile->node(base_edge.node);
+        edges.emplace_back(base_edge.node.tileid(), base_edge.node.level(),
+                           nodeinfo->edge_index() + ShortcutCount(tile, nodeinfo) + base_edge.index);
+      }
+      // the shortcut can still be recovered by walking the graph
+      if (edges.size() != superseded.size()) {
+        ++failed;
+        continue;
+      }
+      tilebuilder.SetShortcutEdges(shortcut_idx, std::move(edges));
+    }
+    tilebuilder.StoreTileData();
+    shortcut_edges.clear();
+
+    // Check if we need to clear the tile cache.
+    if (reader.OverCommitted()) {
+      reader.Trim();
+    }
+  }
+  level_shortcut_edges.clear();
+  return failed;
+}
+
 } // namespace
 
 namespace valhalla {
@@ -783,12 +862,19 @@ void ShortcutBuilder::Build(const boost::property_tree::ptree& pt) {
   for (; tile_level != TileHierarchy::levels().rend(); ++tile_level) {
     // Create shortcuts on this level
     LOG_INFO("Creating shortcuts on level " + std::to_string(tile_level->level));
-    auto [sc_count, edge_count, exceeded_max] = FormShortcuts(reader, *tile_level);
+    std::unordered_map<uint32_t, ShortcutEdges> level_shortcut_edges;
+    auto [sc_count, edge_count, exceeded_max] =
+        FormShortcuts(reader, *tile_level, level_shortcut_edges);
     [[maybe_unused]] uint32_t avg = sc_count ? (edge_count / sc_count) : 0;
     LOG_INFO("Finished with " + std::to_string(sc_count) + " shortcuts superseding " +
              std::to_string(edge_count) + " edges, average ~" + std::to_string(avg) +
              " edges per shortcut");
     total_exceeded_max += exceeded_max;
+
+    // Store the superseded edges with the shortcuts
+    if (uint32_t failed = StoreShortcutEdges(reader, *tile_level, level_shortcut_edges)) {
+      LOG_WARN("Could not store the edges of " + std::to_string(failed) + " shortcuts");
+    }
   }
 
   if (total_exceeded_max > 0) {
@@ -5,13 +5,16 @@
 #include "baldr/rapidjson_utils.h"
 #include "baldr/tilehierarchy.h"
 #include "midgard/logging.h"
+#include "mjolnir/altlandmarkbuilder.h"
 #include "mjolnir/bssbuilder.h"
+#include "mjolnir/contractionhierarchybuilder.h"
 #include "mjolnir/elevationbuilder.h"
 #include "mjolnir/graphbuilder.h"
 #include "mjolnir/graphenhancer.h"
 #include "mjolnir/graphfilter.h"
 #include "mjolnir/graphvalidator.h"
 #include "mjolnir/hierarchybuilder.h"
+#include "mjolnir/overlaybuilder.h"
 #include "mjolnir/pbfgraphparser.h"
 #include "mjolnir/restrictionbuilder.h"
 #include "mjolnir/shortcutbuilder.h"
@@ -849,6 +852,21 @@ bool build_tile_set(const boost::property_tree::ptree& original_config,
     GraphValidator::Validate(config);
   }
 
+  // Build the contraction hierarchies for the configured costings
+  if (start_stage <= BuildStage::kContract && BuildStage::kContract <= end_stage) {
+    ContractionHierarchyBuilder::Build(config);
+  }
+
+  // Partition the graph into the cells of the overlay thor customizes per request
+  if (start_stage <= BuildStage::kPartition && BuildStage::kPartition <= end_stage) {
+    OverlayBuilder::Build(config);
+  }
+
+  // Select the landmarks of the ALT heuristics and compute the distances to and from them
+  if (start_stage <= BuildStage::kAlt && BuildStage::kAlt <= end_stage) {
+    AltLandmarkBuilder::Build(config);
+  }
+
   // Cleanup bin files
   if (start_stage <= BuildStage::kCleanup && BuildStage::kCleanup <= end_stage) {
     LOG_INFO("Cleaning up temporary *.bin files within " + tile_dir);
@@ -11,6 +11,9 @@ const std::string& MatrixAlgoToString(const valhalla::Matrix::Algorithm algo) {
       {valhalla::Matrix::CostMatrix, "costmatrix"},
       {valhalla::Matrix::TimeDistanceMatrix, "timedistancematrix"},
       {valhalla::Matrix::TimeDistanceBSSMatrix, "timedistancebssmatrix"},
+      {valhalla::Matrix::ContractionHierarchy, "chmatrix"},
+      {valhalla::Matrix::Overlay, "overlaymatrix"},
+      {valhalla::Matrix::Phast, "phastmatrix"},
   };
   auto i = algos.find(algo);
   return i == algos.cend() ? empty_str : i->second;
@@ -280,7 +283,7 @@ const std::string& ShapeMatch_Enum_Name(const ShapeMatch match) {
 bool Options_Format_Enum_Parse(const std::string& format, Options::Format* f) {
   static const std::unordered_map<std::string, Options::Format> formats{
       {"json", Options::json}, {"gpx", Options::gpx},         {"osrm", Options::osrm},
-      {"pbf", Options::pbf},   {"geotiff", Options::geotiff},
+      {"pbf", Options::pbf},   {"geotiff", Options::geotiff}, {"binary", Options::binary},
   };
   auto i = formats.find(format);
   if (i == formats.cend())
@@ -292,7 +295,7 @@ bool Options_Format_Enum_Parse(const std::string& format, Options::Format* f) {
 const std::string& Options_Format_Enum_Name(const Options::Format match) {
   static const std::unordered_map<int, std::string> formats{
       {Options::json, "json"}, {Options::gpx, "gpx"},         {Options::osrm, "osrm"},
-      {Options::pbf, "pbf"},   {Options::geotiff, "geotiff"},
+      {Options::pbf, "pbf"},   {Options::geotiff, "geotiff"}, {Options::binary, "binary"},
   };
   auto i = formats.find(match);
   return i == formats.cend() ? empty_str : i->second;
@@ -474,4 +477,41 @@ bool Options_ReverseTimeTracking_Enum_Parse(const std::string& strategy,
   *f = i->second;
   return true;
 }
+
+bool Options_TourOptimizer_Enum_Parse(const std::string& optimizer, Options::TourOptimizer* o) {
+  static const std::unordered_map<std::string, Options::TourOptimizer> optimizers{
+      {"annealing", Options::tsp_annealing},
+      {"local_search", Options::tsp_local_search},
+  };
+  auto i = optimizers.find(optimizer);
+  if (i == optimizers.cend())
+    return false;
+  *o = i->second;
+  return true;
+}
+
+bool Options_RouteBatch_Enum_Parse(const std::string& batch, Options::RouteBatch* b) {
+  static const std::unordered_map<std::string, Options::RouteBatch> batches{
+      {"many_to_one", Options::many_to_one},
+      {"one_to_many", Options::one_to_many},
+  };
+  auto i = batches.find(batch);
+  if (i == batches.cend())
+    return false;
+  *b = i->second;
+  return true;
+}
+
+bool Options_MultimodalAlgorithm_Enum_Parse(const std::string& algorithm,
+                                            Options::MultimodalAlgorithm* a) {
+  static const std::unordered_map<std::string, Options::MultimodalAlgorithm> algorithms{
+      {"dijkstra", Options::multimodal_dijkstra},
+      {"raptor", Options::multimodal_raptor},
+  };
+  auto i = algorithms.find(algorithm);
+  if (i == algorithms.cend())
+    return false;
+  *a = i->second;
+  return true;
+}
 } // namespace valhalla
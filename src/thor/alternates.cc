@@ -1,5 +1,6 @@
 #include "thor/alternates.h"
 
+#include <algorithm>
 #include <vector>
 
 using namespace valhalla::thor;
@@ -147,7 +148,7 @@ bool validate_alternate_by_stretch(const std::vector<PathInfo>& optimal_path,
 // Limited Sharing. Compare length of edge segments shared between optimal path and
 // candidate path. If they share more than kAtMostShared throw out this alternate.
 // Note that you should recover all shortcuts before call this function.
-bool validate_alternate_by_sharing(std::vector<std::unordered_set<GraphId>>& shared_edgeids,
+bool validate_alternate_by_sharing(std::vector<std::vector<GraphId>>& shared_edgeids,
                                    const std::vector<std::vector<PathInfo>>& paths,
                                    const std::vector<PathInfo>& candidate_path,
                                    float at_most_shared) {
@@ -159,12 +160,14 @@ bool validate_alternate_by_sharing(std::vector<std::unordered_set<GraphId>>& sha
 
   // we check each accepted path against the candidate
   for (size_t i = 0; i < paths.size(); ++i) {
-    // cache edge ids encountered on the current best path. Don't care about shortcuts because they
+    // cache the sorted edge ids of the current best path. Don't care about shortcuts because they
     // have already been recovered.
     auto& shared = shared_edgeids[i];
     if (shared.empty()) {
+      shared.reserve(paths[i].size());
       for (const auto& pi : paths[i])
-        shared.insert(pi.edgeid);
+        shared.push_back(pi.edgeid);
+      std::sort(shared.begin(), shared.end());
     }
 
     // if an edge on the candidate_path is encountered that is also on one of the existing paths,
@@ -174,7 +177,7 @@ bool validate_alternate_by_sharing(std::vector<std::unordered_set<GraphId>>& sha
       const auto length = &cpi == &candidate_path.front()
                               ? cpi.path_distance
                               : cpi.path_distance - (&cpi - 1)->path_distance;
-      if (shared.find(cpi.edgeid) != shared.end()) {
+      if (std::binary_search(shared.begin(), shared.end(), cpi.edgeid)) {
         shared_length += length;
       }
     }
@@ -195,5 +198,52 @@ bool validate_alternate_by_local_optimality(const std::vector<PathInfo>&) {
   // [TODO] NOT IMPLEMENTED
   return true;
 }
+
+TreeSharing::TreeSharing(std::span<const sif::BDEdgeLabel> forward_labels,
+                         std::span<const sif::BDEdgeLabel> reverse_labels)
+    : forward_labels_(forward_labels), reverse_labels_(reverse_labels) {
+}
+
+void TreeSharing::add(const uint32_t forward_idx, const uint32_t reverse_idx) {
+  auto& on_forward = on_forward_.emplace_back(forward_labels_.size(), false);
+  for (auto l = forward_idx; l != kInvalidLabel; l = forward_labels_[l].predecessor()) {
+    on_forward[l] = true;
+  }
+  auto& on_reverse = on_reverse_.emplace_back(reverse_labels_.size(), false);
+  for (auto l = reverse_idx; l != kInvalidLabel; l = reverse_labels_[l].predecessor()) {
+    on_reverse[l] = true;
+  }
+}
+
+bool TreeSharing::shares_too_much(const uint32_t forward_idx,
+                                  const uint32_t reverse_idx,
+                                  const std::vector<std::vector<PathInfo>>& paths,
+                                  const float at_most_shared) const {
+  for (size_t i = 0; i < on_forward_.size() && i < paths.size(); ++i) {
+    // the forward labels have the distance from the origin to the end of their edge, the reverse
+    // ones from the start of their edge to the destination. The connection edge is on the forward
+    // part of the path.
+    uint32_t shared_length = 0;
+    for (auto l = forward_idx; l != kInvalidLabel; l = forward_labels_[l].predecessor()) {
+      if (on_forward_[i][l]) {
+        shared_length += forward_labels_[l].path_distance();
+        break;
+      }
+    }
+    for (auto l = reverse_labels_[reverse_idx].predecessor(); l != kInvalidLabel;
+         l = reverse_labels_[l].predecessor()) {
+      if (on_reverse_[i][l]) {
+        shared_length += reverse_labels_[l].path_distance();
+        break;
+      }
+    }
+
+    if (shared_length > at_most_shared * paths[i].back().path_distance) {
+      LOG_DEBUG("Candidate alternate rejected by sharing on the search trees");
+      return true;
+    }
+  }
+  return false;
+}
 } // namespace thor
 } // namespace valhalla
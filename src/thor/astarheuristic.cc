@@ -0,0 +1,24 @@
+#include "thor/astarheuristic.h"
+
+#include <algorithm>
+
+using namespace valhalla::baldr;
+
+namespace valhalla {
+namespace thor {
+
+std::vector<GraphId> correlated_nodes(GraphReader& reader, const valhalla::Location& location) {
+  std::vector<GraphId> nodes;
+  for (const auto& edge : location.correlation().edges()) {
+    const GraphId edgeid(edge.graph_id());
+    for (const auto& node : {reader.edge_startnode(edgeid), reader.edge_endnode(edgeid)}) {
+      if (node.is_valid() && std::find(nodes.begin(), nodes.end(), node) == nodes.end()) {
+        nodes.push_back(node);
+      }
+    }
+  }
+  return nodes;
+}
+
+} // namespace thor
+} // namespace valhalla
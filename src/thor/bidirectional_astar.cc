@@ -2,15 +2,20 @@
 #include "baldr/datetime.h"
 #include "baldr/directededge.h"
 #include "baldr/graphid.h"
+#include "midgard/arena.h"
 #include "midgard/logging.h"
 #include "sif/edgelabel.h"
 #include "sif/hierarchylimits.h"
 #include "sif/recost.h"
 #include "thor/alternates.h"
+#include "round_barrier.h"
 
 #include <boost/property_tree/ptree.hpp>
 
 #include <algorithm>
+#include <exception>
+#include <thread>
+#include <unordered_set>
 
 using namespace valhalla::midgard;
 using namespace valhalla::baldr;
@@ -37,6 +42,13 @@ constexpr float kAlternativeCostExtend = 1.2f;
 // iterations in order no to drop performance too much.
 constexpr uint32_t kAlternativeIterationsDelta = 100000;
 
+// How many labels each tree settles per round when both expand at the same time, the trees are
+// only connected and the threads only wait for each other between the rounds
+constexpr uint32_t kConcurrentExpansions = 250;
+
+// Locations at least this crow flies distance (meters) apart expand both trees at the same time
+constexpr float kConcurrencyMinDistance = 50000.f;
+
 inline float find_percent_along(const valhalla::Location& location, const GraphId& edge_id) {
   for (const auto& e : location.correlation().edges()) {
     if (e.graph_id() == edge_id)
@@ -51,11 +63,19 @@ namespace valhalla {
 namespace thor {
 
 // Default constructor
-BidirectionalAStar::BidirectionalAStar(const boost::property_tree::ptree& config)
+BidirectionalAStar::BidirectionalAStar(const boost::property_tree::ptree& config,
+                                       std::pmr::memory_resource* arena)
     : PathAlgorithm(config.get<uint32_t>("max_reserved_labels_count_bidir_astar",
                                          kInitialEdgeLabelCountBidirAstar),
                     config.get<bool>("clear_reserved_memory", false)),
-      extended_search_(config.get<bool>("extended_search", false)) {
+      arena_(arena), overlay_(nullptr),
+      edgelabels_forward_(arena ? arena : std::pmr::get_default_resource()),
+      edgelabels_reverse_(arena ? arena : std::pmr::get_default_resource()),
+      extended_search_(config.get<bool>("extended_search", false)),
+      concurrency_(config.get<uint32_t>("bidirectional_astar.concurrency", 1)),
+      concurrency_min_distance_(config.get<float>("bidirectional_astar.concurrency_min_distance",
+                                                  kConcurrencyMinDistance)),
+      concurrent_(false) {
   cost_threshold_ = 0;
   iterations_threshold_ = 0;
   desired_paths_count_ = 1;
@@ -67,11 +87,23 @@ BidirectionalAStar::BidirectionalAStar(const boost::property_tree::ptree& config
   pruning_disabled_at_destination_ = false;
   ignore_hierarchy_limits_ = false;
   threshold_delta_ = config.get<float>("bidirectional_astar.threshold_delta", kThresholdDelta);
+  landmarks_ = nullptr;
+  use_landmarks_ = config.get<std::string>("bidirectional_astar.heuristic", "distance") == "alt";
   alternative_cost_extend_ =
       config.get<float>("bidirectional_astar.alternative_cost_extend", kAlternativeCostExtend);
   alternative_iterations_delta_ =
       config.get<uint32_t>("bidirectional_astar.alternative_iterations_delta",
                            kAlternativeIterationsDelta);
+  const auto edge_status_pool_size =
+      clear_reserved_memory_
+          ? 0
+          : config.get<size_t>("max_reserved_edge_status_size", kDefaultEdgeStatusPoolSize);
+  edgestatus_forward_.set_max_pool_size(edge_status_pool_size);
+  edgestatus_reverse_.set_max_pool_size(edge_status_pool_size);
+  const auto queue_type = baldr::to_label_queue_type(
+      config.get<std::string>("bidirectional_astar.queue", "double_bucket"));
+  adjacencylist_forward_.set_type(queue_type);
+  adjacencylist_reverse_.set_type(queue_type);
 }
 
 // Destructor
@@ -80,12 +112,13 @@ BidirectionalAStar::~BidirectionalAStar() {
 
 // Clear the temporary information generated during path construction.
 void BidirectionalAStar::Clear() {
+  // arena memory is not given back before the end of the request so there is nothing to shrink
   auto reservation = clear_reserved_memory_ ? 0 : max_reserved_labels_count_;
-  if (edgelabels_forward_.size() > reservation) {
+  if (!arena_ && edgelabels_forward_.size() > reservation) {
     edgelabels_forward_.resize(reservation);
     edgelabels_forward_.shrink_to_fit();
   }
-  if (edgelabels_reverse_.size() > reservation) {
+  if (!arena_ && edgelabels_reverse_.size() > reservation) {
     edgelabels_reverse_.resize(reservation);
     edgelabels_reverse_.shrink_to_fit();
   }
@@ -105,6 +138,19 @@ void BidirectionalAStar::Clear() {
   pruning_disabled_at_origin_ = false;
   pruning_disabled_at_destination_ = false;
   ignore_hierarchy_limits_ = false;
+
+  shortcuts_forward_.clear();
+  shortcuts_reverse_.clear();
+  if (reverse_reader_ && reverse_reader_->OverCommitted()) {
+    reverse_reader_->Trim();
+  }
+}
+
+void BidirectionalAStar::ReleaseArena() {
+  if (arena_) {
+    release_memory(edgelabels_forward_);
+    release_memory(edgelabels_reverse_);
+  }
 }
 
 // Initialize the A* heuristic and adjacency lists for both the forward
@@ -204,8 +250,16 @@ inline bool BidirectionalAStar::ExpandInner(baldr::GraphReader& graphreader,
     if (ignore_hierarchy_limits_ || !get_opp_edge_data())
       return false;
 
-    const auto& opp_edgestatus = FORWARD ? edgestatus_reverse_ : edgestatus_forward_;
-    const auto opp_edge_set = opp_edgestatus.Get(opp_edge_id).set();
+    // While both trees expand the other one has only handed over the shortcuts up to the last round
+    EdgeSet opp_edge_set;
+    if (concurrent_) {
+      const auto& opp_shortcuts = FORWARD ? shortcuts_reverse_ : shortcuts_forward_;
+      const auto found = opp_shortcuts.find(opp_edge_id);
+      opp_edge_set = found == opp_shortcuts.end() ? EdgeSet::kUnreachedOrReset : found->second;
+    } else {
+      const auto& opp_edgestatus = FORWARD ? edgestatus_reverse_ : edgestatus_forward_;
+      opp_edge_set = opp_edgestatus.Get(opp_edge_id).set();
+    }
     // Synchronize shortcuts for both directions. If this shortcut has been already
     // encountered on the opposing search we should do the same now: skip or traverse.
     if ((opp_edge_set != EdgeSet::kSkipped &&
@@ -215,6 +269,10 @@ inline bool BidirectionalAStar::ExpandInner(baldr::GraphReader& graphreader,
     } else {
       // Mark this edge as "skipped".
       *meta.edge_status = {EdgeSet::kSkipped, 0};
+      if (concurrent_) {
+        (FORWARD ? round_shortcuts_forward_ : round_shortcuts_reverse_)
+            .emplace_back(meta.edge_id, EdgeSet::kSkipped);
+      }
       return false;
     }
   }
@@ -319,8 +377,10 @@ inline bool BidirectionalAStar::ExpandInner(baldr::GraphReader& graphreader,
   // Find the sort cost (with A* heuristic) using the lat,lng at the
   // end node of the directed edge.
   float dist = 0.0f;
-  float sortcost = newcost.cost + (FORWARD ? astarheuristic_forward_.Get(end_node_ll, dist)
-                                           : astarheuristic_reverse_.Get(end_node_ll, dist));
+  const auto end_node = meta.edge->endnode();
+  float sortcost =
+      newcost.cost + (FORWARD ? astarheuristic_forward_.Get(end_node_ll, end_node, dist)
+                              : astarheuristic_reverse_.Get(end_node_ll, end_node, dist));
 
   // not_thru_pruning_ is only set to false on the 2nd pass in route_action.
   // We allow settling not_thru edges so we can connect both trees on them.
@@ -371,6 +431,10 @@ inline bool BidirectionalAStar::ExpandInner(baldr::GraphReader& graphreader,
   }
 
   *meta.edge_status = {EdgeSet::kTemporary, idx};
+  if (concurrent_ && meta.edge->is_shortcut()) {
+    (FORWARD ? round_shortcuts_forward_ : round_shortcuts_reverse_)
+        .emplace_back(meta.edge_id, EdgeSet::kTemporary);
+  }
 
   // setting this edge as reached
   if (expansion_callback_) {
@@ -532,6 +596,13 @@ BidirectionalAStar::GetBestPath(valhalla::Location& origin,
                           destination.correlation().edges(0).ll().lat());
   Init(origin_new, destination_new);
 
+  // landmark distances only know the edges some mode may take in their direction
+  if (use_landmarks_ && landmarks_ && !costing_->ignore_oneways()) {
+    astarheuristic_forward_.SetLandmarks(landmarks_, correlated_nodes(graphreader, destination),
+                                         true);
+    astarheuristic_reverse_.SetLandmarks(landmarks_, correlated_nodes(graphreader, origin), false);
+  }
+
   // we use a non varying time for all time dependent routes until we can figure out how to vary the
   // time during the path computation in the bidirectional algorithm
   bool invariant = options.date_time_type() == Options::invariant;
@@ -573,6 +644,17 @@ BidirectionalAStar::GetBestPath(valhalla::Location& origin,
   //    reverse_time_info = TimeInfo::make(d, graphreader, &tz_cache_);
   //  }
 
+  // without a time the customized overlay finds the same path without expanding the graph
+  if (overlay_ && overlay_->available() && desired_paths_count_ == 1 && !expansion_callback_ &&
+      !forward_time_info.valid && !reverse_time_info.valid &&
+      overlay_->Supports(graphreader, *costing_) &&
+      overlay_->Ready(options, graphreader, *costing_)) {
+    auto paths = OverlayPath(graphreader, options, origin, destination);
+    if (!paths.empty()) {
+      return paths;
+    }
+  }
+
   // Set origin and destination locations - seeds the adj. lists
   // Note: because we can correlate to more than one place for a given
   // PathLocation using edges.front here means we are only setting the
@@ -581,6 +663,14 @@ BidirectionalAStar::GetBestPath(valhalla::Location& origin,
   SetOrigin(graphreader, origin, forward_time_info);
   SetDestination(graphreader, destination, reverse_time_info);
 
+  // long routes expand both trees at the same time if there is a graph reader for the second thread,
+  // the request arena and the expansion callback are not thread-safe
+  if (concurrency_ > 1 && !reader_config_.empty() && !arena_ && !expansion_callback_ &&
+      origin_new.Distance(destination_new) >= concurrency_min_distance_) {
+    return ExpandConcurrent(graphreader, options, origin, destination, forward_time_info,
+                            reverse_time_info, invariant);
+  }
+
   // Find shortest path. Switch between a forward direction and a reverse
   // direction search based on the current costs. Alternating like this
   // prevents one tree from expanding much more quickly (if in a sparser
@@ -773,7 +863,8 @@ BidirectionalAStar::GetBestPath(valhalla::Location& origin,
           float route_lower_bound =
               edgelabels_forward_[fwd_pred.predecessor()].cost().cost +
               fwd_pred.transition_cost().cost + rev_pred.sortcost() -
-              astarheuristic_reverse_.Get(tile->get_node_ll(fwd_pred.endnode()));
+              astarheuristic_reverse_.Get(tile->get_node_ll(fwd_pred.endnode()),
+                                          fwd_pred.endnode());
           // Prune this edge if estimated lower bound cost exceeds the cost threshold.
           if (route_lower_bound > cost_threshold_) {
             continue;
@@ -830,7 +921,8 @@ BidirectionalAStar::GetBestPath(valhalla::Location& origin,
           float route_lower_bound =
               edgelabels_reverse_[rev_pred.predecessor()].cost().cost +
               rev_pred.transition_cost().cost + fwd_pred.sortcost() -
-              astarheuristic_forward_.Get(tile->get_node_ll(rev_pred.endnode()));
+              astarheuristic_forward_.Get(tile->get_node_ll(rev_pred.endnode()),
+                                          rev_pred.endnode());
           // Prune this edge if estimated lower bound cost exceeds the cost threshold.
           if (route_lower_bound > cost_threshold_) {
             continue;
@@ -849,6 +941,276 @@ BidirectionalAStar::GetBestPath(valhalla::Location& origin,
   return {}; // If we are here the route failed
 }
 
+// Settles and expands up to kConcurrentExpansions labels of one tree like GetBestPath does, but
+// only with its own labels and edge status. What it needs of the other tree is from the start of
+// the round and the connections are made once the round is over.
+template <const ExpansionType expansion_direction>
+void BidirectionalAStar::ExpandRound(GraphReader& graphreader,
+                                     expansion_round_t& round,
+                                     const TimeInfo& time_info,
+                                     const bool invariant,
+                                     const std::function<void()>* round_interrupt) {
+  constexpr bool FORWARD = expansion_direction == ExpansionType::forward;
+  auto& adjacencylist = FORWARD ? adjacencylist_forward_ : adjacencylist_reverse_;
+  auto& edgelabels = FORWARD ? edgelabels_forward_ : edgelabels_reverse_;
+  auto& edgestatus = FORWARD ? edgestatus_forward_ : edgestatus_reverse_;
+  auto& hierarchy_limits = FORWARD ? hierarchy_limits_forward_ : hierarchy_limits_reverse_;
+  const auto& other_heuristic = FORWARD ? astarheuristic_reverse_ : astarheuristic_forward_;
+
+  for (uint32_t step = 0; step < kConcurrentExpansions; ++step) {
+    // Allow this process to be aborted
+    if (round_interrupt && (round.expansions++ % kInterruptIterationsInterval) == 0) {
+      (*round_interrupt)();
+    }
+
+    const auto pred_idx = adjacencylist.pop();
+    if (pred_idx == kInvalidLabel) {
+      round.exhausted = true;
+      return;
+    }
+    BDEdgeLabel pred = edgelabels[pred_idx];
+    edgestatus.Update(pred.edgeid(), EdgeSet::kPermanent);
+    round.pred = pred;
+
+    // Terminate if the cost threshold has been exceeded.
+    if (pred.sortcost() + (FORWARD ? cost_diff_ : 0.f) > round.cost_threshold) {
+      round.done = true;
+      return;
+    }
+    round.settled.push_back(pred_idx);
+
+    // Prune path if predecessor is not a through edge or if the maximum
+    // number of upward transitions has been exceeded on this hierarchy level.
+    if ((pred.not_thru() && pred.not_thru_pruning()) ||
+        (!ignore_hierarchy_limits_ &&
+         StopExpanding(hierarchy_limits[pred.endnode().level()], pred.distance()))) {
+      continue;
+    }
+
+    // Get the opposing predecessor directed edge going in reverse
+    const DirectedEdge* opp_pred_edge = nullptr;
+    if (!FORWARD) {
+      const auto pred_tile = graphreader.GetGraphTile(pred.opp_edgeid());
+      if (pred_tile == nullptr) {
+        continue;
+      }
+      opp_pred_edge = pred_tile->directededge(pred.opp_edgeid());
+    }
+
+    // Reach-based pruning, with the sort cost the other tree was at when the round started
+    if (round.cost_threshold != std::numeric_limits<float>::max() &&
+        pred.predecessor() != kInvalidLabel) {
+      const auto tile = graphreader.GetGraphTile(pred.endnode());
+      if (tile == nullptr) {
+        continue;
+      }
+      const float route_lower_bound =
+          edgelabels[pred.predecessor()].cost().cost + pred.transition_cost().cost +
+          round.other_sortcost -
+          other_heuristic.Get(tile->get_node_ll(pred.endnode()), pred.endnode());
+      if (route_lower_bound > round.cost_threshold) {
+        continue;
+      }
+    }
+
+    Expand<expansion_direction>(graphreader, pred.endnode(), pred, pred_idx, opp_pred_edge,
+                                time_info, invariant);
+  }
+}
+
+// Expands the forward tree on the calling thread and the reverse tree on a second one with its
+// own graph reader, each a round of kConcurrentExpansions labels at a time. During a round a tree
+// only changes and reads its own labels, edge status and hierarchy limits. Between the rounds the
+// edges settled in the round are connected to the other tree, the shortcuts each tree took or
+// skipped are handed to the other one and the stopping criteria of GetBestPath are checked with
+// the new connections. A tree can expand past a connection by up to a round, which only adds
+// labels and connections that cost more.
+std::vector<std::vector<PathInfo>>
+BidirectionalAStar::ExpandConcurrent(GraphReader& graphreader,
+                                     const Options& options,
+                                     valhalla::Location& origin,
+                                     valhalla::Location& destination,
+                                     const TimeInfo& forward_time_info,
+                                     const TimeInfo& reverse_time_info,
+                                     const bool invariant) {
+  if (!reverse_reader_) {
+    reverse_reader_ = std::make_unique<GraphReader>(reader_config_);
+  }
+  // the forward tree keeps tz_cache_ to itself while the trees expand at the same time
+  TimeInfo reverse_thread_time_info = reverse_time_info;
+  reverse_thread_time_info.tz_cache = &reverse_tz_cache_;
+
+  expansion_round_t forward{};
+  expansion_round_t reverse{};
+  bool done = false;
+  std::exception_ptr error;
+  round_barrier_t barrier(2);
+
+  // the reverse tree expands on the second thread in the rounds both trees expand in
+  std::thread reverse_thread([&]() {
+    while (true) {
+      barrier.wait();
+      if (done) {
+        return;
+      }
+      try {
+        ExpandRound<ExpansionType::reverse>(*reverse_reader_, reverse, reverse_thread_time_info,
+                                            invariant, nullptr);
+      } catch (...) { error = std::current_exception(); }
+      barrier.wait();
+    }
+  });
+
+  auto search = [&]() -> std::vector<std::vector<PathInfo>> {
+    bool forward_exhausted = false;
+    bool reverse_exhausted = false;
+    std::unordered_set<GraphId> connected;
+    while (true) {
+      // Exhaust hierarchy limits simultaneously in both directions, see GetBestPath
+      bool force_forward = false;
+      bool force_reverse = false;
+      if (!ignore_hierarchy_limits_) {
+        for (size_t level = TileHierarchy::levels().size() - 1; level > 0; --level) {
+          if (StopExpanding(hierarchy_limits_reverse_[level], reverse.pred.distance()) &&
+              !StopExpanding(hierarchy_limits_forward_[level], forward.pred.distance())) {
+            force_forward = true;
+            break;
+          } else if (StopExpanding(hierarchy_limits_forward_[level], forward.pred.distance()) &&
+                     !StopExpanding(hierarchy_limits_reverse_[level], reverse.pred.distance())) {
+            force_reverse = true;
+            break;
+          }
+        }
+      }
+      const bool expand_forward = !forward_exhausted && (!force_reverse || reverse_exhausted);
+      const bool expand_reverse = !reverse_exhausted && (!force_forward || forward_exhausted);
+
+      // Expand a round of both trees, or of one of them while the other waits on it
+      for (auto* round : {&forward, &reverse}) {
+        round->settled.clear();
+        round->cost_threshold = cost_threshold_;
+        round->exhausted = false;
+        round->done = false;
+      }
+      forward.other_sortcost = reverse.pred.sortcost();
+      reverse.other_sortcost = forward.pred.sortcost();
+      if (expand_forward && expand_reverse) {
+        // the round is finished by both threads even if one of them threw, the second thread
+        // waits on the barrier for the next round or to stop
+        std::exception_ptr forward_error;
+        barrier.wait();
+        try {
+          ExpandRound<ExpansionType::forward>(graphreader, forward, forward_time_info, invariant,
+                                              interrupt);
+        } catch (...) { forward_error = std::current_exception(); }
+        barrier.wait();
+        if (forward_error) {
+          std::rethrow_exception(forward_error);
+        }
+        if (error) {
+          std::rethrow_exception(error);
+        }
+      } else if (expand_forward) {
+        ExpandRound<ExpansionType::forward>(graphreader, forward, forward_time_info, invariant,
+                                            interrupt);
+      } else {
+        ExpandRound<ExpansionType::reverse>(*reverse_reader_, reverse, reverse_thread_time_info,
+                                            invariant, interrupt);
+      }
+
+      // Hand the shortcuts over to the other tree
+      for (const auto& [edge_id, set] : round_shortcuts_forward_) {
+        shortcuts_forward_.insert_or_assign(edge_id, set);
+      }
+      for (const auto& [edge_id, set] : round_shortcuts_reverse_) {
+        shortcuts_reverse_.insert_or_assign(edge_id, set);
+      }
+      round_shortcuts_forward_.clear();
+      round_shortcuts_reverse_.clear();
+
+      // Connect the edges settled in the round to the other tree, an edge settled by both trees in
+      // the round only once. Like GetBestPath the destination (origin) edges connect before the
+      // reverse (forward) tree settles them.
+      connected.clear();
+      for (const auto idx : forward.settled) {
+        const auto& fwd_pred = edgelabels_forward_[idx];
+        const auto opp_status = edgestatus_reverse_.Get(fwd_pred.opp_edgeid());
+        if ((opp_status.set() == EdgeSet::kPermanent ||
+             (opp_status.set() == EdgeSet::kTemporary &&
+              edgelabels_reverse_[opp_status.index()].predecessor() == kInvalidLabel)) &&
+            SetForwardConnection(graphreader, fwd_pred)) {
+          connected.insert(fwd_pred.edgeid());
+        }
+      }
+      for (const auto idx : reverse.settled) {
+        const auto& rev_pred = edgelabels_reverse_[idx];
+        if (connected.count(rev_pred.opp_edgeid())) {
+          continue;
+        }
+        const auto opp_status = edgestatus_forward_.Get(rev_pred.opp_edgeid());
+        if (opp_status.set() == EdgeSet::kPermanent ||
+            (opp_status.set() == EdgeSet::kTemporary &&
+             edgelabels_forward_[opp_status.index()].predecessor() == kInvalidLabel)) {
+          SetReverseConnection(graphreader, rev_pred);
+        }
+      }
+
+      // Terminate if the cost or the iterations threshold has been exceeded
+      if (forward.done || reverse.done ||
+          (edgelabels_reverse_.size() + edgelabels_forward_.size()) > iterations_threshold_) {
+        return FormPath(graphreader, options, origin, destination, forward_time_info);
+      }
+
+      // If a direction is exhausted return the connections found, if there are none the other one
+      // only goes on if it may still find the way onto a not_thru or closed edge, see GetBestPath
+      if (expand_forward && forward.exhausted) {
+        forward_exhausted = true;
+        if (!best_connections_.empty()) {
+          return FormPath(graphreader, options, origin, destination, forward_time_info);
+        }
+        if (!extended_search_ || !pruning_disabled_at_destination_) {
+          return {};
+        }
+      }
+      if (expand_reverse && reverse.exhausted) {
+        reverse_exhausted = true;
+        if (!best_connections_.empty()) {
+          return FormPath(graphreader, options, origin, destination, forward_time_info);
+        }
+        if (!extended_search_ || !pruning_disabled_at_origin_) {
+          return {};
+        }
+      }
+      if (forward_exhausted && reverse_exhausted) {
+        LOG_ERROR("Bi-directional route failure - search exhausted: n = " +
+                  std::to_string(edgelabels_forward_.size()) + "," +
+                  std::to_string(edgelabels_reverse_.size()));
+        return {};
+      }
+    }
+  };
+
+  auto stop = [&]() {
+    done = true;
+    barrier.wait();
+    reverse_thread.join();
+    concurrent_ = false;
+    round_shortcuts_forward_.clear();
+    round_shortcuts_reverse_.clear();
+  };
+
+  concurrent_ = true;
+  std::vector<std::vector<PathInfo>> paths;
+  try {
+    paths = search();
+  } catch (...) {
+    stop();
+    throw;
+  }
+  stop();
+  return paths;
+}
+
 // The edge on the forward search connects to a reached edge on the reverse
 // search tree. Check if this is the best connection so far and set the
 // search threshold.
@@ -1053,8 +1415,10 @@ void BidirectionalAStar::SetOrigin(GraphReader& graphreader,
     // We assume the slowest speed you could travel to cover that distance to start/end the route
     // TODO: assumes 1m/s which is a maximum penalty this could vary per costing model
     cost.cost += edge.distance();
-    float dist = astarheuristic_forward_.GetDistance(nodeinfo->latlng(endtile->header()->base_ll()));
-    float sortcost = cost.cost + astarheuristic_forward_.Get(dist);
+    float dist = 0.f;
+    float sortcost =
+        cost.cost + astarheuristic_forward_.Get(nodeinfo->latlng(endtile->header()->base_ll()),
+                                                directededge->endnode(), dist);
 
     // Add EdgeLabel to the adjacency list. Set the predecessor edge index
     // to invalid to indicate the origin of the path.
@@ -1160,8 +1524,9 @@ void BidirectionalAStar::SetDestination(GraphReader& graphreader,
     cost.cost += edge.distance();
 
     const auto& end_node_ll = tile->get_node_ll(opp_dir_edge->endnode());
-    float dist = astarheuristic_reverse_.GetDistance(end_node_ll);
-    float sortcost = cost.cost + astarheuristic_reverse_.Get(dist);
+    float dist = 0.f;
+    float sortcost =
+        cost.cost + astarheuristic_reverse_.Get(end_node_ll, opp_dir_edge->endnode(), dist);
 
     // Add EdgeLabel to the adjacency list. Set the predecessor edge index
     // to invalid to indicate the origin of the path. Make sure the opposing
@@ -1224,7 +1589,9 @@ std::vector<std::vector<PathInfo>> BidirectionalAStar::FormPath(GraphReader& gra
     filter_alternates_by_stretch(best_connections_);
   }
   // For looking up edge ids on previously chosen best paths
-  std::vector<std::unordered_set<GraphId>> shared_edgeids;
+  std::vector<std::vector<GraphId>> shared_edgeids;
+  // For rejecting the connections sharing too much with them before forming their paths
+  TreeSharing tree_sharing(edgelabels_forward_, edgelabels_reverse_);
 
   // get maximum amount of sharing parameter based on origin->destination distance
   float max_sharing = desired_paths_count_ > 1 ? get_max_sharing(origin, dest) : 0.f;
@@ -1268,6 +1635,12 @@ std::vector<std::vector<PathInfo>> BidirectionalAStar::FormPath(GraphReader& gra
     uint32_t idx1 = edgestatus_forward_.Get(best_connection->edgeid).index();
     uint32_t idx2 = edgestatus_reverse_.Get(best_connection->opp_edgeid).index();
 
+    // The connections on the plateau of a chosen path give the same path, and most of the others
+    // share too much of a chosen path on the search trees already
+    if (!paths.empty() && tree_sharing.shares_too_much(idx1, idx2, paths, max_sharing)) {
+      continue;
+    }
+
     // Metrics (TODO - more accurate cost)
     LOG_DEBUG("path_cost::" + std::to_string(edgelabels_forward_[idx1].cost().cost +
                                              edgelabels_reverse_[idx2].cost().cost));
@@ -1386,15 +1759,63 @@ std::vector<std::vector<PathInfo>> BidirectionalAStar::FormPath(GraphReader& gra
                           validate_alternate_by_stretch(paths.front(), path) &&
                           validate_alternate_by_local_optimality(path))) {
       paths.emplace_back(std::move(path));
+      if (paths.size() < desired_paths_count_) {
+        tree_sharing.add(idx1, idx2);
+      }
     }
   }
   // give back the paths
   return paths;
 }
 
+std::vector<std::vector<PathInfo>> BidirectionalAStar::OverlayPath(GraphReader& graphreader,
+                                                                   const Options& options,
+                                                                   const valhalla::Location& origin,
+                                                                   const valhalla::Location& dest) {
+  overlay_->set_interrupt(interrupt);
+  const auto metric = overlay_->Metric(options, graphreader, *costing_);
+  const auto sources = overlay_->Seeds(graphreader, *costing_, *metric, origin, true);
+  const auto targets = overlay_->Seeds(graphreader, *costing_, *metric, dest, false);
+
+  // going around the block back onto the same edge is left to the regular search
+  for (const auto& source : sources) {
+    for (const auto& target : targets) {
+      if (source.node == target.node && source.percent_along > target.percent_along) {
+        return {};
+      }
+    }
+  }
+  const auto path_edges = overlay_->Route(*metric, sources, targets);
+  if (path_edges.empty()) {
+    return {};
+  }
+
+  std::vector<PathInfo> path;
+  path.reserve(path_edges.size());
+  auto edge_itr = path_edges.begin();
+  const auto edge_cb = [&edge_itr, &path_edges]() {
+    return (edge_itr == path_edges.end()) ? GraphId{} : (*edge_itr++);
+  };
+  const auto label_cb = [this, &path](const PathEdgeLabel& label) {
+    path.emplace_back(label.mode(), label.cost(), label.edgeid(), 0, label.path_distance(),
+                      label.restriction_idx(), label.transition_cost(), false);
+    has_ferry_ = has_ferry_ || label.use() == Use::kFerry;
+  };
+  try {
+    sif::recost_forward(graphreader, *costing_, edge_cb, label_cb,
+                        find_percent_along(origin, path_edges.front()),
+                        find_percent_along(dest, path_edges.back()), TimeInfo::invalid(), false,
+                        true);
+  } catch (const std::exception& e) {
+    LOG_ERROR(std::string("Bi-directional astar failed to recost the overlay path: ") + e.what());
+    return {};
+  }
+  return {std::move(path)};
+}
+
 bool IsBridgingEdgeRestricted(GraphReader& graphreader,
-                              std::vector<sif::BDEdgeLabel>& edge_labels_fwd,
-                              std::vector<sif::BDEdgeLabel>& edge_labels_rev,
+                              std::pmr::vector<sif::BDEdgeLabel>& edge_labels_fwd,
+                              std::pmr::vector<sif::BDEdgeLabel>& edge_labels_rev,
                               const BDEdgeLabel& fwd_pred,
                               const BDEdgeLabel& rev_pred,
                               const sif::cost_ptr_t& costing) {
@@ -0,0 +1,298 @@
+#include "thor/chmatrix.h"
+#include "baldr/time_info.h"
+#include "midgard/logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <limits>
+
+using namespace valhalla::baldr;
+using namespace valhalla::sif;
+
+namespace {
+
+constexpr float kUnreached = std::numeric_limits<float>::max();
+
+// whether the edge of a location is also an edge of the other side at the very same spot
+bool is_super_trivial(const valhalla::PathEdge& edge,
+                      const std::unordered_multimap<GraphId, double>& other_edges) {
+  auto others = other_edges.equal_range(GraphId(edge.graph_id()));
+  for (auto it = others.first; it != others.second; ++it) {
+    if (edge.percent_along() == it->second) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+namespace valhalla {
+namespace thor {
+
+CHMatrix::CHMatrix(const boost::property_tree::ptree& config, const std::string& dir)
+    : MatrixAlgorithm(config), hierarchy_(nullptr) {
+  std::error_code ec;
+  if (dir.empty() || !std::filesystem::is_directory(dir, ec)) {
+    return;
+  }
+  for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+    if (entry.path().extension() != ".ch") {
+      continue;
+    }
+    try {
+      auto hierarchy = std::make_unique<ContractionHierarchy>(entry.path().string());
+      const auto type = static_cast<Costing::Type>(hierarchy->costing());
+      LOG_INFO("Using the contraction hierarchy for " + Costing_Enum_Name(type) + " with " +
+               std::to_string(hierarchy->size()) + " edges");
+      hierarchies_[type] = std::move(hierarchy);
+    } catch (const std::exception& e) {
+      LOG_WARN("Skipping " + entry.path().string() + ": " + e.what());
+    }
+  }
+}
+
+CHMatrix::CHMatrix(const boost::property_tree::ptree& config, const CHMatrix& other)
+    : MatrixAlgorithm(config), hierarchies_(other.hierarchies_), hierarchy_(nullptr) {
+}
+
+bool CHMatrix::HasHierarchy(const Options& options) const {
+  auto hierarchy = hierarchies_.find(options.costing_type());
+  if (hierarchy == hierarchies_.end()) {
+    return false;
+  }
+  auto costing = options.costings().find(options.costing_type());
+  return costing != options.costings().end() &&
+         ContractionHierarchy::SerializeOptions(costing->second) == hierarchy->second->options();
+}
+
+bool CHMatrix::Supports(const Api& request,
+                        GraphReader& graphreader,
+                        const DynamicCost& costing) const {
+  // the hierarchy has the static weights, the live traffic and closures would only show on the
+  // edges of the locations
+  const auto& options = request.options();
+  return !has_time_ && options.shape_format() == no_shape &&
+         options.matrix_locations() == std::numeric_limits<uint32_t>::max() &&
+         !((costing.flow_mask() & kCurrentFlowMask) && graphreader.HasLiveTraffic()) &&
+         HasHierarchy(options);
+}
+
+void CHMatrix::Clear() {
+  hierarchy_ = nullptr;
+  costing_.reset();
+  buckets_.clear();
+  bucket_index_.clear();
+  labels_.clear();
+  queue_.clear();
+  if (clear_reserved_memory_) {
+    buckets_.shrink_to_fit();
+    bucket_index_ = {};
+    labels_ = {};
+    queue_.shrink_to_fit();
+  }
+}
+
+std::unordered_multimap<GraphId, double>
+CHMatrix::CorrelatedEdges(const google::protobuf::RepeatedPtrField<valhalla::Location>& locations) {
+  std::unordered_multimap<GraphId, double> edges;
+  for (const auto& location : locations) {
+    for (const auto& e : location.correlation().edges()) {
+      edges.emplace(static_cast<GraphId>(e.graph_id()), e.percent_along());
+    }
+  }
+  return edges;
+}
+
+std::vector<CHMatrix::seed_t>
+CHMatrix::Seeds(GraphReader& graphreader,
+                const valhalla::Location& location,
+                const std::unordered_multimap<GraphId, double>& others,
+                const bool forward) const {
+  // like the other matrices, skip the edges that only touch a node snapped location if there are
+  // others, so sources leave on the outbound edges and targets are reached on the inbound ones
+  const auto& edges = location.correlation().edges();
+  const bool has_other_edges = std::any_of(edges.begin(), edges.end(), [forward](const auto& e) {
+    return forward ? !e.end_node() : !e.begin_node();
+  });
+
+  std::vector<seed_t> seeds;
+  for (const auto& edge : edges) {
+    if (has_other_edges && (forward ? edge.end_node() : edge.begin_node()) &&
+        !is_super_trivial(edge, others)) {
+      continue;
+    }
+    const GraphId edgeid(edge.graph_id());
+    const float percent_along = edge.percent_along();
+    if (forward ? costing_->AvoidAsOriginEdge(edgeid, percent_along)
+                : costing_->AvoidAsDestinationEdge(edgeid, percent_along)) {
+      continue;
+    }
+    const auto node = hierarchy_->node(edgeid);
+    graph_tile_ptr tile = graphreader.GetGraphTile(edgeid);
+    if (node == kInvalidCHNode || !tile) {
+      continue;
+    }
+
+    // the part of the edge after the source or before the target plus the same penalty for the
+    // distance to the input location the other matrices use
+    const auto* directededge = tile->directededge(edgeid);
+    uint8_t flow_sources;
+    Cost cost = costing_->PartialEdgeCost(directededge, edgeid, tile, TimeInfo::invalid(),
+                                          flow_sources, forward ? percent_along : 0.f,
+                                          forward ? 1.f : percent_along);
+    cost += Cost(edge.distance(), 0);
+    search_label_t label{cost.cost, cost.secs,
+                         directededge->length() * (forward ? 1.f - percent_along : percent_along),
+                         false};
+
+    // the arcs into the target's node include all of its edge, take back what is not traversed
+    if (!forward) {
+      const auto& full = hierarchy_->cost(node);
+      label.cost -= full.cost;
+      label.secs -= full.secs;
+      label.length -= full.length;
+    }
+    seeds.push_back({node, percent_along, label});
+  }
+  return seeds;
+}
+
+template <typename settled_t>
+void CHMatrix::Search(const std::vector<seed_t>& seeds,
+                      const bool forward,
+                      const settled_t& settled) {
+  labels_.clear();
+  queue_.clear();
+  const auto later = [](const auto& a, const auto& b) { return a.first > b.first; };
+  const auto push = [&](const uint32_t node, const search_label_t& label) {
+    auto [found, inserted] = labels_.try_emplace(node, label);
+    if (!inserted) {
+      if (label.cost >= found->second.cost) {
+        return;
+      }
+      found->second = label;
+    }
+    queue_.emplace_back(label.cost, node);
+    std::push_heap(queue_.begin(), queue_.end(), later);
+  };
+
+  for (const auto& seed : seeds) {
+    push(seed.node, seed.label);
+  }
+  while (!queue_.empty()) {
+    std::pop_heap(queue_.begin(), queue_.end(), later);
+    const auto [cost, node] = queue_.back();
+    queue_.pop_back();
+    const auto label = labels_.find(node)->second;
+    if (cost > label.cost) {
+      continue;
+    }
+    settled(node, label);
+
+    const auto* arc = forward ? hierarchy_->forward_begin(node) : hierarchy_->backward_begin(node);
+    const auto* end = forward ? hierarchy_->forward_end(node) : hierarchy_->backward_end(node);
+    for (; arc != end; ++arc) {
+      push(arc->node, {label.cost + arc->cost, label.secs + arc->secs, label.length + arc->length,
+                       label.restricted || arc->restricted});
+    }
+  }
+}
+
+bool CHMatrix::SourceToTarget(Api& request,
+                              GraphReader& graphreader,
+                              const mode_costing_t& mode_costing,
+                              const travel_mode_t mode,
+                              const float /*max_matrix_distance*/) {
+  request.mutable_matrix()->set_algorithm(Matrix::ContractionHierarchy);
+  const auto& options = request.options();
+  hierarchy_ = hierarchies_.at(options.costing_type()).get();
+  costing_ = mode_costing[static_cast<uint32_t>(mode)];
+
+  const auto& sources = options.sources();
+  const auto& targets = options.targets();
+  const auto source_edges = CorrelatedEdges(sources);
+  const auto target_edges = CorrelatedEdges(targets);
+
+  // leave what the upward searches from the targets settle in the buckets of the nodes
+  std::vector<std::vector<seed_t>> target_seeds;
+  target_seeds.reserve(targets.size());
+  for (uint32_t target = 0; target < static_cast<uint32_t>(targets.size()); ++target) {
+    target_seeds.push_back(Seeds(graphreader, targets.Get(target), source_edges, false));
+    Search(target_seeds.back(), false, [&](const uint32_t node, const search_label_t& label) {
+      buckets_.push_back({node, target, label});
+    });
+    if (interrupt_) {
+      (*interrupt_)();
+    }
+  }
+  std::stable_sort(buckets_.begin(), buckets_.end(),
+                   [](const auto& a, const auto& b) { return a.node < b.node; });
+  for (uint32_t i = 0; i < buckets_.size(); ++i) {
+    bucket_index_.try_emplace(buckets_[i].node, i);
+  }
+
+  valhalla::Matrix& matrix = *request.mutable_matrix();
+  reserve_pbf_arrays(matrix, sources.size() * targets.size(), options.verbose());
+  std::vector<search_label_t> best(targets.size());
+  std::vector<bool> unsupported(targets.size());
+  bool found_all = true;
+  for (uint32_t source = 0; source < static_cast<uint32_t>(sources.size()); ++source) {
+    std::fill(best.begin(), best.end(), search_label_t{kUnreached, 0, 0, false});
+    std::fill(unsupported.begin(), unsupported.end(), false);
+
+    // the searches meet at the highest node of every path, scan its bucket for the targets
+    const auto source_seeds = Seeds(graphreader, sources.Get(source), target_edges, true);
+    Search(source_seeds, true, [&](const uint32_t node, const search_label_t& label) {
+      auto first = bucket_index_.find(node);
+      if (first == bucket_index_.end()) {
+        return;
+      }
+      auto source_seed = std::find_if(source_seeds.begin(), source_seeds.end(),
+                                       [node](const seed_t& s) { return s.node == node; });
+      for (auto i = first->second; i < buckets_.size() && buckets_[i].node == node; ++i) {
+        const auto& entry = buckets_[i];
+        // both on the same edge only connects directly if the target is ahead of the source,
+        // otherwise it takes a loop back onto the edge which the hierarchy does not keep
+        if (source_seed != source_seeds.end()) {
+          const auto& seeds = target_seeds[entry.target];
+          auto target_seed = std::find_if(seeds.begin(), seeds.end(),
+                                          [node](const seed_t& s) { return s.node == node; });
+          if (target_seed != seeds.end() &&
+              source_seed->percent_along > target_seed->percent_along) {
+            unsupported[entry.target] = true;
+            continue;
+          }
+        }
+        const float cost = label.cost + entry.label.cost;
+        if (cost < best[entry.target].cost) {
+          best[entry.target] = {cost, label.secs + entry.label.secs,
+                                label.length + entry.label.length,
+                                label.restricted || entry.label.restricted};
+        }
+      }
+    });
+
+    for (uint32_t target = 0; target < static_cast<uint32_t>(targets.size()); ++target) {
+      const auto idx = source * targets.size() + target;
+      const auto& result = best[target];
+      // a path that might break a complex restriction is left to the other matrices
+      const bool found = result.cost != kUnreached && !unsupported[target] && !result.restricted;
+      found_all = found_all && found;
+      matrix.mutable_from_indices()->Set(idx, source);
+      matrix.mutable_to_indices()->Set(idx, target);
+      matrix.mutable_distances()->Set(idx, found ? static_cast<uint32_t>(std::round(
+                                                       std::max(result.length, 0.f)))
+                                                 : static_cast<uint32_t>(kMaxCost));
+      matrix.mutable_times()->Set(idx, found ? std::max(result.secs, 0.f) : kMaxCost);
+    }
+    if (interrupt_) {
+      (*interrupt_)();
+    }
+  }
+  return found_all;
+}
+
+} // namespace thor
+} // namespace valhalla
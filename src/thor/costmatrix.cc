@@ -1,16 +1,22 @@
 #include "thor/costmatrix.h"
 #include "baldr/datetime.h"
 #include "exceptions.h"
+#include "midgard/arena.h"
 #include "midgard/encoded.h"
 #include "midgard/logging.h"
 #include "midgard/util.h"
 #include "sif/hierarchylimits.h"
 #include "sif/recost.h"
+#include "round_barrier.h"
 
 #include <ankerl/unordered_dense.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 using namespace valhalla::baldr;
@@ -24,6 +30,9 @@ constexpr uint32_t kMaxThreshold = std::numeric_limits<int>::max();
 constexpr uint32_t kMaxLocationReservation = 25; // the default config for max matrix locations
 constexpr uint32_t kDefaultMinIterations = 100;
 constexpr uint32_t kDefaultMaxIterations = 2800;
+// how often each search is expanded per round when the searches run in parallel, the threads only
+// wait for each other between the rounds
+constexpr uint32_t kParallelExpansions = 16;
 
 /**
  * Checks whether an edge of the source (target) correlation is present with the same percent_along in
@@ -102,13 +111,25 @@ private:
 };
 
 // Constructor with cost threshold.
-CostMatrix::CostMatrix(const boost::property_tree::ptree& config)
+CostMatrix::CostMatrix(const boost::property_tree::ptree& config, std::pmr::memory_resource* arena)
     : MatrixAlgorithm(config),
       max_reserved_labels_count_(config.get<uint32_t>("max_reserved_labels_count_bidir_dijkstras",
                                                       kInitialEdgeLabelCountBidirDijkstra)),
       max_reserved_locations_count_(
           config.get<uint32_t>("costmatrix.max_reserved_locations", kMaxLocationReservation)),
+      max_reserved_edge_status_size_(
+          clear_reserved_memory_
+              ? 0
+              : config.get<size_t>("costmatrix.max_reserved_edge_status_size",
+                                   kDefaultMatrixEdgeStatusPoolSize)),
+      queue_type_(baldr::to_label_queue_type(
+          config.get<std::string>("costmatrix.queue", "double_bucket"))),
+      arena_(arena),
       check_reverse_connection_(config.get<bool>("costmatrix.check_reverse_connection", true)),
+      landmarks_(nullptr),
+      use_landmarks_(config.get<std::string>("costmatrix.heuristic", "distance") == "alt"),
+      concurrency_(std::max(config.get<uint32_t>("costmatrix.concurrency", 1), 1u)),
+      parallel_(false),
       min_iterations_(
           std::max(config.get<uint32_t>("costmatrix.min_iterations", kDefaultMinIterations),
                    static_cast<uint32_t>(1))),
@@ -117,7 +138,12 @@ CostMatrix::CostMatrix(const boost::property_tree::ptree& config)
                    static_cast<uint32_t>(1))),
       access_mode_(kAutoAccess),
       mode_(travel_mode_t::kDrive), locs_count_{0, 0}, locs_remaining_{0, 0},
-      current_pathdist_threshold_(0), targets_{new ReachedMap}, sources_{new ReachedMap} {
+      current_pathdist_threshold_(0),
+      edgelabel_{std::pmr::vector<std::pmr::vector<BDEdgeLabel>>(
+                     arena ? arena : std::pmr::get_default_resource()),
+                 std::pmr::vector<std::pmr::vector<BDEdgeLabel>>(
+                     arena ? arena : std::pmr::get_default_resource())},
+      targets_{new ReachedMap}, sources_{new ReachedMap} {
 }
 
 CostMatrix::~CostMatrix() {
@@ -132,7 +158,8 @@ void CostMatrix::Clear() {
     sources_->clear();
 
   // Clear all adjacency lists, edge labels, and edge status
-  // Resize and shrink_to_fit so all capacity is reduced.
+  // Resize and shrink_to_fit so all capacity is reduced, unless the labels are in the arena
+  // which does not give memory back before the end of the request anyway.
   auto label_reservation = clear_reserved_memory_ ? 0 : max_reserved_labels_count_;
   auto locs_reservation = clear_reserved_memory_ ? 0 : max_reserved_locations_count_;
   for (const auto is_fwd : {MATRIX_FORW, MATRIX_REV}) {
@@ -148,7 +175,7 @@ void CostMatrix::Clear() {
       astar_heuristics_[is_fwd].shrink_to_fit();
     }
     for (auto& iter : edgelabel_[is_fwd]) {
-      if (iter.size() > label_reservation) {
+      if (!arena_ && iter.size() > label_reservation) {
         iter.resize(label_reservation);
         iter.shrink_to_fit();
       }
@@ -163,12 +190,25 @@ void CostMatrix::Clear() {
     hierarchy_limits_[is_fwd].clear();
     locs_status_[is_fwd].clear();
     astar_heuristics_[is_fwd].clear();
+    pending_[is_fwd].clear();
   }
   best_connection_.clear();
+  for (auto& reader : readers_) {
+    if (reader->OverCommitted()) {
+      reader->Trim();
+    }
+  }
   set_not_thru_pruning(true);
   ignore_hierarchy_limits_ = false;
 }
 
+void CostMatrix::ReleaseArena() {
+  if (arena_) {
+    release_memory(edgelabel_[MATRIX_FORW]);
+    release_memory(edgelabel_[MATRIX_REV]);
+  }
+}
+
 // Form a time distance matrix from the set of source locations
 // to the set of target locations.
 bool CostMatrix::SourceToTarget(Api& request,
@@ -196,6 +236,18 @@ bool CostMatrix::SourceToTarget(Api& request,
   // location set.
   Initialize(source_location_list, target_location_list, request.matrix());
 
+  // landmark distances only know the edges some mode may take in their direction
+  if (use_landmarks_ && landmarks_ && !costing_->ignore_oneways()) {
+    for (const auto is_fwd : {MATRIX_FORW, MATRIX_REV}) {
+      const auto& locations = is_fwd ? source_location_list : target_location_list;
+      for (int i = 0; i < locations.size(); ++i) {
+        astar_heuristics_[!is_fwd][i].SetLandmarks(landmarks_,
+                                                   correlated_nodes(graphreader, locations.Get(i)),
+                                                   !is_fwd);
+      }
+    }
+  }
+
   // Set the source and target locations
   // TODO: for now we only allow depart_at/current date_time
   SetSources(graphreader, source_location_list, time_infos, target_location_list);
@@ -204,99 +256,56 @@ bool CostMatrix::SourceToTarget(Api& request,
   // Perform backward search from all target locations. Perform forward
   // search from all source locations. Connections between the 2 search
   // spaces is checked during the forward search.
-  uint32_t n = 0;
-  uint32_t interrupt_n = 0;
-  while (true) {
-    // First iterate over all targets, then over all sources: we only for sure
-    // check the connection between both trees on the forward search, so reverse
-    // has to come first
-    for (uint32_t i = 0; i < locs_count_[MATRIX_REV]; i++) {
-      if (locs_status_[MATRIX_REV][i].threshold > 0) {
-        locs_status_[MATRIX_REV][i].threshold--;
-        Expand<MatrixExpansionType::reverse>(i, n, graphreader, request.options());
-        // if we exhausted this search
-        if (locs_status_[MATRIX_REV][i].threshold == 0) {
-          for (uint32_t source = 0; source < locs_count_[MATRIX_FORW]; source++) {
-            // update the target for each source's remaining targets, if it still exists
-            auto& targets = locs_status_[MATRIX_FORW][source].unfound_connections;
-            auto it = targets.find(i);
-            if (it != targets.end()) {
-              // remove the target so we don't come here again
-              targets.erase(it);
-              // if there's no more target and the current source has not exhausted
-              // we update the source's threshold so that it doesn't enter its outer "if" statement
-              // anymore
-              if (targets.empty() && locs_status_[MATRIX_FORW][source].threshold > 0) {
-                // TODO(nils): shouldn't we extend the search here similar to bidir A*
-                //   i.e. if pruning was disabled we extend the search in the other direction
-                locs_status_[MATRIX_FORW][source].threshold = -1;
-                if (locs_remaining_[MATRIX_FORW] > 0) {
-                  locs_remaining_[MATRIX_FORW]--;
-                }
-              }
-            }
-          }
-          // in any case make sure this was the last time we looked at this target
-          locs_status_[MATRIX_REV][i].threshold = -1;
-          if (locs_remaining_[MATRIX_REV] > 0) {
-            locs_remaining_[MATRIX_REV]--;
+  // the request arena and the expansion callback are not thread-safe
+  if (concurrency_ > 1 && !reader_config_.empty() && !arena_ && !expansion_callback_) {
+    ExpandParallel(graphreader, request.options(), time_infos, invariant);
+  } else {
+    uint32_t n = 0;
+    uint32_t interrupt_n = 0;
+    while (true) {
+      // First iterate over all targets, then over all sources: we only for sure
+      // check the connection between both trees on the forward search, so reverse
+      // has to come first
+      for (uint32_t i = 0; i < locs_count_[MATRIX_REV]; i++) {
+        if (locs_status_[MATRIX_REV][i].threshold > 0) {
+          locs_status_[MATRIX_REV][i].threshold--;
+          Expand<MatrixExpansionType::reverse>(i, n, graphreader, request.options());
+          // if we exhausted this search
+          if (locs_status_[MATRIX_REV][i].threshold == 0) {
+            FinishLocation(MATRIX_REV, i);
           }
         }
       }
-    }
 
-    for (uint32_t i = 0; i < locs_count_[MATRIX_FORW]; i++) {
-      if (locs_status_[MATRIX_FORW][i].threshold > 0) {
-        locs_status_[MATRIX_FORW][i].threshold--;
-        Expand<MatrixExpansionType::forward>(i, n, graphreader, request.options(), time_infos[i],
-                                             invariant);
-        // if we exhausted this search
-        if (locs_status_[MATRIX_FORW][i].threshold == 0) {
-          for (uint32_t target = 0; target < locs_count_[MATRIX_REV]; target++) {
-            // if we still didn't find the connection between this pair
-            auto& sources = locs_status_[MATRIX_REV][target].unfound_connections;
-            auto it = sources.find(i);
-            if (it != sources.end()) {
-              // remove the source so we don't come here again
-              sources.erase(it);
-              // if there's no more sources and the current target has not exhausted
-              // we update the target's threshold so that it doesn't enter this outer "if" statement
-              // anymore
-              if (sources.empty() && locs_status_[MATRIX_REV][target].threshold > 0) {
-                // TODO(nils): shouldn't we extend the search here similar to bidir A*
-                //   i.e. if pruning was disabled we extend the search in the other direction
-                locs_status_[MATRIX_REV][target].threshold = -1;
-                if (locs_remaining_[MATRIX_REV] > 0) {
-                  locs_remaining_[MATRIX_REV]--;
-                }
-              }
-            }
-          }
-          // in any case make sure this was the last time we looked at this source
-          locs_status_[MATRIX_FORW][i].threshold = -1;
-          if (locs_remaining_[MATRIX_FORW] > 0) {
-            locs_remaining_[MATRIX_FORW]--;
+      for (uint32_t i = 0; i < locs_count_[MATRIX_FORW]; i++) {
+        if (locs_status_[MATRIX_FORW][i].threshold > 0) {
+          locs_status_[MATRIX_FORW][i].threshold--;
+          Expand<MatrixExpansionType::forward>(i, n, graphreader, request.options(), time_infos[i],
+                                               invariant);
+          // if we exhausted this search
+          if (locs_status_[MATRIX_FORW][i].threshold == 0) {
+            FinishLocation(MATRIX_FORW, i);
           }
         }
       }
-    }
 
-    // Break out when remaining sources and targets to expand are both 0
-    if (locs_remaining_[MATRIX_FORW] == 0 && locs_remaining_[MATRIX_REV] == 0) {
-      LOG_DEBUG("SourceToTarget iterations: n = " + std::to_string(n));
-      break;
-    }
+      // Break out when remaining sources and targets to expand are both 0
+      if (locs_remaining_[MATRIX_FORW] == 0 && locs_remaining_[MATRIX_REV] == 0) {
+        LOG_DEBUG("SourceToTarget iterations: n = " + std::to_string(n));
+        break;
+      }
 
-    // Protect against edge cases that may lead to never breaking out of
-    // this loop. This should never occur but lets make sure.
-    if (n >= kMaxMatrixIterations) {
-      throw valhalla_exception_t{430};
-    }
-    // Allow this process to be aborted
-    if (interrupt_ && (interrupt_n++ % kInterruptIterationsInterval) == 0) {
-      (*interrupt_)();
+      // Protect against edge cases that may lead to never breaking out of
+      // this loop. This should never occur but lets make sure.
+      if (n >= kMaxMatrixIterations) {
+        throw valhalla_exception_t{430};
+      }
+      // Allow this process to be aborted
+      if (interrupt_ && (interrupt_n++ % kInterruptIterationsInterval) == 0) {
+        (*interrupt_)();
+      }
+      n++;
     }
-    n++;
   }
 
   // resize/reserve all properties of Matrix on first pass only
@@ -373,6 +382,14 @@ void CostMatrix::Initialize(
   const uint32_t bucketsize = costing_->UnitSize();
   const float range = kBucketCount * bucketsize;
 
+  // The search trees kept between requests split the edge status pool evenly, so a worker holds on
+  // to at most max_reserved_edge_status_size_ however many locations a request has
+  const uint32_t pooled_trees =
+      std::min(locs_count_[MATRIX_FORW], max_reserved_locations_count_) +
+      std::min(locs_count_[MATRIX_REV], max_reserved_locations_count_);
+  const size_t edge_status_pool_size =
+      pooled_trees > 0 ? max_reserved_edge_status_size_ / pooled_trees : 0;
+
   // Add initial sources & targets properties
   for (const auto is_fwd : {MATRIX_FORW, MATRIX_REV}) {
     const auto count = locs_count_[is_fwd];
@@ -387,6 +404,9 @@ void CostMatrix::Initialize(
     edgestatus_[is_fwd].resize(count);
     edgelabel_[is_fwd].resize(count);
     for (uint32_t i = 0; i < count; i++) {
+      // Keep the edge status arrays of the locations we hold on to between requests
+      edgestatus_[is_fwd][i].set_max_pool_size(
+          i < max_reserved_locations_count_ ? edge_status_pool_size : 0);
       // Allocate the adjacency list and hierarchy limits for this source.
       // Use the cost threshold to size the adjacency list.
       edgelabel_[is_fwd][i].reserve(max_reserved_labels_count_);
@@ -396,6 +416,8 @@ void CostMatrix::Initialize(
       auto& ll = locations[i].ll();
       astar_heuristics_[!is_fwd][i].Init({ll.lng(), ll.lat()}, costing_->AStarCostFactor());
 
+      adjacency_[is_fwd][i].set_type(queue_type_);
+
       // get the min heuristic to all targets/sources for this source's/target's adjacency list
       float min_heuristic = std::numeric_limits<float>::max();
       for (uint32_t j = 0; j < other_count; j++) {
@@ -616,16 +638,19 @@ bool CostMatrix::ExpandInner(baldr::GraphReader& graphreader,
                             opp_edge->destonly() || (costing_->is_hgv() && opp_edge->destonly_hgv()),
                             opp_edge->forwardaccess() & kTruckAccess, destonly_restriction_mask);
   }
-  auto newsortcost =
-      GetAstarHeuristic<expansion_direction>(index, t2->get_node_ll(meta.edge->endnode()));
+  auto newsortcost = GetAstarHeuristic<expansion_direction>(index, meta.edge->endnode(),
+                                                            t2->get_node_ll(meta.edge->endnode()));
   edgelabels.back().SetSortCost(newcost.cost + newsortcost);
   adj.add(idx);
 
-  // mark the edge as settled for the connection check
-  if (!FORWARD) {
-    targets_->add(meta.edge_id, index);
-  } else if (check_reverse_connection_) {
-    sources_->add(meta.edge_id, index);
+  // mark the edge as settled for the connection check, only after the round if the searches run
+  // in parallel, nothing reads the reached edges of this direction until then
+  if (!FORWARD || check_reverse_connection_) {
+    if (parallel_) {
+      pending_[FORWARD][index].reached.push_back(meta.edge_id);
+    } else {
+      (FORWARD ? sources_ : targets_)->add(meta.edge_id, index);
+    }
   }
 
   // setting this edge as reached
@@ -985,25 +1010,193 @@ void CostMatrix::CheckConnections(const uint32_t loc_idx,
 // Update status when a connection is found.
 template <const MatrixExpansionType expansion_direction, const bool FORWARD>
 void CostMatrix::UpdateStatus(const uint32_t loc_idx, const uint32_t opp_loc_idx) {
+  const auto label_count = edgelabel_[FORWARD][loc_idx].size();
+  UpdateLocationStatus(FORWARD, loc_idx, opp_loc_idx,
+                       label_count + edgelabel_[!FORWARD][opp_loc_idx].size());
+
+  // the opposite location belongs to the other direction which is not expanding right now
+  if (parallel_) {
+    pending_[FORWARD][loc_idx].found.emplace_back(opp_loc_idx, label_count);
+  } else {
+    UpdateLocationStatus(!FORWARD, opp_loc_idx, loc_idx,
+                         edgelabel_[!FORWARD][opp_loc_idx].size() + label_count);
+  }
+}
+
+void CostMatrix::UpdateLocationStatus(const bool is_fwd,
+                                      const uint32_t index,
+                                      const uint32_t opp_index,
+                                      const size_t label_count) {
+  auto& unfound_conns = locs_status_[is_fwd][index].unfound_connections;
+  auto it = unfound_conns.find(opp_index);
+  if (it != unfound_conns.end()) {
+    unfound_conns.erase(it);
+    if (unfound_conns.empty() && locs_status_[is_fwd][index].threshold > 0) {
+      // At least 1 connection has been found to each opposite location for this location.
+      // Set a threshold to continue search for a limited number of times.
+      locs_status_[is_fwd][index].threshold =
+          GetThreshold(mode_, label_count, max_iterations_, min_iterations_);
+    }
+  }
+}
+
+void CostMatrix::FinishLocation(const bool is_fwd, const uint32_t index) {
+  for (uint32_t opp_index = 0; opp_index < locs_count_[!is_fwd]; opp_index++) {
+    // update the opposite location's remaining connections, if it still exists
+    auto& opp_status = locs_status_[!is_fwd][opp_index];
+    auto it = opp_status.unfound_connections.find(index);
+    if (it != opp_status.unfound_connections.end()) {
+      // remove this location so we don't come here again
+      opp_status.unfound_connections.erase(it);
+      // if there's no more connections and the opposite location has not exhausted
+      // we update its threshold so that it doesn't get expanded anymore
+      if (opp_status.unfound_connections.empty() && opp_status.threshold > 0) {
+        // TODO(nils): shouldn't we extend the search here similar to bidir A*
+        //   i.e. if pruning was disabled we extend the search in the other direction
+        opp_status.threshold = -1;
+        if (locs_remaining_[!is_fwd] > 0) {
+          locs_remaining_[!is_fwd]--;
+        }
+      }
+    }
+  }
+  // in any case make sure this was the last time we looked at this location
+  locs_status_[is_fwd][index].threshold = -1;
+  if (locs_remaining_[is_fwd] > 0) {
+    locs_remaining_[is_fwd]--;
+  }
+}
+
+// Expands the searches of all targets and then those of all sources a few times per round, the
+// searches of one direction on several threads. A search only changes its own labels, edge status
+// and best connections during a round, the other direction does not expand then, so what it
+// changes for the other direction waits until the round is over and is applied in the order of
+// the locations. That makes the result independent of the threads.
+void CostMatrix::ExpandParallel(GraphReader& graphreader,
+                                const valhalla::Options& options,
+                                const std::vector<TimeInfo>& time_infos,
+                                const bool invariant) {
+  while (readers_.size() + 1 < concurrency_) {
+    readers_.emplace_back(std::make_unique<GraphReader>(reader_config_));
+  }
+  for (const auto is_fwd : {MATRIX_FORW, MATRIX_REV}) {
+    pending_[is_fwd].resize(locs_count_[is_fwd]);
+  }
 
-  for (const bool DIRECTION : {MATRIX_FORW, MATRIX_REV}) {
-    uint32_t index = (DIRECTION == MATRIX_FORW) == FORWARD ? loc_idx : opp_loc_idx;
-    uint32_t counter_index = (DIRECTION == MATRIX_FORW) == FORWARD ? opp_loc_idx : loc_idx;
-    auto& unfound_conns = locs_status_[DIRECTION][index].unfound_connections;
-    auto it = unfound_conns.find(counter_index);
-    if (it != unfound_conns.end()) {
-      unfound_conns.erase(it);
-      if (unfound_conns.empty() && locs_status_[DIRECTION][index].threshold > 0) {
-        // At least 1 connection has been found to each opposite location for this location.
-        // Set a threshold to continue search for a limited number of times.
-        locs_status_[DIRECTION][index].threshold =
-            GetThreshold(mode_,
-                         edgelabel_[DIRECTION][index].size() +
-                             edgelabel_[!DIRECTION][counter_index].size(),
-                         max_iterations_, min_iterations_);
+  // the state of the current round, only changed while the threads wait for the next one
+  bool is_fwd = MATRIX_REV;
+  uint32_t n = 0;
+  bool done = false;
+  std::atomic<uint32_t> next{0};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  round_barrier_t barrier(concurrency_);
+
+  // the time zone offsets along the paths are looked up in a cache, each helper thread gets its
+  // own copy of the time infos pointing at a cache of its own
+  std::vector<DateTime::tz_sys_info_cache_t> tz_caches(concurrency_ - 1);
+  std::vector<std::vector<TimeInfo>> thread_time_infos(concurrency_ - 1, time_infos);
+  for (uint32_t t = 0; t + 1 < concurrency_; ++t) {
+    for (auto& time_info : thread_time_infos[t]) {
+      time_info.tz_cache = &tz_caches[t];
+    }
+  }
+
+  // each thread takes the next location of the direction until there are none left
+  auto round = [&](GraphReader& reader, const std::vector<TimeInfo>& round_time_infos) {
+    for (uint32_t i = next++; i < locs_count_[is_fwd]; i = next++) {
+      auto& status = locs_status_[is_fwd][i];
+      try {
+        for (uint32_t step = 0; step < kParallelExpansions && status.threshold > 0; ++step) {
+          status.threshold--;
+          if (is_fwd) {
+            Expand<MatrixExpansionType::forward>(i, n + step, reader, options,
+                                                 round_time_infos[i], invariant);
+          } else {
+            Expand<MatrixExpansionType::reverse>(i, n + step, reader, options);
+          }
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t + 1 < concurrency_; ++t) {
+    threads.emplace_back([&, t]() {
+      while (true) {
+        barrier.wait();
+        if (done) {
+          return;
+        }
+        round(*readers_[t], thread_time_infos[t]);
+        barrier.wait();
+      }
+    });
+  }
+  auto stop = [&]() {
+    done = true;
+    barrier.wait();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  };
+
+  try {
+    parallel_ = true;
+    uint32_t interrupt_n = 0;
+    while (true) {
+      // reverse has to come first, see the serial expansion
+      for (const auto direction : {MATRIX_REV, MATRIX_FORW}) {
+        is_fwd = direction;
+        next = 0;
+        barrier.wait();
+        round(graphreader, time_infos);
+        barrier.wait();
+        if (error) {
+          std::rethrow_exception(error);
+        }
+
+        auto* reached = is_fwd ? sources_.get() : targets_.get();
+        for (uint32_t i = 0; i < locs_count_[is_fwd]; i++) {
+          auto& pending = pending_[is_fwd][i];
+          for (const auto edgeid : pending.reached) {
+            reached->add(edgeid, i);
+          }
+          for (const auto& [opp_index, label_count] : pending.found) {
+            UpdateLocationStatus(!is_fwd, opp_index, i,
+                                 edgelabel_[!is_fwd][opp_index].size() + label_count);
+          }
+          pending.reached.clear();
+          pending.found.clear();
+          if (locs_status_[is_fwd][i].threshold == 0) {
+            FinishLocation(is_fwd, i);
+          }
+        }
+      }
+
+      if (locs_remaining_[MATRIX_FORW] == 0 && locs_remaining_[MATRIX_REV] == 0) {
+        LOG_DEBUG("SourceToTarget iterations: n = " + std::to_string(n));
+        break;
+      }
+      if (n >= kMaxMatrixIterations) {
+        throw valhalla_exception_t{430};
+      }
+      if (interrupt_ && (interrupt_n++ % (kInterruptIterationsInterval / kParallelExpansions)) == 0) {
+        (*interrupt_)();
       }
+      n += kParallelExpansions;
     }
+  } catch (...) {
+    parallel_ = false;
+    stop();
+    throw;
   }
+  parallel_ = false;
+  stop();
 }
 
 // Sets the source/origin locations. Search expands forward from these
@@ -1082,8 +1275,9 @@ void CostMatrix::SetSources(GraphReader& graphreader,
                                  (costing_->is_hgv() && directededge->destonly_hgv()),
                              directededge->forwardaccess() & kTruckAccess, destonly_restriction_mask);
       auto newsortcost =
-          GetAstarHeuristic<MatrixExpansionType::forward>(index, opp_tile->get_node_ll(
-                                                                     directededge->endnode()));
+          GetAstarHeuristic<MatrixExpansionType::forward>(index, directededge->endnode(),
+                                                          opp_tile->get_node_ll(
+                                                              directededge->endnode()));
       edge_label.SetSortCost(edgecost.cost + newsortcost);
 
       // Set the initial not_thru flag to false. There is an issue with not_thru
@@ -1190,7 +1384,7 @@ void CostMatrix::SetTargets(baldr::GraphReader& graphreader,
                              directededge->forwardaccess() & kTruckAccess, destonly_restriction_mask);
 
       auto newsortcost =
-          GetAstarHeuristic<MatrixExpansionType::reverse>(index,
+          GetAstarHeuristic<MatrixExpansionType::reverse>(index, opp_dir_edge->endnode(),
                                                           tile->get_node_ll(opp_dir_edge->endnode()));
       edge_label.SetSortCost(edgecost.cost + newsortcost);
       // Set the initial not_thru flag to false. There is an issue with not_thru
@@ -1374,14 +1568,16 @@ std::string CostMatrix::RecostFormPath(GraphReader& graphreader,
 }
 
 template <const MatrixExpansionType expansion_direction, const bool FORWARD>
-float CostMatrix::GetAstarHeuristic(const uint32_t loc_idx, const PointLL& ll) const {
+float CostMatrix::GetAstarHeuristic(const uint32_t loc_idx,
+                                    const GraphId& node,
+                                    const PointLL& ll) const {
   if (locs_status_[FORWARD][loc_idx].unfound_connections.empty()) {
     return 0.f;
   }
 
   auto min_cost = std::numeric_limits<float>::max();
   for (const auto other_idx : locs_status_[FORWARD][loc_idx].unfound_connections) {
-    const auto cost = astar_heuristics_[FORWARD][other_idx].Get(ll);
+    const auto cost = astar_heuristics_[FORWARD][other_idx].Get(ll, node);
     min_cost = std::min(cost, min_cost);
   }
 
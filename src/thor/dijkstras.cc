@@ -1,5 +1,6 @@
 #include "thor/dijkstras.h"
 #include "baldr/datetime.h"
+#include "midgard/arena.h"
 #include "midgard/logging.h"
 
 #include <algorithm>
@@ -12,24 +13,31 @@ namespace valhalla {
 namespace thor {
 
 // Default constructor
-Dijkstras::Dijkstras(const boost::property_tree::ptree& config)
-    : mode_(travel_mode_t::kDrive), access_mode_(kAutoAccess),
+Dijkstras::Dijkstras(const boost::property_tree::ptree& config, std::pmr::memory_resource* arena)
+    : mode_(travel_mode_t::kDrive), access_mode_(kAutoAccess), arena_(arena),
+      bdedgelabels_(arena ? arena : std::pmr::get_default_resource()),
+      mmedgelabels_(arena ? arena : std::pmr::get_default_resource()),
       max_reserved_labels_count_(config.get<uint32_t>("max_reserved_labels_count_dijkstras",
                                                       kInitialEdgeLabelCountDijkstras)),
       clear_reserved_memory_(config.get<bool>("clear_reserved_memory", false)), multipath_(false) {
+  const auto queue_type =
+      baldr::to_label_queue_type(config.get<std::string>("dijkstras.queue", "double_bucket"));
+  adjacencylist_.set_type(queue_type);
+  mmadjacencylist_.set_type(queue_type);
 }
 
 // Clear the temporary information generated during path construction.
 void Dijkstras::Clear() {
   // Clear the edge labels, edge status flags, and adjacency list
   // TODO - clear only the edge label set that was used?
+  // arena memory is not given back before the end of the request so there is nothing to shrink
   auto reservation = clear_reserved_memory_ ? 0 : max_reserved_labels_count_;
-  if (bdedgelabels_.size() > reservation) {
+  if (!arena_ && bdedgelabels_.size() > reservation) {
     bdedgelabels_.resize(reservation);
     bdedgelabels_.shrink_to_fit();
   }
   bdedgelabels_.clear();
-  if (mmedgelabels_.size() > reservation) {
+  if (!arena_ && mmedgelabels_.size() > reservation) {
     mmedgelabels_.resize(reservation);
     mmedgelabels_.shrink_to_fit();
   }
@@ -40,11 +48,19 @@ void Dijkstras::Clear() {
   edgestatus_.clear();
 }
 
+void Dijkstras::ReleaseArena() {
+  if (arena_) {
+    release_memory(bdedgelabels_);
+    release_memory(mmedgelabels_);
+  }
+}
+
 // Initialize - create adjacency list, edgestatus support, and reserve
 // edgelabels
 template <typename label_container_t>
 void Dijkstras::Initialize(label_container_t& labels,
-                           baldr::DoubleBucketQueue<typename label_container_t::value_type>& queue,
+                           baldr::LabelQueue<typename label_container_t::value_type,
+                                             label_container_t>& queue,
                            const uint32_t bucket_size) {
   // Set aside some space for edge labels
   uint32_t edge_label_reservation;
@@ -58,11 +74,11 @@ void Dijkstras::Initialize(label_container_t& labels,
 }
 template void
 Dijkstras::Initialize<decltype(Dijkstras::bdedgelabels_)>(decltype(Dijkstras::bdedgelabels_)&,
-                                                          baldr::DoubleBucketQueue<sif::BDEdgeLabel>&,
+                                                          decltype(Dijkstras::adjacencylist_)&,
                                                           const uint32_t);
 template void
 Dijkstras::Initialize<decltype(Dijkstras::mmedgelabels_)>(decltype(Dijkstras::mmedgelabels_)&,
-                                                          baldr::DoubleBucketQueue<sif::MMEdgeLabel>&,
+                                                          decltype(Dijkstras::mmadjacencylist_)&,
                                                           const uint32_t);
 
 // Initializes the time of the expansion if there is one
@@ -515,10 +531,17 @@ void Dijkstras::ExpandForwardMultiModal(GraphReader& graphreader,
         continue;
       }
 
-      // Look up the next departure along this edge
+      // Look up the next departure along this edge on the schedules running on the day
+      auto active = active_schedules_.find(tile->id().tileid());
+      if (active == active_schedules_.end()) {
+        active = active_schedules_
+                     .emplace(tile->id().tileid(),
+                              tile->GetActiveSchedules(day_, dow_, date_before_tile_))
+                     .first;
+      }
       const TransitDeparture* departure =
-          tile->GetNextDeparture(directededge->lineid(), offset_time.day_seconds(), day_, dow_,
-                                 date_before_tile_, tc->wheelchair(), tc->bicycle());
+          tile->GetNextDeparture(directededge->lineid(), offset_time.day_seconds(), active->second,
+                                 tc->wheelchair(), tc->bicycle());
       if (departure) {
         // Check if there has been a mode change
         mode_change = (mode_ == travel_mode_t::kPedestrian);
@@ -542,8 +565,8 @@ void Dijkstras::ExpandForwardMultiModal(GraphReader& graphreader,
             // TODO - is there a better way?
             if (offset_time.day_seconds() + 30 > departure->departure_time()) {
               departure =
-                  tile->GetNextDeparture(directededge->lineid(), offset_time.day_seconds() + 30, day_,
-                                         dow_, date_before_tile_, tc->wheelchair(), tc->bicycle());
+                  tile->GetNextDeparture(directededge->lineid(), offset_time.day_seconds() + 30,
+                                         active->second, tc->wheelchair(), tc->bicycle());
               if (!departure) {
                 continue;
               }
@@ -711,6 +734,7 @@ void Dijkstras::ComputeMultiModal(
   // Clear operators and processed tiles
   operators_.clear();
   processed_tiles_.clear();
+  active_schedules_.clear();
 
   // Expand using adjacency list until we exceed threshold
   auto cb_decision = ExpansionRecommendation::continue_expansion;
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+
+namespace valhalla {
+namespace thor {
+
+// Relays the interrupt of a request to the threads helping with it. The interrupt of the request is
+// only called on its own thread, which keeps calling it while waiting for the helpers, the searches
+// of the helpers get a callback throwing once the request is cancelled
+class helper_interrupt_t {
+public:
+  helper_interrupt_t(const std::function<void()>* interrupt, const size_t helpers)
+      : interrupt_(interrupt), running_(helpers), cancelled_(false), callback_([this]() {
+          if (cancelled_) {
+            throw std::runtime_error("Cancelled along with the request");
+          }
+        }) {
+  }
+
+  // the interrupt for the searches of the helpers
+  const std::function<void()>* callback() const {
+    return &callback_;
+  }
+
+  // stops the helpers at their next interrupt check
+  void cancel() {
+    cancelled_ = true;
+  }
+
+  // called by each helper when it is done, whether it threw or not
+  void done() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --running_;
+    condition_.notify_all();
+  }
+
+  // waits for the helpers, if the interrupt of the request throws meanwhile they are cancelled and
+  // waited for before it is rethrown
+  void wait(const std::chrono::milliseconds interval = std::chrono::milliseconds(10)) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto finished = [this]() { return running_ == 0; };
+    if (!interrupt_) {
+      condition_.wait(lock, finished);
+      return;
+    }
+    while (!condition_.wait_for(lock, interval, finished)) {
+      lock.unlock();
+      try {
+        (*interrupt_)();
+      } catch (...) {
+        cancel();
+        lock.lock();
+        condition_.wait(lock, finished);
+        throw;
+      }
+      lock.lock();
+    }
+  }
+
+private:
+  const std::function<void()>* interrupt_;
+  size_t running_;
+  std::atomic<bool> cancelled_;
+  std::function<void()> callback_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+};
+
+} // namespace thor
+} // namespace valhalla
@@ -1,8 +1,11 @@
 #include "thor/isochrone.h"
+#include "baldr/time_info.h"
 #include "midgard/distanceapproximator.h"
 #include "midgard/logging.h"
+#include "proto_conversions.h"
 
 #include <algorithm>
+#include <functional>
 
 using namespace valhalla::midgard;
 using namespace valhalla::baldr;
@@ -46,8 +49,12 @@ namespace valhalla {
 namespace thor {
 
 // Default constructor
-Isochrone::Isochrone(const boost::property_tree::ptree& config)
-    : Dijkstras(config), shape_interval_(50.0f) {
+Isochrone::Isochrone(const boost::property_tree::ptree& config, std::pmr::memory_resource* arena)
+    : Dijkstras(config, arena), shape_interval_(50.0f),
+      max_cached_grids_(config.get<size_t>("isochrone.max_cached_grids", 0)),
+      cache_time_bucket_(
+          std::max(config.get<uint32_t>("isochrone.cache_time_bucket", 15), 1u) * kSecPerMinute),
+      tileset_build_(0) {
 }
 
 // Construct the isotile. Use a fixed grid size. Convert time in minutes to
@@ -174,13 +181,106 @@ std::shared_ptr<const GriddedData<2>> Isochrone::Expand(const ExpansionType& exp
                                                         GraphReader& reader,
                                                         const sif::mode_costing_t& mode_costing,
                                                         const travel_mode_t mode) {
+  // serve the grid of an earlier request with the same origins, costing and largest contours
+  const auto key = CacheKey(expansion_type, api, reader, *mode_costing[static_cast<uint8_t>(mode)]);
+  const auto hash = std::hash<std::string>{}(key);
+  if (!key.empty()) {
+    for (auto cached = grids_.begin(); cached != grids_.end(); ++cached) {
+      if (cached->hash == hash && cached->key == key) {
+        grids_.splice(grids_.begin(), grids_, cached);
+        return grids_.front().grid;
+      }
+    }
+  }
+
   // Initialize and create the isotile
   ConstructIsoTile(expansion_type == ExpansionType::multimodal, api, mode);
   // Compute the expansion
   Dijkstras::Expand(expansion_type, api, reader, mode_costing, mode);
+
+  if (!key.empty()) {
+    grids_.push_front({hash, key, isotile_});
+    while (grids_.size() > max_cached_grids_) {
+      grids_.pop_back();
+    }
+  }
   return isotile_;
 }
 
+std::string Isochrone::CacheKey(const ExpansionType& expansion_type,
+                                const Api& api,
+                                GraphReader& reader,
+                                const DynamicCost& costing) {
+  // expansions are streamed as they happen, transit depends on more than one costing and a grid
+  // would go stale with the live traffic it was made with
+  const auto& options = api.options();
+  if (max_cached_grids_ == 0 || options.action() != Options::isochrone ||
+      expansion_type == ExpansionType::multimodal ||
+      ((costing.flow_mask() & kCurrentFlowMask) && reader.HasLiveTraffic())) {
+    return {};
+  }
+
+  // the grids are of no use once the tiles are rebuilt, which doesn't change the modification
+  // time of the tile dir
+  if (!build_tile_.is_valid()) {
+    for (const auto& location : options.locations()) {
+      if (!build_tile_.is_valid() && location.correlation().edges_size() > 0) {
+        build_tile_ = GraphId(location.correlation().edges(0).graph_id()).tile_base();
+      }
+    }
+  }
+  const auto build = reader.TileBuild(build_tile_);
+  if (build != tileset_build_) {
+    grids_.clear();
+    tileset_build_ = build;
+  }
+  if (build == 0) {
+    build_tile_ = {};
+  }
+
+  std::string key;
+  const auto append = [&key](const auto value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+  append(static_cast<int>(expansion_type));
+
+  // the grid and the extent of the expansion only depend on the largest contour of each metric
+  float max_minutes = -1.f, max_km = -1.f;
+  for (const auto& contour : options.contours()) {
+    if (contour.has_time_case()) {
+      max_minutes = std::max(max_minutes, contour.time());
+    }
+    if (contour.has_distance_case()) {
+      max_km = std::max(max_km, contour.distance());
+    }
+  }
+  append(max_minutes);
+  append(max_km);
+
+  // where the locations are snapped to and when they leave, by the bucket of the departure time
+  for (const auto& location : options.locations()) {
+    append(location.ll().lat());
+    append(location.ll().lng());
+    for (const auto& edge : location.correlation().edges()) {
+      append(edge.graph_id());
+      append(edge.percent_along());
+      append(edge.distance());
+      append(edge.begin_node());
+      append(edge.end_node());
+    }
+    auto timed = location;
+    const auto time_info = TimeInfo::make(timed, reader, &tz_cache_);
+    append(time_info.valid ? static_cast<int64_t>(time_info.local_time / cache_time_bucket_) : -1);
+  }
+
+  key += Costing_Enum_Name(options.costing_type()) + ':' + std::to_string(costing.pass()) + ':';
+  auto found = options.costings().find(options.costing_type());
+  if (found != options.costings().end()) {
+    key += found->second.options().SerializeAsString();
+  }
+  return key;
+}
+
 void Isochrone::UpdateIsoTileAlongSegment(const midgard::PointLL& from,
                                           const midgard::PointLL& to,
                                           float seconds,
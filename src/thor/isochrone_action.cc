@@ -42,8 +42,16 @@ std::string thor_worker_t::isochrones(Api& request) {
   if (options.action() == Options_Action_expansion)
     return "";
 
+  // how much of the network is within the contours, swept on the contraction hierarchy
+  if (options.accessibility()) {
+    phast_matrix_.set_interrupt(interrupt);
+    if (!phast_matrix_.Accessibility(request, *reader, mode_costing, mode)) {
+      add_warning(request, 216);
+    }
+  }
+
   // make the final output (pbf, json or geotiff)
-  std::string ret = tyr::serializeIsochrones(request, intervals, grid);
+  std::string ret = tyr::serializeIsochrones(request, intervals, grid, isochrone_concurrency);
 
   return ret;
 }
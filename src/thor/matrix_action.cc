@@ -3,6 +3,10 @@
 
 #include <valhalla/worker.h>
 
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
 using namespace valhalla;
 using namespace valhalla::tyr;
 using namespace valhalla::midgard;
@@ -24,6 +28,96 @@ const std::string get_unfound_indices(const google::protobuf::RepeatedField<bool
 }
 
 constexpr uint32_t kCostMatrixThreshold = 5;
+
+// some of the sources and targets of a request computed on their own, by their index in it
+struct matrix_part_t {
+  std::vector<uint32_t> sources;
+  std::vector<uint32_t> targets;
+};
+
+// splits the sources and targets into blocks of at most max_locations locations, the smaller side
+// stays whole if it takes up no more than half of a block
+std::vector<matrix_part_t>
+matrix_blocks(const uint32_t sources, const uint32_t targets, uint32_t max_locations) {
+  max_locations = std::max(max_locations, 2u);
+  uint32_t block_sources = max_locations / 2;
+  uint32_t block_targets = max_locations - block_sources;
+  if (sources <= block_sources) {
+    block_sources = sources;
+    block_targets = max_locations - sources;
+  } else if (targets <= block_targets) {
+    block_targets = targets;
+    block_sources = max_locations - targets;
+  }
+
+  std::vector<matrix_part_t> blocks;
+  for (uint32_t s = 0; s < sources; s += block_sources) {
+    for (uint32_t t = 0; t < targets; t += block_targets) {
+      auto& block = blocks.emplace_back();
+      block.sources.resize(std::min(block_sources, sources - s));
+      std::iota(block.sources.begin(), block.sources.end(), s);
+      block.targets.resize(std::min(block_targets, targets - t));
+      std::iota(block.targets.begin(), block.targets.end(), t);
+    }
+  }
+  return blocks;
+}
+
+// the options of the request with only the sources and targets of the part
+void set_part_locations(const Options& options, const matrix_part_t& part, Options& part_options) {
+  part_options.clear_sources();
+  for (const auto s : part.sources) {
+    part_options.add_sources()->CopyFrom(options.sources(s));
+  }
+  part_options.clear_targets();
+  for (const auto t : part.targets) {
+    part_options.add_targets()->CopyFrom(options.targets(t));
+  }
+}
+
+// copies the connections of a part from the matrix of the whole request into the matrix of the
+// part or back, dst has to have room for them
+void copy_part(const Matrix& src,
+               Matrix& dst,
+               const matrix_part_t& part,
+               const uint32_t targets,
+               const bool into_part) {
+  const bool verbose = src.begin_heading_size() > 0 && dst.begin_heading_size() > 0;
+  for (uint32_t s = 0; s < part.sources.size(); ++s) {
+    for (uint32_t t = 0; t < part.targets.size(); ++t) {
+      const int part_idx = s * part.targets.size() + t;
+      const int idx = part.sources[s] * targets + part.targets[t];
+      const int from = into_part ? idx : part_idx;
+      const int to = into_part ? part_idx : idx;
+      const auto copy = [from, to](const auto& src_field, auto& dst_field) {
+        *dst_field.Mutable(to) = src_field.Get(from);
+      };
+
+      dst.set_from_indices(to, into_part ? s : part.sources[s]);
+      dst.set_to_indices(to, into_part ? t : part.targets[t]);
+      copy(src.distances(), *dst.mutable_distances());
+      copy(src.times(), *dst.mutable_times());
+      copy(src.second_pass(), *dst.mutable_second_pass());
+      // the matrix of the blocks of a CostMatrix leaves out the strings nobody asked for
+      if (src.date_times_size() > 0 && dst.date_times_size() > 0) {
+        copy(src.date_times(), *dst.mutable_date_times());
+        copy(src.time_zone_offsets(), *dst.mutable_time_zone_offsets());
+        copy(src.time_zone_names(), *dst.mutable_time_zone_names());
+      }
+      if (src.shapes_size() > 0 && dst.shapes_size() > 0) {
+        copy(src.shapes(), *dst.mutable_shapes());
+      }
+      if (verbose) {
+        copy(src.begin_heading(), *dst.mutable_begin_heading());
+        copy(src.end_heading(), *dst.mutable_end_heading());
+        copy(src.begin_lat(), *dst.mutable_begin_lat());
+        copy(src.begin_lon(), *dst.mutable_begin_lon());
+        copy(src.end_lat(), *dst.mutable_end_lat());
+        copy(src.end_lon(), *dst.mutable_end_lon());
+      }
+    }
+  }
+}
 } // namespace
 
 namespace valhalla {
@@ -35,6 +129,23 @@ thor_worker_t::get_matrix_algorithm(Api& request, const bool has_time, const std
     return &time_distance_bss_matrix_;
   }
 
+  // the contraction hierarchy is the fastest if there is one that is exact for the request, swept
+  // as a whole once there are enough locations
+  const auto& mode_cost = *mode_costing[static_cast<uint32_t>(mode)];
+  if (source_to_target_algorithm == SELECT_OPTIMAL &&
+      phast_matrix_.Supports(request, *reader, mode_cost)) {
+    return &phast_matrix_;
+  }
+  if (source_to_target_algorithm == SELECT_OPTIMAL &&
+      ch_matrix_.Supports(request, *reader, mode_cost)) {
+    return &ch_matrix_;
+  }
+  // otherwise the overlay customized for the costing options of the request
+  if (source_to_target_algorithm == SELECT_OPTIMAL &&
+      overlay_matrix_.Supports(request, *reader, mode_cost)) {
+    return &overlay_matrix_;
+  }
+
   Matrix::Algorithm config_algo = Matrix::CostMatrix;
   switch (source_to_target_algorithm) {
     case SELECT_OPTIMAL:
@@ -89,10 +200,102 @@ std::string thor_worker_t::matrix(Api& request) {
   // time this whole method and save that statistic
   auto _ = measure_scope_time(request);
 
-  auto& options = *request.mutable_options();
   adjust_locations(request);
   auto costing = parse_costing(request);
 
+  // with the cache only the rows and columns of the connections it doesn't have are computed
+  const auto cached =
+      matrix_cache_.Get(request, *reader, *mode_costing[static_cast<uint32_t>(mode)]);
+  if (cached.empty()) {
+    compute_matrix(request, costing);
+    return tyr::serializeMatrix(request);
+  }
+
+  // the hit rate of the cache is hits / (hits + misses)
+  const auto hits = static_cast<uint32_t>(std::count(cached.begin(), cached.end(), true));
+  const auto misses = static_cast<uint32_t>(cached.size()) - hits;
+  const auto& action = Options_Action_Enum_Name(request.options().action());
+  for (const auto& [name, value] : {std::make_pair("hits", hits), std::make_pair("misses", misses)}) {
+    auto* stat = request.mutable_info()->mutable_statistics()->Add();
+    stat->set_key(action + ".info." + service_name() + ".matrix_cache." + name);
+    stat->set_value(value);
+    stat->set_type(count);
+  }
+
+  // the sources and targets of the connections the cache doesn't have
+  const auto& options = request.options();
+  const uint32_t sources = options.sources_size();
+  const uint32_t targets = options.targets_size();
+  matrix_part_t part;
+  for (uint32_t s = 0; s < sources; ++s) {
+    for (uint32_t t = 0; t < targets; ++t) {
+      if (!cached[s * targets + t]) {
+        part.sources.push_back(s);
+        break;
+      }
+    }
+  }
+  for (uint32_t t = 0; t < targets; ++t) {
+    for (uint32_t s = 0; s < sources; ++s) {
+      if (!cached[s * targets + t]) {
+        part.targets.push_back(t);
+        break;
+      }
+    }
+  }
+  if (part.sources.empty()) {
+    // for the warnings about the date_times
+    check_matrix_time(request, options.prioritize_bidirectional() ? Matrix::CostMatrix
+                                                                  : Matrix::TimeDistanceMatrix);
+    return tyr::serializeMatrix(request);
+  }
+
+  // a time dependent matrix searches from the side with fewer locations, a part has to search from
+  // the same side
+  const auto timed = [](const valhalla::Location& location) {
+    return !location.date_time().empty();
+  };
+  const bool has_date_time =
+      std::any_of(options.sources().begin(), options.sources().end(), timed) ||
+      std::any_of(options.targets().begin(), options.targets().end(), timed);
+  if ((part.sources.size() == sources && part.targets.size() == targets) ||
+      (has_date_time && (part.sources.size() <= part.targets.size()) != (sources <= targets))) {
+    request.mutable_matrix()->Clear();
+    compute_matrix(request, costing);
+    part.sources.resize(sources);
+    std::iota(part.sources.begin(), part.sources.end(), 0);
+    part.targets.resize(targets);
+    std::iota(part.targets.begin(), part.targets.end(), 0);
+    matrix_cache_.Put(request, part.sources, part.targets);
+    return tyr::serializeMatrix(request);
+  }
+
+  Api part_request;
+  part_request.mutable_options()->CopyFrom(options);
+  set_part_locations(options, part, *part_request.mutable_options());
+  compute_matrix(part_request, costing);
+  matrix_cache_.Put(part_request, part.sources, part.targets);
+
+  auto& matrix = *request.mutable_matrix();
+  copy_part(part_request.matrix(), matrix, part, targets, false);
+  matrix.set_algorithm(part_request.matrix().algorithm());
+  // the unfound connections of a second pass are listed by their index in the whole matrix
+  bool second_pass = false;
+  for (const auto& warning : part_request.info().warnings()) {
+    if (warning.code() == 400) {
+      second_pass = true;
+    } else {
+      request.mutable_info()->mutable_warnings()->Add()->CopyFrom(warning);
+    }
+  }
+  if (second_pass) {
+    add_warning(request, 400, get_unfound_indices(matrix.second_pass()));
+  }
+  return tyr::serializeMatrix(request);
+}
+
+void thor_worker_t::compute_matrix(Api& request, const std::string& costing) {
+  auto& options = *request.mutable_options();
   bool has_time =
       check_matrix_time(request, options.prioritize_bidirectional() ? Matrix::CostMatrix
                                                                     : Matrix::TimeDistanceMatrix);
@@ -102,12 +305,19 @@ std::string thor_worker_t::matrix(Api& request) {
            &costmatrix_,
            &time_distance_matrix_,
            &time_distance_bss_matrix_,
+           &ch_matrix_,
+           &phast_matrix_,
+           &overlay_matrix_,
        }) {
     alg->set_interrupt(interrupt);
     alg->set_has_time(has_time);
   }
 
   auto* algo = get_matrix_algorithm(request, has_time, costing);
+  // only the time dependent matrix searches for a profile of departures
+  if (options.profile_departures() > 1 && algo != &time_distance_matrix_) {
+    add_warning(request, 217);
+  }
   if (check_hierarchy_limits(mode_costing[int(mode)]->GetHierarchyLimits(), mode_costing[int(mode)],
                              options.costings().find(options.costing_type())->second.options(),
                              hierarchy_limits_config_costmatrix, allow_hierarchy_limits_modifications,
@@ -117,11 +327,23 @@ std::string thor_worker_t::matrix(Api& request) {
   }
   LOG_INFO("matrix::" + std::string(algo->name()));
 
+  if (algo == &ch_matrix_ || algo == &phast_matrix_ || algo == &overlay_matrix_) {
+    if (algo->SourceToTarget(request, *reader, mode_costing, mode,
+                             max_matrix_distance.find(costing)->second)) {
+      return;
+    }
+    // some connection needs a path the hierarchy or the overlay doesn't keep, start over with
+    // CostMatrix
+    request.mutable_matrix()->Clear();
+    algo = &costmatrix_;
+    LOG_INFO("matrix::" + std::string(algo->name()));
+  }
+
   // TODO(nils): TDMatrix doesn't care about either destonly or no_thru
   if (algo->name() != "costmatrix") {
     algo->SourceToTarget(request, *reader, mode_costing, mode,
                          max_matrix_distance.find(costing)->second);
-    return tyr::serializeMatrix(request);
+    return;
   }
 
   // no matrix_locations for CostMatrix
@@ -134,6 +356,15 @@ std::string thor_worker_t::matrix(Api& request) {
   cost->set_allow_destination_only(false);
   cost->set_pass(0);
 
+  // the trees of every source and target are in memory at once, so a large request is computed a
+  // block of them at a time
+  if (costmatrix_max_block_locations > 0 &&
+      static_cast<uint32_t>(options.sources_size() + options.targets_size()) >
+          costmatrix_max_block_locations) {
+    costmatrix_blocks(request, max_matrix_distance.find(costing)->second);
+    return;
+  }
+
   if (!algo->SourceToTarget(request, *reader, mode_costing, mode,
                             max_matrix_distance.find(costing)->second) &&
       cost->AllowMultiPass() && costmatrix_allow_second_pass) {
@@ -152,8 +383,92 @@ std::string thor_worker_t::matrix(Api& request) {
     // add a warning that we needed to open destonly etc
     add_warning(request, 400, get_unfound_indices(request.matrix().second_pass()));
   };
+}
 
-  return tyr::serializeMatrix(request);
+void thor_worker_t::costmatrix_blocks(Api& request, const float max_matrix_distance) {
+  const auto& options = request.options();
+  const uint32_t targets = options.targets_size();
+  const auto blocks = matrix_blocks(options.sources_size(), targets, costmatrix_max_block_locations);
+  LOG_INFO("matrix::blocks " + std::to_string(blocks.size()));
+
+  // the blocks bound the trees but not the result: the indices, distances, times and second pass
+  // flags of every connection are in memory at once, which grows with sources times targets. The
+  // strings are left out unless CostMatrix writes them, date_times only for a verbose request and
+  // shapes when they are asked for
+  auto& matrix = *request.mutable_matrix();
+  MatrixAlgorithm::reserve_pbf_arrays(matrix, options.sources_size() * targets, options.verbose(), 0,
+                                      options.verbose(), options.shape_format() != no_shape);
+  matrix.set_algorithm(Matrix::CostMatrix);
+
+  // the request of a block has all the options but only the locations of the block, each block
+  // goes into the matrix of the request and its trees are cleared before the next one
+  Api block_request;
+  auto& block_options = *block_request.mutable_options();
+  block_options.CopyFrom(options);
+  auto& block_matrix = *block_request.mutable_matrix();
+  const auto compute = [&](const matrix_part_t& block, const bool second_pass) {
+    set_part_locations(options, block, block_options);
+    block_matrix.Clear();
+    if (second_pass) {
+      MatrixAlgorithm::reserve_pbf_arrays(block_matrix,
+                                          block.sources.size() * block.targets.size(),
+                                          options.verbose());
+      copy_part(matrix, block_matrix, block, targets, true);
+    }
+
+    const bool found = costmatrix_.SourceToTarget(block_request, *reader, mode_costing, mode,
+                                                  max_matrix_distance);
+    costmatrix_.Clear();
+    copy_part(block_matrix, matrix, block, targets, false);
+
+    // the warnings of a block go into the request once, whichever blocks raised them
+    auto& warnings = *request.mutable_info()->mutable_warnings();
+    for (const auto& warning : block_request.info().warnings()) {
+      if (std::none_of(warnings.begin(), warnings.end(),
+                       [&warning](const auto& w) { return w.code() == warning.code(); })) {
+        warnings.Add()->CopyFrom(warning);
+      }
+    }
+    block_request.mutable_info()->clear_warnings();
+
+    // the later blocks of a row start at the departure the first one settled on
+    if (block.targets.front() == 0) {
+      for (uint32_t s = 0; s < block.sources.size(); ++s) {
+        request.mutable_options()
+            ->mutable_sources(block.sources[s])
+            ->set_date_time(block_options.sources(s).date_time());
+      }
+    }
+    return found;
+  };
+
+  bool found = true;
+  for (const auto& block : blocks) {
+    found = compute(block, false) && found;
+  }
+
+  // like a single CostMatrix try a second pass, only for the blocks with unfound connections
+  valhalla::sif::cost_ptr_t cost = mode_costing[static_cast<uint32_t>(mode)];
+  if (found || !cost->AllowMultiPass() || !costmatrix_allow_second_pass) {
+    return;
+  }
+  cost->set_pass(1);
+  cost->RelaxHierarchyLimits(true);
+  cost->set_allow_destination_only(true);
+  cost->set_allow_conditional_destination(true);
+  costmatrix_.set_not_thru_pruning(false);
+  for (const auto& block : blocks) {
+    bool unfound = false;
+    for (const auto s : block.sources) {
+      for (const auto t : block.targets) {
+        unfound = unfound || matrix.second_pass(s * targets + t);
+      }
+    }
+    if (unfound) {
+      compute(block, true);
+    }
+  }
+  add_warning(request, 400, get_unfound_indices(matrix.second_pass()));
 }
 } // namespace thor
 } // namespace valhalla
@@ -0,0 +1,237 @@
+#include "thor/matrixcache.h"
+#include "baldr/time_info.h"
+#include "proto_conversions.h"
+#include "thor/matrixalgorithm.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+using namespace valhalla::midgard;
+using namespace valhalla::baldr;
+using namespace valhalla::sif;
+
+namespace valhalla {
+namespace thor {
+
+MatrixCache::MatrixCache(const boost::property_tree::ptree& config)
+    : max_connections_(config.get<size_t>("matrix_cache.max_connections", 0)),
+      time_bucket_(std::max(config.get<uint32_t>("matrix_cache.time_bucket", 15), 1u) *
+                   kSecPerMinute),
+      traffic_check_interval_(config.get<uint32_t>("matrix_cache.traffic_check_interval", 1000)),
+      verbose_(false), tileset_build_(0), traffic_last_update_(0) {
+}
+
+std::vector<bool> MatrixCache::Get(Api& request, GraphReader& reader, const DynamicCost& costing) {
+  source_keys_.clear();
+  target_keys_.clear();
+  source_departures_.clear();
+  target_departures_.clear();
+
+  // shapes take more room than the rest of a connection, matrix_locations and the profiles are not
+  // made of connections computed on their own
+  const auto& options = request.options();
+  if (max_connections_ == 0 || options.shape_format() != no_shape ||
+      options.matrix_locations() != kAllLocations || options.profile_departures() > 1) {
+    return {};
+  }
+
+  // the connections are of no use once the tiles are rebuilt or the traffic they were computed
+  // with got updated. A rewritten tile doesn't change the modification time of the tile dir
+  if (!build_tile_.is_valid()) {
+    for (const auto* locations : {&options.sources(), &options.targets()}) {
+      for (const auto& location : *locations) {
+        if (!build_tile_.is_valid() && location.correlation().edges_size() > 0) {
+          build_tile_ = GraphId(location.correlation().edges(0).graph_id()).tile_base();
+        }
+      }
+    }
+  }
+  const auto build = reader.TileBuild(build_tile_);
+  if (build != tileset_build_) {
+    connections_.clear();
+    index_.clear();
+    tileset_build_ = build;
+  }
+  // a tile that is gone in the new build is not asked again
+  if (build == 0) {
+    build_tile_ = {};
+  }
+  const auto now = std::chrono::steady_clock::now();
+  if ((costing.flow_mask() & kCurrentFlowMask) && reader.HasLiveTraffic() &&
+      now - traffic_last_check_ >= traffic_check_interval_) {
+    traffic_last_check_ = now;
+    const auto last_update = reader.LastTrafficUpdate();
+    if (last_update != traffic_last_update_) {
+      connections_.clear();
+      index_.clear();
+      traffic_last_update_ = last_update;
+    }
+  }
+
+  // the costing and the options every connection depends on
+  std::string context =
+      Costing_Enum_Name(options.costing_type()) + ':' + std::to_string(costing.pass()) + ':';
+  auto found = options.costings().find(options.costing_type());
+  if (found != options.costings().end()) {
+    context += found->second.options().SerializeAsString();
+  }
+  const auto append = [&context](const auto value) {
+    context.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+  append(options.verbose());
+  append(options.prioritize_bidirectional());
+  append(static_cast<int>(options.date_time_type()));
+  append(options.expansion_max_distance());
+  context_ = MakeKeyPart(std::move(context));
+  verbose_ = options.verbose();
+
+  source_departures_.resize(options.sources_size());
+  target_departures_.resize(options.targets_size());
+  for (int s = 0; s < options.sources_size(); ++s) {
+    source_keys_.push_back(LocationKey(options.sources(s), reader, source_departures_[s]));
+  }
+  for (int t = 0; t < options.targets_size(); ++t) {
+    target_keys_.push_back(LocationKey(options.targets(t), reader, target_departures_[t]));
+  }
+
+  // fill in the connections the cache has
+  std::vector<bool> cached(source_keys_.size() * target_keys_.size(), false);
+  auto& matrix = *request.mutable_matrix();
+  for (uint32_t s = 0; s < source_keys_.size(); ++s) {
+    for (uint32_t t = 0; t < target_keys_.size(); ++t) {
+      const auto connection = index_.find({context_, source_keys_[s], target_keys_[t]});
+      if (connection == index_.end()) {
+        continue;
+      }
+      connections_.splice(connections_.begin(), connections_, connection->second);
+      if (matrix.times_size() == 0) {
+        MatrixAlgorithm::reserve_pbf_arrays(matrix, cached.size(), verbose_);
+        matrix.set_algorithm(connection->second->algorithm);
+      }
+
+      const auto& c = *connection->second;
+      const int i = s * target_keys_.size() + t;
+      cached[i] = true;
+      matrix.set_from_indices(i, s);
+      matrix.set_to_indices(i, t);
+      matrix.set_times(i, c.time);
+      matrix.set_distances(i, c.distance);
+      if (c.timed) {
+        const auto& departure = c.from_target ? target_departures_[t] : source_departures_[s];
+        const auto dt_info = DateTime::offset_date(departure.date_time, departure.time_zone_index,
+                                                   c.time_zone_index, c.date_time_offset);
+        matrix.set_date_times(i, dt_info.date_time);
+        matrix.set_time_zone_offsets(i, dt_info.time_zone_offset);
+        matrix.set_time_zone_names(i, dt_info.time_zone_name);
+      }
+      if (verbose_) {
+        matrix.set_begin_heading(i, c.begin_heading);
+        matrix.set_end_heading(i, c.end_heading);
+        matrix.set_begin_lat(i, c.begin_lat);
+        matrix.set_begin_lon(i, c.begin_lon);
+        matrix.set_end_lat(i, c.end_lat);
+        matrix.set_end_lon(i, c.end_lon);
+      }
+    }
+  }
+  return cached;
+}
+
+void MatrixCache::Put(const Api& part,
+                      const std::vector<uint32_t>& sources,
+                      const std::vector<uint32_t>& targets) {
+  if (source_keys_.empty() || target_keys_.empty()) {
+    return;
+  }
+
+  const auto& matrix = part.matrix();
+  // like the algorithms offset the date_time from the departure of the source, or of the target
+  // when TimeDistanceMatrix searched in reverse, by the whole seconds for TimeDistanceMatrix
+  const bool tdmatrix = matrix.algorithm() == Matrix::TimeDistanceMatrix;
+  const bool from_target = tdmatrix && sources.size() > targets.size();
+  for (uint32_t s = 0; s < sources.size(); ++s) {
+    for (uint32_t t = 0; t < targets.size(); ++t) {
+      const int i = s * targets.size() + t;
+      // the relaxed second pass depends on what the first one didn't find
+      if (matrix.second_pass(i)) {
+        continue;
+      }
+
+      uint64_t time_zone_index = 0;
+      const bool timed = i < matrix.date_times_size() && !matrix.date_times(i).empty();
+      if (timed) {
+        try {
+          time_zone_index = DateTime::get_tz_db().to_index(matrix.time_zone_names(i));
+        } catch (...) { continue; }
+      }
+
+      connection_t connection{{context_, source_keys_[sources[s]], target_keys_[targets[t]]},
+                              matrix.algorithm(),
+                              matrix.times(i),
+                              matrix.distances(i),
+                              timed,
+                              from_target,
+                              tdmatrix ? std::floor(matrix.times(i)) : matrix.times(i),
+                              time_zone_index,
+                              kInvalidHeading,
+                              kInvalidHeading,
+                              INVALID_LL,
+                              INVALID_LL,
+                              INVALID_LL,
+                              INVALID_LL};
+      if (verbose_) {
+        connection.begin_heading = matrix.begin_heading(i);
+        connection.end_heading = matrix.end_heading(i);
+        connection.begin_lat = matrix.begin_lat(i);
+        connection.begin_lon = matrix.begin_lon(i);
+        connection.end_lat = matrix.end_lat(i);
+        connection.end_lon = matrix.end_lon(i);
+      }
+
+      const auto cached = index_.find(connection.key);
+      if (cached != index_.end()) {
+        connections_.erase(cached->second);
+        index_.erase(cached);
+      }
+      connections_.push_front(std::move(connection));
+      index_.emplace(connections_.front().key, connections_.begin());
+    }
+  }
+
+  while (connections_.size() > max_connections_) {
+    index_.erase(connections_.back().key);
+    connections_.pop_back();
+  }
+}
+
+MatrixCache::key_part_t MatrixCache::LocationKey(const valhalla::Location& location,
+                                  GraphReader& reader,
+                                  departure_t& departure) {
+  std::string key;
+  const auto append = [&key](const auto value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+  for (const auto& edge : location.correlation().edges()) {
+    append(edge.graph_id());
+    append(edge.percent_along());
+    append(edge.distance());
+    append(edge.begin_node());
+    append(edge.end_node());
+  }
+
+  // the departure or arrival by its bucket, TimeInfo resolves "current" on a copy
+  int64_t bucket = -1;
+  departure = {};
+  if (!location.date_time().empty()) {
+    auto timed = location;
+    const auto time_info = TimeInfo::make(timed, reader, &tz_cache_);
+    bucket = time_info.valid ? static_cast<int64_t>(time_info.local_time / time_bucket_) : -1;
+    departure = {timed.date_time(), time_info.timezone_index};
+  }
+  append(bucket);
+  return MakeKeyPart(std::move(key));
+}
+
+} // namespace thor
+} // namespace valhalla
@@ -135,6 +135,7 @@ MultiModalPathAlgorithm::GetBestPath(valhalla::Location& origin,
   // Clear operators and processed tiles
   operators_.clear();
   processed_tiles_.clear();
+  active_schedules_.clear();
 
   // Find shortest path
   uint32_t nc = 0; // Count of iterations with no convergence
@@ -338,10 +339,17 @@ bool MultiModalPathAlgorithm::ExpandForward(GraphReader& graphreader,
         continue;
       }
 
-      // Look up the next departure along this edge
+      // Look up the next departure along this edge on the schedules running on the day
+      auto active = active_schedules_.find(tile->id().tileid());
+      if (active == active_schedules_.end()) {
+        active = active_schedules_
+                     .emplace(tile->id().tileid(),
+                              tile->GetActiveSchedules(day_, dow_, date_before_tile_))
+                     .first;
+      }
       const TransitDeparture* departure =
-          tile->GetNextDeparture(directededge->lineid(), offset_time.day_seconds(), day_, dow_,
-                                 date_before_tile_, tc->wheelchair(), tc->bicycle());
+          tile->GetNextDeparture(directededge->lineid(), offset_time.day_seconds(), active->second,
+                                 tc->wheelchair(), tc->bicycle());
 
       if (departure) {
         // Check if there has been a mode change
@@ -366,8 +374,8 @@ bool MultiModalPathAlgorithm::ExpandForward(GraphReader& graphreader,
             // TODO - let's get the transfers.txt implemented!
             if (offset_time.day_seconds() + 30 > departure->departure_time()) {
               departure =
-                  tile->GetNextDeparture(directededge->lineid(), offset_time.day_seconds() + 30, day_,
-                                         dow_, date_before_tile_, tc->wheelchair(), tc->bicycle());
+                  tile->GetNextDeparture(directededge->lineid(), offset_time.day_seconds() + 30,
+                                         active->second, tc->wheelchair(), tc->bicycle());
               if (!departure) {
                 continue;
               }
@@ -48,7 +48,11 @@ void thor_worker_t::optimized_route(Api& request) {
 
   Optimizer optimizer;
   // returns the optimal order of the path_locations
-  auto optimal_order = optimizer.Solve(correlated.size(), time_costs);
+  auto optimal_order =
+      options.optimizer() == Options::tsp_local_search
+          ? optimizer.SolveLocalSearch(correlated.size(), time_costs, optimizer_concurrency,
+                                       optimizer_time_budget)
+          : optimizer.Solve(correlated.size(), time_costs);
   // put the optimal order into the locations array
   options.mutable_locations()->Clear();
   for (size_t i = 0; i < optimal_order.size(); i++) {
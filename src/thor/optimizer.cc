@@ -2,6 +2,24 @@
 #include "midgard/logging.h"
 
 #include <algorithm>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// a move has to make the tour cheaper by more than this, so rounding can't keep the search going
+constexpr double kMinGain = 1e-3;
+
+// the longest run of locations Or-opt moves
+constexpr uint32_t kMaxOrOptLength = 3;
+
+// kicks without a better tour before a thread gives up, per location
+constexpr uint32_t kStaleKicksPerLocation = 2;
+constexpr uint32_t kMinStaleKicks = 100;
+
+} // namespace
 
 namespace valhalla {
 namespace thor {
@@ -54,6 +72,218 @@ std::vector<uint32_t> Optimizer::Solve(const uint32_t count, const std::vector<f
   return best_tour_;
 }
 
+// Optimize the tour with an iterated local search on several threads.
+std::vector<uint32_t> Optimizer::SolveLocalSearch(const uint32_t count,
+                                                  const std::vector<float>& costs,
+                                                  const uint32_t concurrency,
+                                                  const std::chrono::milliseconds time_budget) {
+  // Handle trivial cases like annealing
+  count_ = count;
+  if (count_ <= 4) {
+    return Solve(count, costs);
+  }
+  const auto deadline = std::chrono::steady_clock::now() + time_budget;
+
+  // start from the improved nearest neighbor tour, every thread kicks it with its own seed drawn
+  // here so that seeding the optimizer makes the search on one thread repeatable
+  shared_tour_t best;
+  best.tour = NearestNeighborTour(costs);
+  LocalSearch(costs, best.tour);
+  best.cost = TourCost(costs, best.tour);
+  best.stale = 0;
+  const uint32_t thread_count = std::max(concurrency, 1u);
+  std::vector<uint64_t> seeds;
+  for (uint32_t t = 0; t < thread_count; ++t) {
+    seeds.push_back(random_generator_());
+  }
+
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto work = [&](const uint32_t t) {
+    try {
+      IteratedLocalSearch(costs, best, seeds[t], deadline);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (uint32_t t = 1; t < thread_count; ++t) {
+    threads.emplace_back(work, t);
+  }
+  work(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  // Return the best tour
+  best_tour_ = std::move(best.tour);
+  best_cost_ = best.cost;
+  LOG_DEBUG("Best tour cost = " + std::to_string(best_cost_));
+  return best_tour_;
+}
+
+// Get the tour that always goes on to the cheapest location not visited yet.
+std::vector<uint32_t> Optimizer::NearestNeighborTour(const std::vector<float>& costs) const {
+  std::vector<uint32_t> tour = {0};
+  std::vector<bool> visited(count_, false);
+  visited.front() = visited.back() = true;
+  for (uint32_t i = 1; i < count_ - 1; i++) {
+    uint32_t next = 0;
+    float best = std::numeric_limits<float>::max();
+    for (uint32_t loc = 1; loc < count_ - 1; loc++) {
+      if (!visited[loc] && (next == 0 || Cost(costs, tour.back(), loc) < best)) {
+        next = loc;
+        best = Cost(costs, tour.back(), loc);
+      }
+    }
+    visited[next] = true;
+    tour.push_back(next);
+  }
+  tour.push_back(count_ - 1);
+  return tour;
+}
+
+// Kick the best tour out of its local optimum and improve it again.
+void Optimizer::IteratedLocalSearch(const std::vector<float>& costs,
+                                    shared_tour_t& best,
+                                    const uint64_t seed,
+                                    const std::chrono::steady_clock::time_point deadline) const {
+  std::mt19937_64 random(seed);
+  std::uniform_int_distribution<uint32_t> location(1, count_ - 2);
+  const uint32_t max_stale = std::max(kMinStaleKicks, kStaleKicksPerLocation * count_);
+  std::vector<uint32_t> tour;
+  while (std::chrono::steady_clock::now() < deadline) {
+    {
+      std::lock_guard<std::mutex> lock(best.mutex);
+      if (best.stale >= max_stale) {
+        break;
+      }
+      tour = best.tour;
+    }
+
+    // swap two neighboring runs of locations, which no 2-opt or Or-opt move undoes in one step
+    // and which keeps the direction of all the locations so it suits asymmetric costs
+    uint32_t cut[3];
+    do {
+      cut[0] = location(random);
+      cut[1] = location(random);
+      cut[2] = location(random);
+    } while (cut[0] == cut[1] || cut[0] == cut[2] || cut[1] == cut[2]);
+    std::sort(cut, cut + 3);
+    std::rotate(tour.begin() + cut[0], tour.begin() + cut[1], tour.begin() + cut[2]);
+
+    LocalSearch(costs, tour);
+    const float cost = TourCost(costs, tour);
+    std::lock_guard<std::mutex> lock(best.mutex);
+    if (cost < best.cost - kMinGain) {
+      best.cost = cost;
+      best.tour = std::move(tour);
+      best.stale = 0;
+    } else {
+      best.stale++;
+    }
+  }
+}
+
+// Apply 2-opt and Or-opt moves until none of them makes the tour cheaper.
+void Optimizer::LocalSearch(const std::vector<float>& costs, std::vector<uint32_t>& tour) const {
+  std::vector<double> forward, backward;
+  PrefixCosts(costs, tour, forward, backward);
+  bool improved = true;
+  while (improved) {
+    improved = TwoOpt(costs, tour, forward, backward);
+    improved = OrOpt(costs, tour, forward, backward) || improved;
+  }
+}
+
+// Reverse the parts of the tour that get cheaper reversed.
+bool Optimizer::TwoOpt(const std::vector<float>& costs,
+                       std::vector<uint32_t>& tour,
+                       std::vector<double>& forward,
+                       std::vector<double>& backward) const {
+  bool improved = false;
+  for (uint32_t i = 1; i + 2 < count_; i++) {
+    for (uint32_t j = i + 1; j + 1 < count_; j++) {
+      // the connections at either end change and the part in between is traversed backwards
+      const double diff = static_cast<double>(Cost(costs, tour[i - 1], tour[j])) +
+                          Cost(costs, tour[i], tour[j + 1]) - Cost(costs, tour[i - 1], tour[i]) -
+                          Cost(costs, tour[j], tour[j + 1]) + (backward[j] - backward[i]) -
+                          (forward[j] - forward[i]);
+      if (diff < -kMinGain) {
+        std::reverse(tour.begin() + i, tour.begin() + j + 1);
+        PrefixCosts(costs, tour, forward, backward);
+        improved = true;
+      }
+    }
+  }
+  return improved;
+}
+
+// Move runs of locations to wherever in the tour they are cheaper.
+bool Optimizer::OrOpt(const std::vector<float>& costs,
+                      std::vector<uint32_t>& tour,
+                      std::vector<double>& forward,
+                      std::vector<double>& backward) const {
+  bool improved = false;
+  for (uint32_t length = 1; length <= kMaxOrOptLength; length++) {
+    for (uint32_t i = 1; i + length < count_; i++) {
+      // take out the run from i to last and close the gap
+      const uint32_t last = i + length - 1;
+      const double removed = static_cast<double>(Cost(costs, tour[i - 1], tour[last + 1])) -
+                             Cost(costs, tour[i - 1], tour[i]) -
+                             Cost(costs, tour[last], tour[last + 1]);
+      const double reversal = (backward[last] - backward[i]) - (forward[last] - forward[i]);
+
+      // and put it between p and p + 1 instead, as it is or reversed
+      for (uint32_t p = 0; p + 1 < count_; p++) {
+        if (p + 1 >= i && p <= last) {
+          continue;
+        }
+        const double ahead = static_cast<double>(Cost(costs, tour[p], tour[i])) +
+                             Cost(costs, tour[last], tour[p + 1]);
+        const double reversed = static_cast<double>(Cost(costs, tour[p], tour[last])) +
+                                Cost(costs, tour[i], tour[p + 1]) + reversal;
+        const double diff = removed - Cost(costs, tour[p], tour[p + 1]) + std::min(ahead, reversed);
+        if (diff < -kMinGain) {
+          auto begin = p > last ? tour.begin() + p + 1 - length : tour.begin() + p + 1;
+          if (p > last) {
+            std::rotate(tour.begin() + i, tour.begin() + last + 1, tour.begin() + p + 1);
+          } else {
+            std::rotate(tour.begin() + p + 1, tour.begin() + i, tour.begin() + last + 1);
+          }
+          if (reversed < ahead) {
+            std::reverse(begin, begin + length);
+          }
+          PrefixCosts(costs, tour, forward, backward);
+          improved = true;
+          break;
+        }
+      }
+    }
+  }
+  return improved;
+}
+
+// Set the cost of the tour up to every position in both directions.
+void Optimizer::PrefixCosts(const std::vector<float>& costs,
+                            const std::vector<uint32_t>& tour,
+                            std::vector<double>& forward,
+                            std::vector<double>& backward) const {
+  forward.resize(count_);
+  backward.resize(count_);
+  forward[0] = backward[0] = 0.0;
+  for (uint32_t i = 1; i < count_; i++) {
+    forward[i] = forward[i - 1] + Cost(costs, tour[i - 1], tour[i]);
+    backward[i] = backward[i - 1] + Cost(costs, tour[i], tour[i - 1]);
+  }
+}
+
 // Perform the annealing process.
 uint32_t Optimizer::Anneal(const std::vector<float>& costs, float temperature) {
   uint32_t success_count = 0;
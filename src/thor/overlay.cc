@@ -0,0 +1,830 @@
+#include "thor/overlay.h"
+#include "baldr/time_info.h"
+#include "midgard/logging.h"
+#include "proto_conversions.h"
+#include "sif/costfactory.h"
+#include "sif/edgelabel.h"
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+
+using namespace valhalla::baldr;
+using namespace valhalla::sif;
+using namespace valhalla::thor;
+
+namespace {
+
+constexpr size_t kInterruptInterval = 5000;
+
+const auto later = [](const auto& a, const auto& b) { return a.first > b.first; };
+
+// what a customization is cached by, hierarchy limits don't matter to the overlay, the pass changes
+// what is allowed
+std::string metric_key(const valhalla::Options& options, const DynamicCost& costing) {
+  std::string key = valhalla::Costing_Enum_Name(options.costing_type()) + ':' +
+                    std::to_string(costing.pass()) + ':';
+  auto found = options.costings().find(options.costing_type());
+  if (found != options.costings().end()) {
+    auto costing_options = found->second.options();
+    costing_options.clear_hierarchy_limits();
+    key += costing_options.SerializeAsString();
+  }
+  return key;
+}
+
+/**
+ * Costs every edge and every transition for the costing, the same way the searches of the regular
+ * graph do without a time: turns are only allowed if the costing allows them coming from the
+ * previous edge and u-turns only where nothing else is. The transitions are visited in the order
+ * mjolnir added them, the edges at the end node and then those at its copies on the other levels.
+ */
+void CustomizeEdges(const PartitionOverlay& overlay,
+                    GraphReader& reader,
+                    const DynamicCost& costing,
+                    std::vector<overlay_cost_t>& nodes,
+                    std::vector<overlay_cost_t>& arcs) {
+  nodes.assign(overlay.size(), kOverlayUnreachedCost);
+  arcs.assign(overlay.arc_count(), kOverlayUnreachedCost);
+  auto reader_getter = [&reader]() { return LimitedGraphReader(reader); };
+  using candidate_t = std::tuple<uint64_t, const NodeInfo*, graph_tile_ptr, GraphId>;
+  std::vector<candidate_t> candidates;
+
+  for (uint32_t u = 0; u < overlay.size(); ++u) {
+    const auto edgeid = overlay.edgeid(u);
+    graph_tile_ptr tile = reader.GetGraphTile(edgeid);
+    if (!tile) {
+      throw std::runtime_error("The partition overlay does not match the graph");
+    }
+    const auto* edge = tile->directededge(edgeid);
+    if (!costing.IsAccessible(edge)) {
+      continue;
+    }
+    uint8_t flow_sources;
+    const auto cost = costing.EdgeCost(edge, edgeid, tile, TimeInfo::invalid(), flow_sources);
+    // the paths onto the last edge of a complex restriction are left to the regular searches
+    nodes[u] = {cost.cost, cost.secs, static_cast<float>(edge->length()),
+                (edge->end_restriction() & costing.access_mode()) != 0};
+
+    graph_tile_ptr end_tile = reader.GetGraphTile(edge->endnode(), tile);
+    if (!end_tile) {
+      continue;
+    }
+    const auto* nodeinfo = end_tile->node(edge->endnode());
+
+    // line the turns at the node up with the arcs
+    candidates.clear();
+    auto arc = overlay.arcs_begin(u);
+    auto collect = [&](const NodeInfo* node, const graph_tile_ptr& node_tile) {
+      GraphId to_id = node_tile->id();
+      to_id.set_id(node->edge_index());
+      for (uint32_t i = 0; i < node->edge_count(); ++i, ++to_id) {
+        const auto v = overlay.node(to_id);
+        if (v == kInvalidOverlayNode) {
+          continue;
+        }
+        if (arc == overlay.arcs_end(u) || overlay.arc(arc).node != v) {
+          throw std::runtime_error("The partition overlay does not match the graph");
+        }
+        candidates.emplace_back(arc++, node, node_tile, to_id);
+      }
+    };
+    collect(nodeinfo, end_tile);
+    for (const auto& trans : end_tile->GetNodeTransitions(nodeinfo)) {
+      auto trans_tile = reader.GetGraphTile(trans.endnode());
+      if (trans_tile) {
+        collect(trans_tile->node(trans.endnode()), trans_tile);
+      }
+    }
+    if (arc != overlay.arcs_end(u)) {
+      throw std::runtime_error("The partition overlay does not match the graph");
+    }
+
+    EdgeLabel pred(kInvalidLabel, edgeid, edge, {}, 0, costing.travel_mode(), 0,
+                   kInvalidRestriction, true, false, InternalTurn::kNoTurn, 0,
+                   edge->destonly() || (costing.is_hgv() && edge->destonly_hgv()),
+                   edge->forwardaccess() & kTruckAccess);
+    auto evaluate = [&](const candidate_t& candidate) {
+      const auto& [index, node, node_tile, to_id] = candidate;
+      const auto* to = node_tile->directededge(to_id);
+      uint8_t restriction_idx = kInvalidRestriction;
+      uint8_t destonly_mask = 0;
+      if (!costing.Allowed(to, false, pred, node_tile, to_id, 0, 0, restriction_idx,
+                           destonly_mask)) {
+        return false;
+      }
+      const auto transition = costing.TransitionCost(to, node, pred, node_tile, reader_getter);
+      arcs[index] = {transition.cost, transition.secs, 0.f};
+      return true;
+    };
+
+    // at a barrier the only way on is back, at a dead end too
+    bool allowed = false;
+    if (costing.Allowed(nodeinfo)) {
+      for (const auto& candidate : candidates) {
+        if (!overlay.arc(std::get<0>(candidate)).uturn) {
+          allowed = evaluate(candidate) || allowed;
+        }
+      }
+    }
+    if (!allowed) {
+      pred.set_deadend(true);
+      for (const auto& candidate : candidates) {
+        if (overlay.arc(std::get<0>(candidate)).uturn) {
+          evaluate(candidate);
+        }
+      }
+    }
+
+    if (reader.OverCommitted()) {
+      reader.Trim();
+    }
+  }
+}
+
+} // namespace
+
+namespace valhalla {
+namespace thor {
+
+/**
+ * Dijkstra from a node within its cell on a level. On level 0 it expands the arcs of the regular
+ * graph, above that it goes through the cells one level down and along the arcs between them.
+ */
+class OverlayCellSearch {
+public:
+  struct label_t {
+    overlay_cost_t cost;
+    uint32_t pred;
+    int8_t level;
+    bool settled;
+  };
+
+  OverlayCellSearch(const PartitionOverlay& overlay, const OverlayMetric& metric)
+      : overlay_(overlay), metric_(metric) {
+  }
+
+  /**
+   * Runs the search.
+   * @param level   the level of the cell
+   * @param source  where to start
+   * @param target  where to stop, kInvalidOverlayNode to run until all exits are settled
+   */
+  void Run(const uint32_t level, const uint32_t source, const uint32_t target) {
+    labels_.clear();
+    queue_.clear();
+    const auto cell = overlay_.cell(level, source);
+    size_t remaining = target == kInvalidOverlayNode ? overlay_.exits(level, cell).size() : 1;
+
+    auto push = [&](uint32_t node, const overlay_cost_t& cost, uint32_t pred, int8_t via) {
+      auto [found, inserted] = labels_.try_emplace(node, label_t{cost, pred, via, false});
+      if (!inserted) {
+        if (found->second.settled || cost.cost >= found->second.cost.cost) {
+          return;
+        }
+        found->second = {cost, pred, via, false};
+      }
+      queue_.emplace_back(cost.cost, node);
+      std::push_heap(queue_.begin(), queue_.end(), later);
+    };
+    // an arc of the regular graph, within the cell
+    auto relax = [&](uint32_t node, const overlay_cost_t& cost, uint64_t arc) {
+      const auto head = overlay_.arc(arc).node;
+      const auto& transition = metric_.arc(arc);
+      const auto& edge = metric_.node(head);
+      if (transition.reachable() && edge.reachable()) {
+        push(head, cost + transition + edge, node, -1);
+      }
+    };
+
+    push(source, {0, 0, 0}, kInvalidOverlayNode, -1);
+    while (!queue_.empty() && remaining > 0) {
+      std::pop_heap(queue_.begin(), queue_.end(), later);
+      const auto node = queue_.back().second;
+      queue_.pop_back();
+      auto& label = labels_.find(node)->second;
+      if (label.settled) {
+        continue;
+      }
+      label.settled = true;
+      const auto cost = label.cost;
+      if (target == kInvalidOverlayNode ? overlay_.exit_index(level, node) != kInvalidOverlayNode
+                                        : node == target) {
+        --remaining;
+      }
+
+      if (level == 0) {
+        for (auto a = overlay_.arcs_begin(node); a < overlay_.arcs_end(node); ++a) {
+          if (overlay_.cell(0, overlay_.arc(a).node) == cell) {
+            relax(node, cost, a);
+          }
+        }
+        continue;
+      }
+
+      const uint32_t sub = level - 1;
+      const auto subcell = overlay_.cell(sub, node);
+      const auto entry = overlay_.entry_index(sub, node);
+      if (entry != kInvalidOverlayNode) {
+        const auto exits = overlay_.exits(sub, subcell);
+        for (uint32_t i = 0; i < exits.size(); ++i) {
+          const auto& through = metric_.clique(sub, subcell, entry, i);
+          if (through.reachable()) {
+            push(exits[i], cost + through, node, static_cast<int8_t>(sub));
+          }
+        }
+      }
+      if (overlay_.exit_index(sub, node) != kInvalidOverlayNode) {
+        for (auto a = overlay_.arcs_begin(node); a < overlay_.arcs_end(node); ++a) {
+          const auto head = overlay_.arc(a).node;
+          if (overlay_.cell(level, head) == cell && overlay_.cell(sub, head) != subcell) {
+            relax(node, cost, a);
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * @return the label of a node, nullptr if it was not reached
+   */
+  const label_t* label(const uint32_t node) const {
+    auto found = labels_.find(node);
+    return found == labels_.end() ? nullptr : &found->second;
+  }
+
+private:
+  const PartitionOverlay& overlay_;
+  const OverlayMetric& metric_;
+  ankerl::unordered_dense::map<uint32_t, label_t> labels_;
+  std::vector<std::pair<float, uint32_t>> queue_;
+};
+
+std::shared_ptr<const OverlayMetric> OverlayMetric::Customize(const PartitionOverlay& overlay,
+                                                              GraphReader& reader,
+                                                              const DynamicCost& costing,
+                                                              uint32_t concurrency) {
+  auto metric = std::make_shared<OverlayMetric>();
+  CustomizeEdges(overlay, reader, costing, metric->nodes_, metric->arcs_);
+
+  // bottom up, each level goes through the cells of the one below
+  for (uint32_t level = 0; level < overlay.levels(); ++level) {
+    const auto cell_count = overlay.cell_count(level);
+    auto& offsets = metric->clique_offsets_.emplace_back(cell_count + 1, 0);
+    auto& exit_counts = metric->exit_counts_.emplace_back(cell_count, 0);
+    for (uint32_t cell = 0; cell < cell_count; ++cell) {
+      exit_counts[cell] = overlay.exits(level, cell).size();
+      offsets[cell + 1] = offsets[cell] + overlay.entries(level, cell).size() * exit_counts[cell];
+    }
+    auto& cliques = metric->cliques_.emplace_back(offsets.back(), kOverlayUnreachedCost);
+
+    std::atomic<uint32_t> next{0};
+    auto work = [&]() {
+      OverlayCellSearch search(overlay, *metric);
+      for (uint32_t cell = next++; cell < cell_count; cell = next++) {
+        const auto entries = overlay.entries(level, cell);
+        const auto exits = overlay.exits(level, cell);
+        for (uint32_t i = 0; i < entries.size(); ++i) {
+          search.Run(level, entries[i], kInvalidOverlayNode);
+          for (uint32_t j = 0; j < exits.size(); ++j) {
+            const auto* label = search.label(exits[j]);
+            if (label) {
+              cliques[offsets[cell] + i * exits.size() + j] = label->cost;
+            }
+          }
+        }
+      }
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < concurrency; ++i) {
+      threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  return metric;
+}
+
+OverlaySearch::OverlaySearch(const boost::property_tree::ptree& config, const std::string& file)
+    : overlay_(nullptr), concurrency_(std::max(config.get<uint32_t>("overlay.concurrency", 1), 1u)),
+      max_cached_metrics_(config.get<size_t>("overlay.max_cached_metrics", 4)),
+      customize_in_background_(config.get<bool>("overlay.customize_in_background", true)),
+      interrupt_(nullptr) {
+  shared_ = Share(file, max_cached_metrics_);
+  if (shared_) {
+    overlay_ = shared_->overlay.get();
+  }
+}
+
+std::shared_ptr<OverlaySearch::shared_t> OverlaySearch::Share(const std::string& file,
+                                                              const size_t max_cached_metrics) {
+  std::error_code ec;
+  if (file.empty() || !std::filesystem::exists(file, ec)) {
+    return nullptr;
+  }
+
+  // the overlay lives as long as a search uses it, a worker started after that maps it again
+  static std::mutex mutex;
+  static std::unordered_map<std::string, std::weak_ptr<shared_t>> files;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& entry = files[file];
+  if (auto shared = entry.lock()) {
+    return shared;
+  }
+  try {
+    auto shared = std::make_shared<shared_t>();
+    shared->overlay = std::make_unique<PartitionOverlay>(file);
+    shared->max_cached_metrics = max_cached_metrics;
+    LOG_INFO("Using the partition overlay with " + std::to_string(shared->overlay->size()) +
+             " edges on " + std::to_string(shared->overlay->levels()) + " levels");
+    entry = shared;
+    return shared;
+  } catch (const std::exception& e) {
+    LOG_WARN("Skipping " + file + ": " + e.what());
+  }
+  return nullptr;
+}
+
+OverlaySearch::shared_t::~shared_t() {
+  if (customizer.joinable()) {
+    customizer.join();
+  }
+}
+
+bool OverlaySearch::Supports(GraphReader& reader, const DynamicCost& costing) const {
+  // a customization would go stale with the live traffic it was made with
+  return overlay_ && max_cached_metrics_ > 0 &&
+         !((costing.flow_mask() & kCurrentFlowMask) && reader.HasLiveTraffic());
+}
+
+bool OverlaySearch::Ready(const Options& options,
+                          GraphReader& reader,
+                          const DynamicCost& costing) {
+  if (!customize_in_background_ || reader_config_.empty()) {
+    return true;
+  }
+  auto key = metric_key(options, costing);
+  const auto hash = std::hash<std::string>{}(key);
+  if (shared_->Cached(key, hash)) {
+    return true;
+  }
+  // one customization at a time for all workers, the one that gets to start it owns the thread
+  bool customizing = false;
+  if (!shared_->customizing.compare_exchange_strong(customizing, true)) {
+    return false;
+  }
+  if (shared_->customizer.joinable()) {
+    shared_->customizer.join();
+  }
+
+  // the request goes on with its costing, the customization gets one of its own with the rules of
+  // the pass of the bidirectional searches
+  std::shared_ptr<const DynamicCost> background_costing = [&]() {
+    auto copy = CostFactory().Create(options);
+    copy->set_pass(costing.pass());
+    copy->set_allow_destination_only(costing.pass() > 0);
+    copy->set_allow_conditional_destination(costing.pass() > 0);
+    return copy;
+  }();
+  LOG_INFO("Customizing the partition overlay for " + Costing_Enum_Name(options.costing_type()) +
+           " in the background");
+  // the worker may be gone before the customization is done, the shared state waits for it
+  shared_->customizer =
+      std::thread([shared = shared_.get(), reader_config = reader_config_,
+                   concurrency = concurrency_, key = std::move(key), hash,
+                   background_costing]() mutable {
+        try {
+          GraphReader background_reader(reader_config);
+          shared->Cache(std::move(key), hash,
+                        OverlayMetric::Customize(*shared->overlay, background_reader,
+                                                 *background_costing, concurrency));
+        } catch (const std::exception& e) {
+          LOG_ERROR(std::string("Customizing the partition overlay failed: ") + e.what());
+        }
+        shared->customizing = false;
+      });
+  return false;
+}
+
+std::shared_ptr<const OverlayMetric> OverlaySearch::Metric(const Options& options,
+                                                           GraphReader& reader,
+                                                           const DynamicCost& costing) {
+  auto key = metric_key(options, costing);
+  const auto hash = std::hash<std::string>{}(key);
+  auto metric = shared_->Cached(key, hash);
+  if (metric) {
+    return metric;
+  }
+
+  LOG_INFO("Customizing the partition overlay for " + Costing_Enum_Name(options.costing_type()));
+  metric = OverlayMetric::Customize(*overlay_, reader, costing, concurrency_);
+  shared_->Cache(std::move(key), hash, metric);
+  return metric;
+}
+
+std::shared_ptr<const OverlayMetric> OverlaySearch::shared_t::Cached(const std::string& key,
+                                                                     const size_t hash) {
+  std::lock_guard<std::mutex> lock(metrics_mutex);
+  for (auto cached = metrics.begin(); cached != metrics.end(); ++cached) {
+    if (cached->hash == hash && cached->key == key) {
+      metrics.splice(metrics.begin(), metrics, cached);
+      return metrics.front().metric;
+    }
+  }
+  return nullptr;
+}
+
+void OverlaySearch::shared_t::Cache(std::string key,
+                                    const size_t hash,
+                                    std::shared_ptr<const OverlayMetric> metric) {
+  std::lock_guard<std::mutex> lock(metrics_mutex);
+  // another worker may have customized the same options in the meantime
+  for (const auto& cached : metrics) {
+    if (cached.hash == hash && cached.key == key) {
+      return;
+    }
+  }
+  metrics.push_front({hash, std::move(key), std::move(metric)});
+  while (metrics.size() > max_cached_metrics) {
+    metrics.pop_back();
+  }
+}
+
+std::vector<overlay_seed_t> OverlaySearch::Seeds(GraphReader& reader,
+                                                 const DynamicCost& costing,
+                                                 const OverlayMetric& metric,
+                                                 const valhalla::Location& location,
+                                                 const bool forward) const {
+  // like the regular searches, skip the edges that only touch a node snapped location if there
+  // are others, so origins leave on the outbound edges and destinations are reached on inbound ones
+  const auto& edges = location.correlation().edges();
+  const bool has_other_edges = std::any_of(edges.begin(), edges.end(), [forward](const auto& e) {
+    return forward ? !e.end_node() : !e.begin_node();
+  });
+
+  std::vector<overlay_seed_t> seeds;
+  for (const auto& edge : edges) {
+    if (has_other_edges && (forward ? edge.end_node() : edge.begin_node())) {
+      continue;
+    }
+    const GraphId edgeid(edge.graph_id());
+    const float percent_along = edge.percent_along();
+    if (forward ? costing.AvoidAsOriginEdge(edgeid, percent_along)
+                : costing.AvoidAsDestinationEdge(edgeid, percent_along)) {
+      continue;
+    }
+    const auto node = overlay_->node(edgeid);
+    graph_tile_ptr tile = reader.GetGraphTile(edgeid);
+    if (node == kInvalidOverlayNode || !metric.node(node).reachable() || !tile) {
+      continue;
+    }
+
+    // the part of the edge after the origin or before the destination and a penalty for the
+    // distance to the input location, as the regular searches do
+    const auto* directededge = tile->directededge(edgeid);
+    uint8_t flow_sources;
+    Cost cost = costing.PartialEdgeCost(directededge, edgeid, tile, TimeInfo::invalid(),
+                                        flow_sources, forward ? percent_along : 0.f,
+                                        forward ? 1.f : percent_along);
+    cost.cost += edge.distance();
+    overlay_cost_t seed{cost.cost, cost.secs,
+                        directededge->length() * (forward ? 1.f - percent_along : percent_along)};
+
+    // the arcs into the destination's node include all of its edge, take back what is not driven
+    if (!forward) {
+      const auto& full = metric.node(node);
+      seed = {seed.cost - full.cost, seed.secs - full.secs, seed.length - full.length};
+    }
+    seeds.push_back({node, percent_along, seed});
+  }
+  return seeds;
+}
+
+void OverlaySearch::Pin(const std::vector<overlay_seed_t>& seeds) {
+  pinned_.resize(overlay_->levels());
+  for (uint32_t level = 0; level < overlay_->levels(); ++level) {
+    auto& cells = pinned_[level];
+    for (const auto& seed : seeds) {
+      cells.push_back(overlay_->cell(level, seed.node));
+    }
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+  }
+}
+
+uint32_t OverlaySearch::QueryLevel(const uint32_t node) const {
+  for (uint32_t level = overlay_->levels(); level > 0; --level) {
+    const auto& cells = pinned_[level - 1];
+    if (!std::binary_search(cells.begin(), cells.end(), overlay_->cell(level - 1, node))) {
+      return level;
+    }
+  }
+  return 0;
+}
+
+bool OverlaySearch::Pop(direction_t& direction, uint32_t& node, label_t& label) {
+  auto& queue = direction.queue;
+  while (!queue.empty()) {
+    std::pop_heap(queue.begin(), queue.end(), later);
+    const auto [cost, popped] = queue.back();
+    queue.pop_back();
+    const auto& current = direction.labels.find(popped)->second;
+    if (cost <= current.cost.cost) {
+      node = popped;
+      label = current;
+      return true;
+    }
+  }
+  return false;
+}
+
+template <bool forward, typename relax_t>
+void OverlaySearch::Expand(const OverlayMetric& metric,
+                           const uint32_t node,
+                           const label_t& label,
+                           const relax_t& relax) {
+  // along an arc of the regular graph, the edge it leads to is part of its cost
+  auto arc = [&](const uint32_t tail, const uint64_t index, const uint32_t head) {
+    const auto& transition = metric.arc(index);
+    const auto& edge = metric.node(head);
+    if (transition.reachable() && edge.reachable()) {
+      relax(forward ? head : tail, label.cost + transition + edge, int8_t(-1));
+    }
+  };
+
+  const auto query_level = QueryLevel(node);
+  if (query_level == 0) {
+    if (forward) {
+      for (auto a = overlay_->arcs_begin(node); a < overlay_->arcs_end(node); ++a) {
+        arc(node, a, overlay_->arc(a).node);
+      }
+    } else {
+      for (const auto& reverse : overlay_->reverse_arcs(node)) {
+        arc(reverse.node, reverse.arc, node);
+      }
+    }
+    return;
+  }
+
+  // across the cell from an entry to its exits or the other way, and out of the cell
+  const uint32_t level = query_level - 1;
+  const auto cell = overlay_->cell(level, node);
+  const auto entry = overlay_->entry_index(level, node);
+  const auto exit = overlay_->exit_index(level, node);
+  if (forward ? entry != kInvalidOverlayNode : exit != kInvalidOverlayNode) {
+    const auto others = forward ? overlay_->exits(level, cell) : overlay_->entries(level, cell);
+    for (uint32_t i = 0; i < others.size(); ++i) {
+      const auto& through =
+          forward ? metric.clique(level, cell, entry, i) : metric.clique(level, cell, i, exit);
+      if (through.reachable()) {
+        relax(others[i], label.cost + through, static_cast<int8_t>(level));
+      }
+    }
+  }
+  if (forward ? exit != kInvalidOverlayNode : entry != kInvalidOverlayNode) {
+    if (forward) {
+      for (auto a = overlay_->arcs_begin(node); a < overlay_->arcs_end(node); ++a) {
+        const auto head = overlay_->arc(a).node;
+        if (overlay_->cell(level, head) != cell) {
+          arc(node, a, head);
+        }
+      }
+    } else {
+      for (const auto& reverse : overlay_->reverse_arcs(node)) {
+        if (overlay_->cell(level, reverse.node) != cell) {
+          arc(reverse.node, reverse.arc, node);
+        }
+      }
+    }
+  }
+}
+
+void OverlaySearch::Unpack(const OverlayMetric& metric,
+                           const uint32_t level,
+                           const uint32_t from,
+                           const uint32_t to,
+                           std::vector<uint32_t>& nodes) const {
+  OverlayCellSearch search(*overlay_, metric);
+  search.Run(level, from, to);
+  std::vector<std::pair<uint32_t, int8_t>> steps;
+  for (auto node = to; node != from;) {
+    const auto* label = search.label(node);
+    if (!label) {
+      throw std::logic_error("Could not unpack a path through a cell of the partition overlay");
+    }
+    steps.emplace_back(node, label->level);
+    node = label->pred;
+  }
+
+  auto previous = from;
+  for (auto step = steps.rbegin(); step != steps.rend(); ++step) {
+    if (step->second < 0) {
+      nodes.push_back(step->first);
+    } else {
+      Unpack(metric, step->second, previous, step->first, nodes);
+    }
+    previous = step->first;
+  }
+}
+
+std::vector<GraphId> OverlaySearch::Route(const OverlayMetric& metric,
+                                          const std::vector<overlay_seed_t>& sources,
+                                          const std::vector<overlay_seed_t>& targets) {
+  Clear();
+  auto seeds = sources;
+  seeds.insert(seeds.end(), targets.begin(), targets.end());
+  Pin(seeds);
+
+  float best = kOverlayUnreached;
+  uint32_t meeting = kInvalidOverlayNode;
+  auto relaxer = [&](direction_t& direction, const direction_t& other, const uint32_t pred) {
+    return [&direction, &other, &best, &meeting, pred](const uint32_t node,
+                                                      const overlay_cost_t& cost,
+                                                      const int8_t level) {
+      auto [found, inserted] = direction.labels.try_emplace(node, label_t{cost, pred, level});
+      if (!inserted) {
+        if (cost.cost >= found->second.cost.cost) {
+          return;
+        }
+        found->second = {cost, pred, level};
+      }
+      direction.queue.emplace_back(cost.cost, node);
+      std::push_heap(direction.queue.begin(), direction.queue.end(), later);
+
+      auto connection = other.labels.find(node);
+      if (connection != other.labels.end() && cost.cost + connection->second.cost.cost < best) {
+        best = cost.cost + connection->second.cost.cost;
+        meeting = node;
+      }
+    };
+  };
+  for (const auto& seed : sources) {
+    relaxer(forward_, reverse_, kInvalidOverlayNode)(seed.node, seed.cost, -1);
+  }
+  for (const auto& seed : targets) {
+    relaxer(reverse_, forward_, kInvalidOverlayNode)(seed.node, seed.cost, -1);
+  }
+
+  // expand the cheaper side until the two can't find anything cheaper anymore, once one side has
+  // run out every connection through what it reached is known
+  size_t n = 0;
+  while (!forward_.queue.empty() && !reverse_.queue.empty() &&
+         forward_.queue.front().first + reverse_.queue.front().first < best) {
+    if (interrupt_ && (++n % kInterruptInterval) == 0) {
+      (*interrupt_)();
+    }
+    const bool forward = forward_.queue.front().first <= reverse_.queue.front().first;
+    uint32_t node;
+    label_t label;
+    if (forward) {
+      if (Pop(forward_, node, label)) {
+        Expand<true>(metric, node, label, relaxer(forward_, reverse_, node));
+      }
+    } else if (Pop(reverse_, node, label)) {
+      Expand<false>(metric, node, label, relaxer(reverse_, forward_, node));
+    }
+  }
+  if (meeting == kInvalidOverlayNode ||
+      (forward_.labels.find(meeting)->second.cost + reverse_.labels.find(meeting)->second.cost)
+          .restricted) {
+    return {};
+  }
+
+  // back to the origin and on to the destination, through the cells on the way
+  std::vector<std::pair<uint32_t, int8_t>> steps;
+  auto node = meeting;
+  for (auto label = forward_.labels.find(node)->second; label.pred != kInvalidOverlayNode;
+       label = forward_.labels.find(node)->second) {
+    steps.emplace_back(node, label.level);
+    node = label.pred;
+  }
+  std::vector<uint32_t> nodes{node};
+  for (auto step = steps.rbegin(); step != steps.rend(); ++step) {
+    if (step->second < 0) {
+      nodes.push_back(step->first);
+    } else {
+      Unpack(metric, step->second, nodes.back(), step->first, nodes);
+    }
+  }
+  node = meeting;
+  for (auto label = reverse_.labels.find(node)->second; label.pred != kInvalidOverlayNode;
+       label = reverse_.labels.find(node)->second) {
+    if (label.level < 0) {
+      nodes.push_back(label.pred);
+    } else {
+      Unpack(metric, label.level, node, label.pred, nodes);
+    }
+    node = label.pred;
+  }
+
+  std::vector<GraphId> edges;
+  edges.reserve(nodes.size());
+  for (const auto node : nodes) {
+    edges.push_back(overlay_->edgeid(node));
+  }
+  return edges;
+}
+
+std::vector<overlay_cost_t>
+OverlaySearch::OneToMany(const OverlayMetric& metric,
+                         const std::vector<overlay_seed_t>& source,
+                         const std::vector<std::vector<overlay_seed_t>>& targets) {
+  Clear();
+  auto seeds = source;
+  for (const auto& target : targets) {
+    seeds.insert(seeds.end(), target.begin(), target.end());
+  }
+  Pin(seeds);
+
+  // which targets end at a node and how far they are from reaching it
+  ankerl::unordered_dense::map<uint32_t, std::vector<std::pair<uint32_t, overlay_cost_t>>> ends;
+  std::vector<float> closest(targets.size(), kOverlayUnreached);
+  for (uint32_t t = 0; t < targets.size(); ++t) {
+    for (const auto& seed : targets[t]) {
+      ends[seed.node].emplace_back(t, seed.cost);
+      closest[t] = std::min(closest[t], seed.cost.cost);
+    }
+  }
+
+  std::vector<overlay_cost_t> best(targets.size(), kOverlayUnreachedCost);
+  size_t unfound = targets.size();
+  // once every target is found nothing costs less than this can still improve one of them
+  float bound = kOverlayUnreached;
+  auto update_bound = [&]() {
+    bound = 0;
+    for (uint32_t t = 0; t < targets.size(); ++t) {
+      if (closest[t] != kOverlayUnreached) {
+        bound = std::max(bound, best[t].cost - closest[t]);
+      }
+    }
+  };
+
+  auto relaxer = [this](const uint32_t pred) {
+    return [this, pred](const uint32_t node, const overlay_cost_t& cost, const int8_t level) {
+      auto [found, inserted] = forward_.labels.try_emplace(node, label_t{cost, pred, level});
+      if (!inserted) {
+        if (cost.cost >= found->second.cost.cost) {
+          return;
+        }
+        found->second = {cost, pred, level};
+      }
+      forward_.queue.emplace_back(cost.cost, node);
+      std::push_heap(forward_.queue.begin(), forward_.queue.end(), later);
+    };
+  };
+  for (const auto& seed : source) {
+    relaxer(kInvalidOverlayNode)(seed.node, seed.cost, -1);
+  }
+  for (uint32_t t = 0; t < targets.size(); ++t) {
+    unfound -= targets[t].empty();
+  }
+
+  size_t n = 0;
+  uint32_t node;
+  label_t label;
+  while (Pop(forward_, node, label)) {
+    if (unfound == 0 && label.cost.cost >= bound) {
+      break;
+    }
+    if (interrupt_ && (++n % kInterruptInterval) == 0) {
+      (*interrupt_)();
+    }
+    auto end = ends.find(node);
+    if (end != ends.end()) {
+      bool improved = false;
+      for (const auto& [t, remaining] : end->second) {
+        const auto total = label.cost + remaining;
+        if (total.cost < best[t].cost) {
+          unfound -= !best[t].reachable();
+          best[t] = total;
+          improved = true;
+        }
+      }
+      if (improved && unfound == 0) {
+        update_bound();
+      }
+    }
+    Expand<true>(metric, node, label, relaxer(node));
+  }
+  return best;
+}
+
+void OverlaySearch::Clear() {
+  pinned_.clear();
+  for (auto* direction : {&forward_, &reverse_}) {
+    direction->labels.clear();
+    direction->queue.clear();
+  }
+}
+
+} // namespace thor
+} // namespace valhalla
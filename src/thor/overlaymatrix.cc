@@ -0,0 +1,91 @@
+#include "thor/overlaymatrix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace valhalla::baldr;
+using namespace valhalla::sif;
+
+namespace valhalla {
+namespace thor {
+
+OverlayMatrix::OverlayMatrix(const boost::property_tree::ptree& config, OverlaySearch& overlay)
+    : MatrixAlgorithm(config), overlay_(overlay) {
+}
+
+bool OverlayMatrix::Supports(const Api& request,
+                             GraphReader& graphreader,
+                             const DynamicCost& costing) const {
+  const auto& options = request.options();
+  return !has_time_ && options.shape_format() == no_shape &&
+         options.matrix_locations() == std::numeric_limits<uint32_t>::max() &&
+         overlay_.Supports(graphreader, costing) &&
+         overlay_.Ready(request.options(), graphreader, costing);
+}
+
+bool OverlayMatrix::SourceToTarget(Api& request,
+                                   GraphReader& graphreader,
+                                   const mode_costing_t& mode_costing,
+                                   const travel_mode_t mode,
+                                   const float /*max_matrix_distance*/) {
+  request.mutable_matrix()->set_algorithm(Matrix::Overlay);
+  const auto& options = request.options();
+  // the same rules as the first pass of CostMatrix, which takes over for what is not found
+  const auto& costing = mode_costing[static_cast<uint32_t>(mode)];
+  costing->set_allow_destination_only(false);
+  costing->set_pass(0);
+  overlay_.set_interrupt(interrupt_);
+  const auto metric = overlay_.Metric(options, graphreader, *costing);
+
+  const auto& sources = options.sources();
+  const auto& targets = options.targets();
+  std::vector<std::vector<overlay_seed_t>> target_seeds;
+  target_seeds.reserve(targets.size());
+  for (const auto& target : targets) {
+    target_seeds.push_back(overlay_.Seeds(graphreader, *costing, *metric, target, false));
+  }
+
+  valhalla::Matrix& matrix = *request.mutable_matrix();
+  reserve_pbf_arrays(matrix, sources.size() * targets.size(), options.verbose());
+  bool found_all = true;
+  for (uint32_t source = 0; source < static_cast<uint32_t>(sources.size()); ++source) {
+    const auto source_seeds =
+        overlay_.Seeds(graphreader, *costing, *metric, sources.Get(source), true);
+    const auto best = overlay_.OneToMany(*metric, source_seeds, target_seeds);
+
+    for (uint32_t target = 0; target < static_cast<uint32_t>(targets.size()); ++target) {
+      // both on the same edge only connects directly if the target is ahead of the source,
+      // otherwise the loop back onto the edge is left to CostMatrix, as is a path that might break
+      // a complex restriction
+      bool supported = true;
+      for (const auto& source_seed : source_seeds) {
+        for (const auto& target_seed : target_seeds[target]) {
+          supported = supported && (source_seed.node != target_seed.node ||
+                                    source_seed.percent_along <= target_seed.percent_along);
+        }
+      }
+      const auto idx = source * targets.size() + target;
+      const auto& result = best[target];
+      const bool found = result.reachable() && supported && !result.restricted;
+      found_all = found_all && found;
+      matrix.mutable_from_indices()->Set(idx, source);
+      matrix.mutable_to_indices()->Set(idx, target);
+      matrix.mutable_distances()->Set(idx, found ? static_cast<uint32_t>(std::round(
+                                                       std::max(result.length, 0.f)))
+                                                 : static_cast<uint32_t>(kMaxCost));
+      matrix.mutable_times()->Set(idx, found ? std::max(result.secs, 0.f) : kMaxCost);
+    }
+    if (interrupt_) {
+      (*interrupt_)();
+    }
+  }
+  return found_all;
+}
+
+void OverlayMatrix::Clear() {
+  overlay_.Clear();
+}
+
+} // namespace thor
+} // namespace valhalla
@@ -0,0 +1,215 @@
+#include "thor/phast.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define VALHALLA_PHAST_AVX
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace valhalla::baldr;
+
+namespace {
+
+// how many nodes the sweep passes between checking for an interrupt
+constexpr uint32_t kInterruptInterval = 1 << 16;
+
+// relaxes the arcs coming down into every node from the highest ranked to the lowest, all lanes
+// of a node are kept in locals while its arcs are relaxed. the lanes an arc makes better take its
+// restricted bits, all of them if the arc itself is restricted
+template <typename arc_t>
+void sweep_scalar(valhalla::thor::phast_label_t* labels,
+                  uint8_t* restricted,
+                  const uint64_t* offsets,
+                  const arc_t* arcs,
+                  uint32_t begin,
+                  uint32_t end) {
+  using valhalla::thor::kPhastLanes;
+  for (uint32_t position = begin; position < end; ++position) {
+    auto& to = labels[position];
+    float cost[kPhastLanes], secs[kPhastLanes], length[kPhastLanes];
+    std::copy_n(to.cost, kPhastLanes, cost);
+    std::copy_n(to.secs, kPhastLanes, secs);
+    std::copy_n(to.length, kPhastLanes, length);
+    uint8_t mask = restricted[position];
+    for (auto a = offsets[position]; a < offsets[position + 1]; ++a) {
+      const auto& arc = arcs[a];
+      const auto& from = labels[arc.node];
+      uint8_t better_mask = 0;
+      for (uint32_t lane = 0; lane < kPhastLanes; ++lane) {
+        const float c = from.cost[lane] + arc.cost;
+        const bool better = c < cost[lane];
+        cost[lane] = better ? c : cost[lane];
+        secs[lane] = better ? from.secs[lane] + arc.secs : secs[lane];
+        length[lane] = better ? from.length[lane] + arc.length : length[lane];
+        better_mask |= better << lane;
+      }
+      const uint8_t from_mask = arc.restricted ? 0xff : restricted[arc.node];
+      mask = (mask & ~better_mask) | (from_mask & better_mask);
+    }
+    std::copy_n(cost, kPhastLanes, to.cost);
+    std::copy_n(secs, kPhastLanes, to.secs);
+    std::copy_n(length, kPhastLanes, to.length);
+    restricted[position] = mask;
+  }
+}
+
+#ifdef VALHALLA_PHAST_AVX
+static_assert(valhalla::thor::kPhastLanes == 8, "the avx sweep has all lanes in one register");
+
+// same as above with the 8 lanes in one register. the same additions and comparisons in the same
+// order so the results match the scalar sweep exactly
+template <typename arc_t>
+__attribute__((target("avx"))) void sweep_avx(valhalla::thor::phast_label_t* labels,
+                                              uint8_t* restricted,
+                                              const uint64_t* offsets,
+                                              const arc_t* arcs,
+                                              uint32_t begin,
+                                              uint32_t end) {
+  for (uint32_t position = begin; position < end; ++position) {
+    auto& to = labels[position];
+    __m256 cost = _mm256_load_ps(to.cost);
+    __m256 secs = _mm256_load_ps(to.secs);
+    __m256 length = _mm256_load_ps(to.length);
+    uint8_t mask = restricted[position];
+    for (auto a = offsets[position]; a < offsets[position + 1]; ++a) {
+      const auto& arc = arcs[a];
+      const auto& from = labels[arc.node];
+      const __m256 c = _mm256_add_ps(_mm256_load_ps(from.cost), _mm256_set1_ps(arc.cost));
+      const __m256 better = _mm256_cmp_ps(c, cost, _CMP_LT_OQ);
+      cost = _mm256_blendv_ps(cost, c, better);
+      const __m256 s = _mm256_add_ps(_mm256_load_ps(from.secs), _mm256_set1_ps(arc.secs));
+      const __m256 l = _mm256_add_ps(_mm256_load_ps(from.length), _mm256_set1_ps(arc.length));
+      secs = _mm256_blendv_ps(secs, s, better);
+      length = _mm256_blendv_ps(length, l, better);
+      const auto better_mask = static_cast<uint8_t>(_mm256_movemask_ps(better));
+      const uint8_t from_mask = arc.restricted ? 0xff : restricted[arc.node];
+      mask = (mask & ~better_mask) | (from_mask & better_mask);
+    }
+    _mm256_store_ps(to.cost, cost);
+    _mm256_store_ps(to.secs, secs);
+    _mm256_store_ps(to.length, length);
+    restricted[position] = mask;
+  }
+}
+
+bool has_avx() {
+  static const bool avx = __builtin_cpu_supports("avx");
+  return avx;
+}
+#endif
+
+} // namespace
+
+namespace valhalla {
+namespace thor {
+
+PhastSweep::PhastSweep(const ContractionHierarchy& hierarchy) : position_(hierarchy.size()) {
+  for (uint32_t rank = 0; rank < hierarchy.size(); ++rank) {
+    position_[hierarchy.ranked(rank)] = rank;
+  }
+
+  // the arcs of a position point at the positions of the higher ranked nodes, which all come
+  // before it so the sweep only ever reads labels it is done with
+  auto lay_out = [&](arcs_t& out, const bool forward) {
+    out.offsets.reserve(hierarchy.size() + 1);
+    for (uint32_t rank = 0; rank < hierarchy.size(); ++rank) {
+      out.offsets.push_back(out.arcs.size());
+      const auto node = hierarchy.ranked(rank);
+      const auto* arc = forward ? hierarchy.forward_begin(node) : hierarchy.backward_begin(node);
+      const auto* end = forward ? hierarchy.forward_end(node) : hierarchy.backward_end(node);
+      for (; arc != end; ++arc) {
+        out.arcs.push_back({position_[arc->node], arc->restricted, arc->cost, arc->secs,
+                            static_cast<float>(arc->length)});
+      }
+    }
+    out.offsets.push_back(out.arcs.size());
+  };
+  lay_out(forward_, true);
+  lay_out(backward_, false);
+}
+
+void PhastSweep::Run(const std::vector<std::vector<phast_seed_t>>& seeds,
+                     const bool forward,
+                     std::vector<phast_label_t>& labels,
+                     std::vector<uint8_t>& restricted,
+                     const std::function<void()>* interrupt) const {
+  if (seeds.size() > kPhastLanes) {
+    throw std::logic_error("A sweep has room for " + std::to_string(kPhastLanes) + " locations");
+  }
+  const uint32_t size = static_cast<uint32_t>(position_.size());
+  labels.resize(size);
+  phast_label_t unreached;
+  std::fill_n(unreached.cost, kPhastLanes, kPhastUnreached);
+  std::fill_n(unreached.secs, kPhastLanes, 0.f);
+  std::fill_n(unreached.length, kPhastLanes, 0.f);
+  std::fill(labels.begin(), labels.end(), unreached);
+  restricted.assign(size, 0);
+
+  // the upward search of every lane, the labels it leaves are exact for the nodes it settles
+  // and an upper bound for the others which the sweep then lowers
+  const auto& up = forward ? forward_ : backward_;
+  std::vector<std::pair<float, uint32_t>> queue;
+  const auto later = [](const auto& a, const auto& b) { return a.first > b.first; };
+  for (uint32_t lane = 0; lane < seeds.size(); ++lane) {
+    const uint8_t bit = 1 << lane;
+    const auto push = [&](const uint32_t position, const float cost, const float secs,
+                          const float length, const bool is_restricted) {
+      auto& label = labels[position];
+      if (cost >= label.cost[lane]) {
+        return;
+      }
+      label.cost[lane] = cost;
+      label.secs[lane] = secs;
+      label.length[lane] = length;
+      restricted[position] = is_restricted ? restricted[position] | bit : restricted[position] & ~bit;
+      queue.emplace_back(cost, position);
+      std::push_heap(queue.begin(), queue.end(), later);
+    };
+    for (const auto& seed : seeds[lane]) {
+      push(position_[seed.node], seed.cost, seed.secs, seed.length, false);
+    }
+    while (!queue.empty()) {
+      std::pop_heap(queue.begin(), queue.end(), later);
+      const auto [cost, position] = queue.back();
+      queue.pop_back();
+      const auto& label = labels[position];
+      if (cost > label.cost[lane]) {
+        continue;
+      }
+      const float secs = label.secs[lane], length = label.length[lane];
+      const bool is_restricted = restricted[position] & bit;
+      for (auto a = up.offsets[position]; a < up.offsets[position + 1]; ++a) {
+        const auto& arc = up.arcs[a];
+        push(arc.node, cost + arc.cost, secs + arc.secs, length + arc.length,
+             is_restricted || arc.restricted);
+      }
+    }
+  }
+
+  // the arcs coming down into a node are those going up from it in the other direction
+  const auto& down = forward ? backward_ : forward_;
+  for (uint32_t begin = 0; begin < size; begin += kInterruptInterval) {
+    const auto end = std::min(size, begin + kInterruptInterval);
+#ifdef VALHALLA_PHAST_AVX
+    if (has_avx()) {
+      sweep_avx(labels.data(), restricted.data(), down.offsets.data(), down.arcs.data(), begin,
+                end);
+    } else {
+      sweep_scalar(labels.data(), restricted.data(), down.offsets.data(), down.arcs.data(), begin,
+                   end);
+    }
+#else
+    sweep_scalar(labels.data(), restricted.data(), down.offsets.data(), down.arcs.data(), begin,
+                 end);
+#endif
+    if (interrupt) {
+      (*interrupt)();
+    }
+  }
+}
+
+} // namespace thor
+} // namespace valhalla
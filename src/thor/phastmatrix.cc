@@ -0,0 +1,200 @@
+#include "thor/phastmatrix.h"
+#include "midgard/logging.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace valhalla::baldr;
+using namespace valhalla::sif;
+
+namespace valhalla {
+namespace thor {
+
+PhastMatrix::PhastMatrix(const boost::property_tree::ptree& config, const CHMatrix& other)
+    : CHMatrix(config, other), min_locations_(config.get<uint32_t>("phast.min_locations", 2000)),
+      sweep_(nullptr) {
+}
+
+bool PhastMatrix::Supports(const Api& request,
+                           GraphReader& graphreader,
+                           const DynamicCost& costing) const {
+  const auto& options = request.options();
+  const auto locations =
+      static_cast<uint32_t>(std::max(options.sources().size(), options.targets().size()));
+  return min_locations_ > 0 && locations >= min_locations_ &&
+         CHMatrix::Supports(request, graphreader, costing);
+}
+
+void PhastMatrix::Prepare(const Options& options,
+                          const mode_costing_t& mode_costing,
+                          const travel_mode_t mode) {
+  hierarchy_ = hierarchies_.at(options.costing_type()).get();
+  costing_ = mode_costing[static_cast<uint32_t>(mode)];
+  auto& sweep = sweeps_[options.costing_type()];
+  if (!sweep) {
+    LOG_INFO("Laying out the contraction hierarchy for " + Costing_Enum_Name(options.costing_type()) +
+             " to sweep it");
+    sweep = std::make_unique<PhastSweep>(*hierarchy_);
+  }
+  sweep_ = sweep.get();
+}
+
+void PhastMatrix::Clear() {
+  CHMatrix::Clear();
+  sweep_ = nullptr;
+  if (clear_reserved_memory_) {
+    labels_ = {};
+    restricted_ = {};
+  }
+}
+
+bool PhastMatrix::SourceToTarget(Api& request,
+                                 GraphReader& graphreader,
+                                 const mode_costing_t& mode_costing,
+                                 const travel_mode_t mode,
+                                 const float /*max_matrix_distance*/) {
+  request.mutable_matrix()->set_algorithm(Matrix::Phast);
+  const auto& options = request.options();
+  Prepare(options, mode_costing, mode);
+
+  const auto& sources = options.sources();
+  const auto& targets = options.targets();
+  const auto source_edges = CorrelatedEdges(sources);
+  const auto target_edges = CorrelatedEdges(targets);
+
+  // sweep for the smaller side, the other side reads the costs off the nodes of its seeds
+  const bool forward = sources.size() <= targets.size();
+  const auto& origins = forward ? sources : targets;
+  const auto& others = forward ? targets : sources;
+  std::vector<std::vector<seed_t>> other_seeds;
+  other_seeds.reserve(others.size());
+  for (const auto& location : others) {
+    other_seeds.push_back(
+        Seeds(graphreader, location, forward ? source_edges : target_edges, !forward));
+  }
+
+  valhalla::Matrix& matrix = *request.mutable_matrix();
+  reserve_pbf_arrays(matrix, sources.size() * targets.size(), options.verbose());
+  bool found_all = true;
+  std::vector<std::vector<seed_t>> origin_seeds;
+  std::vector<std::vector<phast_seed_t>> lanes;
+  for (uint32_t first = 0; first < static_cast<uint32_t>(origins.size()); first += kPhastLanes) {
+    const auto count = std::min(kPhastLanes, static_cast<uint32_t>(origins.size()) - first);
+    origin_seeds.clear();
+    lanes.clear();
+    for (uint32_t lane = 0; lane < count; ++lane) {
+      origin_seeds.push_back(Seeds(graphreader, origins.Get(first + lane),
+                                   forward ? target_edges : source_edges, forward));
+      auto& seeds = lanes.emplace_back();
+      for (const auto& seed : origin_seeds.back()) {
+        seeds.push_back({seed.node, seed.label.cost, seed.label.secs, seed.label.length});
+      }
+    }
+    sweep_->Run(lanes, forward, labels_, restricted_, interrupt_);
+
+    for (uint32_t other = 0; other < static_cast<uint32_t>(others.size()); ++other) {
+      for (uint32_t lane = 0; lane < count; ++lane) {
+        search_label_t best{kPhastUnreached, 0, 0, false};
+        bool unsupported = false;
+        for (const auto& seed : other_seeds[other]) {
+          const auto position = sweep_->position(seed.node);
+          const auto& label = labels_[position];
+          if (label.cost[lane] == kPhastUnreached) {
+            continue;
+          }
+          // both on the same edge only connects directly if the target is ahead of the source,
+          // otherwise it takes a loop back onto the edge which the hierarchy does not keep
+          const auto& seeds = origin_seeds[lane];
+          auto origin_seed = std::find_if(seeds.begin(), seeds.end(),
+                                          [&seed](const seed_t& s) { return s.node == seed.node; });
+          if (origin_seed != seeds.end() &&
+              (forward ? origin_seed->percent_along > seed.percent_along
+                       : seed.percent_along > origin_seed->percent_along)) {
+            unsupported = true;
+            continue;
+          }
+          const float cost = label.cost[lane] + seed.label.cost;
+          if (cost < best.cost) {
+            best = {cost, label.secs[lane] + seed.label.secs, label.length[lane] + seed.label.length,
+                    ((restricted_[position] >> lane) & 1) != 0};
+          }
+        }
+
+        const auto source = forward ? first + lane : other;
+        const auto target = forward ? other : first + lane;
+        const auto idx = source * targets.size() + target;
+        // like the chmatrix a path that might break a complex restriction is left to the others
+        const bool found = best.cost != kPhastUnreached && !unsupported && !best.restricted;
+        found_all = found_all && found;
+        matrix.mutable_from_indices()->Set(idx, source);
+        matrix.mutable_to_indices()->Set(idx, target);
+        matrix.mutable_distances()->Set(idx, found ? static_cast<uint32_t>(std::round(
+                                                         std::max(best.length, 0.f)))
+                                                   : static_cast<uint32_t>(kMaxCost));
+        matrix.mutable_times()->Set(idx, found ? std::max(best.secs, 0.f) : kMaxCost);
+      }
+    }
+  }
+  return found_all;
+}
+
+bool PhastMatrix::Accessibility(Api& request,
+                                GraphReader& graphreader,
+                                const mode_costing_t& mode_costing,
+                                const travel_mode_t mode) {
+  const auto& options = request.options();
+  const bool has_time =
+      std::any_of(options.locations().begin(), options.locations().end(),
+                  [](const valhalla::Location& location) { return !location.date_time().empty(); });
+  if (has_time || !HasHierarchy(options)) {
+    return false;
+  }
+  Prepare(options, mode_costing, mode);
+
+  // all locations start in the same lane like the isochrone expands from all of them at once
+  const bool forward = !options.reverse();
+  std::vector<std::vector<phast_seed_t>> lanes(1);
+  for (const auto& location : options.locations()) {
+    for (const auto& seed : Seeds(graphreader, location, {}, forward)) {
+      lanes.front().push_back({seed.node, seed.label.cost, seed.label.secs, seed.label.length});
+    }
+  }
+  sweep_->Run(lanes, forward, labels_, restricted_, interrupt_);
+
+  auto& isochrone = *request.mutable_isochrone();
+  for (const auto& contour : options.contours()) {
+    for (const bool time : {true, false}) {
+      if (time ? !contour.has_time_case() : !contour.has_distance_case()) {
+        continue;
+      }
+      // the contours are in minutes and kilometers
+      const float limit = time ? contour.time() * 60.f : contour.distance() * 1000.f;
+      uint32_t edges = 0;
+      double length = 0;
+      for (uint32_t position = 0; position < static_cast<uint32_t>(labels_.size()); ++position) {
+        const auto& label = labels_[position];
+        if (label.cost[0] == kPhastUnreached) {
+          continue;
+        }
+        // backward labels start at the end of the edge, the whole edge has to be traversed
+        const auto& edge = hierarchy_->cost(hierarchy_->ranked(position));
+        const float value = time ? label.secs[0] + (forward ? 0.f : edge.secs)
+                                 : label.length[0] + (forward ? 0.f : edge.length);
+        if (value <= limit) {
+          ++edges;
+          length += edge.length;
+        }
+      }
+
+      auto* accessibility = isochrone.add_accessibility();
+      accessibility->set_metric(time ? Isochrone::time : Isochrone::distance);
+      accessibility->set_metric_value(time ? contour.time() : contour.distance());
+      accessibility->set_edges(edges);
+      accessibility->set_length(length / 1000.);
+    }
+  }
+  return true;
+}
+
+} // namespace thor
+} // namespace valhalla
@@ -0,0 +1,732 @@
+#include "thor/raptor.h"
+#include "baldr/datetime.h"
+#include "baldr/tilehierarchy.h"
+#include "midgard/distanceapproximator.h"
+#include "midgard/logging.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+
+using namespace valhalla::baldr;
+using namespace valhalla::midgard;
+using namespace valhalla::sif;
+
+namespace {
+
+constexpr uint32_t kNoTime = std::numeric_limits<uint32_t>::max();
+
+// the seconds to change trips without leaving the platform, like the in-station transfer of
+// MultiModalPathAlgorithm
+constexpr uint32_t kSamePlatformTransferTime = 30;
+
+// the transit tiles are read this far around the origin and destination at least, in meters
+constexpr double kMinTileMargin = 10000.;
+
+// a ride of a trip from one stop to the next
+struct hop_t {
+  uint32_t departure;
+  uint32_t arrival;
+  GraphId edge;
+  GraphId from;
+  GraphId to;
+  const TransitDeparture* departure_info;
+  uint32_t shift;
+};
+
+// whether the trip never leaves or arrives before the other one along the same edges
+bool runs_after(const std::vector<hop_t>& trip, const std::vector<hop_t>& other) {
+  for (size_t i = 0; i < trip.size(); ++i) {
+    if (trip[i].departure < other[i].departure || trip[i].arrival < other[i].arrival) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+namespace valhalla {
+namespace thor {
+
+std::shared_ptr<const TransitTimetable>
+TransitTimetable::Build(GraphReader& reader,
+                        const std::vector<GraphId>& tile_ids,
+                        const uint32_t date,
+                        const uint32_t dow,
+                        const bool wheelchair,
+                        const bool bicycle) {
+  auto timetable = std::make_shared<TransitTimetable>();
+
+  // the hops of every trip running on the date, keyed by trip id and instance of its frequency
+  std::unordered_map<uint64_t, std::vector<hop_t>> trip_hops;
+  for (const auto& tile_id : tile_ids) {
+    auto tile = reader.GetGraphTile(tile_id);
+    if (!tile || tile->header()->departurecount() == 0) {
+      continue;
+    }
+    timetable->tiles.push_back(tile);
+    const bool date_before_tile = date < tile->header()->date_created();
+    const uint32_t day = date_before_tile ? 0 : date - tile->header()->date_created();
+
+    // the transit edge and the platform it leaves of each line
+    std::unordered_map<uint32_t, std::pair<GraphId, GraphId>> lines;
+    GraphId node_id(tile_id.tileid(), tile_id.level(), 0);
+    for (const auto& node : tile->GetNodes()) {
+      if (node.type() == NodeType::kMultiUseTransitPlatform) {
+        GraphId edge_id(tile_id.tileid(), tile_id.level(), node.edge_index());
+        for (const auto& edge : tile->GetDirectedEdges(&node)) {
+          if (edge.IsTransitLine()) {
+            lines.emplace(edge.lineid(), std::make_pair(edge_id, node_id));
+          }
+          ++edge_id;
+        }
+      }
+      ++node_id;
+    }
+
+    const auto active_schedules = tile->GetActiveSchedules(day, dow, date_before_tile);
+    for (const auto& departure : tile->GetDepartures()) {
+      if ((wheelchair && !departure.wheelchair_accessible()) ||
+          (bicycle && !departure.bicycle_accessible()) ||
+          !active_schedules[departure.schedule_index()]) {
+        continue;
+      }
+      const auto line = lines.find(departure.lineid());
+      if (line == lines.end()) {
+        continue;
+      }
+      const auto& [edge_id, platform] = line->second;
+      const GraphId to = tile->directededge(edge_id)->endnode();
+      const uint64_t trip_key = static_cast<uint64_t>(departure.tripid()) << 32;
+      if (departure.type() == kFixedSchedule) {
+        trip_hops[trip_key].push_back({departure.departure_time(),
+                                       departure.departure_time() + departure.elapsed_time(),
+                                       edge_id, platform, to, &departure, 0});
+        continue;
+      }
+      // every departure of a frequency is a trip of its own, the nth ones of each edge line up
+      uint32_t instance = 0;
+      for (uint32_t time = departure.departure_time(); time <= departure.end_time();
+           time += departure.frequency()) {
+        trip_hops[trip_key | ++instance].push_back({time, time + departure.elapsed_time(), edge_id,
+                                                    platform, to, &departure,
+                                                    time - departure.departure_time()});
+        if (departure.frequency() == 0) {
+          break;
+        }
+      }
+    }
+  }
+
+  // the trips along the same transit edges form a pattern, broken trips are split where they jump
+  std::map<std::vector<uint64_t>, std::vector<std::vector<hop_t>>> patterns;
+  for (auto& [key, hops] : trip_hops) {
+    std::sort(hops.begin(), hops.end(),
+              [](const hop_t& a, const hop_t& b) { return a.departure < b.departure; });
+    size_t begin = 0;
+    for (size_t i = 1; i <= hops.size(); ++i) {
+      if (i < hops.size() && hops[i].from == hops[i - 1].to &&
+          hops[i].departure >= hops[i - 1].arrival) {
+        continue;
+      }
+      std::vector<uint64_t> edges;
+      for (size_t h = begin; h < i; ++h) {
+        edges.push_back(hops[h].edge.value);
+      }
+      patterns[edges].emplace_back(hops.begin() + begin, hops.begin() + i);
+      begin = i;
+    }
+  }
+
+  auto stop_of = [&timetable](const GraphId& platform) {
+    auto inserted = timetable->stop_index.emplace(platform, timetable->stops.size());
+    if (inserted.second) {
+      timetable->stops.push_back(platform);
+    }
+    return inserted.first->second;
+  };
+
+  // a route holds the trips of a pattern that do not overtake each other
+  for (auto& [edges, trips] : patterns) {
+    std::sort(trips.begin(), trips.end(), [](const auto& a, const auto& b) {
+      return a.front().departure < b.front().departure;
+    });
+    std::vector<std::vector<const std::vector<hop_t>*>> routes;
+    for (const auto& trip : trips) {
+      auto route = std::find_if(routes.begin(), routes.end(), [&trip](const auto& route) {
+        return runs_after(trip, *route.back());
+      });
+      if (route == routes.end()) {
+        routes.emplace_back();
+        route = std::prev(routes.end());
+      }
+      route->push_back(&trip);
+    }
+
+    for (const auto& route : routes) {
+      const auto& first = *route.front();
+      timetable->routes.push_back({static_cast<uint32_t>(timetable->route_stops.size()),
+                                   static_cast<uint32_t>(first.size() + 1),
+                                   static_cast<uint32_t>(timetable->trips.size()),
+                                   static_cast<uint32_t>(route.size())});
+      timetable->route_stops.push_back(stop_of(first.front().from));
+      for (const auto& hop : first) {
+        timetable->route_edges.push_back(hop.edge);
+        timetable->route_stops.push_back(stop_of(hop.to));
+      }
+      timetable->route_edges.emplace_back();
+
+      for (const auto* trip : route) {
+        const auto& hops = *trip;
+        timetable->trips.push_back({hops.front().departure_info->tripid(),
+                                    static_cast<uint32_t>(timetable->stop_times.size()),
+                                    hops.front().shift});
+        timetable->stop_times.push_back({hops.front().departure, hops.front().departure});
+        timetable->departures.push_back(hops.front().departure_info);
+        for (size_t i = 1; i < hops.size(); ++i) {
+          timetable->stop_times.push_back({hops[i - 1].arrival, hops[i].departure});
+          timetable->departures.push_back(hops[i].departure_info);
+        }
+        timetable->stop_times.push_back({hops.back().arrival, hops.back().arrival});
+        timetable->departures.push_back(nullptr);
+      }
+    }
+  }
+
+  // the routes a stop can be boarded at, the last stop of a route is left out
+  const uint32_t stop_count = timetable->stops.size();
+  timetable->stop_routes_begin.assign(stop_count + 1, 0);
+  for (const auto& route : timetable->routes) {
+    for (uint32_t i = 0; i + 1 < route.stop_count; ++i) {
+      ++timetable->stop_routes_begin[timetable->route_stops[route.first_stop + i] + 1];
+    }
+  }
+  for (uint32_t s = 0; s < stop_count; ++s) {
+    timetable->stop_routes_begin[s + 1] += timetable->stop_routes_begin[s];
+  }
+  timetable->stop_routes.resize(timetable->stop_routes_begin.back());
+  auto next = timetable->stop_routes_begin;
+  for (uint32_t r = 0; r < timetable->routes.size(); ++r) {
+    const auto& route = timetable->routes[r];
+    for (uint32_t i = 0; i + 1 < route.stop_count; ++i) {
+      timetable->stop_routes[next[timetable->route_stops[route.first_stop + i]]++] = {r, i};
+    }
+  }
+
+  // the platforms of the same station are a transfer apart
+  timetable->transfers_begin.reserve(stop_count + 1);
+  graph_tile_ptr tile;
+  for (const auto& platform : timetable->stops) {
+    timetable->transfers_begin.push_back(timetable->transfers.size());
+    const auto* node = reader.nodeinfo(platform, tile);
+    if (node == nullptr) {
+      continue;
+    }
+    GraphId to_station(platform.tileid(), platform.level(), node->edge_index());
+    for (const auto& edge : tile->GetDirectedEdges(node)) {
+      if (edge.use() == Use::kPlatformConnection) {
+        graph_tile_ptr station_tile = tile;
+        const auto* station = reader.nodeinfo(edge.endnode(), station_tile);
+        if (station != nullptr) {
+          GraphId to_platform(edge.endnode().tileid(), edge.endnode().level(),
+                              station->edge_index());
+          for (const auto& other : station_tile->GetDirectedEdges(station)) {
+            const auto stop = timetable->stop_index.find(other.endnode());
+            if (other.use() == Use::kPlatformConnection && other.endnode() != platform &&
+                stop != timetable->stop_index.end()) {
+              timetable->transfers.push_back({stop->second, to_station, to_platform});
+            }
+            ++to_platform;
+          }
+        }
+      }
+      ++to_station;
+    }
+  }
+  timetable->transfers_begin.push_back(timetable->transfers.size());
+
+  LOG_DEBUG("TransitTimetable stops::" + std::to_string(stop_count) +
+            " routes::" + std::to_string(timetable->routes.size()) +
+            " trips::" + std::to_string(timetable->trips.size()));
+  return timetable;
+}
+
+TransitWalk::TransitWalk(const boost::property_tree::ptree& config)
+    : Dijkstras(config), timetable_(nullptr), max_distance_(0), forward_(true),
+      destination_label_(kInvalidLabel) {
+}
+
+void TransitWalk::Clear() {
+  stops_.clear();
+  destinations_.clear();
+  destination_label_ = kInvalidLabel;
+  timetable_ = nullptr;
+  Dijkstras::Clear();
+}
+
+void TransitWalk::GetExpansionHints(uint32_t& bucket_count,
+                                    uint32_t& edge_label_reservation) const {
+  bucket_count = 20000;
+  edge_label_reservation = kInitialEdgeLabelCountDijkstras;
+}
+
+void TransitWalk::Walk(const ExpansionType expansion_type,
+                       valhalla::Location& location,
+                       const TransitTimetable& timetable,
+                       GraphReader& reader,
+                       const mode_costing_t& mode_costing,
+                       const uint32_t max_distance,
+                       const valhalla::Location* destination) {
+  Clear();
+  forward_ = expansion_type == ExpansionType::forward;
+  timetable_ = &timetable;
+  max_distance_ = max_distance;
+
+  // the part of the destination edges past the destination is taken off a direct walk
+  const auto& pc = mode_costing[static_cast<uint32_t>(travel_mode_t::kPedestrian)];
+  if (destination) {
+    graph_tile_ptr tile;
+    for (const auto& edge : destination->correlation().edges()) {
+      const GraphId edge_id(edge.graph_id());
+      const auto* directededge = reader.directededge(edge_id, tile);
+      if (directededge != nullptr) {
+        destinations_.emplace(edge_id, pc->EdgeCost(directededge, edge_id, tile) *
+                                           (1.f - edge.percent_along()));
+      }
+    }
+  }
+
+  google::protobuf::RepeatedPtrField<valhalla::Location> seeds;
+  seeds.Add()->CopyFrom(location);
+  if (forward_) {
+    Compute<ExpansionType::forward>(seeds, reader, mode_costing, travel_mode_t::kPedestrian);
+  } else {
+    Compute<ExpansionType::reverse>(seeds, reader, mode_costing, travel_mode_t::kPedestrian);
+  }
+}
+
+ExpansionRecommendation TransitWalk::ShouldExpand(GraphReader& /*reader*/,
+                                                  const sif::EdgeLabel& pred,
+                                                  const ExpansionType /*route_type*/) {
+  if (pred.path_distance() > max_distance_) {
+    return ExpansionRecommendation::prune_expansion;
+  }
+
+  // walking directly to the destination, behind the origin on its edge is left out
+  const auto label = edgestatus_.Get(pred.edgeid()).index();
+  const auto destination = destinations_.find(pred.edgeid());
+  if (destination != destinations_.end() && pred.cost().secs >= destination->second.secs &&
+      (destination_label_ == kInvalidLabel ||
+       pred.cost().cost - destination->second.cost <
+           bdedgelabels_[destination_label_].cost().cost - destination_remainder_.cost)) {
+    destination_label_ = label;
+    destination_remainder_ = destination->second;
+  }
+
+  // the walk ends at the first stop it reaches, going in reverse the end node is where it starts
+  const auto stop = timetable_->stop_index.find(pred.endnode());
+  if (stop != timetable_->stop_index.end()) {
+    stops_.emplace(stop->second, label);
+    return ExpansionRecommendation::prune_expansion;
+  }
+  return ExpansionRecommendation::continue_expansion;
+}
+
+std::vector<uint32_t> TransitWalk::Labels(const uint32_t label) const {
+  std::vector<uint32_t> labels;
+  for (auto l = label; l != kInvalidLabel; l = bdedgelabels_[l].predecessor()) {
+    labels.push_back(l);
+  }
+  // going forward the predecessors lead back to the origin
+  if (forward_) {
+    std::reverse(labels.begin(), labels.end());
+  }
+  return labels;
+}
+
+Raptor::Raptor(const boost::property_tree::ptree& config)
+    : PathAlgorithm(config.get<uint32_t>("max_reserved_labels_count_dijkstras",
+                                         kInitialEdgeLabelCountDijkstras),
+                    config.get<bool>("clear_reserved_memory", false)),
+      max_rounds_(config.get<uint32_t>("raptor.max_transfers", 4) + 1), start_time_(0),
+      timetable_date_(0), timetable_dow_(0), timetable_wheelchair_(false),
+      timetable_bicycle_(false), access_(config), egress_(config) {
+}
+
+void Raptor::Clear() {
+  access_.Clear();
+  egress_.Clear();
+  arrivals_.clear();
+  readies_.clear();
+  best_arrival_.clear();
+  best_ready_.clear();
+  transfer_times_.clear();
+  excluded_stops_.clear();
+  excluded_routes_.clear();
+  if (clear_reserved_memory_) {
+    arrivals_.shrink_to_fit();
+    readies_.shrink_to_fit();
+    timetable_.reset();
+    timetable_tiles_.clear();
+  }
+  has_ferry_ = false;
+}
+
+void Raptor::LoadTimetable(const valhalla::Location& origin,
+                           const valhalla::Location& dest,
+                           GraphReader& graphreader,
+                           const cost_ptr_t& tc) {
+  // the transit tiles around both ends, wider the farther apart they are for detours
+  const PointLL a(origin.ll().lng(), origin.ll().lat());
+  const PointLL b(dest.ll().lng(), dest.ll().lat());
+  const double margin = 0.5 * a.Distance(b) + kMinTileMargin;
+  const double lat = (a.lat() + b.lat()) / 2;
+  const double dlat = margin / kMetersPerDegreeLat;
+  const double dlng = margin / DistanceApproximator<PointLL>::MetersPerLngDegree(lat);
+  const AABB2<PointLL> box(std::min(a.lng(), b.lng()) - dlng, std::min(a.lat(), b.lat()) - dlat,
+                           std::max(a.lng(), b.lng()) + dlng, std::max(a.lat(), b.lat()) + dlat);
+  const auto& level = TileHierarchy::GetTransitLevel();
+  std::vector<GraphId> tiles;
+  for (const auto tile : level.tiles.TileList(box)) {
+    GraphId tile_id(tile, level.level, 0);
+    if (graphreader.DoesTileExist(tile_id)) {
+      tiles.push_back(tile_id);
+    }
+  }
+  std::sort(tiles.begin(), tiles.end());
+
+  const auto& date_time = origin.date_time();
+  const uint32_t date = DateTime::days_from_pivot_date(DateTime::get_formatted_date(date_time));
+  const uint32_t dow = DateTime::day_of_week_mask(date_time);
+  if (!timetable_ || tiles != timetable_tiles_ || date != timetable_date_ ||
+      dow != timetable_dow_ || tc->wheelchair() != timetable_wheelchair_ ||
+      tc->bicycle() != timetable_bicycle_) {
+    timetable_ =
+        TransitTimetable::Build(graphreader, tiles, date, dow, tc->wheelchair(), tc->bicycle());
+    timetable_tiles_ = std::move(tiles);
+    timetable_date_ = date;
+    timetable_dow_ = dow;
+    timetable_wheelchair_ = tc->wheelchair();
+    timetable_bicycle_ = tc->bicycle();
+  }
+}
+
+uint32_t Raptor::TransferTime(const uint32_t transfer,
+                              GraphReader& graphreader,
+                              const cost_ptr_t& pc) {
+  auto& time = transfer_times_[transfer];
+  if (time == kNoTime) {
+    const auto& t = timetable_->transfers[transfer];
+    float secs = 0.f;
+    graph_tile_ptr tile;
+    for (const auto& edge_id : {t.to_station, t.to_platform}) {
+      const auto* edge = graphreader.directededge(edge_id, tile);
+      secs += edge ? pc->EdgeCost(edge, edge_id, tile).secs : 0.f;
+    }
+    time = static_cast<uint32_t>(secs + 0.5f);
+  }
+  return time;
+}
+
+std::vector<std::vector<PathInfo>> Raptor::GetBestPath(valhalla::Location& origin,
+                                                       valhalla::Location& dest,
+                                                       GraphReader& graphreader,
+                                                       const mode_costing_t& mode_costing,
+                                                       const travel_mode_t /*mode*/,
+                                                       const Options& options) {
+  // like MultiModalPathAlgorithm the date_time must be set on the origin
+  if (origin.date_time().empty()) {
+    return {};
+  }
+  const auto& pc = mode_costing[static_cast<uint32_t>(travel_mode_t::kPedestrian)];
+  const auto& tc = mode_costing[static_cast<uint32_t>(travel_mode_t::kPublicTransit)];
+  pc->SetAllowTransitConnections(true);
+  const uint32_t max_walking_distance =
+      options.costings().find(Costing::pedestrian)->second.options().transit_start_end_max_distance();
+  start_time_ = DateTime::seconds_from_midnight(origin.date_time());
+
+  LoadTimetable(origin, dest, graphreader, tc);
+  const auto& timetable = *timetable_;
+  const uint32_t stop_count = timetable.stops.size();
+
+  // the stops and routes the request excludes
+  for (const auto& tile : timetable.tiles) {
+    tc->AddToExcludeList(tile);
+  }
+  excluded_stops_.assign(stop_count, false);
+  graph_tile_ptr tile;
+  for (uint32_t s = 0; s < stop_count; ++s) {
+    const auto* node = graphreader.nodeinfo(timetable.stops[s], tile);
+    excluded_stops_[s] = node == nullptr || tc->IsExcluded(tile, node);
+  }
+  excluded_routes_.assign(timetable.routes.size(), false);
+  for (uint32_t r = 0; r < timetable.routes.size(); ++r) {
+    const auto& route = timetable.routes[r];
+    for (uint32_t i = 0; i + 1 < route.stop_count && !excluded_routes_[r]; ++i) {
+      const auto& edge_id = timetable.route_edges[route.first_stop + i];
+      const auto* edge = graphreader.directededge(edge_id, tile);
+      excluded_routes_[r] = edge == nullptr || tc->IsExcluded(tile, edge);
+    }
+  }
+
+  // walk to the stops around the origin and from the ones around the destination
+  access_.Walk(ExpansionType::forward, origin, timetable, graphreader, mode_costing,
+               max_walking_distance, &dest);
+  egress_.Walk(ExpansionType::reverse, dest, timetable, graphreader, mode_costing,
+               max_walking_distance);
+  std::vector<uint32_t> egress_time(stop_count, kNoTime);
+  for (const auto& [stop, label] : egress_.stops()) {
+    egress_time[stop] = static_cast<uint32_t>(egress_.label(label).cost().secs + 0.5f);
+  }
+
+  arrivals_.assign((max_rounds_ + 1) * stop_count, {kNoTime, 0, 0, 0, 0});
+  readies_.assign((max_rounds_ + 1) * stop_count, {kNoTime, kInvalidLabel, kInvalidLabel});
+  best_arrival_.assign(stop_count, kNoTime);
+  best_ready_.assign(stop_count, kNoTime);
+  transfer_times_.assign(timetable.transfers.size(), kNoTime);
+
+  // round 0 walks to the stops, walking directly to the destination is the first journey
+  std::vector<journey_t> journeys;
+  uint32_t best_target = kNoTime;
+  if (access_.destination_label() != kInvalidLabel) {
+    const auto& label = access_.label(access_.destination_label());
+    best_target = start_time_ + static_cast<uint32_t>(label.cost().secs -
+                                                      access_.destination_remainder().secs + 0.5f);
+    journeys.push_back({0, kInvalidLabel});
+  }
+  std::vector<uint32_t> marked;
+  for (const auto& [stop, label] : access_.stops()) {
+    if (!excluded_stops_[stop]) {
+      const uint32_t time =
+          start_time_ + static_cast<uint32_t>(access_.label(label).cost().secs + 0.5f);
+      readies_[stop] = {time, label, kInvalidLabel};
+      best_ready_[stop] = time;
+      marked.push_back(stop);
+    }
+  }
+
+  std::vector<uint32_t> route_start(timetable.routes.size(), kNoTime);
+  std::vector<uint32_t> routes, improved;
+  std::vector<bool> is_improved(stop_count, false);
+  for (uint32_t round = 1; round <= max_rounds_ && !marked.empty(); ++round) {
+    if (interrupt) {
+      (*interrupt)();
+    }
+    const auto* ready = &readies_[(round - 1) * stop_count];
+    auto* arrival = &arrivals_[round * stop_count];
+
+    // the routes serving the stops improved last round, each from its first such stop
+    routes.clear();
+    for (const auto stop : marked) {
+      for (uint32_t i = timetable.stop_routes_begin[stop]; i < timetable.stop_routes_begin[stop + 1];
+           ++i) {
+        const auto& [route, position] = timetable.stop_routes[i];
+        if (excluded_routes_[route]) {
+          continue;
+        }
+        if (route_start[route] == kNoTime) {
+          routes.push_back(route);
+        }
+        route_start[route] = std::min(route_start[route], position);
+      }
+    }
+    marked.clear();
+
+    // ride the earliest trip that can be caught along each route
+    improved.clear();
+    for (const auto r : routes) {
+      const auto& route = timetable.routes[r];
+      const auto* trips = &timetable.trips[route.first_trip];
+      uint32_t trip = kInvalidLabel;
+      uint32_t board = 0;
+      for (uint32_t i = route_start[r]; i < route.stop_count; ++i) {
+        const uint32_t stop = timetable.route_stops[route.first_stop + i];
+        if (excluded_stops_[stop]) {
+          continue;
+        }
+        if (trip != kInvalidLabel) {
+          const uint32_t time = timetable.stop_times[trips[trip].first_time + i].arrival;
+          if (time < std::min(best_arrival_[stop], best_target)) {
+            arrival[stop] = {time, r, route.first_trip + trip, board, i};
+            best_arrival_[stop] = time;
+            if (!is_improved[stop]) {
+              is_improved[stop] = true;
+              improved.push_back(stop);
+            }
+          }
+        }
+        if (i + 1 == route.stop_count || ready[stop].time == kNoTime ||
+            (trip != kInvalidLabel &&
+             ready[stop].time > timetable.stop_times[trips[trip].first_time + i].departure)) {
+          continue;
+        }
+        // the trips of a route never overtake each other so their departures here are sorted
+        const uint32_t earliest =
+            std::partition_point(trips, trips + (trip == kInvalidLabel ? route.trip_count : trip),
+                                 [&](const TransitTimetable::trip_t& t) {
+                                   return timetable.stop_times[t.first_time + i].departure <
+                                          ready[stop].time;
+                                 }) -
+            trips;
+        if (earliest < (trip == kInvalidLabel ? route.trip_count : trip)) {
+          trip = earliest;
+          board = i;
+        }
+      }
+      route_start[r] = kNoTime;
+    }
+
+    // the best journey with this many rides and the transfers for the next round
+    auto* next_ready = &readies_[round * stop_count];
+    journey_t journey{round, kInvalidLabel};
+    for (const auto stop : improved) {
+      is_improved[stop] = false;
+      const uint32_t time = arrival[stop].time;
+      if (egress_time[stop] != kNoTime && time + egress_time[stop] < best_target) {
+        best_target = time + egress_time[stop];
+        journey.stop = stop;
+      }
+      auto relax = [&](const uint32_t to, const uint32_t ready_time, const uint32_t transfer) {
+        if (ready_time < best_ready_[to] && ready_time < next_ready[to].time) {
+          if (next_ready[to].time == kNoTime) {
+            marked.push_back(to);
+          }
+          next_ready[to] = {ready_time, stop, transfer};
+          best_ready_[to] = ready_time;
+        }
+      };
+      relax(stop, time + kSamePlatformTransferTime, kInvalidLabel);
+      for (uint32_t t = timetable.transfers_begin[stop]; t < timetable.transfers_begin[stop + 1];
+           ++t) {
+        const uint32_t to = timetable.transfers[t].to_stop;
+        if (!excluded_stops_[to]) {
+          relax(to,
+                time + TransferTime(t, graphreader, pc) +
+                    static_cast<uint32_t>(tc->TransferCost().secs),
+                t);
+        }
+      }
+    }
+    if (journey.stop != kInvalidLabel) {
+      journeys.push_back(journey);
+    }
+  }
+
+  // the cheapest of the journeys first, then the others as alternates
+  std::vector<std::vector<PathInfo>> paths;
+  for (const auto& journey : journeys) {
+    paths.emplace_back(FormPath(journey, graphreader, pc, tc));
+  }
+  std::stable_sort(paths.begin(), paths.end(), [](const auto& a, const auto& b) {
+    return a.back().elapsed_cost.cost < b.back().elapsed_cost.cost;
+  });
+  if (paths.size() > options.alternates() + 1) {
+    paths.resize(options.alternates() + 1);
+  }
+  LOG_DEBUG("Raptor rounds::" + std::to_string(journeys.empty() ? 0 : journeys.back().round) +
+            " journeys::" + std::to_string(journeys.size()));
+  return paths;
+}
+
+std::vector<PathInfo> Raptor::FormPath(const journey_t& journey,
+                                       GraphReader& graphreader,
+                                       const cost_ptr_t& pc,
+                                       const cost_ptr_t& tc) const {
+  const auto& timetable = *timetable_;
+  const uint32_t stop_count = timetable.stops.size();
+  std::vector<PathInfo> path;
+  Cost cost;
+  float distance = 0.f;
+
+  // walking directly
+  if (journey.stop == kInvalidLabel) {
+    for (const auto l : access_.Labels(access_.destination_label())) {
+      const auto& label = access_.label(l);
+      path.emplace_back(travel_mode_t::kPedestrian, label.cost(), label.edgeid(), 0,
+                        label.path_distance(), label.restriction_idx(), label.transition_cost());
+    }
+    path.back().elapsed_cost -= access_.destination_remainder();
+    return path;
+  }
+
+  // the rides back from the last one, each with the transfer before it
+  std::vector<std::pair<arrival_t, uint32_t>> rides;
+  uint32_t stop = journey.stop;
+  uint32_t access_label = kInvalidLabel;
+  for (uint32_t round = journey.round; round > 0; --round) {
+    const auto& arrival = arrivals_[round * stop_count + stop];
+    const auto& route = timetable.routes[arrival.route];
+    const uint32_t board_stop = timetable.route_stops[route.first_stop + arrival.board];
+    const auto& ready = readies_[(round - 1) * stop_count + board_stop];
+    rides.emplace_back(arrival, ready.transfer);
+    if (round == 1) {
+      access_label = ready.from;
+    }
+    stop = ready.from;
+  }
+  std::reverse(rides.begin(), rides.end());
+
+  // walk to the first stop
+  for (const auto l : access_.Labels(access_label)) {
+    const auto& label = access_.label(l);
+    path.emplace_back(travel_mode_t::kPedestrian, label.cost(), label.edgeid(), 0,
+                      label.path_distance(), label.restriction_idx(), label.transition_cost());
+  }
+  cost = path.back().elapsed_cost;
+  distance = path.back().path_distance;
+
+  graph_tile_ptr tile;
+  for (size_t r = 0; r < rides.size(); ++r) {
+    const auto& [arrival, transfer] = rides[r];
+    // walk over the station to another platform
+    if (transfer != kInvalidLabel) {
+      const auto& t = timetable.transfers[transfer];
+      for (const auto& edge_id : {t.to_station, t.to_platform}) {
+        const auto* edge = graphreader.directededge(edge_id, tile);
+        if (edge == nullptr) {
+          continue;
+        }
+        Cost edge_cost = pc->EdgeCost(edge, edge_id, tile);
+        edge_cost.cost *= pc->GetModeFactor();
+        cost += edge_cost;
+        distance += edge->length();
+        path.emplace_back(travel_mode_t::kPedestrian, cost, edge_id, 0, distance);
+      }
+    }
+
+    // boarding costs a transfer like it does in MultiModalPathAlgorithm
+    cost.cost += (r > 0 && transfer != kInvalidLabel ? tc->TransferCost() : tc->DefaultTransferCost())
+                     .cost;
+    const auto& route = timetable.routes[arrival.route];
+    const auto& trip = timetable.trips[arrival.trip];
+    for (uint32_t i = arrival.board; i < arrival.alight; ++i) {
+      const auto& edge_id = timetable.route_edges[route.first_stop + i];
+      const auto* edge = graphreader.directededge(edge_id, tile);
+      const auto* d = timetable.departures[trip.first_time + i];
+      const TransitDeparture departure(d->lineid(), d->tripid(), d->routeindex(), d->blockid(),
+                                       d->headsign_offset(), d->departure_time() + trip.shift,
+                                       d->elapsed_time(), d->schedule_index(),
+                                       d->wheelchair_accessible(), d->bicycle_accessible());
+      cost += tc->EdgeCost(edge, &departure, start_time_ + static_cast<uint32_t>(cost.secs));
+      distance += edge->length();
+      path.emplace_back(travel_mode_t::kPublicTransit, cost, edge_id, trip.tripid, distance);
+    }
+  }
+
+  // walk from the last stop, the labels have the cost to the destination
+  const auto labels = egress_.Labels(egress_.stops().at(journey.stop));
+  const Cost egress = egress_.label(labels.front()).cost();
+  for (size_t i = 0; i < labels.size(); ++i) {
+    const auto& label = egress_.label(labels[i]);
+    const Cost rest = i + 1 < labels.size() ? egress_.label(labels[i + 1]).cost() : Cost{};
+    const float rest_distance =
+        i + 1 < labels.size() ? egress_.label(labels[i + 1]).path_distance() : 0.f;
+    path.emplace_back(travel_mode_t::kPedestrian, cost + egress - rest, label.opp_edgeid(), 0,
+                      distance + egress_.label(labels.front()).path_distance() - rest_distance);
+  }
+  return path;
+}
+
+} // namespace thor
+} // namespace valhalla
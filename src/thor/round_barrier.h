@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace valhalla {
+namespace thor {
+
+// Lets the threads of a search expanding in rounds wait for each other between the rounds
+class round_barrier_t {
+public:
+  explicit round_barrier_t(const size_t count) : count_(count), waiting_(0), generation_(0) {
+  }
+
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto generation = generation_;
+    if (++waiting_ == count_) {
+      waiting_ = 0;
+      ++generation_;
+      condition_.notify_all();
+      return;
+    }
+    condition_.wait(lock, [this, generation]() { return generation_ != generation; });
+  }
+
+private:
+  const size_t count_;
+  size_t waiting_;
+  size_t generation_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+};
+
+} // namespace thor
+} // namespace valhalla
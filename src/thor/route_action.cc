@@ -1,4 +1,5 @@
 #include "baldr/attributes_controller.h"
+#include "helper_interrupt.h"
 #include "midgard/logging.h"
 #include "proto/common.pb.h"
 #include "thor/route_matcher.h"
@@ -6,6 +7,9 @@
 #include "thor/worker.h"
 
 #include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 using namespace valhalla;
 using namespace valhalla::midgard;
@@ -123,6 +127,93 @@ template <typename Predicate> inline void remove_path_edges(valhalla::Location&
       ->DeleteSubrange(start_idx, loc.correlation().filtered_edges_size() - start_idx);
 }
 
+// Use A* if any origin and destination edges are the same or are connected - otherwise
+// use bidirectional A*. Bidirectional A* does not handle trivial cases with oneways and
+// has issues when cost of origin or destination edge is high (needs a high threshold to
+// find the proper connection).
+bool edges_connect(const valhalla::Location& origin,
+                   const valhalla::Location& destination,
+                   GraphReader& reader) {
+  for (auto& edge1 : origin.correlation().edges()) {
+    for (auto& edge2 : destination.correlation().edges()) {
+      bool same_graph_id = edge1.graph_id() == edge2.graph_id();
+      bool are_connected =
+          reader.AreEdgesConnected(GraphId(edge1.graph_id()), GraphId(edge2.graph_id()));
+      if (same_graph_id || are_connected) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * Finds the path between two locations, with a second pass on relaxed limits if there is none or
+ * a pedestrian path takes a ferry.
+ * @param relaxed  set if the second pass ran
+ */
+std::vector<std::vector<PathInfo>> find_path(PathAlgorithm* path_algorithm,
+                                             const bool bidirectional,
+                                             valhalla::Location& origin,
+                                             valhalla::Location& destination,
+                                             const std::string& costing,
+                                             const Options& options,
+                                             GraphReader& reader,
+                                             const mode_costing_t& mode_costing,
+                                             const travel_mode_t mode,
+                                             bool& relaxed) {
+  // Find the path.
+  valhalla::sif::cost_ptr_t cost = mode_costing[static_cast<uint32_t>(mode)];
+
+  // If bidirectional A* disable use of destination-only edges on the
+  // first pass. If there is a failure, we allow them on the second pass.
+  // Other path algorithms can use destination-only edges on the first pass.
+  // TODO(nils): why not others with destonly pruning? it gets a 2nd pass as well
+  cost->set_allow_destination_only(bidirectional ? false : true);
+
+  cost->set_pass(0);
+  auto paths = path_algorithm->GetBestPath(origin, destination, reader, mode_costing, mode, options);
+
+  // Check if we should run a second pass pedestrian route with different A*
+  // (to look for better routes where a ferry is taken)
+  // TODO(nils): how would a second pass find a better route, if it changes nothing ferry-related?
+  bool ped_second_pass = false;
+  if (!paths.empty() && (costing == "pedestrian" && path_algorithm->has_ferry())) {
+    // DO NOT run a second pass on long routes due to performance issues
+    float d = PointLL(origin.ll().lng(), origin.ll().lat())
+                  .Distance(PointLL(destination.ll().lng(), destination.ll().lat()));
+    if (d < kPedestrianMultipassThreshold) {
+      ped_second_pass = true;
+    }
+  }
+
+  // If path is not found try again with relaxed limits (if allowed). Use less aggressive
+  // hierarchy transition limits, and retry with more candidate edges (add those filtered
+  // by heading on first pass).
+  if ((paths.empty() || ped_second_pass) && cost->AllowMultiPass()) {
+    relaxed = true;
+    // add filtered edges to candidate edges for origin and destination
+    origin.mutable_correlation()->mutable_edges()->MergeFrom(origin.correlation().filtered_edges());
+    destination.mutable_correlation()->mutable_edges()->MergeFrom(
+        destination.correlation().filtered_edges());
+
+    path_algorithm->Clear();
+    cost->set_pass(1);
+    cost->RelaxHierarchyLimits(bidirectional);
+    cost->set_allow_destination_only(true);
+    cost->set_allow_conditional_destination(true);
+    path_algorithm->set_not_thru_pruning(false);
+    // Get the best path. Return if not empty (else return the original path)
+    auto relaxed_paths =
+        path_algorithm->GetBestPath(origin, destination, reader, mode_costing, mode, options);
+    if (!relaxed_paths.empty()) {
+      return relaxed_paths;
+    }
+  }
+
+  return paths;
+}
+
 /**
 // removes any edges from the location that aren't connected to it (because of radius)
 void remove_edges(const GraphId& edge_id, valhalla::Location& loc, GraphReader& reader) {
@@ -367,7 +458,9 @@ void thor_worker_t::route(Api& request) {
   auto costing = parse_costing(request);
 
   // get all the legs
-  if (options.date_time_type() == Options::arrive_by) {
+  if (options.batch() != Options::no_batch) {
+    path_batch(request, costing);
+  } else if (options.date_time_type() == Options::arrive_by) {
     path_arrive_by(request, costing);
   } else {
     path_depart_at(request, costing);
@@ -381,6 +474,7 @@ thor::PathAlgorithm* thor_worker_t::get_path_algorithm(const std::string& routet
   // make sure they are all cancelable
   for (auto* alg : std::vector<PathAlgorithm*>{
            &multi_modal_transit,
+           &raptor,
            &timedep_forward,
            &timedep_reverse,
            &bidir_astar,
@@ -391,6 +485,9 @@ thor::PathAlgorithm* thor_worker_t::get_path_algorithm(const std::string& routet
 
   // Have to use multimodal for transit based routing
   if (routetype == "multimodal" || routetype == "transit") {
+    if (request.options().multimodal_algorithm() == Options::multimodal_raptor) {
+      return &raptor;
+    }
     return &multi_modal_transit;
   }
 
@@ -429,19 +526,9 @@ thor::PathAlgorithm* thor_worker_t::get_path_algorithm(const std::string& routet
     }
   }
 
-  // Use A* if any origin and destination edges are the same or are connected - otherwise
-  // use bidirectional A*. Bidirectional A* does not handle trivial cases with oneways and
-  // has issues when cost of origin or destination edge is high (needs a high threshold to
-  // find the proper connection).
-  for (auto& edge1 : origin.correlation().edges()) {
-    for (auto& edge2 : destination.correlation().edges()) {
-      bool same_graph_id = edge1.graph_id() == edge2.graph_id();
-      bool are_connected =
-          reader->AreEdgesConnected(GraphId(edge1.graph_id()), GraphId(edge2.graph_id()));
-      if (same_graph_id || are_connected) {
-        return &timedep_forward;
-      }
-    }
+  // Use A* if any origin and destination edges are the same or are connected
+  if (edges_connect(origin, destination, *reader)) {
+    return &timedep_forward;
   }
 
   // No other special cases we land on bidirectional a*
@@ -453,57 +540,12 @@ std::vector<std::vector<thor::PathInfo>> thor_worker_t::get_path(PathAlgorithm*
                                                                  valhalla::Location& destination,
                                                                  const std::string& costing,
                                                                  Api& request) {
-  const Options& options = request.options();
-  // Find the path.
-  valhalla::sif::cost_ptr_t cost = mode_costing[static_cast<uint32_t>(mode)];
-
-  // If bidirectional A* disable use of destination-only edges on the
-  // first pass. If there is a failure, we allow them on the second pass.
-  // Other path algorithms can use destination-only edges on the first pass.
-  // TODO(nils): why not others with destonly pruning? it gets a 2nd pass as well
-  cost->set_allow_destination_only(path_algorithm == &bidir_astar ? false : true);
-
-  cost->set_pass(0);
-  auto paths = path_algorithm->GetBestPath(origin, destination, *reader, mode_costing, mode, options);
-
-  // Check if we should run a second pass pedestrian route with different A*
-  // (to look for better routes where a ferry is taken)
-  // TODO(nils): how would a second pass find a better route, if it changes nothing ferry-related?
-  bool ped_second_pass = false;
-  if (!paths.empty() && (costing == "pedestrian" && path_algorithm->has_ferry())) {
-    // DO NOT run a second pass on long routes due to performance issues
-    float d = PointLL(origin.ll().lng(), origin.ll().lat())
-                  .Distance(PointLL(destination.ll().lng(), destination.ll().lat()));
-    if (d < kPedestrianMultipassThreshold) {
-      ped_second_pass = true;
-    }
-  }
-
-  // If path is not found try again with relaxed limits (if allowed). Use less aggressive
-  // hierarchy transition limits, and retry with more candidate edges (add those filtered
-  // by heading on first pass).
-  if ((paths.empty() || ped_second_pass) && cost->AllowMultiPass()) {
+  bool relaxed = false;
+  auto paths = find_path(path_algorithm, path_algorithm == &bidir_astar, origin, destination, costing,
+                         request.options(), *reader, mode_costing, mode, relaxed);
+  if (relaxed) {
     add_warning(request, 401);
-    // add filtered edges to candidate edges for origin and destination
-    origin.mutable_correlation()->mutable_edges()->MergeFrom(origin.correlation().filtered_edges());
-    destination.mutable_correlation()->mutable_edges()->MergeFrom(
-        destination.correlation().filtered_edges());
-
-    path_algorithm->Clear();
-    cost->set_pass(1);
-    const bool using_bd = path_algorithm == &bidir_astar;
-    cost->RelaxHierarchyLimits(using_bd);
-    cost->set_allow_destination_only(true);
-    cost->set_allow_conditional_destination(true);
-    path_algorithm->set_not_thru_pruning(false);
-    // Get the best path. Return if not empty (else return the original path)
-    auto relaxed_paths =
-        path_algorithm->GetBestPath(origin, destination, *reader, mode_costing, mode, options);
-    if (!relaxed_paths.empty()) {
-      return relaxed_paths;
-    }
   }
-
   return paths;
 }
 
@@ -734,6 +776,11 @@ void thor_worker_t::path_arrive_by(Api& api, const std::string& costing) {
 }
 
 void thor_worker_t::path_depart_at(Api& api, const std::string& costing) {
+  // without times the legs between break locations don't depend on each other
+  if (path_depart_at_concurrently(api, costing)) {
+    return;
+  }
+
   // Things we'll need
   TripRoute* route = nullptr;
   GraphId last_edge;
@@ -927,5 +974,289 @@ void thor_worker_t::path_depart_at(Api& api, const std::string& costing) {
   // assign changed locations
   *api.mutable_options()->mutable_locations() = std::move(correlated);
 }
+
+void thor_worker_t::path_batch(Api& api, const std::string& costing) {
+  auto& options = *api.mutable_options();
+  auto& locations = *options.mutable_locations();
+  const bool many_to_one = options.batch() == Options::many_to_one;
+  const int shared_index = many_to_one ? locations.size() - 1 : 0;
+  google::protobuf::RepeatedPtrField<valhalla::Location>
+      others(std::next(locations.begin(), many_to_one ? 0 : 1),
+             std::next(locations.begin(), many_to_one ? locations.size() - 1 : locations.size()));
+
+  // one tree from the shared location finds most of the paths, the multimodal searches have none
+  std::vector<std::vector<PathInfo>> paths(others.size());
+  if (costing != "multimodal" && costing != "transit" && costing != "auto_pedestrian" &&
+      costing != "bikeshare") {
+    paths = route_tree_.Paths(many_to_one ? ExpansionType::reverse : ExpansionType::forward,
+                              *locations.Mutable(shared_index), others, options, *reader,
+                              mode_costing, mode);
+  }
+
+  // the rest are routed on their own like the legs of a route
+  auto& cost = mode_costing[static_cast<uint32_t>(mode)];
+  const Costing_Options& costing_options =
+      options.costings().find(options.costing_type())->second.options();
+  const auto user_hierarchy_limits = cost->GetHierarchyLimits();
+  bool add_hierarchy_limits_warning = false;
+
+  auto& trip = *api.mutable_trip();
+  trip.mutable_routes()->Reserve(others.size());
+  for (int i = 0; i < others.size(); ++i) {
+    auto& origin = *locations.Mutable(many_to_one ? i : shared_index);
+    auto& destination = *locations.Mutable(many_to_one ? shared_index : i + 1);
+    auto& path = paths[i];
+    std::vector<std::string> algorithms{"route_tree"};
+    if (path.empty()) {
+      thor::PathAlgorithm* path_algorithm = get_path_algorithm(costing, origin, destination, api);
+      path_algorithm->Clear();
+      algorithms = {path_algorithm->name()};
+      const bool is_bidir = path_algorithm == &bidir_astar;
+      auto hierarchy_limits = user_hierarchy_limits;
+      add_hierarchy_limits_warning =
+          check_hierarchy_limits(hierarchy_limits, cost, costing_options,
+                                 is_bidir ? hierarchy_limits_config_bidirectional_astar
+                                          : hierarchy_limits_config_astar,
+                                 allow_hierarchy_limits_modifications,
+                                 cost->UseHierarchyLimits()) ||
+          add_hierarchy_limits_warning;
+      cost->SetHierarchyLimits(hierarchy_limits);
+      auto found = get_path(path_algorithm, origin, destination, costing, api);
+      if (found.empty()) {
+        throw valhalla_exception_t{442};
+      }
+      path = std::move(found.front());
+    }
+
+    // every location gets its own route with one leg
+    auto& leg = *trip.mutable_routes()->Add()->mutable_legs()->Add();
+    thor::TripLegBuilder::Build(options, controller, *reader, mode_costing, path.begin(), path.end(),
+                                origin, destination, leg, algorithms, interrupt);
+  }
+  // maybe warn if we needed to change user provided hierarchy limits
+  if (add_hierarchy_limits_warning) {
+    add_warning(api, allow_hierarchy_limits_modifications ? 210 : 209);
+  }
+}
+
+bool thor_worker_t::path_depart_at_concurrently(Api& api, const std::string& costing) {
+  const Options& options = api.options();
+  if (route_concurrency < 2 || leg_worker_config_.empty() || options.action() != Options::route ||
+      options.alternates() > 0 || costing == "multimodal" || costing == "transit" ||
+      costing == "auto_pedestrian" || costing == "bikeshare") {
+    return false;
+  }
+  // the time at a location depends on all the legs before it
+  if (std::any_of(options.locations().begin(), options.locations().end(),
+                  [](const valhalla::Location& location) { return !location.date_time().empty(); })) {
+    return false;
+  }
+
+  // every break location splits the route into legs which are routed on their own, through
+  // locations and break through locations have to keep going on the edge they were reached on
+  struct legs_t {
+    std::vector<valhalla::Location> locations;
+    std::vector<TripLeg> legs;
+    bool found = false;
+    bool relaxed = false;
+    bool used_bidir = false;
+    bool used_unidir = false;
+  };
+  std::vector<legs_t> parts;
+  std::vector<int> firsts{0};
+  for (int i = 1; i < options.locations_size(); ++i) {
+    if (i + 1 == options.locations_size() || options.locations(i).type() == Location::kBreak) {
+      parts.emplace_back().locations.assign(options.locations().begin() + firsts.back(),
+                                            options.locations().begin() + i + 1);
+      firsts.push_back(i);
+    }
+  }
+  if (parts.size() < 2) {
+    return false;
+  }
+
+  // without a time only the edges of the locations decide between the algorithms, check the
+  // hierarchy limits of both of them up front
+  auto& cost = mode_costing[static_cast<uint32_t>(mode)];
+  const Costing_Options& costing_options =
+      options.costings().find(options.costing_type())->second.options();
+  auto hierarchy_limits_bidir = cost->GetHierarchyLimits();
+  auto hierarchy_limits_unidir = cost->GetHierarchyLimits();
+  const bool bidir_limits_changed =
+      check_hierarchy_limits(hierarchy_limits_bidir, cost, costing_options,
+                             hierarchy_limits_config_bidirectional_astar,
+                             allow_hierarchy_limits_modifications, cost->UseHierarchyLimits());
+  const bool unidir_limits_changed =
+      check_hierarchy_limits(hierarchy_limits_unidir, cost, costing_options,
+                             hierarchy_limits_config_astar, allow_hierarchy_limits_modifications,
+                             cost->UseHierarchyLimits());
+
+  // the calling thread routes with the path algorithms of the worker, the others with their own
+  bidir_astar.set_interrupt(interrupt);
+  timedep_forward.set_interrupt(interrupt);
+  const uint32_t thread_count = std::min(route_concurrency, static_cast<uint32_t>(parts.size()));
+  while (leg_workers_.size() + 1 < thread_count) {
+    leg_workers_.emplace_back(std::make_unique<leg_worker_t>(leg_worker_config_));
+    leg_workers_.back()->bidir_astar.set_landmarks(alt_landmarks_.get());
+  }
+  // the other threads stop with the request when it gets interrupted
+  helper_interrupt_t helpers(interrupt, thread_count - 1);
+  for (uint32_t t = 0; t + 1 < thread_count; ++t) {
+    leg_workers_[t]->bidir_astar.set_interrupt(helpers.callback());
+    leg_workers_[t]->timedep_forward.set_interrupt(helpers.callback());
+    auto worker_mode = mode;
+    auto& worker_costing = leg_workers_[t]->mode_costing;
+    worker_costing = factory.CreateModeCosting(options, worker_mode);
+    worker_costing[static_cast<uint32_t>(mode)]->SetDefaultHierarchyLimits(
+        cost->DefaultHierarchyLimits());
+  }
+
+  auto route_legs = [&](legs_t& part, BidirectionalAStar& bidir, TimeDepForward& unidir,
+                        GraphReader& graphreader, const mode_costing_t& costings,
+                        const std::function<void()>* leg_interrupt) {
+    std::unordered_map<size_t, std::pair<EdgeTrimmingInfo, EdgeTrimmingInfo>> edge_trimming;
+    std::vector<thor::PathInfo> path;
+    std::vector<std::string> algorithms;
+    GraphId last_edge;
+    auto& locations = part.locations;
+    for (auto destination = std::next(locations.begin()); destination != locations.end();
+         ++destination) {
+      auto origin = std::prev(destination);
+      const bool is_bidir = !edges_connect(*origin, *destination, graphreader);
+      PathAlgorithm* path_algorithm = is_bidir ? static_cast<PathAlgorithm*>(&bidir) : &unidir;
+      path_algorithm->Clear();
+      algorithms.push_back(path_algorithm->name());
+      LOG_INFO(std::string("algorithm::") + path_algorithm->name());
+      (is_bidir ? part.used_bidir : part.used_unidir) = true;
+      costings[static_cast<uint32_t>(mode)]->SetHierarchyLimits(
+          is_bidir ? hierarchy_limits_bidir : hierarchy_limits_unidir);
+
+      if (is_through_point(*origin) && last_edge.is_valid()) {
+        remove_path_edges(*origin,
+                          [&last_edge](const auto& edge) { return edge.graph_id() != last_edge; });
+      }
+      auto temp_paths = find_path(path_algorithm, is_bidir, *origin, *destination, costing, options,
+                                  graphreader, costings, mode, part.relaxed);
+      if (temp_paths.empty()) {
+        return;
+      }
+      auto& temp_path = temp_paths.front();
+      last_edge = temp_path.back().edgeid;
+
+      // Merge through legs by updating the time and splicing the lists
+      if (!path.empty()) {
+        auto offset = path.back().elapsed_cost;
+        auto distance_offset = path.back().path_distance;
+        std::for_each(temp_path.begin(), temp_path.end(), [offset, distance_offset](PathInfo& i) {
+          i.elapsed_cost += offset;
+          i.path_distance += distance_offset;
+        });
+        auto at_node =
+            intermediate_loc_edge_trimming(*origin, path.back().edgeid, temp_path.front().edgeid,
+                                           edge_trimming, path.size() - 1, false);
+        if (path.back().edgeid == temp_path.front().edgeid && at_node) {
+          path.pop_back();
+        }
+        path.insert(path.end(), temp_path.begin(), temp_path.end());
+      } else {
+        path.swap(temp_path);
+      }
+
+      if (is_break_point(*destination)) {
+        auto leg_origin = origin;
+        while (!is_break_point(*leg_origin)) {
+          --leg_origin;
+        }
+        thor::TripLegBuilder::Build(options, controller, graphreader, costings, path.begin(),
+                                    path.end(), *leg_origin, *destination, part.legs.emplace_back(),
+                                    algorithms, leg_interrupt, edge_trimming,
+                                    {std::next(leg_origin), destination});
+        path.clear();
+        edge_trimming.clear();
+        algorithms.clear();
+      }
+    }
+    part.found = true;
+  };
+
+  // every thread takes every thread_count-th part, so the same request always routes a leg with
+  // the same search no matter how fast the threads are
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto work = [&](uint32_t t, BidirectionalAStar& bidir, TimeDepForward& unidir,
+                  GraphReader& graphreader, const mode_costing_t& costings,
+                  const std::function<void()>* leg_interrupt) {
+    try {
+      for (size_t i = t; i < parts.size(); i += thread_count) {
+        route_legs(parts[i], bidir, unidir, graphreader, costings, leg_interrupt);
+        if (!parts[i].found) {
+          break;
+        }
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+      helpers.cancel();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t + 1 < thread_count; ++t) {
+    threads.emplace_back([&, t]() {
+      auto& worker = *leg_workers_[t];
+      work(t + 1, worker.bidir_astar, worker.timedep_forward, worker.reader, worker.mode_costing,
+           helpers.callback());
+      helpers.done();
+    });
+  }
+  work(0, bidir_astar, timedep_forward, *reader, mode_costing, interrupt);
+  std::exception_ptr interrupted;
+  try {
+    helpers.wait();
+  } catch (...) { interrupted = std::current_exception(); }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (interrupted) {
+    std::rethrow_exception(interrupted);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  // the legs go the usual way which retries with the reachable candidates or fails
+  if (!std::all_of(parts.begin(), parts.end(), [](const legs_t& part) { return part.found; })) {
+    return false;
+  }
+
+  // stitch the legs in order and put back the locations the searches changed, the break
+  // location between two parts as the origin of the later one
+  bool relaxed = false;
+  bool limits_changed = false;
+  auto* route = api.mutable_trip()->mutable_routes()->Add();
+  route->mutable_legs()->Reserve(options.locations_size());
+  auto& locations = *api.mutable_options()->mutable_locations();
+  for (size_t i = 0; i < parts.size(); ++i) {
+    auto& part = parts[i];
+    relaxed = relaxed || part.relaxed;
+    limits_changed = limits_changed || (part.used_bidir && bidir_limits_changed) ||
+                     (part.used_unidir && unidir_limits_changed);
+    for (auto& leg : part.legs) {
+      route->mutable_legs()->Add()->Swap(&leg);
+    }
+    const size_t count = part.locations.size() - (i + 1 < parts.size() ? 1 : 0);
+    for (size_t j = 0; j < count; ++j) {
+      locations.Mutable(firsts[i] + j)->Swap(&part.locations[j]);
+    }
+  }
+  if (relaxed) {
+    add_warning(api, 401);
+  }
+  // maybe warn if we needed to change user provided hierarchy limits
+  if (limits_changed) {
+    add_warning(api, allow_hierarchy_limits_modifications ? 210 : 209);
+  }
+  return true;
+}
 } // namespace thor
 } // namespace valhalla
@@ -0,0 +1,251 @@
+#include "thor/routetree.h"
+#include "midgard/logging.h"
+#include "sif/recost.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace valhalla::baldr;
+using namespace valhalla::midgard;
+using namespace valhalla::sif;
+
+namespace {
+
+// the tree grows at least this far in meters, short batches would stop before the corners
+constexpr float kMinTreeDistance = 1000.f;
+
+} // namespace
+
+namespace valhalla {
+namespace thor {
+
+RouteTree::RouteTree(const boost::property_tree::ptree& config)
+    : Dijkstras(config), max_distance_(config.get<float>("route_tree.max_distance", 100000.f)),
+      max_stretch_(config.get<float>("route_tree.max_stretch", 3.f)), remaining_(0),
+      others_(nullptr), forward_(true), max_path_distance_(0) {
+}
+
+void RouteTree::Clear() {
+  targets_.clear();
+  target_edges_.clear();
+  shared_edges_.clear();
+  bounds_ = {};
+  others_ = nullptr;
+  remaining_ = 0;
+  Dijkstras::Clear();
+}
+
+void RouteTree::GetExpansionHints(uint32_t& bucket_count, uint32_t& edge_label_reservation) const {
+  bucket_count = 20000;
+  edge_label_reservation = kInitialEdgeLabelCountDijkstras;
+}
+
+std::vector<std::vector<PathInfo>>
+RouteTree::Paths(const ExpansionType expansion_type,
+                 valhalla::Location& shared,
+                 const google::protobuf::RepeatedPtrField<valhalla::Location>& others,
+                 const Options& options,
+                 GraphReader& reader,
+                 const mode_costing_t& mode_costing,
+                 const travel_mode_t mode) {
+  forward_ = expansion_type == ExpansionType::forward;
+  others_ = &others;
+  const auto& costing = mode_costing[static_cast<uint32_t>(mode)];
+
+  // the tree settles the path edge going forward and its opposing edge going in reverse
+  graph_tile_ptr tile;
+  auto tree_edge = [&](const GraphId& edge_id) {
+    return forward_ ? edge_id : reader.GetOpposingEdgeId(edge_id, tile);
+  };
+  for (const auto& edge : shared.correlation().edges()) {
+    const auto edge_id = tree_edge(GraphId(edge.graph_id()));
+    if (edge_id.is_valid()) {
+      shared_edges_.emplace(edge_id, std::make_pair(edge.percent_along(), edge.distance()));
+    }
+  }
+
+  // the candidate edges of the other locations, like the seeds a location at a node only keeps
+  // the edges leaving it as an origin and the ones entering it as a destination
+  const PointLL shared_ll(shared.ll().lng(), shared.ll().lat());
+  float farthest = 0.f;
+  targets_.assign(others.size(), {0, std::numeric_limits<float>::max(), 0.f, kInvalidLabel, -1,
+                                  false});
+  for (uint32_t i = 0; i < static_cast<uint32_t>(others.size()); ++i) {
+    const auto& location = others.Get(i);
+    const float distance = shared_ll.Distance(PointLL(location.ll().lng(), location.ll().lat()));
+    if (distance > max_distance_) {
+      continue;
+    }
+    farthest = std::max(farthest, distance);
+    const auto& edges = location.correlation().edges();
+    const bool off_node = std::any_of(edges.begin(), edges.end(), [this](const PathEdge& e) {
+      return forward_ ? !e.begin_node() : !e.end_node();
+    });
+    auto& target = targets_[i];
+    for (int c = 0; c < edges.size(); ++c) {
+      const auto& edge = edges.Get(c);
+      if (off_node && (forward_ ? edge.begin_node() : edge.end_node())) {
+        continue;
+      }
+      const GraphId edge_id(edge.graph_id());
+      const auto* directededge = reader.directededge(edge_id, tile);
+      const auto settled_id = tree_edge(edge_id);
+      if (directededge == nullptr || !settled_id.is_valid()) {
+        continue;
+      }
+      target_edges_[settled_id].emplace_back(i, c);
+      target.max_edge_cost =
+          std::max(target.max_edge_cost, costing->EdgeCost(directededge, edge_id, tile).cost);
+      ++target.pending;
+    }
+  }
+  remaining_ = 0;
+  for (auto& target : targets_) {
+    target.done = target.pending == 0;
+    remaining_ += !target.done;
+  }
+  max_path_distance_ = std::max(max_stretch_ * farthest, kMinTreeDistance);
+
+  // grow the tree from the shared location
+  google::protobuf::RepeatedPtrField<valhalla::Location> seeds;
+  seeds.Add()->CopyFrom(shared);
+  if (forward_) {
+    Compute<ExpansionType::forward>(seeds, reader, mode_costing, mode);
+  } else {
+    Compute<ExpansionType::reverse>(seeds, reader, mode_costing, mode);
+  }
+  shared.set_date_time(seeds.Get(0).date_time());
+
+  // the departure is only known going forward from the shared origin
+  const auto time_info =
+      forward_ ? TimeInfo::make(shared, reader, &tz_cache_) : TimeInfo::invalid();
+  std::vector<std::vector<PathInfo>> paths;
+  paths.reserve(others.size());
+  for (uint32_t i = 0; i < static_cast<uint32_t>(others.size()); ++i) {
+    paths.emplace_back(FormPath(others.Get(i), i, options, reader, time_info));
+  }
+  LOG_DEBUG("RouteTree labels::" + std::to_string(bdedgelabels_.size()));
+  return paths;
+}
+
+bool RouteTree::CostThrough(const BDEdgeLabel& label,
+                            const valhalla::PathEdge& candidate,
+                            float& cost) const {
+  // the label has the cost to the end of the edge going forward or from its start in reverse
+  const float along = forward_ ? 1.f - candidate.percent_along() : candidate.percent_along();
+  if (label.predecessor() == kInvalidLabel) {
+    // on the edge of the shared location the other one has to be ahead of it
+    const auto shared = shared_edges_.find(label.edgeid());
+    if (shared == shared_edges_.end()) {
+      return false;
+    }
+    const auto [shared_pct, shared_score] = shared->second;
+    const float shared_along = forward_ ? 1.f - shared_pct : shared_pct;
+    if (along > shared_along) {
+      return false;
+    }
+    // the seed also has the score of the shared location, keep it out of the part of the edge
+    const float partial = label.cost().cost - shared_score;
+    cost = label.cost().cost - (shared_along > 0.f ? partial * along / shared_along : 0.f);
+  } else {
+    const float edge_cost = label.cost().cost - label.transition_cost().cost -
+                            bdedgelabels_[label.predecessor()].cost().cost;
+    cost = label.cost().cost - edge_cost * along;
+  }
+  cost += candidate.distance();
+  return true;
+}
+
+ExpansionRecommendation RouteTree::ShouldExpand(GraphReader& /*reader*/,
+                                                const sif::EdgeLabel& pred,
+                                                const ExpansionType /*route_type*/) {
+  if (pred.path_distance() > max_path_distance_) {
+    return ExpansionRecommendation::stop_expansion;
+  }
+
+  // the other locations on this edge may have found their path
+  const auto found = target_edges_.find(pred.edgeid());
+  if (found != target_edges_.end()) {
+    const auto label_index = edgestatus_.Get(pred.edgeid()).index();
+    const auto& label = bdedgelabels_[label_index];
+    for (const auto& [other, c] : found->second) {
+      auto& target = targets_[other];
+      if (target.done) {
+        continue;
+      }
+      float cost;
+      if (CostThrough(label, others_->Get(other).correlation().edges(c), cost) &&
+          cost < target.best_cost) {
+        target.best_cost = cost;
+        target.best_label = label_index;
+        target.best_candidate = c;
+        bounds_.emplace(cost + target.max_edge_cost, other);
+      }
+      if (--target.pending == 0) {
+        target.done = true;
+        --remaining_;
+      }
+    }
+  }
+
+  // a candidate settled later can take at most its whole edge off its label
+  while (!bounds_.empty() && bounds_.top().first <= pred.cost().cost) {
+    auto& target = targets_[bounds_.top().second];
+    bounds_.pop();
+    if (!target.done) {
+      target.done = true;
+      --remaining_;
+    }
+  }
+  return remaining_ == 0 ? ExpansionRecommendation::stop_expansion
+                         : ExpansionRecommendation::continue_expansion;
+}
+
+std::vector<PathInfo> RouteTree::FormPath(const valhalla::Location& other,
+                                          const uint32_t other_index,
+                                          const Options& options,
+                                          GraphReader& reader,
+                                          const TimeInfo& time_info) const {
+  const auto& target = targets_[other_index];
+  if (target.best_label == kInvalidLabel) {
+    return {};
+  }
+
+  // walk the labels back to the shared location, going in reverse they are already in order
+  std::vector<GraphId> path_edges;
+  uint32_t seed = target.best_label;
+  for (auto l = target.best_label; l != kInvalidLabel; l = bdedgelabels_[l].predecessor()) {
+    const auto& label = bdedgelabels_[l];
+    path_edges.push_back(forward_ ? label.edgeid() : label.opp_edgeid());
+    seed = l;
+  }
+  if (forward_) {
+    std::reverse(path_edges.begin(), path_edges.end());
+  }
+  const float shared_pct = shared_edges_.at(bdedgelabels_[seed].edgeid()).first;
+  const float other_pct = other.correlation().edges(target.best_candidate).percent_along();
+
+  std::vector<PathInfo> path;
+  path.reserve(path_edges.size());
+  auto edge_itr = path_edges.begin();
+  const auto edge_cb = [&edge_itr, &path_edges]() {
+    return (edge_itr == path_edges.end()) ? GraphId{} : (*edge_itr++);
+  };
+  const auto label_cb = [&path](const PathEdgeLabel& label) {
+    path.emplace_back(label.mode(), label.cost(), label.edgeid(), 0, label.path_distance(),
+                      label.restriction_idx(), label.transition_cost());
+  };
+
+  try {
+    recost_forward(reader, *costing_, edge_cb, label_cb, forward_ ? shared_pct : other_pct,
+                   forward_ ? other_pct : shared_pct, time_info,
+                   options.date_time_type() == Options::invariant, true);
+  } catch (const std::exception& e) {
+    LOG_ERROR(std::string("RouteTree failed to recost a path: ") + e.what());
+    return {};
+  }
+  return path;
+}
+
+} // namespace thor
+} // namespace valhalla
@@ -1,8 +1,13 @@
 #include "thor/timedistancematrix.h"
 #include "baldr/datetime.h"
+#include "helper_interrupt.h"
 #include "midgard/logging.h"
 
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 using namespace valhalla::baldr;
@@ -12,11 +17,23 @@ namespace valhalla {
 namespace thor {
 
 // Constructor with cost threshold.
-TimeDistanceMatrix::TimeDistanceMatrix(const boost::property_tree::ptree& config)
+TimeDistanceMatrix::TimeDistanceMatrix(const boost::property_tree::ptree& config,
+                                       std::pmr::memory_resource* arena)
     : MatrixAlgorithm(config), settled_count_(0), current_cost_threshold_(0),
       max_reserved_labels_count_(config.get<uint32_t>("max_reserved_labels_count_dijkstras",
                                                       kInitialEdgeLabelCountDijkstras)),
-      mode_(travel_mode_t::kDrive) {
+      arena_(arena), edgelabels_(arena ? arena : std::pmr::get_default_resource()),
+      mode_(travel_mode_t::kDrive),
+      concurrency_(std::max(config.get<uint32_t>("timedistancematrix.concurrency", 1), 1u)),
+      profile_(false),
+      profile_lanes_(std::max(config.get<uint32_t>("timedistancematrix.profile_lanes", 16), 1u)) {
+  adjacencylist_.set_type(baldr::to_label_queue_type(
+      config.get<std::string>("timedistancematrix.queue", "double_bucket")));
+  // the matrices of the other threads search from one origin at a time each
+  if (concurrency_ > 1) {
+    worker_config_ = config;
+    worker_config_.put("timedistancematrix.concurrency", 1);
+  }
 }
 
 // Compute a cost threshold in seconds based on average speed for the travel mode.
@@ -198,8 +215,6 @@ bool TimeDistanceMatrix::ComputeMatrix(Api& request,
   bool invariant = request.options().date_time_type() == Options::invariant;
   uint32_t matrix_locations = request.options().matrix_locations();
 
-  uint32_t bucketsize = costing_->UnitSize();
-
   auto& origins = FORWARD ? *request.mutable_options()->mutable_sources()
                           : *request.mutable_options()->mutable_targets();
   auto& destinations = FORWARD ? *request.mutable_options()->mutable_targets()
@@ -214,103 +229,524 @@ bool TimeDistanceMatrix::ComputeMatrix(Api& request,
   reserve_pbf_arrays(*request.mutable_matrix(), num_elements, request.options().verbose(),
                      costing_->pass());
 
-  for (int origin_index = 0; origin_index < origins.size(); ++origin_index) {
-    // reserve some space for the next dijkstras (will be cleared at the end of the loop)
-    edgelabels_.reserve(max_reserved_labels_count_);
-    auto& origin = origins.Get(origin_index);
-    const auto& time_info = time_infos[origin_index];
+  // the searches from the origins are independent of each other, with several threads each one
+  // takes the next origin and writes its own row or column of the matrix
+  valhalla::Matrix& matrix = *request.mutable_matrix();
+  const uint32_t thread_count =
+      std::min(concurrency_, static_cast<uint32_t>(std::max(origins.size(), 1)));
+  if (thread_count > 1 && !reader_config_.empty()) {
+    while (workers_.size() + 1 < thread_count) {
+      workers_.emplace_back(std::make_unique<TimeDistanceMatrix>(worker_config_));
+      readers_.emplace_back(std::make_unique<GraphReader>(reader_config_));
+    }
+    // the other threads stop with the request when it gets interrupted
+    helper_interrupt_t helpers(interrupt_, thread_count - 1);
+    for (uint32_t t = 0; t + 1 < thread_count; ++t) {
+      auto& worker = *workers_[t];
+      worker.set_interrupt(helpers.callback());
+      worker.mode_ = mode_;
+      worker.costing_ = costing_;
+      worker.max_expansion_distance_ = max_expansion_distance_;
+      worker.InitDestinations<expansion_direction>(*readers_[t], destinations);
+    }
 
-    current_cost_threshold_ = GetCostThreshold(max_matrix_distance);
+    std::atomic<int> next{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto work = [&](TimeDistanceMatrix& search, GraphReader& reader) {
+      for (int origin_index = next++; origin_index < origins.size(); origin_index = next++) {
+        try {
+          // the time zone offsets along the paths go to the cache of the search's own thread
+          auto time_info = time_infos[origin_index];
+          time_info.tz_cache = &search.tz_cache_;
+          if (profile_) {
+            search.ComputeProfile(request.options(), matrix, reader, origin_index, time_info,
+                                  max_matrix_distance);
+          } else {
+            search.ComputeOrigin<expansion_direction>(request.options(), matrix, reader,
+                                                      origin_index, time_info, max_matrix_distance,
+                                                      invariant, matrix_locations);
+          }
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(error_mutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+          next = origins.size();
+          helpers.cancel();
+        }
+      }
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t + 1 < thread_count; ++t) {
+      threads.emplace_back([&, t]() {
+        work(*workers_[t], *readers_[t]);
+        helpers.done();
+      });
+    }
+    work(*this, graphreader);
+    std::exception_ptr interrupted;
+    try {
+      helpers.wait();
+    } catch (...) { interrupted = std::current_exception(); }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    if (interrupted) {
+      std::rethrow_exception(interrupted);
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  } else {
+    for (int origin_index = 0; origin_index < origins.size(); ++origin_index) {
+      if (profile_) {
+        ComputeProfile(request.options(), matrix, graphreader, origin_index,
+                       time_infos[origin_index], max_matrix_distance);
+      } else {
+        ComputeOrigin<expansion_direction>(request.options(), matrix, graphreader, origin_index,
+                                           time_infos[origin_index], max_matrix_distance, invariant,
+                                           matrix_locations);
+      }
+    }
+  }
+
+  // TODO(nils): implement second pass here too
+  return true;
+}
 
-    // Construct adjacency list. Set bucket size and cost range based on DynamicCost.
+// Find the times and distances from one origin to all destinations
+template <const ExpansionType expansion_direction, const bool FORWARD>
+void TimeDistanceMatrix::ComputeOrigin(const valhalla::Options& options,
+                                       valhalla::Matrix& matrix,
+                                       baldr::GraphReader& graphreader,
+                                       const int origin_index,
+                                       const baldr::TimeInfo& time_info,
+                                       const float max_matrix_distance,
+                                       const bool invariant,
+                                       const uint32_t matrix_locations) {
+  const auto& origins = FORWARD ? options.sources() : options.targets();
+  const auto& destinations = FORWARD ? options.targets() : options.sources();
+  const uint32_t bucketsize = costing_->UnitSize();
+
+  // reserve some space for the next dijkstras (will be cleared at the end of the loop)
+  edgelabels_.reserve(max_reserved_labels_count_);
+  auto& origin = origins.Get(origin_index);
+
+  current_cost_threshold_ = GetCostThreshold(max_matrix_distance);
+
+  // Construct adjacency list. Set bucket size and cost range based on DynamicCost.
+  adjacencylist_.reuse(0.0f, current_cost_threshold_, bucketsize, &edgelabels_);
+
+  // Initialize the origin and set the available destination edges
+  settled_count_ = 0;
+  SetOrigin<expansion_direction>(graphreader, origin, time_info);
+  SetDestinationEdges();
+
+  uint32_t n = 0;
+  // Collect edge_ids used for settling a location to determine its time zone
+  std::unordered_map<uint32_t, baldr::GraphId> dest_edge_ids;
+  dest_edge_ids.reserve(destinations.size());
+
+  // Find shortest path
+  graph_tile_ptr tile;
+  while (true) {
+    // Get next element from adjacency list. Check that it is valid. An
+    // invalid label indicates there are no edges that can be expanded.
+    uint32_t predindex = adjacencylist_.pop();
+    if (predindex == kInvalidLabel) {
+      // Can not expand any further...
+      FormTimeDistanceMatrix(options, matrix, graphreader, FORWARD, origin_index,
+                             origin.date_time(), time_info.timezone_index, dest_edge_ids);
+      break;
+    }
+
+    // Copy the EdgeLabel for use in costing
+    EdgeLabel pred = edgelabels_[predindex];
+
+    // Remove label from adjacency list, mark it as permanently labeled.
+
+    // Mark the edge as permanently labeled. Do not do this for an origin
+    // edge. Otherwise loops/around the block cases will not work
+    if (!pred.origin()) {
+      edgestatus_.Update(pred.edgeid(), EdgeSet::kPermanent);
+    }
+
+    // Identify any destinations on this edge
+    auto destedge = dest_edges_.find(pred.edgeid());
+    if (destedge != dest_edges_.end()) {
+      // Update any destinations along this edge. Return if all destinations
+      // have been settled or the requested amount of destinations has been found
+      tile = graphreader.GetGraphTile(pred.edgeid());
+      const DirectedEdge* edge = tile->directededge(pred.edgeid());
+
+      for (auto& dest_id : destedge->second) {
+        dest_edge_ids[dest_id] = pred.edgeid();
+      }
+      if (UpdateDestinations<expansion_direction>(origin, destinations, destedge->second, edge,
+                                                  tile, graphreader, pred, time_info,
+                                                  matrix_locations)) {
+        FormTimeDistanceMatrix(options, matrix, graphreader, FORWARD, origin_index,
+                               origin.date_time(), time_info.timezone_index, dest_edge_ids);
+        break;
+      }
+    }
+
+    // Terminate when we are beyond the cost threshold
+    if (pred.cost().cost > current_cost_threshold_) {
+      FormTimeDistanceMatrix(options, matrix, graphreader, FORWARD, origin_index,
+                             origin.date_time(), time_info.timezone_index, dest_edge_ids);
+      break;
+    }
+
+    // Expand forward from the end node of the predecessor edge.
+    Expand<expansion_direction>(graphreader, pred.endnode(), pred, predindex, false, time_info,
+                                invariant);
+
+    // Allow this process to be aborted
+    if (interrupt_ && (n++ % kInterruptIterationsInterval) == 0) {
+      (*interrupt_)();
+    }
+  }
+
+  reset();
+}
+
+template bool
+TimeDistanceMatrix::ComputeMatrix<ExpansionType::forward, true>(Api& request,
+                                                                baldr::GraphReader& graphreader,
+                                                                const float max_matrix_distance);
+template bool
+TimeDistanceMatrix::ComputeMatrix<ExpansionType::reverse, false>(Api& request,
+                                                                 baldr::GraphReader& graphreader,
+                                                                 const float max_matrix_distance);
+
+// Find the times and distances from one source to all targets for every departure of the profile
+void TimeDistanceMatrix::ComputeProfile(const valhalla::Options& options,
+                                        valhalla::Matrix& matrix,
+                                        baldr::GraphReader& graphreader,
+                                        const int origin_index,
+                                        const baldr::TimeInfo& time_info,
+                                        const float max_matrix_distance) {
+  const auto& origin = options.sources(origin_index);
+  const auto& destinations = options.targets();
+  const uint32_t departures = options.profile_departures();
+  const float interval = options.profile_interval() * midgard::kSecPerMinute;
+  const uint32_t bucketsize = costing_->UnitSize();
+
+  uint32_t n = 0;
+  for (uint32_t first = 0; first < departures; first += profile_lanes_) {
+    const uint32_t lanes = std::min(profile_lanes_, departures - first);
+    departures_.clear();
+    for (uint32_t lane = 0; lane < lanes; ++lane) {
+      departures_.push_back(time_info.forward((first + lane) * interval, time_info.timezone_index));
+    }
+    dest_lanes_.assign(destinations_.size() * lanes, {{kMaxCost, kMaxCost}, 0, 0.f});
+    edge_lanes_.resize(lanes);
+    node_times_.resize(lanes);
+
+    edgelabels_.reserve(max_reserved_labels_count_);
+    label_lanes_.reserve(max_reserved_labels_count_ * lanes);
+    current_cost_threshold_ = GetCostThreshold(max_matrix_distance);
     adjacencylist_.reuse(0.0f, current_cost_threshold_, bucketsize, &edgelabels_);
 
-    // Initialize the origin and set the available destination edges
-    settled_count_ = 0;
-    SetOrigin<expansion_direction>(graphreader, origin, time_info);
-    SetDestinationEdges();
+    // the origin edges cost what they do at every departure, each starts at its cheapest
+    SetOrigin<ExpansionType::forward>(graphreader, origin, departures_.front());
+    for (uint32_t idx = 0; idx < edgelabels_.size(); ++idx) {
+      auto& label = edgelabels_[idx];
+      const auto edge = std::find_if(origin.correlation().edges().begin(),
+                                     origin.correlation().edges().end(),
+                                     [&label](const valhalla::PathEdge& e) {
+                                       return GraphId(e.graph_id()) == label.edgeid();
+                                     });
+      graph_tile_ptr tile = graphreader.GetGraphTile(label.edgeid());
+      const DirectedEdge* directededge = tile->directededge(label.edgeid());
+      Cost best{kMaxCost, kMaxCost};
+      for (const auto& departure : departures_) {
+        uint8_t flow_sources;
+        auto cost = costing_->PartialEdgeCost(directededge, label.edgeid(), tile, departure,
+                                              flow_sources, edge->percent_along(), 1.0f);
+        cost.cost += edge->distance();
+        label_lanes_.push_back({cost, label.path_distance(), 0.f});
+        best = cost.cost < best.cost ? cost : best;
+      }
+      if (best.cost < label.sortcost()) {
+        adjacencylist_.decrease(idx, best.cost);
+      }
+      label.Update(kInvalidLabel, best, best.cost, label.path_distance(), kInvalidRestriction);
+    }
 
-    uint32_t n = 0;
-    // Collect edge_ids used for settling a location to determine its time zone
+    // the edges the destinations were reached on, for their time zones
     std::unordered_map<uint32_t, baldr::GraphId> dest_edge_ids;
-    dest_edge_ids.reserve(destinations.size());
-
-    // Find shortest path
-    graph_tile_ptr tile;
     while (true) {
-      // Get next element from adjacency list. Check that it is valid. An
-      // invalid label indicates there are no edges that can be expanded.
-      uint32_t predindex = adjacencylist_.pop();
+      const uint32_t predindex = adjacencylist_.pop();
       if (predindex == kInvalidLabel) {
-        // Can not expand any further...
-        FormTimeDistanceMatrix(request, graphreader, FORWARD, origin_index, origin.date_time(),
-                               time_info.timezone_index, dest_edge_ids);
         break;
       }
 
-      // Copy the EdgeLabel for use in costing
-      EdgeLabel pred = edgelabels_[predindex];
-
-      // Remove label from adjacency list, mark it as permanently labeled.
-
-      // Mark the edge as permanently labeled. Do not do this for an origin
-      // edge. Otherwise loops/around the block cases will not work
+      // a label is popped by the cheapest of its lanes that got cheaper since it was last
+      // expanded, the others can only have got more expensive paths which it is done with
+      const EdgeLabel& pred = edgelabels_[predindex];
+      const float key = pred.sortcost();
       if (!pred.origin()) {
         edgestatus_.Update(pred.edgeid(), EdgeSet::kPermanent);
       }
 
-      // Identify any destinations on this edge
       auto destedge = dest_edges_.find(pred.edgeid());
       if (destedge != dest_edges_.end()) {
-        // Update any destinations along this edge. Return if all destinations
-        // have been settled or the requested amount of destinations has been found
-        tile = graphreader.GetGraphTile(pred.edgeid());
-        const DirectedEdge* edge = tile->directededge(pred.edgeid());
-
-        for (auto& dest_id : destedge->second) {
-          dest_edge_ids[dest_id] = pred.edgeid();
-        }
-        if (UpdateDestinations<expansion_direction>(origin, destinations, destedge->second, edge,
-                                                    tile, graphreader, pred, time_info,
-                                                    matrix_locations)) {
-          FormTimeDistanceMatrix(request, graphreader, FORWARD, origin_index, origin.date_time(),
-                                 time_info.timezone_index, dest_edge_ids);
-          break;
-        }
+        current_cost_threshold_ =
+            std::min(current_cost_threshold_,
+                     UpdateProfileDestinations(origin, destinations, destedge->second, graphreader,
+                                               predindex, dest_edge_ids));
       }
 
-      // Terminate when we are beyond the cost threshold
-      if (pred.cost().cost > current_cost_threshold_) {
-        FormTimeDistanceMatrix(request, graphreader, FORWARD, origin_index, origin.date_time(),
-                               time_info.timezone_index, dest_edge_ids);
+      if (key > current_cost_threshold_) {
         break;
       }
 
-      // Expand forward from the end node of the predecessor edge.
-      Expand<expansion_direction>(graphreader, pred.endnode(), pred, predindex, false, time_info,
-                                  invariant);
+      ExpandProfile(graphreader, edgelabels_[predindex].endnode(), predindex, false);
 
-      // Allow this process to be aborted
       if (interrupt_ && (n++ % kInterruptIterationsInterval) == 0) {
         (*interrupt_)();
       }
     }
 
+    // the first departure is the one of the matrix itself
+    for (uint32_t i = 0; i < destinations_.size(); ++i) {
+      for (uint32_t lane = 0; lane < lanes; ++lane) {
+        const auto& dest = dest_lanes_[i * lanes + lane];
+        const auto idx = (origin_index * destinations.size() + i) * departures + first + lane;
+        matrix.mutable_profile_times()->Set(idx, dest.cost.secs);
+        matrix.mutable_profile_distances()->Set(idx, dest.distance);
+      }
+      if (first == 0) {
+        destinations_[i].best_cost = dest_lanes_[i * lanes].cost;
+        destinations_[i].distance = dest_lanes_[i * lanes].distance;
+      }
+    }
+    if (first == 0) {
+      FormTimeDistanceMatrix(options, matrix, graphreader, true, origin_index, origin.date_time(),
+                             time_info.timezone_index, dest_edge_ids);
+    }
     reset();
   }
+}
 
-  // TODO(nils): implement second pass here too
-  return true;
+// Relax the edges leaving a node for every departure
+void TimeDistanceMatrix::ExpandProfile(GraphReader& graphreader,
+                                       const GraphId& node,
+                                       const uint32_t pred_idx,
+                                       const bool from_transition) {
+  graph_tile_ptr tile = graphreader.GetGraphTile(node);
+  if (tile == nullptr) {
+    return;
+  }
+  const NodeInfo* nodeinfo = tile->node(node);
+  if (!costing_->Allowed(nodeinfo)) {
+    return;
+  }
+
+  // the time every departure gets to the node at
+  const uint32_t lanes = departures_.size();
+  for (uint32_t lane = 0; lane < lanes; ++lane) {
+    node_times_[lane] =
+        departures_[lane].forward(label_lanes_[pred_idx * lanes + lane].cost.secs,
+                                  static_cast<int>(nodeinfo->timezone()));
+  }
+
+  GraphId edgeid(node.tileid(), node.level(), nodeinfo->edge_index());
+  EdgeStatusInfo* es = edgestatus_.GetPtr(edgeid, tile);
+  const DirectedEdge* directededge = tile->directededge(nodeinfo->edge_index());
+  for (uint32_t i = 0; i < nodeinfo->edge_count(); i++, directededge++, ++edgeid, ++es) {
+    // permanent labels are reopened if any departure gets there cheaper
+    if (directededge->is_shortcut()) {
+      continue;
+    }
+
+    // the labels can grow below, only keep the index of the predecessor around
+    const EdgeLabel& pred = edgelabels_[pred_idx];
+    const bool is_dest = dest_edges_.find(edgeid) != dest_edges_.cend();
+    auto reader_getter = [&graphreader]() { return baldr::LimitedGraphReader(graphreader); };
+    bool transition_costed = false;
+    Cost transition_cost;
+    uint32_t best_lane = lanes;
+    uint8_t best_restriction_idx = kInvalidRestriction;
+    uint8_t best_destonly_restriction_mask = 0;
+    uint8_t best_flow_sources = 0;
+    for (uint32_t lane = 0; lane < lanes; ++lane) {
+      const auto& from = label_lanes_[pred_idx * lanes + lane];
+      auto& to = edge_lanes_[lane];
+      to = {{kMaxCost, kMaxCost}, 0, 0.f};
+      if (from.cost.cost == kMaxCost) {
+        continue;
+      }
+
+      const auto& time = node_times_[lane];
+      uint8_t restriction_idx = kInvalidRestriction;
+      uint8_t destonly_restriction_mask = pred.destonly_access_restr_mask();
+      if (!costing_->Allowed(directededge, is_dest, pred, tile, edgeid, time.local_time,
+                             nodeinfo->timezone(), restriction_idx, destonly_restriction_mask) ||
+          costing_->Restricted(directededge, pred, edgelabels_, tile, edgeid, true, nullptr,
+                               time.local_time, nodeinfo->timezone())) {
+        continue;
+      }
+      const uint32_t path_distance = from.distance + directededge->length();
+      if (max_expansion_distance_ > 0 && path_distance > max_expansion_distance_) {
+        continue;
+      }
+
+      // the turn costs the same at any time
+      if (!transition_costed) {
+        transition_cost = costing_->TransitionCost(directededge, nodeinfo, pred, tile, reader_getter);
+        transition_costed = true;
+      }
+      uint8_t flow_sources;
+      to.cost = from.cost + transition_cost +
+                costing_->EdgeCost(directededge, edgeid, tile, time, flow_sources);
+      to.distance = path_distance;
+      to.start_secs = from.cost.secs;
+      if (best_lane == lanes || to.cost.cost < edge_lanes_[best_lane].cost.cost) {
+        best_lane = lane;
+        best_restriction_idx = restriction_idx;
+        best_destonly_restriction_mask = destonly_restriction_mask;
+        best_flow_sources = flow_sources;
+      }
+    }
+    if (best_lane == lanes) {
+      continue;
+    }
+    const auto& best = edge_lanes_[best_lane];
+
+    // keep the lanes that got cheaper, the label is queued again by the cheapest of them
+    if (es->set() == EdgeSet::kTemporary || es->set() == EdgeSet::kPermanent) {
+      const uint32_t idx = es->index();
+      float key = kMaxCost;
+      for (uint32_t lane = 0; lane < lanes; ++lane) {
+        auto& lane_label = label_lanes_[idx * lanes + lane];
+        if (edge_lanes_[lane].cost.cost < lane_label.cost.cost) {
+          lane_label = edge_lanes_[lane];
+          key = std::min(key, lane_label.cost.cost);
+        }
+      }
+      if (key == kMaxCost) {
+        continue;
+      }
+
+      auto& lab = edgelabels_[idx];
+      const bool permanent = es->set() == EdgeSet::kPermanent;
+      const float sortcost = permanent ? key : std::min(key, lab.sortcost());
+      if (!permanent && sortcost < lab.sortcost()) {
+        adjacencylist_.decrease(idx, sortcost);
+      }
+      // the cheapest departure decides the predecessor
+      if (best.cost.cost < lab.cost().cost) {
+        lab.Update(pred_idx, best.cost, sortcost, best.distance, best_restriction_idx);
+      } else {
+        lab.Update(lab.predecessor(), lab.cost(), sortcost, lab.path_distance(),
+                   lab.restriction_idx());
+      }
+      if (permanent) {
+        *es = {EdgeSet::kTemporary, idx};
+        adjacencylist_.add(idx);
+      }
+      continue;
+    }
+
+    uint32_t idx = edgelabels_.size();
+    edgelabels_.emplace_back(pred_idx, edgeid, directededge, best.cost, best.cost.cost, mode_,
+                             best.distance, best_restriction_idx,
+                             (pred.closure_pruning() || !(costing_->IsClosed(directededge, tile))),
+                             0 != (best_flow_sources & kDefaultFlowMask),
+                             costing_->TurnType(pred.opp_local_idx(), nodeinfo, directededge), 0,
+                             directededge->destonly() ||
+                                 (costing_->is_hgv() && directededge->destonly_hgv()),
+                             directededge->forwardaccess() & kTruckAccess,
+                             best_destonly_restriction_mask);
+    label_lanes_.insert(label_lanes_.end(), edge_lanes_.begin(), edge_lanes_.end());
+    *es = {EdgeSet::kTemporary, idx};
+    adjacencylist_.add(idx);
+  }
+
+  // Handle transitions - expand from the end node each transition
+  if (!from_transition && nodeinfo->transition_count() > 0) {
+    const NodeTransition* trans = tile->transition(nodeinfo->transition_index());
+    for (uint32_t i = 0; i < nodeinfo->transition_count(); ++i, ++trans) {
+      ExpandProfile(graphreader, trans->endnode(), pred_idx, true);
+    }
+  }
 }
 
-template bool
-TimeDistanceMatrix::ComputeMatrix<ExpansionType::forward, true>(Api& request,
-                                                                baldr::GraphReader& graphreader,
-                                                                const float max_matrix_distance);
-template bool
-TimeDistanceMatrix::ComputeMatrix<ExpansionType::reverse, false>(Api& request,
-                                                                 baldr::GraphReader& graphreader,
-                                                                 const float max_matrix_distance);
+// Update every departure to the destinations along the edge of a label
+float TimeDistanceMatrix::UpdateProfileDestinations(
+    const valhalla::Location& origin,
+    const google::protobuf::RepeatedPtrField<valhalla::Location>& locations,
+    const std::vector<uint32_t>& destinations,
+    GraphReader& reader,
+    const uint32_t pred_idx,
+    std::unordered_map<uint32_t, GraphId>& edge_ids) {
+  const EdgeLabel& pred = edgelabels_[pred_idx];
+  const uint32_t lanes = departures_.size();
+  graph_tile_ptr tile = reader.GetGraphTile(pred.edgeid());
+  const DirectedEdge* edge = tile->directededge(pred.edgeid());
+  for (auto dest_idx : destinations) {
+    Destination& dest = destinations_[dest_idx];
+    const auto& dest_loc = locations.Get(dest_idx);
+    auto dest_edge = dest.dest_edges_percent_along.find(pred.edgeid());
+    if (dest_edge == dest.dest_edges_percent_along.end()) {
+      continue;
+    }
+
+    if (origin.ll().lat() == dest_loc.ll().lat() && origin.ll().lng() == dest_loc.ll().lng()) {
+      for (uint32_t lane = 0; lane < lanes; ++lane) {
+        dest_lanes_[dest_idx * lanes + lane] = {{0.f, 0.f}, 0, 0.f};
+      }
+      edge_ids[dest_idx] = pred.edgeid();
+      continue;
+    }
+
+    // the destination is only behind the origin on the same edge with a trivial path
+    if (pred.predecessor() == kInvalidLabel && !IsTrivial(pred.edgeid(), origin, dest_loc)) {
+      continue;
+    }
+
+    // take off the remainder of the edge at the time every departure entered it
+    const float remainder = dest_edge->second;
+    auto opp_edge_id = reader.GetOpposingEdgeId(pred.edgeid());
+    auto opp_tile = reader.GetGraphTile(opp_edge_id);
+    auto begin_node = reader.GetBeginNodeId(edge, opp_tile);
+    const int timezone_index = opp_tile->node(begin_node)->timezone();
+    for (uint32_t lane = 0; lane < lanes; ++lane) {
+      const auto& label_lane = label_lanes_[pred_idx * lanes + lane];
+      if (label_lane.cost.cost == kMaxCost) {
+        continue;
+      }
+      uint8_t flow_sources;
+      const auto offset_time = departures_[lane].forward(label_lane.start_secs, timezone_index);
+      const Cost cost =
+          label_lane.cost -
+          (costing_->EdgeCost(edge, pred.edgeid(), tile, offset_time, flow_sources) * remainder);
+      auto& dest_lane = dest_lanes_[dest_idx * lanes + lane];
+      if (cost.cost < dest_lane.cost.cost) {
+        dest_lane = {cost, static_cast<uint32_t>(label_lane.distance - edge->length() * remainder),
+                     label_lane.start_secs};
+        edge_ids[dest_idx] = pred.edgeid();
+      }
+    }
+  }
+
+  // no departure gets any cheaper to a destination past its threshold
+  float maxcost = 0.0f;
+  for (uint32_t i = 0; i < destinations_.size(); ++i) {
+    for (uint32_t lane = 0; lane < lanes; ++lane) {
+      const auto& dest_lane = dest_lanes_[i * lanes + lane];
+      if (dest_lane.cost.cost == kMaxCost) {
+        return kMaxCost;
+      }
+      maxcost = std::max(maxcost, dest_lane.cost.cost + destinations_[i].threshold);
+    }
+  }
+  return maxcost;
+}
 
 // Add edges at the origin to the adjacency list
 template <const ExpansionType expansion_direction, const bool FORWARD>
@@ -598,7 +1034,8 @@ bool TimeDistanceMatrix::UpdateDestinations(
 }
 
 // Form the time, distance matrix from the destinations list
-void TimeDistanceMatrix::FormTimeDistanceMatrix(Api& request,
+void TimeDistanceMatrix::FormTimeDistanceMatrix(const valhalla::Options& options,
+                                                valhalla::Matrix& matrix,
                                                 GraphReader& reader,
                                                 const bool forward,
                                                 const uint32_t origin_index,
@@ -607,12 +1044,11 @@ void TimeDistanceMatrix::FormTimeDistanceMatrix(Api& request,
                                                 std::unordered_map<uint32_t, GraphId>& edge_ids) {
   // when it's forward, origin_index will be the source_index
   // when it's reverse, origin_index will be the target_index
-  valhalla::Matrix& matrix = *request.mutable_matrix();
   graph_tile_ptr tile;
   for (uint32_t i = 0; i < destinations_.size(); i++) {
     auto& dest = destinations_[i];
-    auto pbf_idx = forward ? (origin_index * request.options().targets().size()) + i
-                           : (i * request.options().targets().size()) + origin_index;
+    auto pbf_idx = forward ? (origin_index * options.targets().size()) + i
+                           : (i * options.targets().size()) + origin_index;
     matrix.mutable_from_indices()->Set(pbf_idx, forward ? origin_index : i);
     matrix.mutable_to_indices()->Set(pbf_idx, forward ? i : origin_index);
     matrix.mutable_distances()->Set(pbf_idx, dest.distance);
@@ -4,6 +4,8 @@
 
 #include <boost/property_tree/ptree.hpp>
 
+#include <algorithm>
+#include <filesystem>
 #include <functional>
 #include <stdexcept>
 #include <string>
@@ -52,6 +54,13 @@ std::string serialize_to_pbf(Api& request) {
 };
 #endif
 
+// the path algorithms allocate their labels from the request arena when it may keep some memory
+// between requests, otherwise they keep their own reservations on the heap
+std::pmr::memory_resource* label_arena(const boost::property_tree::ptree& config,
+                                       valhalla::midgard::request_arena_t& arena) {
+  return config.get<size_t>("thor.max_reserved_arena_size", 0) ? &arena : nullptr;
+}
+
 } // namespace
 
 namespace valhalla {
@@ -59,12 +68,24 @@ namespace thor {
 
 thor_worker_t::thor_worker_t(const boost::property_tree::ptree& config,
                              const std::shared_ptr<baldr::GraphReader>& graph_reader)
-    : service_worker_t(config), mode(valhalla::sif::TravelMode::kPedestrian),
-      bidir_astar(config.get_child("thor")), multimodal_astar(config.get_child("thor")),
-      multi_modal_transit(config.get_child("thor")), timedep_forward(config.get_child("thor")),
-      timedep_reverse(config.get_child("thor")), costmatrix_(config.get_child("thor")),
-      time_distance_matrix_(config.get_child("thor")),
-      time_distance_bss_matrix_(config.get_child("thor")), isochrone_gen(config.get_child("thor")),
+    : service_worker_t(config, config.get<size_t>("thor.max_reserved_arena_size", 0)),
+      mode(valhalla::sif::TravelMode::kPedestrian),
+      overlay_(config.get_child("thor"),
+               baldr::PartitionOverlay::FileName(config.get_child("mjolnir"))),
+      bidir_astar(config.get_child("thor"), label_arena(config, arena)),
+      multimodal_astar(config.get_child("thor")), multi_modal_transit(config.get_child("thor")),
+      raptor(config.get_child("thor")),
+      timedep_forward(config.get_child("thor")), timedep_reverse(config.get_child("thor")),
+      costmatrix_(config.get_child("thor"), label_arena(config, arena)),
+      time_distance_matrix_(config.get_child("thor"), label_arena(config, arena)),
+      time_distance_bss_matrix_(config.get_child("thor")),
+      ch_matrix_(config.get_child("thor"),
+                 baldr::ContractionHierarchy::Directory(config.get_child("mjolnir"))),
+      phast_matrix_(config.get_child("thor"), ch_matrix_),
+      overlay_matrix_(config.get_child("thor"), overlay_),
+      matrix_cache_(config.get_child("thor")),
+      isochrone_gen(config.get_child("thor"), label_arena(config, arena)),
+      route_tree_(config.get_child("thor")),
       reader(graph_reader ? graph_reader
                           : std::make_shared<baldr::GraphReader>(config.get_child("mjolnir"))),
       matcher_factory(config, reader), controller{},
@@ -84,7 +105,7 @@ thor_worker_t::thor_worker_t(const boost::property_tree::ptree& config,
         kv.first == "isochrone" || kv.first == "centroid" || kv.first == "status" ||
         kv.first == "max_distance_disable_hierarchy_culling" || kv.first == "allow_hard_exclusions" ||
         kv.first == "hierarchy_limits" || kv.first == "min_linear_cost_factor" ||
-        kv.first == "max_linear_cost_edges") {
+        kv.first == "max_linear_cost_edges" || kv.first == "max_profile_departures") {
       continue;
     }
 
@@ -101,6 +122,12 @@ thor_worker_t::thor_worker_t(const boost::property_tree::ptree& config,
   }
 
   costmatrix_allow_second_pass = config.get<bool>("thor.costmatrix.allow_second_pass", false);
+  costmatrix_max_block_locations = config.get<uint32_t>("thor.costmatrix.max_block_locations", 0);
+  isochrone_concurrency = std::max(config.get<uint32_t>("thor.isochrone.concurrency", 1), 1u);
+  optimizer_concurrency = std::max(config.get<uint32_t>("thor.optimizer.concurrency", 1), 1u);
+  route_concurrency = std::max(config.get<uint32_t>("thor.route.concurrency", 1), 1u);
+  optimizer_time_budget =
+      std::chrono::milliseconds(config.get<uint32_t>("thor.optimizer.time_budget", 1000));
 
   max_timedep_distance =
       config.get<float>("service_limits.max_timedep_distance", kDefaultMaxTimeDependentDistance);
@@ -111,6 +138,31 @@ thor_worker_t::thor_worker_t(const boost::property_tree::ptree& config,
   hierarchy_limits_config_bidirectional_astar =
       parse_hierarchy_limits_from_config(config, "bidirectional_astar", true);
 
+  // routes without a time take the overlay if there is one
+  bidir_astar.set_overlay(&overlay_);
+
+  // the ALT heuristics need the landmark distances, without them they fall back to distance
+  const auto alt_file = baldr::AltLandmarks::FileName(config.get_child("mjolnir"));
+  if (!alt_file.empty() && std::filesystem::exists(alt_file)) {
+    try {
+      alt_landmarks_ = std::make_unique<baldr::AltLandmarks>(alt_file);
+    } catch (const std::exception& e) {
+      LOG_WARN("Could not load the landmarks in " + alt_file + ": " + e.what());
+    }
+  }
+  bidir_astar.set_landmarks(alt_landmarks_.get());
+  costmatrix_.set_landmarks(alt_landmarks_.get());
+
+  // the threads of the matrices and of the reverse tree of a route each read the graph on their own
+  costmatrix_.set_reader_config(config.get_child("mjolnir"));
+  time_distance_matrix_.set_reader_config(config.get_child("mjolnir"));
+  bidir_astar.set_reader_config(config.get_child("mjolnir"));
+  overlay_.set_reader_config(config.get_child("mjolnir"));
+  if (route_concurrency > 1) {
+    leg_worker_config_.put_child("thor", config.get_child("thor"));
+    leg_worker_config_.put_child("mjolnir", config.get_child("mjolnir"));
+  }
+
   // signal that the worker started successfully
   started();
 }
@@ -118,6 +170,11 @@ thor_worker_t::thor_worker_t(const boost::property_tree::ptree& config,
 thor_worker_t::~thor_worker_t() {
 }
 
+thor_worker_t::leg_worker_t::leg_worker_t(const boost::property_tree::ptree& config)
+    : bidir_astar(config.get_child("thor")), timedep_forward(config.get_child("thor")),
+      reader(config.get_child("mjolnir")) {
+}
+
 #ifdef ENABLE_SERVICES
 prime_server::worker_t::result_t
 thor_worker_t::work(const std::list<zmq::message_t>& job,
@@ -351,22 +408,40 @@ void thor_worker_t::log_admin(const valhalla::TripLeg& trip_path) {
 }
 
 void thor_worker_t::cleanup() {
-  service_worker_t::cleanup();
   bidir_astar.Clear();
   timedep_forward.Clear();
   timedep_reverse.Clear();
   multi_modal_transit.Clear();
+  raptor.Clear();
   multimodal_astar.Clear();
   trace.clear();
   costmatrix_.Clear();
   time_distance_matrix_.Clear();
   time_distance_bss_matrix_.Clear();
+  ch_matrix_.Clear();
+  phast_matrix_.Clear();
+  overlay_matrix_.Clear();
   isochrone_gen.Clear();
+  route_tree_.Clear();
   centroid_gen.Clear();
   matcher_factory.ClearFullCache();
   if (reader->OverCommitted()) {
     reader->Trim();
   }
+  for (auto& leg_worker : leg_workers_) {
+    leg_worker->bidir_astar.Clear();
+    leg_worker->timedep_forward.Clear();
+    leg_worker->mode_costing = {};
+    if (leg_worker->reader.OverCommitted()) {
+      leg_worker->reader.Trim();
+    }
+  }
+  // nothing may point into the arena once the base releases it
+  bidir_astar.ReleaseArena();
+  costmatrix_.ReleaseArena();
+  time_distance_matrix_.ReleaseArena();
+  isochrone_gen.ReleaseArena();
+  service_worker_t::cleanup();
 }
 
 void thor_worker_t::set_interrupt(const std::function<void()>* interrupt_function) {
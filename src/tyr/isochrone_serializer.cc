@@ -384,6 +384,23 @@ std::string serializeGeoTIFF(Api& request, const std::shared_ptr<const GriddedDa
 }
 #endif
 
+// how much of the network is within the interval, if it was requested and could be computed
+void addAccessibility(const Api& request,
+                      const contour_interval_t& interval,
+                      rapidjson::writer_wrapper_t& writer) {
+  const auto metric =
+      std::get<2>(interval) == "time" ? valhalla::Isochrone::time : valhalla::Isochrone::distance;
+  for (const auto& accessibility : request.isochrone().accessibility()) {
+    if (accessibility.metric() == metric && accessibility.metric_value() == std::get<1>(interval)) {
+      writer.start_object("accessibility");
+      writer("edges", accessibility.edges());
+      writer("length", accessibility.length());
+      writer.end_object();
+      return;
+    }
+  }
+}
+
 std::string serializeIsochroneJson(Api& request,
                                    std::vector<contour_interval_t>& intervals,
                                    contours_t& contours,
@@ -416,6 +433,7 @@ std::string serializeIsochroneJson(Api& request,
       writer("color", hex);         // lines
       writer("contour", std::get<1>(interval));
       writer("metric", std::get<2>(interval));
+      addAccessibility(request, interval, writer);
       writer.end_object(); // properties
 
       writer.start_object("geometry");
@@ -517,7 +535,8 @@ namespace tyr {
 
 std::string serializeIsochrones(Api& request,
                                 std::vector<midgard::GriddedData<2>::contour_interval_t>& intervals,
-                                const std::shared_ptr<const midgard::GriddedData<2>>& isogrid) {
+                                const std::shared_ptr<const midgard::GriddedData<2>>& isogrid,
+                                const uint32_t concurrency) {
 
   // only generate if json or pbf output is requested
   contours_t contours;
@@ -528,9 +547,9 @@ std::string serializeIsochrones(Api& request,
       // we have parallel vectors of contour properties and the actual geojson features
       // this method sorts the contour specifications by metric (time or distance) and then by value
       // with the largest values coming first. eg (60min, 30min, 10min, 40km, 10km)
-      contours =
-          isogrid->GenerateContours(intervals, request.options().polygons(),
-                                    request.options().denoise(), request.options().generalize());
+      contours = isogrid->GenerateContours(intervals, request.options().polygons(),
+                                           request.options().denoise(),
+                                           request.options().generalize(), concurrency);
       return request.options().format() == Options_Format_json
                  ? serializeIsochroneJson(request, intervals, contours,
                                           request.options().show_locations(),
@@ -367,5 +367,23 @@ std::string serializeLocate(const Api& request, GraphReader& reader) {
   return writer.get_buffer();
 }
 
+std::string serializeLocateLines(const Api& request, GraphReader& reader) {
+  std::string lines;
+  for (const auto& location : request.options().locations()) {
+    // unlike the array above each line gets its own writer so a failure cant leave a partial object
+    try {
+      rapidjson::writer_wrapper_t writer(1024);
+      serialize(writer, location, reader, request.options().verbose());
+      lines.append(writer.get_buffer());
+    } catch (const std::exception& e) {
+      rapidjson::writer_wrapper_t writer(128);
+      serialize(writer, location.ll(), "No data found for location", request.options().verbose());
+      lines.append(writer.get_buffer());
+    }
+    lines.push_back('\n');
+  }
+  return lines;
+}
+
 } // namespace tyr
 } // namespace valhalla
@@ -1,9 +1,13 @@
+#include "baldr/compression_utils.h"
 #include "baldr/rapidjson_utils.h"
 #include "proto_conversions.h"
 #include "thor/matrixalgorithm.h"
 #include "tyr/serializers.h"
 
+#include <algorithm>
+#include <bit>
 #include <cstdint>
+#include <cstring>
 
 using namespace valhalla;
 using namespace valhalla::midgard;
@@ -41,6 +45,29 @@ void serialize_distance(const valhalla::Matrix& matrix,
   }
 }
 
+// how many departures the profile of every pair has, 0 without one
+size_t profile_departures(const valhalla::Matrix& matrix) {
+  return matrix.times_size() ? matrix.profile_times_size() / matrix.times_size() : 0;
+}
+
+void serialize_profile(const valhalla::Matrix& matrix,
+                       rapidjson::writer_wrapper_t& writer,
+                       const size_t td,
+                       const bool times,
+                       const double distance_scale) {
+  const auto departures = profile_departures(matrix);
+  for (size_t i = td * departures; i < (td + 1) * departures; ++i) {
+    // return null for the departures which found no route
+    if (matrix.profile_times()[i] == kMaxCost) {
+      writer(nullptr);
+    } else if (times) {
+      writer(static_cast<uint64_t>(matrix.profile_times()[i]));
+    } else {
+      writer(static_cast<double>(matrix.profile_distances()[i] * distance_scale));
+    }
+  }
+}
+
 void serialize_shape(const valhalla::Matrix& matrix,
                      rapidjson::writer_wrapper_t& writer,
                      const size_t start_td,
@@ -213,6 +240,16 @@ void serialize_row(const valhalla::Matrix& matrix,
       writer("time", nullptr);
       writer("distance", nullptr);
     }
+    if (profile_departures(matrix)) {
+      writer.start_object("profile");
+      writer.start_array("times");
+      serialize_profile(matrix, writer, i, true, distance_scale);
+      writer.end_array();
+      writer.start_array("distances");
+      serialize_profile(matrix, writer, i, false, distance_scale);
+      writer.end_array();
+      writer.end_object();
+    }
     writer.end_object();
   }
   writer.end_array();
@@ -260,6 +297,25 @@ std::string serialize(const Api& request, double distance_scale) {
     }
     writer.end_array();
 
+    // the durations and distances of every departure of a profile
+    if (profile_departures(request.matrix())) {
+      for (const bool times : {true, false}) {
+        writer.start_array(times ? "profile_durations" : "profile_distances");
+        for (int source_index = 0; source_index < options.sources_size(); ++source_index) {
+          writer.start_array();
+          for (int target_index = 0; target_index < options.targets_size(); ++target_index) {
+            writer.start_array();
+            serialize_profile(request.matrix(), writer,
+                              source_index * options.targets_size() + target_index, times,
+                              distance_scale);
+            writer.end_array();
+          }
+          writer.end_array();
+        }
+        writer.end_array();
+      }
+    }
+
     if (!(options.shape_format() == no_shape ||
           (request.matrix().algorithm() != Matrix::CostMatrix))) {
       writer.start_array("shapes");
@@ -292,6 +348,111 @@ std::string serialize(const Api& request, double distance_scale) {
 }
 } // namespace valhalla_serializers
 
+namespace binary_serializers {
+/*
+The binary format is a header followed by the times and then the distances of every pair of
+sources and targets, row-ordered like the json. The times are float seconds and the distances
+uint32 meters, everything little-endian. A pair without a route has the no_time and no_distance of
+the header. With "compress":true the whole response is gzipped.
+*/
+struct header_t {
+  char magic[4];        // "VMTX"
+  uint32_t version;     // of the layout, 1
+  uint32_t sources;     // number of rows
+  uint32_t targets;     // number of columns
+  uint32_t algorithm;   // Matrix::Algorithm
+  float no_time;        // the time of the pairs without a route
+  uint32_t no_distance; // the distance of the pairs without a route
+  uint32_t reserved;
+};
+static_assert(sizeof(header_t) == 32, "Bad sizeof(header_t)");
+
+// writes the 4 bytes of a field little-endian whatever the byte order of the machine
+char* write_le(char* out, const uint32_t value) {
+  for (int shift = 0; shift < 32; shift += 8) {
+    *out++ = static_cast<char>((value >> shift) & 0xff);
+  }
+  return out;
+}
+
+char* write_le(char* out, const float value) {
+  return write_le(out, std::bit_cast<uint32_t>(value));
+}
+
+// writes an array of 4 byte fields, as it is on little-endian machines and a field at a time on
+// the others
+template <typename T> char* write_le(char* out, const T* values, const size_t count) {
+  static_assert(sizeof(T) == sizeof(uint32_t), "The binary matrix fields are 4 bytes");
+  if constexpr (std::endian::native == std::endian::little) {
+    std::memcpy(out, values, count * sizeof(T));
+    return out + count * sizeof(T);
+  } else {
+    for (size_t i = 0; i < count; ++i) {
+      out = write_le(out, values[i]);
+    }
+    return out;
+  }
+}
+
+std::string gzip(const std::string& uncompressed) {
+  auto deflate_src = [&uncompressed](z_stream& s) {
+    s.next_in = reinterpret_cast<Byte*>(const_cast<char*>(uncompressed.data()));
+    s.avail_in = static_cast<unsigned int>(uncompressed.size());
+    return Z_FINISH;
+  };
+
+  // times and distances compress to a fraction, grow by a quarter of the input at a time
+  std::string compressed;
+  const size_t chunk = std::max<size_t>(uncompressed.size() / 4, 1024);
+  auto deflate_dst = [&compressed, chunk](z_stream& s) {
+    // if the whole buffer wasn't used we are done
+    auto size = compressed.size();
+    if (s.total_out < size)
+      compressed.resize(s.total_out);
+    // we need more space
+    else {
+      compressed.resize(size + chunk);
+      s.next_out = reinterpret_cast<Byte*>(&compressed[size]);
+      s.avail_out = static_cast<unsigned int>(chunk);
+    }
+  };
+
+  if (!baldr::deflate(deflate_src, deflate_dst, Z_BEST_SPEED)) {
+    throw std::runtime_error("Failed to gzip the binary matrix");
+  }
+  return compressed;
+}
+
+std::string serialize(const Api& request) {
+  const auto& matrix = request.matrix();
+  const size_t count = matrix.times_size();
+  header_t header{{'V', 'M', 'T', 'X'},
+                  1,
+                  static_cast<uint32_t>(request.options().sources_size()),
+                  static_cast<uint32_t>(request.options().targets_size()),
+                  static_cast<uint32_t>(matrix.algorithm()),
+                  kMaxCost,
+                  static_cast<uint32_t>(kMaxCost),
+                  0};
+
+  // on little-endian machines the arrays the matrix algorithms filled go in as they are
+  std::string bytes(sizeof(header) + count * (sizeof(float) + sizeof(uint32_t)), '\0');
+  char* out = bytes.data();
+  std::memcpy(out, header.magic, sizeof(header.magic));
+  out += sizeof(header.magic);
+  for (const auto field : {header.version, header.sources, header.targets, header.algorithm}) {
+    out = write_le(out, field);
+  }
+  out = write_le(out, header.no_time);
+  out = write_le(out, header.no_distance);
+  out = write_le(out, header.reserved);
+  out = write_le(out, matrix.times().data(), count);
+  write_le(out, matrix.distances().data(), count);
+
+  return request.options().compress() ? gzip(bytes) : bytes;
+}
+} // namespace binary_serializers
+
 namespace valhalla {
 namespace tyr {
 
@@ -310,6 +471,8 @@ std::string serializeMatrix(Api& request) {
       return valhalla_serializers::serialize(request, distance_scale);
     case Options_Format_pbf:
       return serializePbf(request);
+    case Options_Format_binary:
+      return binary_serializers::serialize(request);
     default:
       throw;
   }
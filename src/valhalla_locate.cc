@@ -0,0 +1,73 @@
+#include "argparse_utils.h"
+#include "config.h"
+#include "loki/worker.h"
+
+#include <boost/property_tree/ptree.hpp>
+#include <cxxopts.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+  const auto program = std::filesystem::path(__FILE__).stem().string();
+  // args
+  std::string request, input_file;
+  size_t batch_size;
+  boost::property_tree::ptree config;
+
+  try {
+    // clang-format off
+    cxxopts::Options options(
+      program,
+      program + " " + VALHALLA_PRINT_VERSION + "\n\n"
+      "Correlates a stream of locations to the graph. Reads one json location per line,\n"
+      "eg {\"lat\":52.09,\"lon\":5.11}, and writes one json locate result per line in the\n"
+      "same order. Lines that cannot be correlated produce an error object instead.\n\n");
+
+    options.add_options()
+      ("h,help", "Print this help message.")
+      ("v,version", "Print the version of this software.")
+      ("c,config", "Path to the json configuration file.", cxxopts::value<std::string>())
+      ("i,inline-config", "Inline json config.", cxxopts::value<std::string>())
+      ("j,concurrency", "Number of threads to use. Defaults to all threads.", cxxopts::value<uint32_t>())
+      ("b,batch-size", "Number of locations correlated per request.", cxxopts::value<size_t>(batch_size)->default_value("1000"))
+      ("r,request", "Locate request json applied to every location, eg {\"costing\":\"auto\"}.", cxxopts::value<std::string>(request)->default_value("{}"))
+      ("input", "Input file with one location per line, defaults to stdin.", cxxopts::value<std::string>(input_file));
+    // clang-format on
+
+    options.parse_positional({"input"});
+    options.positional_help("[INPUT]");
+    auto result = options.parse(argc, argv);
+    if (!parse_common_args(program, options, result, &config, true))
+      return EXIT_SUCCESS;
+  } catch (cxxopts::exceptions::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (std::exception& e) {
+    std::cerr << "Unable to parse command line options because: " << e.what() << "\n"
+              << "This is a bug, please report it at " PACKAGE_BUGREPORT << "\n";
+    return EXIT_FAILURE;
+  }
+
+  std::ifstream file;
+  if (!input_file.empty()) {
+    file.open(input_file);
+    if (!file.is_open()) {
+      std::cerr << "Unable to open " << input_file << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  try {
+    std::ios::sync_with_stdio(false);
+    valhalla::loki::locate_stream(config, request, input_file.empty() ? std::cin : file, std::cout,
+                                  config.get<uint32_t>("mjolnir.concurrency"), batch_size);
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -34,6 +34,8 @@ static const worker::content_type& fmt_to_mime(const Options::Format& fmt) noexc
       return worker::TIFF_MIME;
     case Options::mvt:
       return worker::MVT_MIME;
+    case Options::binary:
+      return worker::BINARY_MIME;
     default:
       return worker::JSON_MIME;
   }
@@ -84,6 +86,8 @@ bool is_format_supported(Options::Action action, Options::Format format) {
 #endif
       // mvt
       (1 << Options::tile),
+      // binary
+      (1 << Options::sources_to_targets),
   };
   static_assert(std::size(kFormatActionSupport) == Options::Format_ARRAYSIZE,
                 "Please update format_action array to match Options::Action_ARRAYSIZE");
@@ -724,10 +728,11 @@ void from_json(rapidjson::Document& doc, Options::Action action, Api& api) {
     options.set_format(Options::json);
     add_warning(api, 211);
   }
-  if (options.format() == Options::pbf) {
+  if (options.format() == Options::pbf || options.format() == Options::binary) {
     // jsonp wont work because javascript doesnt support byte arrays
     options.clear_jsonp();
   }
+  options.set_compress(rapidjson::get<bool>(doc, "/compress", options.compress()));
 
   auto units = rapidjson::get_optional<std::string>(doc, "/units");
   if (units && ((*units == "miles") || (*units == "mi"))) {
@@ -764,6 +769,25 @@ void from_json(rapidjson::Document& doc, Options::Action action, Api& api) {
     options.set_reverse_time_tracking(reverse_tt);
   }
 
+  auto optimizer_str = rapidjson::get_optional<std::string>(doc, "/optimizer");
+  Options::TourOptimizer optimizer;
+  if (optimizer_str && Options_TourOptimizer_Enum_Parse(*optimizer_str, &optimizer)) {
+    options.set_optimizer(optimizer);
+  }
+
+  auto batch_str = rapidjson::get_optional<std::string>(doc, "/batch");
+  Options::RouteBatch batch;
+  if (batch_str && Options_RouteBatch_Enum_Parse(*batch_str, &batch)) {
+    options.set_batch(batch);
+  }
+
+  auto multimodal_algorithm_str = rapidjson::get_optional<std::string>(doc, "/multimodal_algorithm");
+  Options::MultimodalAlgorithm multimodal_algorithm;
+  if (multimodal_algorithm_str &&
+      Options_MultimodalAlgorithm_Enum_Parse(*multimodal_algorithm_str, &multimodal_algorithm)) {
+    options.set_multimodal_algorithm(multimodal_algorithm);
+  }
+
   // costing defaults to none which is only valid for locate
   auto costing_str =
       rapidjson::get<std::string>(doc, "/costing",
@@ -1092,6 +1116,18 @@ void from_json(rapidjson::Document& doc, Options::Action action, Api& api) {
     options.set_expansion_max_distance(*expansion_max_distance);
   }
 
+  // the departures of a time dependent matrix, one search answers all of them
+  auto profile_departures = rapidjson::get_optional<unsigned int>(doc, "/profile_departures");
+  if (profile_departures) {
+    options.set_profile_departures(*profile_departures);
+  }
+  auto profile_interval = rapidjson::get_optional<unsigned int>(doc, "/profile_interval");
+  if (profile_interval && *profile_interval > 0) {
+    options.set_profile_interval(*profile_interval);
+  } else if (!options.profile_interval()) {
+    options.set_profile_interval(15);
+  }
+
   // get the avoid polygons in there
   auto exclude_polygons =
       rapidjson::get_child_optional(doc, doc.HasMember("avoid_polygons") ? "/avoid_polygons"
@@ -1239,6 +1275,9 @@ void from_json(rapidjson::Document& doc, Options::Action action, Api& api) {
   // if specified, get the show_locations boolean in there
   options.set_show_locations(rapidjson::get<bool>(doc, "/show_locations", options.show_locations()));
 
+  // if specified, get the accessibility boolean in there
+  options.set_accessibility(rapidjson::get<bool>(doc, "/accessibility", options.accessibility()));
+
   // if specified, get the shape_match in there
   auto shape_match_str = rapidjson::get_optional<std::string>(doc, "/shape_match");
   ShapeMatch shape_match;
@@ -1662,7 +1701,8 @@ struct statsd_client_t : public Statsd::StatsdClient {
   std::vector<std::string> tags;
 };
 
-service_worker_t::service_worker_t(const boost::property_tree::ptree& conf) : interrupt(nullptr) {
+service_worker_t::service_worker_t(const boost::property_tree::ptree& conf, size_t max_arena_size)
+    : interrupt(nullptr), arena(max_arena_size) {
   if (conf.count("statsd")) {
     statsd_client = std::make_unique<statsd_client_t>(conf);
   }
@@ -1677,6 +1717,7 @@ void service_worker_t::cleanup() {
     // sends metrics to statsd server over udp
     statsd_client->flush();
   }
+  arena.release();
 }
 void service_worker_t::enqueue_statistics(Api& api) const {
   // nothing to do without stats
@@ -0,0 +1,99 @@
+#include "midgard/arena.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+using namespace valhalla::midgard;
+
+namespace {
+
+// counts what the arena asks of its upstream
+class counting_resource_t : public std::pmr::memory_resource {
+public:
+  size_t outstanding = 0;
+  size_t allocations = 0;
+
+protected:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    outstanding += bytes;
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    outstanding -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+TEST(RequestArena, Alignment) {
+  request_arena_t arena(0, 1024);
+  for (size_t alignment : {1, 2, 4, 8, 16, 32, 64}) {
+    auto* ptr = arena.allocate(3, alignment);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % alignment, 0);
+  }
+
+  // consecutive allocations are bumped out of the same block
+  auto* a = static_cast<char*>(arena.allocate(8, 8));
+  auto* b = static_cast<char*>(arena.allocate(8, 8));
+  EXPECT_EQ(b - a, 8);
+  EXPECT_EQ(arena.reserved(), 1024);
+}
+
+TEST(RequestArena, ReleaseKeepsBlocksUnderHighWaterMark) {
+  counting_resource_t upstream;
+  {
+    request_arena_t arena(2048, 1024, &upstream);
+
+    // a vector that outgrows a few blocks and an allocation larger than a block
+    std::pmr::vector<uint64_t> labels(&arena);
+    for (uint64_t i = 0; i < 1000; ++i) {
+      labels.push_back(i);
+    }
+    for (uint64_t i = 0; i < 1000; ++i) {
+      ASSERT_EQ(labels[i], i);
+    }
+    EXPECT_NE(arena.allocate(4096, 8), nullptr);
+    EXPECT_GE(arena.allocated(), 1000 * sizeof(uint64_t) + 4096);
+    EXPECT_EQ(upstream.outstanding, arena.reserved());
+
+    // everything allocated from the arena has to be gone before releasing it
+    release_memory(labels);
+    EXPECT_EQ(labels.capacity(), 0);
+    EXPECT_EQ(labels.get_allocator().resource(), &arena);
+    arena.release();
+    EXPECT_EQ(arena.allocated(), 0);
+    EXPECT_LE(arena.reserved(), 2048);
+    EXPECT_EQ(upstream.outstanding, arena.reserved());
+
+    // the next request of the same size only goes upstream for what was not kept
+    const auto kept = arena.reserved();
+    ASSERT_GT(kept, 0);
+    const auto allocations = upstream.allocations;
+    EXPECT_NE(arena.allocate(kept / 2, 8), nullptr);
+    EXPECT_EQ(upstream.allocations, allocations);
+
+    // nothing is kept without a high-water mark
+    arena.set_max_retained_size(0);
+    arena.release();
+    EXPECT_EQ(arena.reserved(), 0);
+    EXPECT_EQ(upstream.outstanding, 0);
+
+    EXPECT_NE(arena.allocate(100, 8), nullptr);
+    EXPECT_GT(upstream.outstanding, 0);
+  }
+  // and the rest goes back when the arena is destroyed
+  EXPECT_EQ(upstream.outstanding, 0);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
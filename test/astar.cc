@@ -1338,8 +1338,8 @@ TEST(Astar, test_IsBridgingEdgeRestricted) {
   create_costing_options(options, Costing::auto_);
   vs::TravelMode mode;
   auto costs = vs::CostFactory().CreateModeCosting(options, mode);
-  std::vector<sif::BDEdgeLabel> edge_labels_fwd;
-  std::vector<sif::BDEdgeLabel> edge_labels_rev;
+  std::pmr::vector<sif::BDEdgeLabel> edge_labels_fwd;
+  std::pmr::vector<sif::BDEdgeLabel> edge_labels_rev;
 
   // Lets construct the inputs fed to IsBridgingEdgeRestricted for a situation
   // where it tries to connect edge 14 to edge_labels_fwd from 21 and opposing edges
@@ -64,6 +64,53 @@ TEST(EdgeStatus, TestStatus) {
   TryGet(edgestatus, GraphId(555, 3, 1), EdgeSet::kUnreachedOrReset);
 }
 
+TEST(EdgeStatus, TestPoolAndGrowth) {
+  // two tiles of different sizes so pooled arrays get handed out to tiles they werent made for
+  GraphTileHeader small_header, big_header;
+  small_header.set_directededgecount(100);
+  big_header.set_directededgecount(5000);
+  test_tile* small_tt = new test_tile;
+  small_tt->header_ = &small_header;
+  test_tile* big_tt = new test_tile;
+  big_tt->header_ = &big_header;
+  graph_tile_ptr small_tile{small_tt}, big_tile{big_tt};
+
+  EdgeStatus edgestatus;
+  edgestatus.set_max_pool_size(1024 * 1024);
+  for (int pass = 0; pass < 3; ++pass) {
+    // enough tiles and paths to grow the table a few times
+    for (uint32_t tileid = 0; tileid < 100; ++tileid) {
+      const auto& tile = (tileid + pass) % 2 ? big_tile : small_tile;
+      for (uint8_t path_id = 0; path_id < 3; ++path_id) {
+        GraphId edgeid(tileid, 2, 99);
+        EXPECT_EQ(edgestatus.Get(edgeid, path_id).set(), EdgeSet::kUnreachedOrReset);
+        EXPECT_EQ(edgestatus.GetPtr(edgeid, tile, path_id)->set(), EdgeSet::kUnreachedOrReset);
+        edgestatus.Set(edgeid, EdgeSet::kTemporary, tileid + path_id, tile, path_id);
+        edgestatus.Update(edgeid, EdgeSet::kPermanent, path_id);
+      }
+    }
+    for (uint32_t tileid = 0; tileid < 100; ++tileid) {
+      for (uint8_t path_id = 0; path_id < 3; ++path_id) {
+        auto info = edgestatus.Get(GraphId(tileid, 2, 99), path_id);
+        EXPECT_EQ(info.set(), EdgeSet::kPermanent);
+        EXPECT_EQ(info.index(), tileid + path_id);
+      }
+      TryGet(edgestatus, GraphId(tileid, 2, 98), EdgeSet::kUnreachedOrReset);
+      TryGet(edgestatus, GraphId(tileid, 1, 99), EdgeSet::kUnreachedOrReset);
+    }
+    edgestatus.clear();
+    TryGet(edgestatus, GraphId(1, 2, 99), EdgeSet::kUnreachedOrReset);
+  }
+
+  EXPECT_THROW(edgestatus.Update(GraphId(1, 2, 99), EdgeSet::kPermanent), std::runtime_error);
+
+  // moving hands over the arrays
+  edgestatus.Set(GraphId(7, 2, 5), EdgeSet::kSkipped, 3, small_tile);
+  EdgeStatus moved(std::move(edgestatus));
+  EXPECT_EQ(moved.Get(GraphId(7, 2, 5)).set(), EdgeSet::kSkipped);
+  EXPECT_EQ(moved.Get(GraphId(7, 2, 5)).index(), 3);
+}
+
 } // namespace
 
 int main(int argc, char* argv[]) {
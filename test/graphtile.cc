@@ -8,7 +8,9 @@
 #include <gtest/gtest.h>
 
 #include <cstdint>
+#include <memory>
 #include <sstream>
+#include <utility>
 #include <vector>
 
 using namespace valhalla::baldr;
@@ -27,6 +29,18 @@ struct testable_graphtile : public valhalla::baldr::GraphTile {
   }
 };
 
+struct departures_graphtile : public valhalla::baldr::GraphTile {
+  explicit departures_graphtile(std::vector<TransitDeparture>& departures) {
+    header_ = new GraphTileHeader();
+    header_->set_departurecount(departures.size());
+    departures_ = departures.data();
+    IndexDepartures();
+  }
+  ~departures_graphtile() {
+    delete header_;
+  }
+};
+
 TEST(Graphtile, FileSuffix) {
   EXPECT_EQ(GraphTile::FileSuffix(GraphId(2, 2, 0)), "2/000/000/002.gph");
   EXPECT_EQ(GraphTile::FileSuffix(GraphId(4, 2, 0)), "2/000/000/004.gph");
@@ -323,6 +337,44 @@ TEST(ComplexRestrictionView, ModeFiltering) {
   EXPECT_EQ(count3, 3);
 }
 
+TEST(Graphtile, NextDepartureOfFixedAndFrequencyTrips) {
+  // sorted by line, schedule type and departure time like mjolnir writes them: line 0 has fixed
+  // trips at 8:00 and 9:00 and a trip every 10 minutes from 8:10 to 10:00 on another schedule
+  std::vector<TransitDeparture> departures = {
+      {0, 1, 0, 0, 0, 8 * 3600, 600, 0, true, true},
+      {0, 2, 0, 0, 0, 9 * 3600, 600, 0, true, true},
+      {0, 3, 0, 0, 0, 8 * 3600 + 600, 10 * 3600, 600, 600, 1, true, true},
+      {1, 4, 0, 0, 0, 8 * 3600 + 1800, 600, 0, true, true},
+  };
+  departures_graphtile tile(departures);
+
+  const auto next = [&tile](const uint32_t lineid, const uint32_t time,
+                            const std::vector<bool>& active) {
+    const auto* departure = tile.GetNextDeparture(lineid, time, active, false, false);
+    // the departures of frequency trips are made up for the time asked for
+    std::unique_ptr<const TransitDeparture> made_up;
+    if (departure && departure->type() == kFrequencySchedule) {
+      made_up.reset(departure);
+    }
+    return departure ? std::make_pair(departure->tripid(), departure->departure_time())
+                     : std::make_pair(0u, 0u);
+  };
+
+  // the frequency trip leaving before the next fixed one wins
+  EXPECT_EQ(next(0, 8 * 3600 + 300, {true, true}), std::make_pair(3u, 8u * 3600 + 600));
+  EXPECT_EQ(next(0, 8 * 3600 + 1500, {true, true}), std::make_pair(3u, 8u * 3600 + 1800));
+  // the fixed one leaving before the first frequency trip or at the same time wins
+  EXPECT_EQ(next(0, 7 * 3600, {true, true}), std::make_pair(1u, 8u * 3600));
+  EXPECT_EQ(next(0, 8 * 3600 + 3300, {true, true}), std::make_pair(2u, 9u * 3600));
+  // the frequency trip doesn't run without its schedule and not after its end
+  EXPECT_EQ(next(0, 8 * 3600 + 300, {true, false}), std::make_pair(2u, 9u * 3600));
+  EXPECT_EQ(next(0, 9 * 3600 + 60, {true, true}), std::make_pair(3u, 9u * 3600 + 600));
+  EXPECT_EQ(next(0, 10 * 3600 + 60, {true, true}), std::make_pair(0u, 0u));
+  // the other line has its own departures
+  EXPECT_EQ(next(1, 8 * 3600 + 300, {true, true}), std::make_pair(4u, 8u * 3600 + 1800));
+  EXPECT_EQ(next(2, 8 * 3600, {true, true}), std::make_pair(0u, 0u));
+}
+
 } // namespace
 
 int main(int argc, char* argv[]) {
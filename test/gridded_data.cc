@@ -3,7 +3,9 @@
 
 #include <gtest/gtest.h>
 
+#include <array>
 #include <limits>
+#include <vector>
 // #include <iostream>
 
 using namespace valhalla::midgard;
@@ -79,6 +81,56 @@ TEST(GriddedData, Basic) {
   */
 }
 
+TEST(GriddedData, Extent) {
+  GriddedData<2> g({-7, -7, 7, 7}, 1, {10, 10});
+  auto extent = g.Extent();
+  EXPECT_GT(extent[0], extent[2]);
+  EXPECT_GT(extent[1], extent[3]);
+
+  // nothing below the max value is not part of it
+  g.SetIfLessThan(g.TileId(1, 1), {10, 10});
+  EXPECT_EQ(g.Extent(), extent);
+
+  g.SetIfLessThan(g.TileId(3, 9), {5, 10});
+  g.SetIfLessThan(g.TileId(8, 4), {10, 2});
+  extent = {3, 4, 8, 9};
+  EXPECT_EQ(g.Extent(), extent);
+  std::array<int32_t, 4> padded{2, 3, 10, 11};
+  EXPECT_EQ(g.MinExtent(), padded);
+}
+
+TEST(GriddedData, Concurrency) {
+  // two hills of time and one of distance in a corner of the grid
+  GriddedData<2> g({-10, -10, 10, 10}, .25f, {1000, 1000});
+  for (int i = 0; i < g.ncolumns(); ++i) {
+    for (int j = 0; j < g.nrows(); ++j) {
+      auto b = g.Base(g.TileId(i, j));
+      if (b.lng() > 5 || b.lat() > 5) {
+        continue;
+      }
+      float minutes = std::min(b.Distance({-2, -2}), b.Distance({2, 1})) / 10000;
+      float km = PointLL(-3, 3).Distance(b) / 5000;
+      g.SetIfLessThan(g.TileId(i, j), {minutes, km});
+    }
+  }
+
+  for (const bool rings_only : {false, true}) {
+    std::vector<GriddedData<2>::contour_interval_t> intervals{
+        {0, 20, "time", ""},     {0, 40, "time", ""},     {0, 60, "time", ""},
+        {1, 50, "distance", ""}, {1, 90, "distance", ""},
+    };
+    auto serial = g.GenerateContours(intervals, rings_only, 0.f);
+    for (const uint32_t concurrency : {2, 3, 16}) {
+      auto parallel = g.GenerateContours(intervals, rings_only, 0.f, 200.f, concurrency);
+      ASSERT_EQ(parallel.size(), serial.size());
+      for (size_t i = 0; i < serial.size(); ++i) {
+        ASSERT_FALSE(serial[i].empty());
+        EXPECT_EQ(parallel[i], serial[i]) << "contour " << i << " with " << concurrency;
+      }
+    }
+  }
+}
+
 } // namespace
 
 int main(int argc, char* argv[]) {
@@ -0,0 +1,149 @@
+#include "baldr/alt_landmarks.h"
+#include "baldr/graphreader.h"
+#include "baldr/rapidjson_utils.h"
+#include "gurka.h"
+#include "midgard/pointll.h"
+#include "mjolnir/altlandmarkbuilder.h"
+#include "test.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <filesystem>
+
+using namespace valhalla;
+
+namespace {
+
+rapidjson::Document matrix(const gurka::map& map,
+                           const std::vector<std::string>& sources,
+                           const std::vector<std::string>& targets) {
+  std::string json;
+  gurka::do_action(Options::sources_to_targets, map, sources, targets, "auto", {}, nullptr, &json);
+  rapidjson::Document result;
+  result.Parse(json.c_str());
+  return result;
+}
+
+} // namespace
+
+class AltTest : public ::testing::Test {
+protected:
+  static gurka::map map;
+  static gurka::map alt_map;
+
+  static void SetUpTestSuite() {
+    const std::string ascii_map = R"(
+      A----B----C----D----E
+      |    |    |    |    |
+      F----G----H----I----J
+      |    |    |    |    |
+      K----L----M----N----O
+      |    |    |    |    |
+      P----Q----R----S----T
+    )";
+
+    const gurka::ways ways = {
+        {"ABCDE", {{"highway", "primary"}}},
+        {"FGHIJ", {{"highway", "residential"}}},
+        {"KLMNO", {{"highway", "residential"}, {"oneway", "yes"}}},
+        {"PQRST", {{"highway", "secondary"}}},
+        {"AFKP", {{"highway", "tertiary"}}},
+        {"BG", {{"highway", "residential"}}},
+        {"GL", {{"highway", "residential"}, {"oneway", "-1"}}},
+        {"LQ", {{"highway", "residential"}}},
+        {"CHMR", {{"highway", "tertiary"}}},
+        {"DI", {{"highway", "service"}}},
+        {"INS", {{"highway", "residential"}, {"oneway", "yes"}}},
+        {"EJOT", {{"highway", "primary"}}},
+    };
+
+    const auto layout = gurka::detail::map_to_coordinates(ascii_map, 200);
+    map = gurka::buildtiles(layout, ways, {}, {}, VALHALLA_BUILD_DIR "test/data/alt",
+                            {{"thor.source_to_target_algorithm", "costmatrix"}});
+    map.config.put("mjolnir.alt.landmark_count", 3);
+    mjolnir::AltLandmarkBuilder::Build(map.config);
+
+    // the same tiles and landmarks with the alt heuristics turned on
+    alt_map = map;
+    alt_map.config.put("thor.bidirectional_astar.heuristic", "alt");
+    alt_map.config.put("thor.costmatrix.heuristic", "alt");
+  }
+};
+
+gurka::map AltTest::map = {};
+gurka::map AltTest::alt_map = {};
+
+TEST_F(AltTest, WritesLandmarks) {
+  const auto file = baldr::AltLandmarks::FileName(map.config.get_child("mjolnir"));
+  ASSERT_TRUE(std::filesystem::exists(file));
+
+  baldr::AltLandmarks landmarks(file);
+  ASSERT_EQ(landmarks.landmark_count(), 3u);
+  const auto count = landmarks.landmark_count();
+  for (uint32_t i = 0; i < count; ++i) {
+    const auto* distances = landmarks.distances(landmarks.landmark(i));
+    ASSERT_NE(distances, nullptr);
+    EXPECT_EQ(distances[i], 0.f);
+    EXPECT_EQ(distances[count + i], 0.f);
+  }
+
+  // the grid is strongly connected so every landmark reaches every node both ways, and the
+  // triangle inequality holds along the two way edge between A and B
+  baldr::GraphReader reader(map.config.get_child("mjolnir"));
+  const auto a = gurka::findNode(reader, map.nodes, "A");
+  const auto b = gurka::findNode(reader, map.nodes, "B");
+  const auto length = map.nodes.at("A").Distance(map.nodes.at("B"));
+  const auto* from_a = landmarks.distances(a);
+  const auto* from_b = landmarks.distances(b);
+  ASSERT_NE(from_a, nullptr);
+  ASSERT_NE(from_b, nullptr);
+  for (uint32_t i = 0; i < 2 * count; ++i) {
+    ASSERT_NE(from_a[i], baldr::kUnreachedLandmark);
+    ASSERT_NE(from_b[i], baldr::kUnreachedLandmark);
+    EXPECT_LE(std::abs(from_a[i] - from_b[i]), length + 1.f);
+  }
+}
+
+TEST_F(AltTest, MatchesRoute) {
+  for (const auto& [from, to] : std::vector<std::pair<std::string, std::string>>{
+           {"A", "T"}, {"P", "E"}, {"M", "K"}, {"S", "A"}, {"C", "O"}}) {
+    auto alt = gurka::do_action(Options::route, alt_map, {from, to}, "auto");
+    auto regular = gurka::do_action(Options::route, map, {from, to}, "auto");
+    const auto& leg = alt.trip().routes(0).legs(0);
+    const auto& regular_leg = regular.trip().routes(0).legs(0);
+    ASSERT_EQ(leg.node_size(), regular_leg.node_size()) << from << " -> " << to;
+    EXPECT_EQ(leg.shape(), regular_leg.shape()) << from << " -> " << to;
+  }
+}
+
+TEST_F(AltTest, MatchesCostMatrix) {
+  const std::vector<std::string> sources = {"A", "G", "M", "S"};
+  const std::vector<std::string> targets = {"E", "L", "Q", "T", "H", "J"};
+  auto alt = matrix(alt_map, sources, targets);
+  auto regular = matrix(map, sources, targets);
+
+  const auto& alt_rows = alt["sources_to_targets"].GetArray();
+  const auto& regular_rows = regular["sources_to_targets"].GetArray();
+  ASSERT_EQ(alt_rows.Size(), regular_rows.Size());
+  for (rapidjson::SizeType i = 0; i < alt_rows.Size(); ++i) {
+    for (rapidjson::SizeType j = 0; j < alt_rows[i].Size(); ++j) {
+      ASSERT_FALSE(alt_rows[i][j]["time"].IsNull()) << i << " -> " << j;
+      EXPECT_NEAR(alt_rows[i][j]["time"].GetDouble(), regular_rows[i][j]["time"].GetDouble(), 1.)
+          << i << " -> " << j;
+      EXPECT_NEAR(alt_rows[i][j]["distance"].GetDouble(),
+                  regular_rows[i][j]["distance"].GetDouble(), 0.01)
+          << i << " -> " << j;
+    }
+  }
+}
+
+TEST_F(AltTest, WithoutLandmarks) {
+  // without the file the alt heuristics fall back to the distance
+  auto no_landmarks = alt_map;
+  no_landmarks.config.put("mjolnir.alt.file",
+                          map.config.get<std::string>("mjolnir.tile_dir") + "/no_alt.bin");
+  auto result = gurka::do_action(Options::route, no_landmarks, {"A", "T"}, "auto");
+  auto regular = gurka::do_action(Options::route, map, {"A", "T"}, "auto");
+  EXPECT_EQ(result.trip().routes(0).legs(0).shape(), regular.trip().routes(0).legs(0).shape());
+}
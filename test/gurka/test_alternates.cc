@@ -2,6 +2,8 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 using namespace valhalla;
 
 TEST(Alternates, test_short_route) {
@@ -105,3 +107,48 @@ TEST(Alternates, test_too_long_detour) {
 
   ASSERT_EQ(paths.size(), 1) << "Got alternative with too long detour";
 }
+
+TEST(Alternates, test_more_than_three) {
+  const std::string ascii_map = R"(
+           K---------L
+           E---------F
+       A---B---------C---D
+           G---------H
+           M---------N
+    )";
+
+  const gurka::ways ways = {
+      {"AB", {{"highway", "primary"}, {"maxspeed", "60"}}},
+      {"BC", {{"highway", "primary"}, {"maxspeed", "60"}}},
+      {"CD", {{"highway", "primary"}, {"maxspeed", "60"}}},
+
+      {"BE", {{"highway", "primary"}, {"maxspeed", "60"}}},
+      {"EF", {{"highway", "primary"}, {"maxspeed", "60"}}},
+      {"FC", {{"highway", "primary"}, {"maxspeed", "60"}}},
+      {"EKLF", {{"highway", "primary"}, {"maxspeed", "60"}}},
+
+      {"BG", {{"highway", "primary"}, {"maxspeed", "60"}}},
+      {"GH", {{"highway", "primary"}, {"maxspeed", "60"}}},
+      {"HC", {{"highway", "primary"}, {"maxspeed", "60"}}},
+      {"GMNH", {{"highway", "primary"}, {"maxspeed", "60"}}},
+  };
+
+  const auto layout = gurka::detail::map_to_coordinates(ascii_map, 100);
+  auto map = gurka::buildtiles(layout, ways, {}, {}, "test/data/alternates_more_than_three",
+                               {{"service_limits.max_alternates", "4"}});
+
+  auto result =
+      gurka::do_action(valhalla::Options::route, map, {"A", "D"}, "auto", {{"/alternates", "4"}});
+  auto paths = gurka::detail::get_paths(result);
+
+  ASSERT_EQ(paths.size(), 5) << "Unexpected number of routes";
+  EXPECT_EQ(paths[0], std::vector<std::string>({"AB", "BC", "CD"})) << "Wrong shortest route";
+
+  // the detours on either side cost the same, the ones around them follow
+  std::sort(paths.begin() + 1, paths.begin() + 3);
+  std::sort(paths.begin() + 3, paths.end());
+  EXPECT_EQ(paths[1], std::vector<std::string>({"AB", "BE", "EF", "FC", "CD"}));
+  EXPECT_EQ(paths[2], std::vector<std::string>({"AB", "BG", "GH", "HC", "CD"}));
+  EXPECT_EQ(paths[3], std::vector<std::string>({"AB", "BE", "EKLF", "FC", "CD"}));
+  EXPECT_EQ(paths[4], std::vector<std::string>({"AB", "BG", "GMNH", "HC", "CD"}));
+}
@@ -1,5 +1,6 @@
 #include "gurka.h"
 #include "test.h"
+#include "tyr/actor.h"
 
 #include <gtest/gtest.h>
 
@@ -136,3 +137,64 @@ TEST(StandAlone, failed_search) {
   [[maybe_unused]] auto result =
       gurka::do_action(valhalla::Options::route, map, {"A", "F"}, "auto", {});
 }
+
+TEST(StandAlone, concurrent_search) {
+  const std::string ascii_map = R"(
+    A----B----C----D----E
+    |    |    |    |    |
+    F----G----H----I----J
+    |    |    |    |    |
+    K----L----M----N----O
+    |    |    |    |    |
+    P----Q----R----S----T
+  )";
+  const gurka::ways ways = {
+      {"ABCDE", {{"highway", "primary"}}},
+      {"FGHIJ", {{"highway", "residential"}}},
+      {"KLMNO", {{"highway", "residential"}, {"oneway", "yes"}}},
+      {"PQRST", {{"highway", "secondary"}}},
+      {"AFKP", {{"highway", "tertiary"}}},
+      {"BGLQ", {{"highway", "residential"}}},
+      {"CHMR", {{"highway", "tertiary"}}},
+      {"DINS", {{"highway", "residential"}, {"oneway", "yes"}}},
+      {"EJOT", {{"highway", "primary"}}},
+  };
+  const auto layout = gurka::detail::map_to_coordinates(ascii_map, 100);
+  auto map = gurka::buildtiles(layout, ways, {}, {}, "test/data/bidir_search_concurrent");
+  auto concurrent_map = map;
+  concurrent_map.config.put("thor.bidirectional_astar.concurrency", 2);
+  concurrent_map.config.put("thor.bidirectional_astar.concurrency_min_distance", 0);
+
+  // both trees expanding at the same time find the same routes as taking turns
+  for (const auto& [from, to] : std::vector<std::pair<std::string, std::string>>{
+           {"A", "T"}, {"T", "A"}, {"K", "O"}, {"O", "K"}, {"P", "E"}, {"G", "S"}}) {
+    auto serial = gurka::do_action(valhalla::Options::route, map, {from, to}, "auto");
+    auto concurrent = gurka::do_action(valhalla::Options::route, concurrent_map, {from, to}, "auto");
+    const auto& expected = serial.directions().routes(0).legs(0).summary();
+    const auto& summary = concurrent.directions().routes(0).legs(0).summary();
+    EXPECT_NEAR(summary.time(), expected.time(), 0.1) << from << to;
+    EXPECT_NEAR(summary.length(), expected.length(), 0.001) << from << to;
+  }
+
+  // with an invariant time both trees track it, the reverse one with its own time zone cache
+  const std::unordered_map<std::string, std::string> invariant = {
+      {"/date_time/type", "3"}, {"/date_time/value", "2020-10-10T08:00"}};
+  auto serial = gurka::do_action(valhalla::Options::route, map, {"A", "T"}, "auto", invariant);
+  auto concurrent =
+      gurka::do_action(valhalla::Options::route, concurrent_map, {"A", "T"}, "auto", invariant);
+  EXPECT_NEAR(concurrent.directions().routes(0).legs(0).summary().time(),
+              serial.directions().routes(0).legs(0).summary().time(), 0.1);
+
+  // the interrupt throws in the first round of the forward tree while the reverse tree expands on
+  // the other thread, the request fails without waiting on it and the worker answers the next one
+  auto reader = test::make_clean_graphreader(concurrent_map.config.get_child("mjolnir"));
+  tyr::actor_t actor(concurrent_map.config, *reader, true);
+  const std::vector<midgard::PointLL> lls = {concurrent_map.nodes.at("A"),
+                                             concurrent_map.nodes.at("T")};
+  const auto request = gurka::detail::build_valhalla_request({"locations"}, {lls}, "auto");
+  const std::function<void()> interrupt = []() { throw std::runtime_error("interrupted"); };
+  EXPECT_ANY_THROW(actor.route(request, &interrupt));
+  Api api;
+  actor.route(request, nullptr, &api);
+  EXPECT_EQ(api.trip().routes(0).legs_size(), 1);
+}
@@ -0,0 +1,182 @@
+#include "baldr/contraction_hierarchy.h"
+#include "baldr/rapidjson_utils.h"
+#include "gurka.h"
+#include "mjolnir/contractionhierarchybuilder.h"
+#include "test.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+
+using namespace valhalla;
+
+namespace {
+
+rapidjson::Document matrix(const gurka::map& map,
+                           const std::vector<std::string>& sources,
+                           const std::vector<std::string>& targets,
+                           const std::unordered_map<std::string, std::string>& options = {}) {
+  std::string json;
+  gurka::do_action(Options::sources_to_targets, map, sources, targets, "auto", options, nullptr,
+                   &json);
+  rapidjson::Document result;
+  result.Parse(json.c_str());
+  return result;
+}
+
+} // namespace
+
+class CHMatrixTest : public ::testing::Test {
+protected:
+  static gurka::map map;
+  static gurka::map costmatrix_map;
+
+  static void SetUpTestSuite() {
+    const std::string ascii_map = R"(
+      A----B----C----D----E
+      |    |    |    |    |
+      F----G----H----I----J
+      |    |    |    |    |
+      K----L----M----N----O
+      |    |    |    |    |
+      P----Q----R----S----T
+    )";
+
+    const gurka::ways ways = {
+        {"ABCDE", {{"highway", "primary"}}},
+        {"FGHIJ", {{"highway", "residential"}}},
+        {"KLMNO", {{"highway", "residential"}, {"oneway", "yes"}}},
+        {"PQRST", {{"highway", "secondary"}}},
+        {"AFKP", {{"highway", "tertiary"}}},
+        {"BG", {{"highway", "residential"}}},
+        {"GL", {{"highway", "residential"}, {"oneway", "-1"}}},
+        {"LQ", {{"highway", "residential"}}},
+        {"CHMR", {{"highway", "tertiary"}}},
+        {"DI", {{"highway", "service"}}},
+        {"INS", {{"highway", "residential"}, {"oneway", "yes"}}},
+        {"EJOT", {{"highway", "primary"}}},
+    };
+    const gurka::relations relations = {
+        {{{gurka::way_member, "CHMR", "from"},
+          {gurka::node_member, "M", "via"},
+          {gurka::way_member, "KLMNO", "to"}},
+         {{"type", "restriction"}, {"restriction", "no_right_turn"}}},
+    };
+
+    const auto layout = gurka::detail::map_to_coordinates(ascii_map, 200);
+    map = gurka::buildtiles(layout, ways, {}, relations, VALHALLA_BUILD_DIR "test/data/ch_matrix",
+                            {{"mjolnir.shortcuts", "0"}});
+    boost::property_tree::ptree costings;
+    costings.push_back({"", boost::property_tree::ptree("auto")});
+    map.config.put_child("mjolnir.contraction_hierarchy.costings", costings);
+    mjolnir::ContractionHierarchyBuilder::Build(map.config);
+
+    costmatrix_map = map;
+    costmatrix_map.config.put("thor.source_to_target_algorithm", "costmatrix");
+  }
+};
+
+gurka::map CHMatrixTest::map = {};
+gurka::map CHMatrixTest::costmatrix_map = {};
+
+TEST_F(CHMatrixTest, WritesHierarchy) {
+  const auto dir = baldr::ContractionHierarchy::Directory(map.config.get_child("mjolnir"));
+  const auto file = baldr::ContractionHierarchy::FileName(dir, "auto");
+  ASSERT_TRUE(std::filesystem::exists(file));
+
+  baldr::ContractionHierarchy hierarchy(file);
+  EXPECT_EQ(hierarchy.costing(), static_cast<uint32_t>(Costing::auto_));
+  EXPECT_GT(hierarchy.size(), 0u);
+}
+
+TEST_F(CHMatrixTest, MatchesCostMatrix) {
+  const std::vector<std::string> sources = {"A", "G", "M", "S"};
+  const std::vector<std::string> targets = {"E", "L", "Q", "T", "H", "J"};
+  auto ch = matrix(map, sources, targets);
+  auto costmatrix = matrix(costmatrix_map, sources, targets);
+
+  EXPECT_STREQ(ch["algorithm"].GetString(), "chmatrix");
+  EXPECT_STREQ(costmatrix["algorithm"].GetString(), "costmatrix");
+
+  const auto& ch_rows = ch["sources_to_targets"].GetArray();
+  const auto& costmatrix_rows = costmatrix["sources_to_targets"].GetArray();
+  ASSERT_EQ(ch_rows.Size(), costmatrix_rows.Size());
+  for (rapidjson::SizeType i = 0; i < ch_rows.Size(); ++i) {
+    ASSERT_EQ(ch_rows[i].Size(), costmatrix_rows[i].Size());
+    for (rapidjson::SizeType j = 0; j < ch_rows[i].Size(); ++j) {
+      const auto& expected = costmatrix_rows[i][j];
+      const auto& actual = ch_rows[i][j];
+      ASSERT_FALSE(actual["time"].IsNull()) << i << " -> " << j;
+      EXPECT_NEAR(actual["time"].GetDouble(), expected["time"].GetDouble(), 1.) << i << " -> " << j;
+      EXPECT_NEAR(actual["distance"].GetDouble(), expected["distance"].GetDouble(), 0.01)
+          << i << " -> " << j;
+    }
+  }
+}
+
+TEST_F(CHMatrixTest, OtherOptionsFallBack) {
+  auto result = matrix(map, {"A"}, {"T"}, {{"/costing_options/auto/use_highways", "0.1"}});
+  EXPECT_STREQ(result["algorithm"].GetString(), "costmatrix");
+}
+
+TEST_F(CHMatrixTest, TimeFallsBack) {
+  auto result = matrix(map, {"A"}, {"T"},
+                       {{"/date_time/type", "1"}, {"/date_time/value", "2020-10-10T08:00"}});
+  EXPECT_STRNE(result["algorithm"].GetString(), "chmatrix");
+}
+
+TEST_F(CHMatrixTest, LiveTrafficFallsBack) {
+  // the hierarchy has no idea of the live speeds, those requests go to the other algorithms
+  auto traffic_map = map;
+  traffic_map.config.put("mjolnir.traffic_extract",
+                         VALHALLA_BUILD_DIR "test/data/ch_matrix/traffic.tar");
+  test::build_live_traffic_data(traffic_map.config);
+
+  const auto result = matrix(traffic_map, {"A"}, {"T"});
+  EXPECT_STREQ(result["algorithm"].GetString(), "costmatrix");
+}
+
+TEST(CHMatrixRestriction, ComplexRestrictionFallsBack) {
+  const std::string ascii_map = R"(
+      A----B----C
+           |    |
+           |    E
+           |    |
+           D----F
+    )";
+  const gurka::ways ways = {
+      {"AB", {{"highway", "primary"}}},
+      {"BC", {{"highway", "primary"}}},
+      {"CEF", {{"highway", "primary"}}},
+      {"BD", {{"highway", "primary"}}},
+      {"DF", {{"highway", "primary"}}},
+  };
+  const gurka::relations relations = {
+      {{{gurka::way_member, "AB", "from"},
+        {gurka::way_member, "BC", "via"},
+        {gurka::way_member, "CEF", "to"}},
+       {{"type", "restriction"}, {"restriction", "no_right_turn"}}},
+  };
+  const auto layout = gurka::detail::map_to_coordinates(ascii_map, 100);
+  auto map = gurka::buildtiles(layout, ways, {}, relations,
+                               VALHALLA_BUILD_DIR "test/data/ch_matrix_restriction",
+                               {{"mjolnir.shortcuts", "0"}});
+  boost::property_tree::ptree costings;
+  costings.push_back({"", boost::property_tree::ptree("auto")});
+  map.config.put_child("mjolnir.contraction_hierarchy.costings", costings);
+  mjolnir::ContractionHierarchyBuilder::Build(map.config);
+  auto costmatrix_map = map;
+  costmatrix_map.config.put("thor.source_to_target_algorithm", "costmatrix");
+
+  // the hierarchy's cheapest path goes through the restriction, only the other matrices know
+  // that it has to go around
+  auto result = matrix(map, {"A"}, {"E"});
+  auto expected = matrix(costmatrix_map, {"A"}, {"E"});
+  EXPECT_STREQ(result["algorithm"].GetString(), "costmatrix");
+  EXPECT_NEAR(result["sources_to_targets"][0][0]["distance"].GetDouble(),
+              expected["sources_to_targets"][0][0]["distance"].GetDouble(), 0.01);
+
+  // paths that do not pass the end of a restriction stay on the hierarchy
+  result = matrix(map, {"A"}, {"D"});
+  EXPECT_STREQ(result["algorithm"].GetString(), "chmatrix");
+}
@@ -863,6 +863,13 @@ TEST(GtfsExample, MakeTile) {
             tile->GetNextDeparture(edge.lineid(), 21600, // 06:00 am
                                    dt_day, dt_dow, date_before_tile, false, false);
         EXPECT_EQ(dep->elapsed_time(), 180);
+        // the schedules running on the day looked up once find the same departure
+        const auto active_schedules = tile->GetActiveSchedules(dt_day, dt_dow, date_before_tile);
+        const auto* active_dep =
+            tile->GetNextDeparture(edge.lineid(), 21600, active_schedules, false, false);
+        ASSERT_NE(active_dep, nullptr);
+        EXPECT_EQ(active_dep->tripid(), dep->tripid());
+        EXPECT_EQ(active_dep->departure_time(), dep->departure_time());
         const auto shape = tile->edgeinfo(&edge).encoded_shape();
         EXPECT_FALSE(shape.empty());
         dep->routeindex();
@@ -1059,6 +1066,46 @@ TEST(GtfsExample, route_trip4) {
   EXPECT_EQ(transit_info.onestop_id(), f2_name + "_" + r2_id);
 }
 
+TEST(GtfsExample, raptor) {
+  std::ostringstream tmrw;
+  tmrw << date::format("%F", std::chrono::system_clock::now() + std::chrono::hours(24));
+
+  // raptor takes the same trips as the time dependent expansion
+  for (const auto& [waypoints, date_time] :
+       std::vector<std::pair<std::vector<std::string>, std::string>>{
+           {{"A", "G"}, tmrw.str() + "T05:50"},
+           {{"g", "h"}, "2023-02-27T22:50"},
+       }) {
+    std::unordered_map<std::string, std::string> options = {
+        {"/date_time/type", "1"},
+        {"/date_time/value", date_time},
+        {"/costing_options/pedestrian/transit_start_end_max_distance", "20000"}};
+    auto expected = gurka::do_action(valhalla::Options::route, map, waypoints, "multimodal", options);
+    options["/multimodal_algorithm"] = "raptor";
+    auto result = gurka::do_action(valhalla::Options::route, map, waypoints, "multimodal", options);
+
+    ASSERT_EQ(result.directions().routes_size(), 1) << date_time;
+    const auto& leg = result.directions().routes(0).legs(0);
+    const auto& expected_leg = expected.directions().routes(0).legs(0);
+    EXPECT_NEAR(leg.summary().length(), expected_leg.summary().length(), 0.001) << date_time;
+    ASSERT_EQ(leg.maneuver_size(), expected_leg.maneuver_size()) << date_time;
+    for (int i = 0; i < leg.maneuver_size(); ++i) {
+      EXPECT_EQ(leg.maneuver(i).type(), expected_leg.maneuver(i).type()) << date_time << " " << i;
+      if (leg.maneuver(i).type() != DirectionsLeg_Maneuver_Type_kTransit) {
+        continue;
+      }
+      const auto& stops = leg.maneuver(i).transit_info().transit_stops();
+      const auto& expected_stops = expected_leg.maneuver(i).transit_info().transit_stops();
+      EXPECT_EQ(leg.maneuver(i).transit_info().onestop_id(),
+                expected_leg.maneuver(i).transit_info().onestop_id());
+      ASSERT_EQ(stops.size(), expected_stops.size());
+      EXPECT_EQ(stops.begin()->departure_date_time(), expected_stops.begin()->departure_date_time());
+      EXPECT_EQ(stops.rbegin()->arrival_date_time(), expected_stops.rbegin()->arrival_date_time());
+    }
+    EXPECT_STREQ(result.trip().routes(0).legs(0).algorithms(0).c_str(), "raptor") << date_time;
+  }
+}
+
 TEST(GtfsExample, isochrones) {
 
   std::string res_string;
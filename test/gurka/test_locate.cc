@@ -1,6 +1,8 @@
 #include "baldr/openlr.h"
 #include "baldr/rapidjson_utils.h"
 #include "gurka.h"
+#include "loki/search.h"
+#include "loki/worker.h"
 #include "midgard/pointll.h"
 #include "proto/options.pb.h"
 #include "test.h"
@@ -436,6 +438,85 @@ TEST_F(Search, EdgeSnapCutoffJustWithinReach) {
   EXPECT_GT(edge_count(api), 0);
 }
 
+// bare nearest edge snapping
+
+TEST_F(Search, NearestEdgesClosestFirst) {
+  GraphReader reader(map.config.get_child("mjolnir"));
+  valhalla::loki::Search search(reader);
+  auto edges = search.nearest_edges(pt("3"), 3, 1000);
+  ASSERT_EQ(edges.size(), 3);
+
+  // point 3 is on AD 40% of the way from A
+  auto ad = std::get<0>(gurka::findEdgeByNodes(reader, layout, "A", "D"));
+  auto da = std::get<0>(gurka::findEdgeByNodes(reader, layout, "D", "A"));
+  ASSERT_TRUE(edges[0].id == ad || edges[0].id == da);
+  EXPECT_NEAR(edges[0].distance, 0, 1);
+  EXPECT_NEAR(edges[0].percent_along, edges[0].id == ad ? .4 : .6, .05);
+
+  // sorted and only one direction of each edge
+  for (size_t i = 1; i < edges.size(); ++i) {
+    EXPECT_LE(edges[i - 1].distance, edges[i].distance);
+    EXPECT_NE(edges[i].id, ad);
+    EXPECT_NE(edges[i].id, da);
+  }
+}
+
+TEST_F(Search, NearestEdgesLimits) {
+  GraphReader reader(map.config.get_child("mjolnir"));
+  valhalla::loki::Search search(reader);
+  EXPECT_TRUE(search.nearest_edges(pt("3"), 0, 1000).empty());
+  EXPECT_TRUE(search.nearest_edges({-77, -77}, 5, 1000).empty());
+  // there are only 5 edge pairs in the map
+  EXPECT_EQ(search.nearest_edges(pt("3"), 10, 50000).size(), 5);
+  // y is 500 meters from C
+  EXPECT_TRUE(search.nearest_edges(pt("y"), 5, 499).empty());
+  EXPECT_EQ(search.nearest_edges(pt("y"), 5, 501).size(), 2);
+}
+
+TEST_F(Search, LocateStream) {
+  auto line = [](const PointLL& ll) {
+    return "{\"lat\":" + std::to_string(ll.lat()) + ",\"lon\":" + std::to_string(ll.lng()) + "}\n";
+  };
+  // bad lines in the middle of a batch, blank lines and a trailing partial batch. A line with more
+  // than one location or with more than a location is as bad as one that isn't json
+  auto one = line(pt("1"));
+  one.pop_back();
+  std::vector<std::string> bad{"not json\n", one + "," + line(pt("A")),
+                               one + "],\"costing\":\"pedestrian\"\n"};
+  std::vector<std::string> names{"3", "7", "5", "", "1", "A", "", "y", ""};
+  std::stringstream input;
+  size_t b = 0;
+  for (const auto& name : names)
+    input << (name.empty() ? bad[b++] : line(pt(name)));
+  input << "\n  \n";
+
+  std::stringstream output;
+  loki::locate_stream(map.config, R"({"costing":"auto"})", input, output, 2, 3);
+
+  std::string result;
+  size_t i = 0;
+  while (std::getline(output, result)) {
+    ASSERT_LT(i, names.size());
+    rapidjson::Document doc;
+    doc.Parse(result.c_str());
+    ASSERT_FALSE(doc.HasParseError()) << result;
+    if (names[i].empty()) {
+      EXPECT_TRUE(doc.HasMember("error_code")) << result;
+    } else {
+      EXPECT_NEAR(doc["input_lat"].GetDouble(), pt(names[i]).lat(), 1e-5) << result;
+      EXPECT_NEAR(doc["input_lon"].GetDouble(), pt(names[i]).lng(), 1e-5) << result;
+      EXPECT_TRUE(doc.HasMember("edges")) << result;
+    }
+    ++i;
+  }
+  EXPECT_EQ(i, names.size());
+
+  // locations belong in the stream not in the request
+  std::stringstream empty;
+  EXPECT_THROW(loki::locate_stream(map.config, R"({"locations":[]})", empty, output),
+               valhalla_exception_t);
+}
+
 TEST(locate, basic_properties) {
   const std::string ascii_map = R"(
     A-1--B--2-C
@@ -1,3 +1,4 @@
+#include "baldr/compression_utils.h"
 #include "baldr/rapidjson_utils.h"
 #include "gurka.h"
 #include "loki/worker.h"
@@ -5,11 +6,15 @@
 #include "proto/api.pb.h"
 #include "test.h"
 #include "thor/worker.h"
+#include "tyr/actor.h"
 #include "valhalla/proto_conversions.h"
 #include "valhalla/worker.h"
 
 #include <gtest/gtest.h>
 
+#include <cstring>
+#include <set>
+
 using namespace valhalla;
 using namespace valhalla::thor;
 using namespace valhalla::midgard;
@@ -841,6 +846,84 @@ TEST_F(DateTimeTest, NoTimeZone) {
   }
 }
 
+TEST(StandAlone, TDMatrixProfile) {
+  const std::string ascii_map = R"(
+    A-----B-----C
+          |
+          D-----E
+  )";
+  const gurka::ways ways = {
+      {"ABC", {{"highway", "primary"}}},
+      {"BDE", {{"highway", "residential"}}},
+  };
+  const auto layout = gurka::detail::map_to_coordinates(ascii_map, 500, {-8.5755, 42.1079});
+  auto map = gurka::buildtiles(layout, ways, {}, {}, VALHALLA_BUILD_DIR "test/data/td_matrix_profile",
+                               {{"mjolnir.timezone", VALHALLA_BUILD_DIR "test/data/tz.sqlite"},
+                                {"service_limits.max_timedep_distance_matrix", "50000"}});
+  // fast before 7am, slow after
+  test::customize_historical_traffic(map.config, [](baldr::DirectedEdge& e) {
+    e.set_free_flow_speed(80);
+    e.set_constrained_flow_speed(10);
+    return std::nullopt;
+  });
+
+  const uint32_t departures = 8;
+  auto matrix = [&](const gurka::map& map, const std::string& date_time, const bool profile) {
+    std::unordered_map<std::string, std::string> options = {{"/sources/0/date_time", date_time}};
+    if (profile) {
+      options["/profile_departures"] = std::to_string(departures);
+      options["/profile_interval"] = "15";
+    }
+    std::string json;
+    auto api = gurka::do_action(Options::sources_to_targets, map, {"A"}, {"C", "E"}, "auto", options,
+                                nullptr, &json);
+    EXPECT_EQ(api.matrix().algorithm(), Matrix::TimeDistanceMatrix);
+    rapidjson::Document doc;
+    doc.Parse(json.c_str());
+    return doc;
+  };
+
+  // several searches for the departures give the same profile
+  auto lanes_map = map;
+  lanes_map.config.put("thor.timedistancematrix.profile_lanes", 3);
+
+  const auto profile = matrix(map, "2024-03-20T06:15", true);
+  const auto lanes = matrix(lanes_map, "2024-03-20T06:15", true);
+  const std::vector<std::string> times = {"06:15", "06:30", "06:45", "07:00",
+                                          "07:15", "07:30", "07:45", "08:00"};
+  for (rapidjson::SizeType target = 0; target < 2; ++target) {
+    const auto& cell = profile["sources_to_targets"][0][target];
+    ASSERT_TRUE(cell.HasMember("profile"));
+    const auto& profile_times = cell["profile"]["times"];
+    const auto& profile_distances = cell["profile"]["distances"];
+    ASSERT_EQ(profile_times.Size(), departures);
+    ASSERT_EQ(profile_distances.Size(), departures);
+    EXPECT_EQ(cell["time"].GetUint64(), profile_times[0].GetUint64());
+    EXPECT_LT(profile_times[0].GetUint64(), profile_times[departures - 1].GetUint64());
+
+    // every departure is what a request for it alone gets
+    for (uint32_t k = 0; k < departures; ++k) {
+      const auto single = matrix(map, "2024-03-20T" + times[k], false);
+      const auto& expected = single["sources_to_targets"][0][target];
+      EXPECT_EQ(profile_times[k].GetUint64(), expected["time"].GetUint64()) << times[k];
+      EXPECT_NEAR(profile_distances[k].GetDouble(), expected["distance"].GetDouble(), 0.001)
+          << times[k];
+      EXPECT_EQ(lanes["sources_to_targets"][0][target]["profile"]["times"][k].GetUint64(),
+                profile_times[k].GetUint64())
+          << times[k];
+    }
+  }
+
+  // without a time there is no profile
+  std::string json;
+  auto api = gurka::do_action(Options::sources_to_targets, map, {"A"}, {"C", "E"}, "auto",
+                              {{"/profile_departures", "4"}}, nullptr, &json);
+  EXPECT_EQ(api.matrix().profile_times_size(), 0);
+  const auto& warnings = api.info().warnings();
+  EXPECT_TRUE(std::any_of(warnings.begin(), warnings.end(),
+                          [](const auto& warning) { return warning.code() == 217; }));
+}
+
 // Parameterize check_reverse_connection
 class TestConnectionCheck : public ::testing::TestWithParam<std::string> {};
 
@@ -1417,3 +1500,474 @@ TEST(StandAlone, MaxDistanceCutoff) {
     EXPECT_TRUE(row[2]["distance"].IsNull()) << "A->D should NOT be reachable with max_distance=4500";
   }
 }
+
+TEST(StandAlone, CostMatrixParallel) {
+  const std::string ascii_map = R"(
+    A----B----C----D----E
+    |    |    |    |    |
+    F----G----H----I----J
+    |    |    |    |    |
+    K----L----M----N----O
+    |    |    |    |    |
+    P----Q----R----S----T
+  )";
+  const gurka::ways ways = {
+      {"ABCDE", {{"highway", "primary"}}},
+      {"FGHIJ", {{"highway", "residential"}}},
+      {"KLMNO", {{"highway", "residential"}, {"oneway", "yes"}}},
+      {"PQRST", {{"highway", "secondary"}}},
+      {"AFKP", {{"highway", "tertiary"}}},
+      {"BGLQ", {{"highway", "residential"}}},
+      {"CHMR", {{"highway", "tertiary"}}},
+      {"DINS", {{"highway", "residential"}, {"oneway", "yes"}}},
+      {"EJOT", {{"highway", "primary"}}},
+  };
+
+  const auto layout = gurka::detail::map_to_coordinates(ascii_map, 100);
+  auto map =
+      gurka::buildtiles(layout, ways, {}, {}, VALHALLA_BUILD_DIR "test/data/costmatrix_parallel",
+                        {{"thor.source_to_target_algorithm", "costmatrix"}});
+  auto parallel_map = map;
+  parallel_map.config.put("thor.costmatrix.concurrency", 4);
+
+  const std::vector<std::string> sources = {"A", "G", "M", "S", "T", "K"};
+  const std::vector<std::string> targets = {"E", "L", "Q", "T", "H", "J", "A"};
+  auto serial =
+      gurka::do_action(valhalla::Options::sources_to_targets, map, sources, targets, "auto");
+  auto parallel =
+      gurka::do_action(valhalla::Options::sources_to_targets, parallel_map, sources, targets, "auto");
+  ASSERT_EQ(parallel.matrix().times_size(), serial.matrix().times_size());
+  for (int i = 0; i < serial.matrix().times_size(); ++i) {
+    EXPECT_NEAR(parallel.matrix().times(i), serial.matrix().times(i), 1.) << i;
+    EXPECT_NEAR(parallel.matrix().distances(i), serial.matrix().distances(i), 1.) << i;
+  }
+
+  // the searches of a round only see what the other direction did up to the round before, so
+  // the result does not depend on the threads
+  for (int run = 0; run < 3; ++run) {
+    auto again = gurka::do_action(valhalla::Options::sources_to_targets, parallel_map, sources,
+                                  targets, "auto");
+    for (int i = 0; i < parallel.matrix().times_size(); ++i) {
+      EXPECT_EQ(again.matrix().times(i), parallel.matrix().times(i)) << i;
+      EXPECT_EQ(again.matrix().distances(i), parallel.matrix().distances(i)) << i;
+    }
+  }
+
+  // the threads look up the time zones of a departure in caches of their own
+  const std::unordered_map<std::string, std::string> depart = {
+      {"/date_time/type", "1"}, {"/date_time/value", "2020-10-10T08:00"}};
+  auto timed = gurka::do_action(valhalla::Options::sources_to_targets, map, sources, targets,
+                                "auto", depart);
+  auto timed_parallel = gurka::do_action(valhalla::Options::sources_to_targets, parallel_map,
+                                         sources, targets, "auto", depart);
+  ASSERT_EQ(timed_parallel.matrix().times_size(), timed.matrix().times_size());
+  for (int i = 0; i < timed.matrix().times_size(); ++i) {
+    EXPECT_NEAR(timed_parallel.matrix().times(i), timed.matrix().times(i), 1.) << i;
+  }
+  ASSERT_EQ(timed_parallel.matrix().date_times_size(), timed.matrix().date_times_size());
+  for (int i = 0; i < timed.matrix().date_times_size(); ++i) {
+    EXPECT_EQ(timed_parallel.matrix().date_times(i), timed.matrix().date_times(i)) << i;
+  }
+}
+
+TEST(StandAlone, TimeDistanceMatrixParallel) {
+  const std::string ascii_map = R"(
+    A----B----C----D----E
+    |    |    |    |    |
+    F----G----H----I----J
+    |    |    |    |    |
+    K----L----M----N----O
+  )";
+  const gurka::ways ways = {
+      {"ABCDE", {{"highway", "residential"}}},
+      {"FGHIJ", {{"highway", "footway"}}},
+      {"KLMNO", {{"highway", "residential"}}},
+      {"AFK", {{"highway", "residential"}}},
+      {"BGL", {{"highway", "path"}}},
+      {"CHM", {{"highway", "residential"}}},
+      {"DIN", {{"highway", "steps"}}},
+      {"EJO", {{"highway", "residential"}}},
+  };
+
+  const auto layout = gurka::detail::map_to_coordinates(ascii_map, 100);
+  auto map = gurka::buildtiles(layout, ways, {}, {},
+                               VALHALLA_BUILD_DIR "test/data/timedistancematrix_parallel",
+                               {{"thor.source_to_target_algorithm", "timedistancematrix"}});
+  auto parallel_map = map;
+  parallel_map.config.put("thor.timedistancematrix.concurrency", 3);
+
+  // every origin is searched on its own, so the threads give exactly the same matrix in both
+  // directions, with more sources than targets it searches from the targets
+  for (const auto& [sources, targets] :
+       std::vector<std::pair<std::vector<std::string>, std::vector<std::string>>>{
+           {{"A", "H", "O"}, {"E", "K", "M", "C", "J"}},
+           {{"E", "K", "M", "C", "J"}, {"A", "H", "O"}},
+       }) {
+    for (const auto& costing : {"pedestrian", "bicycle"}) {
+      auto serial =
+          gurka::do_action(valhalla::Options::sources_to_targets, map, sources, targets, costing);
+      auto parallel = gurka::do_action(valhalla::Options::sources_to_targets, parallel_map, sources,
+                                       targets, costing);
+      ASSERT_EQ(parallel.matrix().times_size(), serial.matrix().times_size());
+      for (int i = 0; i < serial.matrix().times_size(); ++i) {
+        EXPECT_GT(serial.matrix().distances(i), 0u) << costing << " " << i;
+        EXPECT_EQ(parallel.matrix().times(i), serial.matrix().times(i)) << costing << " " << i;
+        EXPECT_EQ(parallel.matrix().distances(i), serial.matrix().distances(i))
+            << costing << " " << i;
+        EXPECT_EQ(parallel.matrix().from_indices(i), serial.matrix().from_indices(i));
+        EXPECT_EQ(parallel.matrix().to_indices(i), serial.matrix().to_indices(i));
+      }
+    }
+  }
+
+  // with a departure every thread looks up the time zones in a cache of its own
+  const std::unordered_map<std::string, std::string> depart = {
+      {"/date_time/type", "1"}, {"/date_time/value", "2020-10-10T08:00"}};
+  const std::vector<std::string> timed_sources = {"A", "H", "O"};
+  const std::vector<std::string> timed_targets = {"E", "K", "M", "C", "J"};
+  auto timed = gurka::do_action(valhalla::Options::sources_to_targets, map, timed_sources,
+                                timed_targets, "pedestrian", depart);
+  auto timed_parallel = gurka::do_action(valhalla::Options::sources_to_targets, parallel_map,
+                                         timed_sources, timed_targets, "pedestrian", depart);
+  ASSERT_EQ(timed_parallel.matrix().date_times_size(), timed.matrix().date_times_size());
+  for (int i = 0; i < timed.matrix().date_times_size(); ++i) {
+    EXPECT_EQ(timed_parallel.matrix().times(i), timed.matrix().times(i)) << i;
+    EXPECT_EQ(timed_parallel.matrix().date_times(i), timed.matrix().date_times(i)) << i;
+  }
+
+  // an interrupted request stops the other threads with it and the worker answers the next one
+  auto reader = test::make_clean_graphreader(parallel_map.config.get_child("mjolnir"));
+  tyr::actor_t actor(parallel_map.config, *reader, true);
+  std::vector<midgard::PointLL> source_lls, target_lls;
+  for (const auto& node : {"A", "H", "O"}) {
+    source_lls.push_back(parallel_map.nodes.at(node));
+  }
+  for (const auto& node : {"E", "K", "M", "C", "J"}) {
+    target_lls.push_back(parallel_map.nodes.at(node));
+  }
+  const auto request = gurka::detail::build_valhalla_request({"sources", "targets"},
+                                                             {source_lls, target_lls}, "pedestrian");
+  const std::function<void()> interrupt = []() { throw std::runtime_error("interrupted"); };
+  EXPECT_ANY_THROW(actor.matrix(request, &interrupt));
+  Api api;
+  actor.matrix(request, nullptr, &api);
+  EXPECT_EQ(api.matrix().times_size(), 15);
+}
+
+TEST(StandAlone, BinaryFormat) {
+  const std::string ascii_map = R"(
+    A----B----C
+    |    |    |
+    D----E----F
+    |         |
+    G----H    I
+  )";
+  const gurka::ways ways = {
+      {"ABC", {{"highway", "residential"}}}, {"DEF", {{"highway", "residential"}}},
+      {"GH", {{"highway", "residential"}}},  {"ADG", {{"highway", "residential"}}},
+      {"BE", {{"highway", "residential"}}},  {"CFI", {{"highway", "residential"}}},
+  };
+  const auto layout = gurka::detail::map_to_coordinates(ascii_map, 100);
+  auto map = gurka::buildtiles(layout, ways, {}, {}, VALHALLA_BUILD_DIR "test/data/matrix_binary");
+
+  const std::vector<std::string> sources = {"A", "H", "E"};
+  const std::vector<std::string> targets = {"I", "G", "B", "E"};
+  std::string response, request_json;
+  auto api = gurka::do_action(valhalla::Options::sources_to_targets, map, sources, targets, "auto",
+                              {{"/format", "binary"}}, nullptr, &response, &request_json);
+
+  // the same arrays as in the pbf after a 32 byte header
+  const auto check = [&](const std::string& bytes) {
+    const size_t count = sources.size() * targets.size();
+    ASSERT_EQ(bytes.size(), 32 + count * 8);
+    EXPECT_EQ(bytes.substr(0, 4), "VMTX");
+    uint32_t header[8];
+    std::memcpy(header, bytes.data(), sizeof(header));
+    EXPECT_EQ(header[1], 1u);
+    EXPECT_EQ(header[2], sources.size());
+    EXPECT_EQ(header[3], targets.size());
+    EXPECT_EQ(header[4], static_cast<uint32_t>(api.matrix().algorithm()));
+
+    std::vector<float> times(count);
+    std::vector<uint32_t> distances(count);
+    std::memcpy(times.data(), bytes.data() + 32, count * sizeof(float));
+    std::memcpy(distances.data(), bytes.data() + 32 + count * sizeof(float),
+                count * sizeof(uint32_t));
+    ASSERT_EQ(api.matrix().times_size(), static_cast<int>(count));
+    for (size_t i = 0; i < count; ++i) {
+      EXPECT_EQ(times[i], api.matrix().times(i)) << i;
+      EXPECT_EQ(distances[i], api.matrix().distances(i)) << i;
+    }
+    EXPECT_GT(distances[0], 0u);
+  };
+  check(response);
+
+  // gzipped it has to inflate to the same bytes
+  rapidjson::Document request;
+  request.Parse(request_json);
+  request.AddMember("compress", true, request.GetAllocator());
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  request.Accept(writer);
+  std::string compressed;
+  api = gurka::do_action(valhalla::Options::sources_to_targets, map, buffer.GetString(), nullptr,
+                         &compressed);
+
+  std::string inflated;
+  auto inflate_src = [&compressed](z_stream& s) {
+    s.next_in = reinterpret_cast<Byte*>(compressed.data());
+    s.avail_in = static_cast<unsigned int>(compressed.size());
+  };
+  auto inflate_dst = [&inflated](z_stream& s) {
+    auto size = inflated.size();
+    if (s.total_out < size)
+      inflated.resize(s.total_out);
+    else {
+      inflated.resize(size + 256);
+      s.next_out = reinterpret_cast<Byte*>(&inflated[size]);
+      s.avail_out = 256;
+    }
+    return Z_NO_FLUSH;
+  };
+  ASSERT_TRUE(valhalla::baldr::inflate(inflate_src, inflate_dst));
+  EXPECT_EQ(inflated, response);
+}
+
+TEST(StandAlone, CostMatrixBlocks) {
+  const std::string ascii_map = R"(
+    A----B----C----D----E
+    |    |    |    |    |
+    F----G----H----I----J
+    |    |    |    |    |
+    K----L----M----N----O
+  )";
+  const gurka::ways ways = {
+      {"ABCDE", {{"highway", "primary"}}},
+      {"FGHIJ", {{"highway", "residential"}}},
+      {"KLMNO", {{"highway", "residential"}, {"oneway", "yes"}}},
+      {"AFK", {{"highway", "tertiary"}}},
+      {"BGL", {{"highway", "residential"}}},
+      {"CHM", {{"highway", "tertiary"}}},
+      {"DIN", {{"highway", "residential"}, {"oneway", "-1"}}},
+      {"EJO", {{"highway", "primary"}}},
+  };
+  const auto layout = gurka::detail::map_to_coordinates(ascii_map, 100);
+  auto map = gurka::buildtiles(layout, ways, {}, {}, VALHALLA_BUILD_DIR "test/data/costmatrix_blocks",
+                               {{"thor.source_to_target_algorithm", "costmatrix"}});
+
+  const std::vector<std::string> sources = {"A", "G", "M", "O", "K"};
+  const std::vector<std::string> targets = {"E", "L", "A", "H", "J", "N", "C"};
+  auto whole = gurka::do_action(valhalla::Options::sources_to_targets, map, sources, targets, "auto");
+  ASSERT_EQ(whole.matrix().times_size(), 35);
+
+  // blocks keeping all the sources, splitting both sides and a block per source and target give
+  // the same connections in the same places
+  for (const auto max_locations : {10, 4, 2}) {
+    auto blocks_map = map;
+    blocks_map.config.put("thor.costmatrix.max_block_locations", max_locations);
+    auto blocks = gurka::do_action(valhalla::Options::sources_to_targets, blocks_map, sources,
+                                   targets, "auto");
+    ASSERT_EQ(blocks.matrix().times_size(), whole.matrix().times_size()) << max_locations;
+    EXPECT_EQ(blocks.matrix().algorithm(), Matrix::CostMatrix);
+    for (int i = 0; i < whole.matrix().times_size(); ++i) {
+      EXPECT_EQ(blocks.matrix().from_indices(i), whole.matrix().from_indices(i)) << i;
+      EXPECT_EQ(blocks.matrix().to_indices(i), whole.matrix().to_indices(i)) << i;
+      EXPECT_NEAR(blocks.matrix().times(i), whole.matrix().times(i), 1.) << max_locations << " " << i;
+      EXPECT_NEAR(blocks.matrix().distances(i), whole.matrix().distances(i), 1.)
+          << max_locations << " " << i;
+    }
+  }
+
+  // a concise request without shapes has no strings to keep for every connection
+  {
+    auto blocks_map = map;
+    blocks_map.config.put("thor.costmatrix.max_block_locations", 4);
+    auto concise = gurka::do_action(valhalla::Options::sources_to_targets, blocks_map, sources,
+                                    targets, "auto", {{"/verbose", "0"}});
+    ASSERT_EQ(concise.matrix().times_size(), whole.matrix().times_size());
+    EXPECT_EQ(concise.matrix().date_times_size(), 0);
+    EXPECT_EQ(concise.matrix().time_zone_names_size(), 0);
+    EXPECT_EQ(concise.matrix().shapes_size(), 0);
+    for (int i = 0; i < whole.matrix().times_size(); ++i) {
+      EXPECT_NEAR(concise.matrix().times(i), whole.matrix().times(i), 1.) << i;
+    }
+  }
+
+  // the warnings every block raises are in the response once, like for the whole matrix
+  std::unordered_map<std::string, std::string> options;
+  for (size_t t = 0; t < targets.size(); ++t) {
+    options["/targets/" + std::to_string(t) + "/date_time"] = "2016-07-03T08:06";
+  }
+  whole = gurka::do_action(valhalla::Options::sources_to_targets, map, sources, targets, "auto",
+                           options);
+  auto blocks_map = map;
+  blocks_map.config.put("thor.costmatrix.max_block_locations", 4);
+  auto blocks = gurka::do_action(valhalla::Options::sources_to_targets, blocks_map, sources,
+                                 targets, "auto", options);
+  std::set<uint64_t> whole_codes, block_codes;
+  for (const auto& warning : whole.info().warnings()) {
+    whole_codes.insert(warning.code());
+  }
+  for (const auto& warning : blocks.info().warnings()) {
+    EXPECT_TRUE(block_codes.insert(warning.code()).second) << warning.code();
+  }
+  EXPECT_TRUE(whole_codes.count(206));
+  EXPECT_EQ(block_codes, whole_codes);
+}
+
+namespace {
+// the value of a matrix cache statistic of the request, -1 if it has none
+double matrix_cache_stat(const Api& api, const std::string& name) {
+  for (const auto& stat : api.info().statistics()) {
+    if (stat.key().ends_with(".matrix_cache." + name)) {
+      return stat.value();
+    }
+  }
+  return -1;
+}
+
+// one worker answering every request, so the cache lives on between them
+Api cached_matrix(tyr::actor_t& actor,
+                  const gurka::map& map,
+                  const std::vector<std::string>& sources,
+                  const std::vector<std::string>& targets,
+                  const std::unordered_map<std::string, std::string>& options = {}) {
+  std::vector<midgard::PointLL> source_lls, target_lls;
+  for (const auto& source : sources) {
+    source_lls.push_back(map.nodes.at(source));
+  }
+  for (const auto& target : targets) {
+    target_lls.push_back(map.nodes.at(target));
+  }
+  const auto request = gurka::detail::build_valhalla_request({"sources", "targets"},
+                                                             {source_lls, target_lls}, "auto",
+                                                             options);
+  Api api;
+  actor.matrix(request, nullptr, &api);
+  return api;
+}
+} // namespace
+
+TEST(StandAlone, MatrixCache) {
+  const std::string ascii_map = R"(
+    A----B----C----D----E
+    |    |    |    |    |
+    F----G----H----I----J
+    |    |    |    |    |
+    K----L----M----N----O
+  )";
+  const gurka::ways ways = {
+      {"ABCDE", {{"highway", "primary"}}},
+      {"FGHIJ", {{"highway", "residential"}}},
+      {"KLMNO", {{"highway", "residential"}, {"oneway", "yes"}}},
+      {"AFK", {{"highway", "tertiary"}}},
+      {"BGL", {{"highway", "residential"}}},
+      {"CHM", {{"highway", "tertiary"}}},
+      {"DIN", {{"highway", "residential"}}},
+      {"EJO", {{"highway", "primary"}}},
+  };
+  const auto layout = gurka::detail::map_to_coordinates(ascii_map, 100);
+  auto map = gurka::buildtiles(layout, ways, {}, {}, VALHALLA_BUILD_DIR "test/data/matrix_cache",
+                               {{"thor.matrix_cache.max_connections", "100"}});
+  auto reader = test::make_clean_graphreader(map.config.get_child("mjolnir"));
+  tyr::actor_t actor(map.config, *reader, true);
+
+  // the first request computes everything, the same one again nothing
+  auto first = cached_matrix(actor, map, {"A", "G"}, {"E", "L", "O"});
+  EXPECT_EQ(matrix_cache_stat(first, "hits"), 0);
+  EXPECT_EQ(matrix_cache_stat(first, "misses"), 6);
+  auto again = cached_matrix(actor, map, {"A", "G"}, {"E", "L", "O"});
+  EXPECT_EQ(matrix_cache_stat(again, "hits"), 6);
+  EXPECT_EQ(matrix_cache_stat(again, "misses"), 0);
+  ASSERT_EQ(again.matrix().times_size(), first.matrix().times_size());
+  for (int i = 0; i < first.matrix().times_size(); ++i) {
+    EXPECT_EQ(again.matrix().times(i), first.matrix().times(i)) << i;
+    EXPECT_EQ(again.matrix().distances(i), first.matrix().distances(i)) << i;
+  }
+
+  // an overlapping request only computes the row of the new source, in its place among the cached
+  // connections
+  const std::vector<std::string> sources = {"A", "M", "G"};
+  const std::vector<std::string> targets = {"E", "L", "O"};
+  auto overlap = cached_matrix(actor, map, sources, targets);
+  EXPECT_EQ(matrix_cache_stat(overlap, "hits"), 6);
+  EXPECT_EQ(matrix_cache_stat(overlap, "misses"), 3);
+  auto uncached =
+      gurka::do_action(valhalla::Options::sources_to_targets, map, sources, targets, "auto");
+  ASSERT_EQ(overlap.matrix().times_size(), uncached.matrix().times_size());
+  for (int i = 0; i < uncached.matrix().times_size(); ++i) {
+    EXPECT_EQ(overlap.matrix().from_indices(i), uncached.matrix().from_indices(i)) << i;
+    EXPECT_EQ(overlap.matrix().to_indices(i), uncached.matrix().to_indices(i)) << i;
+    EXPECT_NEAR(overlap.matrix().times(i), uncached.matrix().times(i), 1.) << i;
+    EXPECT_NEAR(overlap.matrix().distances(i), uncached.matrix().distances(i), 1.) << i;
+  }
+
+  // other costing options are other connections
+  auto shorter = cached_matrix(actor, map, {"A", "G"}, {"E", "L", "O"},
+                               {{"/costing_options/auto/use_highways", "0.2"}});
+  EXPECT_EQ(matrix_cache_stat(shorter, "hits"), 0);
+
+  // rebuilt tiles drop the connections once the reader sees them
+  auto rebuilt_ways = ways;
+  rebuilt_ways["EJO"] = {{"highway", "residential"}};
+  gurka::buildtiles(layout, rebuilt_ways, {}, {}, VALHALLA_BUILD_DIR "test/data/matrix_cache",
+                    {{"thor.matrix_cache.max_connections", "100"}});
+  reader->Clear();
+  auto rebuilt = cached_matrix(actor, map, {"A", "G"}, {"E", "L", "O"});
+  EXPECT_EQ(matrix_cache_stat(rebuilt, "hits"), 0);
+  EXPECT_EQ(matrix_cache_stat(rebuilt, "misses"), 6);
+}
+
+TEST_F(MatrixTrafficTest, MatrixCacheTrafficUpdate) {
+  auto cache_map = map;
+  cache_map.config.put("thor.matrix_cache.max_connections", 10);
+  cache_map.config.put("thor.matrix_cache.traffic_check_interval", 0);
+  auto reader = test::make_clean_graphreader(cache_map.config.get_child("mjolnir"));
+  tyr::actor_t actor(cache_map.config, *reader, true);
+  const std::unordered_map<std::string, std::string> options = {
+      {"/costing_options/auto/speed_types/0", "current"}};
+
+  auto first = cached_matrix(actor, cache_map, {"1", "2"}, {"1", "2"}, options);
+  EXPECT_EQ(matrix_cache_stat(first, "misses"), 4);
+  auto again = cached_matrix(actor, cache_map, {"1", "2"}, {"1", "2"}, options);
+  EXPECT_EQ(matrix_cache_stat(again, "hits"), 4);
+
+  // a newer traffic update drops the connections computed with the traffic before it
+  test::customize_live_traffic_data(cache_map.config,
+                                    [](baldr::GraphReader&, baldr::TrafficTile& tile, uint32_t,
+                                       baldr::TrafficSpeed*) { tile.header->last_update = 1000; });
+  auto updated = cached_matrix(actor, cache_map, {"1", "2"}, {"1", "2"}, options);
+  EXPECT_EQ(matrix_cache_stat(updated, "hits"), 0);
+  EXPECT_EQ(matrix_cache_stat(updated, "misses"), 4);
+}
+
+TEST_F(DateTimeTest, MatrixCacheDateTimes) {
+  auto cache_map = map_tz;
+  cache_map.config.put("thor.matrix_cache.max_connections", 10);
+  auto reader = test::make_clean_graphreader(cache_map.config.get_child("mjolnir"));
+  tyr::actor_t actor(cache_map.config, *reader, true);
+
+  // a departure in the same bucket gets the cached connections, arriving as much later as it left
+  for (const auto* prioritize_bidirectional : {"0", "1"}) {
+    std::unordered_map<std::string, std::string> options = {
+        {"/prioritize_bidirectional", prioritize_bidirectional},
+        {"/verbose", "1"},
+        {"/date_time/type", "1"},
+        {"/date_time/value", "2020-10-30T09:00"}};
+    auto first = cached_matrix(actor, cache_map, {"A", "G"}, {"A", "G"}, options);
+    EXPECT_EQ(matrix_cache_stat(first, "misses"), 4);
+    options["/date_time/value"] = "2020-10-30T09:05";
+    auto later = cached_matrix(actor, cache_map, {"A", "G"}, {"A", "G"}, options);
+    EXPECT_EQ(matrix_cache_stat(later, "hits"), 4);
+    auto uncached = gurka::do_action(valhalla::Options::sources_to_targets, map_tz, {"A", "G"},
+                                     {"A", "G"}, "auto", options);
+    ASSERT_EQ(later.matrix().date_times_size(), uncached.matrix().date_times_size());
+    for (int i = 0; i < uncached.matrix().date_times_size(); ++i) {
+      EXPECT_FALSE(later.matrix().date_times(i).empty()) << i;
+      EXPECT_NE(later.matrix().date_times(i), first.matrix().date_times(i)) << i;
+      EXPECT_EQ(later.matrix().date_times(i), uncached.matrix().date_times(i)) << i;
+      EXPECT_EQ(later.matrix().time_zone_offsets(i), uncached.matrix().time_zone_offsets(i)) << i;
+      EXPECT_EQ(later.matrix().time_zone_names(i), uncached.matrix().time_zone_names(i)) << i;
+    }
+  }
+}
@@ -0,0 +1,270 @@
+#include "baldr/partition_overlay.h"
+#include "baldr/rapidjson_utils.h"
+#include "gurka.h"
+#include "mjolnir/overlaybuilder.h"
+#include "test.h"
+#include "tyr/actor.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+using namespace valhalla;
+
+namespace {
+
+rapidjson::Document matrix(const gurka::map& map,
+                           const std::vector<std::string>& sources,
+                           const std::vector<std::string>& targets,
+                           const std::unordered_map<std::string, std::string>& options = {}) {
+  std::string json;
+  gurka::do_action(Options::sources_to_targets, map, sources, targets, "auto", options, nullptr,
+                   &json);
+  rapidjson::Document result;
+  result.Parse(json.c_str());
+  return result;
+}
+
+void expect_same_matrix(const rapidjson::Document& actual, const rapidjson::Document& expected) {
+  const auto& actual_rows = actual["sources_to_targets"].GetArray();
+  const auto& expected_rows = expected["sources_to_targets"].GetArray();
+  ASSERT_EQ(actual_rows.Size(), expected_rows.Size());
+  for (rapidjson::SizeType i = 0; i < actual_rows.Size(); ++i) {
+    ASSERT_EQ(actual_rows[i].Size(), expected_rows[i].Size());
+    for (rapidjson::SizeType j = 0; j < actual_rows[i].Size(); ++j) {
+      const auto& cell = actual_rows[i][j];
+      const auto& expected_cell = expected_rows[i][j];
+      ASSERT_FALSE(cell["time"].IsNull()) << i << " -> " << j;
+      EXPECT_NEAR(cell["time"].GetDouble(), expected_cell["time"].GetDouble(), 1.)
+          << i << " -> " << j;
+      EXPECT_NEAR(cell["distance"].GetDouble(), expected_cell["distance"].GetDouble(), 0.01)
+          << i << " -> " << j;
+    }
+  }
+}
+
+} // namespace
+
+class OverlayTest : public ::testing::Test {
+protected:
+  static gurka::map map;
+  static gurka::map regular_map;
+
+  static void SetUpTestSuite() {
+    const std::string ascii_map = R"(
+      A----B----C----D----E
+      |    |    |    |    |
+      F----G----H----I----J
+      |    |    |    |    |
+      K----L----M----N----O
+      |    |    |    |    |
+      P----Q----R----S----T
+    )";
+
+    const gurka::ways ways = {
+        {"ABCDE", {{"highway", "primary"}}},
+        {"FGHIJ", {{"highway", "residential"}}},
+        {"KLMNO", {{"highway", "residential"}, {"oneway", "yes"}}},
+        {"PQRST", {{"highway", "secondary"}}},
+        {"AFKP", {{"highway", "tertiary"}}},
+        {"BG", {{"highway", "residential"}}},
+        {"GL", {{"highway", "residential"}, {"oneway", "-1"}}},
+        {"LQ", {{"highway", "residential"}}},
+        {"CHMR", {{"highway", "tertiary"}}},
+        {"DI", {{"highway", "service"}}},
+        {"INS", {{"highway", "residential"}, {"oneway", "yes"}}},
+        {"EJOT", {{"highway", "primary"}}},
+    };
+    const gurka::relations relations = {
+        {{{gurka::way_member, "CHMR", "from"},
+          {gurka::node_member, "M", "via"},
+          {gurka::way_member, "KLMNO", "to"}},
+         {{"type", "restriction"}, {"restriction", "no_right_turn"}}},
+    };
+
+    const auto layout = gurka::detail::map_to_coordinates(ascii_map, 200);
+    map = gurka::buildtiles(layout, ways, {}, relations, VALHALLA_BUILD_DIR "test/data/overlay");
+    boost::property_tree::ptree cell_sizes;
+    for (const auto* size : {"4", "16"}) {
+      cell_sizes.push_back({"", boost::property_tree::ptree(size)});
+    }
+    map.config.put_child("mjolnir.overlay.cell_sizes", cell_sizes);
+    mjolnir::OverlayBuilder::Build(map.config);
+    // every action gets a new worker, which would take the regular searches while customizing
+    map.config.put("thor.overlay.customize_in_background", false);
+
+    // without an overlay to compare to
+    regular_map = map;
+    regular_map.config.put("mjolnir.overlay.file", map.config.get<std::string>("mjolnir.tile_dir") +
+                                                       "/no_overlay.bin");
+  }
+};
+
+gurka::map OverlayTest::map = {};
+gurka::map OverlayTest::regular_map = {};
+
+TEST_F(OverlayTest, WritesOverlay) {
+  const auto file = baldr::PartitionOverlay::FileName(map.config.get_child("mjolnir"));
+  ASSERT_TRUE(std::filesystem::exists(file));
+
+  baldr::PartitionOverlay overlay(file);
+  EXPECT_EQ(overlay.levels(), 2u);
+  EXPECT_GT(overlay.size(), 0u);
+  EXPECT_GT(overlay.cell_count(0), overlay.cell_count(1));
+  for (uint32_t node = 0; node < overlay.size(); ++node) {
+    EXPECT_EQ(overlay.node(overlay.edgeid(node)), node);
+  }
+}
+
+TEST_F(OverlayTest, MatchesCostMatrix) {
+  const std::vector<std::string> sources = {"A", "G", "M", "S"};
+  const std::vector<std::string> targets = {"E", "L", "Q", "T", "H", "J"};
+  auto overlay = matrix(map, sources, targets);
+  auto costmatrix = matrix(regular_map, sources, targets);
+
+  EXPECT_STREQ(overlay["algorithm"].GetString(), "overlaymatrix");
+  EXPECT_STREQ(costmatrix["algorithm"].GetString(), "costmatrix");
+  expect_same_matrix(overlay, costmatrix);
+}
+
+TEST_F(OverlayTest, CustomizesOptions) {
+  const std::vector<std::string> sources = {"A", "K", "R"};
+  const std::vector<std::string> targets = {"E", "N", "T"};
+  for (const auto& options : std::vector<std::unordered_map<std::string, std::string>>{
+           {{"/costing_options/auto/use_highways", "0.1"}},
+           {{"/costing_options/auto/use_living_streets", "0"}},
+           {{"/costing_options/auto/top_speed", "30"}},
+       }) {
+    auto overlay = matrix(map, sources, targets, options);
+    auto costmatrix = matrix(regular_map, sources, targets, options);
+    EXPECT_STREQ(overlay["algorithm"].GetString(), "overlaymatrix");
+    expect_same_matrix(overlay, costmatrix);
+  }
+}
+
+TEST_F(OverlayTest, MatchesRoute) {
+  for (const auto& [from, to] : std::vector<std::pair<std::string, std::string>>{
+           {"A", "T"}, {"P", "E"}, {"M", "K"}, {"S", "A"}, {"C", "O"}}) {
+    auto overlay = gurka::do_action(Options::route, map, {from, to}, "auto");
+    auto regular = gurka::do_action(Options::route, regular_map, {from, to}, "auto");
+    const auto& leg = overlay.trip().routes(0).legs(0);
+    const auto& regular_leg = regular.trip().routes(0).legs(0);
+    ASSERT_EQ(leg.node_size(), regular_leg.node_size()) << from << " -> " << to;
+    EXPECT_EQ(leg.shape(), regular_leg.shape()) << from << " -> " << to;
+    EXPECT_NEAR(leg.node(leg.node_size() - 1).cost().elapsed_cost().seconds(),
+                regular_leg.node(regular_leg.node_size() - 1).cost().elapsed_cost().seconds(), 1.)
+        << from << " -> " << to;
+  }
+}
+
+TEST_F(OverlayTest, TimeFallsBack) {
+  auto result = matrix(map, {"A"}, {"T"},
+                       {{"/date_time/type", "1"}, {"/date_time/value", "2020-10-10T08:00"}});
+  EXPECT_STRNE(result["algorithm"].GetString(), "overlaymatrix");
+}
+
+TEST_F(OverlayTest, CustomizesInBackground) {
+  auto background_map = map;
+  background_map.config.put("thor.overlay.customize_in_background", true);
+  auto reader = test::make_clean_graphreader(background_map.config.get_child("mjolnir"));
+  tyr::actor_t actor(background_map.config, *reader, true);
+  const auto request = [&background_map]() {
+    return gurka::detail::build_valhalla_request({"sources", "targets"},
+                                                 {{background_map.nodes.at("A"),
+                                                   background_map.nodes.at("K")},
+                                                  {background_map.nodes.at("E"),
+                                                   background_map.nodes.at("T")}},
+                                                 "auto", {{"/costing_options/auto/top_speed", "40"}});
+  }();
+
+  // the first request doesn't wait for the customization
+  rapidjson::Document result;
+  result.Parse(actor.matrix(request).c_str());
+  EXPECT_STREQ(result["algorithm"].GetString(), "costmatrix");
+  const auto costmatrix = matrix(regular_map, {"A", "K"}, {"E", "T"},
+                                 {{"/costing_options/auto/top_speed", "40"}});
+  expect_same_matrix(result, costmatrix);
+
+  // a later one gets the overlay once it is done
+  for (int i = 0; i < 100 && std::string(result["algorithm"].GetString()) != "overlaymatrix"; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    result.Parse(actor.matrix(request).c_str());
+  }
+  EXPECT_STREQ(result["algorithm"].GetString(), "overlaymatrix");
+  expect_same_matrix(result, costmatrix);
+}
+
+TEST_F(OverlayTest, SharesCustomizations) {
+  auto background_map = map;
+  background_map.config.put("thor.overlay.customize_in_background", true);
+  auto reader = test::make_clean_graphreader(background_map.config.get_child("mjolnir"));
+  tyr::actor_t first(background_map.config, *reader, true);
+  tyr::actor_t second(background_map.config, *reader, true);
+  const auto request = gurka::detail::build_valhalla_request(
+      {"sources", "targets"}, {{background_map.nodes.at("A")}, {background_map.nodes.at("T")}},
+      "auto", {{"/costing_options/auto/top_speed", "50"}});
+
+  rapidjson::Document result;
+  result.Parse(first.matrix(request).c_str());
+  for (int i = 0; i < 100 && std::string(result["algorithm"].GetString()) != "overlaymatrix"; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    result.Parse(first.matrix(request).c_str());
+  }
+  EXPECT_STREQ(result["algorithm"].GetString(), "overlaymatrix");
+
+  // the other worker gets the customization the first one made right away
+  result.Parse(second.matrix(request).c_str());
+  EXPECT_STREQ(result["algorithm"].GetString(), "overlaymatrix");
+}
+
+TEST(OverlayRestriction, ComplexRestrictionFallsBack) {
+  const std::string ascii_map = R"(
+      A----B----C
+           |    |
+           |    E
+           |    |
+           D----F
+    )";
+  const gurka::ways ways = {
+      {"AB", {{"highway", "primary"}}},
+      {"BC", {{"highway", "primary"}}},
+      {"CEF", {{"highway", "primary"}}},
+      {"BD", {{"highway", "primary"}}},
+      {"DF", {{"highway", "primary"}}},
+  };
+  const gurka::relations relations = {
+      {{{gurka::way_member, "AB", "from"},
+        {gurka::way_member, "BC", "via"},
+        {gurka::way_member, "CEF", "to"}},
+       {{"type", "restriction"}, {"restriction", "no_right_turn"}}},
+  };
+  const auto layout = gurka::detail::map_to_coordinates(ascii_map, 100);
+  auto map = gurka::buildtiles(layout, ways, {}, relations,
+                               VALHALLA_BUILD_DIR "test/data/overlay_restriction",
+                               {{"mjolnir.shortcuts", "0"}});
+  boost::property_tree::ptree cell_sizes;
+  cell_sizes.push_back({"", boost::property_tree::ptree("4")});
+  map.config.put_child("mjolnir.overlay.cell_sizes", cell_sizes);
+  mjolnir::OverlayBuilder::Build(map.config);
+  map.config.put("thor.overlay.customize_in_background", false);
+  auto regular_map = map;
+  regular_map.config.put("mjolnir.overlay.file",
+                         map.config.get<std::string>("mjolnir.tile_dir") + "/no_overlay.bin");
+
+  // the overlay's cheapest path goes through the restriction, only the regular searches know that
+  // it has to go around
+  auto result = matrix(map, {"A"}, {"E"});
+  auto expected = matrix(regular_map, {"A"}, {"E"});
+  EXPECT_STREQ(result["algorithm"].GetString(), "costmatrix");
+  expect_same_matrix(result, expected);
+
+  auto route = gurka::do_action(Options::route, map, {"A", "E"}, "auto");
+  auto regular = gurka::do_action(Options::route, regular_map, {"A", "E"}, "auto");
+  EXPECT_EQ(route.trip().routes(0).legs(0).shape(), regular.trip().routes(0).legs(0).shape());
+
+  // paths that do not pass the end of a restriction stay on the overlay
+  result = matrix(map, {"A"}, {"D"});
+  EXPECT_STREQ(result["algorithm"].GetString(), "overlaymatrix");
+}
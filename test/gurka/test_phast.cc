@@ -0,0 +1,191 @@
+#include "baldr/contraction_hierarchy.h"
+#include "baldr/rapidjson_utils.h"
+#include "gurka.h"
+#include "mjolnir/contractionhierarchybuilder.h"
+#include "test.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+
+using namespace valhalla;
+
+namespace {
+
+rapidjson::Document matrix(const gurka::map& map,
+                           const std::vector<std::string>& sources,
+                           const std::vector<std::string>& targets) {
+  std::string json;
+  gurka::do_action(Options::sources_to_targets, map, sources, targets, "auto", {}, nullptr, &json);
+  rapidjson::Document result;
+  result.Parse(json.c_str());
+  return result;
+}
+
+Api isochrone(const gurka::map& map,
+              const std::string& location,
+              const std::string& extra,
+              std::string* json = nullptr) {
+  const auto& ll = map.nodes.at(location);
+  const std::string request =
+      R"({"locations":[{"lat":)" + std::to_string(ll.lat()) + R"(,"lon":)" +
+      std::to_string(ll.lng()) +
+      R"(}],"costing":"auto","contours":[{"time":5},{"time":10},{"time":60},{"distance":2.5}],)" +
+      R"("accessibility":true)" + extra + "}";
+  return gurka::do_action(Options::isochrone, map, request, nullptr, json);
+}
+
+} // namespace
+
+class PhastTest : public ::testing::Test {
+protected:
+  static gurka::map map;
+  static gurka::map phast_map;
+
+  static void SetUpTestSuite() {
+    const std::string ascii_map = R"(
+      A----B----C----D----E
+      |    |    |    |    |
+      F----G----H----I----J
+      |    |    |    |    |
+      K----L----M----N----O
+      |    |    |    |    |
+      P----Q----R----S----T
+    )";
+
+    const gurka::ways ways = {
+        {"ABCDE", {{"highway", "primary"}}},
+        {"FGHIJ", {{"highway", "residential"}}},
+        {"KLMNO", {{"highway", "residential"}, {"oneway", "yes"}}},
+        {"PQRST", {{"highway", "secondary"}}},
+        {"AFKP", {{"highway", "tertiary"}}},
+        {"BG", {{"highway", "residential"}}},
+        {"GL", {{"highway", "residential"}, {"oneway", "-1"}}},
+        {"LQ", {{"highway", "residential"}}},
+        {"CHMR", {{"highway", "tertiary"}}},
+        {"DI", {{"highway", "service"}}},
+        {"INS", {{"highway", "residential"}, {"oneway", "yes"}}},
+        {"EJOT", {{"highway", "primary"}}},
+    };
+    const gurka::relations relations = {
+        {{{gurka::way_member, "CHMR", "from"},
+          {gurka::node_member, "M", "via"},
+          {gurka::way_member, "KLMNO", "to"}},
+         {{"type", "restriction"}, {"restriction", "no_right_turn"}}},
+    };
+
+    const auto layout = gurka::detail::map_to_coordinates(ascii_map, 200);
+    map = gurka::buildtiles(layout, ways, {}, relations, VALHALLA_BUILD_DIR "test/data/phast",
+                            {{"mjolnir.shortcuts", "0"}});
+    boost::property_tree::ptree costings;
+    costings.push_back({"", boost::property_tree::ptree("auto")});
+    map.config.put_child("mjolnir.contraction_hierarchy.costings", costings);
+    mjolnir::ContractionHierarchyBuilder::Build(map.config);
+
+    phast_map = map;
+    phast_map.config.put("thor.phast.min_locations", 1);
+  }
+};
+
+gurka::map PhastTest::map = {};
+gurka::map PhastTest::phast_map = {};
+
+TEST_F(PhastTest, KeepsOrder) {
+  const auto dir = baldr::ContractionHierarchy::Directory(map.config.get_child("mjolnir"));
+  baldr::ContractionHierarchy hierarchy(baldr::ContractionHierarchy::FileName(dir, "auto"));
+  std::vector<uint32_t> rank(hierarchy.size(), hierarchy.size());
+  for (uint32_t i = 0; i < hierarchy.size(); ++i) {
+    ASSERT_LT(hierarchy.ranked(i), hierarchy.size());
+    ASSERT_EQ(rank[hierarchy.ranked(i)], hierarchy.size()) << "ranked twice";
+    rank[hierarchy.ranked(i)] = i;
+  }
+  // every arc goes to a higher ranked node, which comes first
+  for (uint32_t node = 0; node < hierarchy.size(); ++node) {
+    for (auto* arc = hierarchy.forward_begin(node); arc != hierarchy.forward_end(node); ++arc) {
+      EXPECT_LT(rank[arc->node], rank[node]);
+    }
+    for (auto* arc = hierarchy.backward_begin(node); arc != hierarchy.backward_end(node); ++arc) {
+      EXPECT_LT(rank[arc->node], rank[node]);
+    }
+  }
+}
+
+TEST_F(PhastTest, MatchesCHMatrix) {
+  // more sources than targets sweeps from the targets, either side spans two sweeps
+  for (const auto& [sources, targets] :
+       std::vector<std::pair<std::vector<std::string>, std::vector<std::string>>>{
+           {{"A", "B", "C", "D", "E", "F", "G", "H", "I", "J"},
+            {"K", "L", "M", "N", "O", "P", "Q", "R", "S", "T"}},
+           {{"K", "L", "M", "N", "O", "P", "Q", "R", "S", "T"},
+            {"A", "B", "C", "D", "E", "F", "G", "H", "I"}},
+       }) {
+    auto phast = matrix(phast_map, sources, targets);
+    auto ch = matrix(map, sources, targets);
+    EXPECT_STREQ(phast["algorithm"].GetString(), "phastmatrix");
+    EXPECT_STREQ(ch["algorithm"].GetString(), "chmatrix");
+
+    const auto& phast_rows = phast["sources_to_targets"].GetArray();
+    const auto& ch_rows = ch["sources_to_targets"].GetArray();
+    ASSERT_EQ(phast_rows.Size(), ch_rows.Size());
+    for (rapidjson::SizeType i = 0; i < phast_rows.Size(); ++i) {
+      ASSERT_EQ(phast_rows[i].Size(), ch_rows[i].Size());
+      for (rapidjson::SizeType j = 0; j < phast_rows[i].Size(); ++j) {
+        const auto& expected = ch_rows[i][j];
+        const auto& actual = phast_rows[i][j];
+        ASSERT_FALSE(actual["time"].IsNull()) << sources[i] << " -> " << targets[j];
+        EXPECT_NEAR(actual["time"].GetDouble(), expected["time"].GetDouble(), 0.01)
+            << sources[i] << " -> " << targets[j];
+        EXPECT_NEAR(actual["distance"].GetDouble(), expected["distance"].GetDouble(), 0.01)
+            << sources[i] << " -> " << targets[j];
+      }
+    }
+  }
+}
+
+TEST_F(PhastTest, Accessibility) {
+  const auto dir = baldr::ContractionHierarchy::Directory(map.config.get_child("mjolnir"));
+  baldr::ContractionHierarchy hierarchy(baldr::ContractionHierarchy::FileName(dir, "auto"));
+
+  for (const std::string reverse : {"false", "true"}) {
+    std::string json;
+    auto result = isochrone(map, "G", R"(,"reverse":)" + reverse, &json);
+    const auto& accessibility = result.isochrone().accessibility();
+    ASSERT_EQ(accessibility.size(), 4) << reverse;
+
+    // the contours are in the order of the request, each reaches at least as much as the last
+    EXPECT_EQ(accessibility.Get(0).metric(), Isochrone::time);
+    EXPECT_EQ(accessibility.Get(0).metric_value(), 5.f);
+    EXPECT_EQ(accessibility.Get(3).metric(), Isochrone::distance);
+    EXPECT_GT(accessibility.Get(0).edges(), 0u) << reverse;
+    EXPECT_LE(accessibility.Get(0).edges(), accessibility.Get(1).edges()) << reverse;
+    EXPECT_LE(accessibility.Get(1).edges(), accessibility.Get(2).edges()) << reverse;
+    EXPECT_LE(accessibility.Get(0).length(), accessibility.Get(1).length()) << reverse;
+    EXPECT_LE(accessibility.Get(2).edges(), hierarchy.size()) << reverse;
+    // every edge of the grid is a kilometer long
+    for (const auto& reached : accessibility) {
+      EXPECT_NEAR(reached.length(), reached.edges(), 0.01 * reached.edges()) << reverse;
+    }
+
+    rapidjson::Document doc;
+    doc.Parse(json.c_str());
+    bool found = false;
+    for (const auto& feature : doc["features"].GetArray()) {
+      const auto& properties = feature["properties"];
+      if (properties["metric"] == "time" && properties["contour"].GetDouble() == 60.) {
+        ASSERT_TRUE(properties.HasMember("accessibility"));
+        EXPECT_EQ(properties["accessibility"]["edges"].GetUint(), accessibility.Get(2).edges());
+        found = true;
+      }
+    }
+    EXPECT_TRUE(found) << reverse;
+  }
+}
+
+TEST_F(PhastTest, AccessibilityNeedsHierarchy) {
+  auto result = isochrone(map, "G", R"(,"costing_options":{"auto":{"use_highways":0.1}})");
+  EXPECT_EQ(result.isochrone().accessibility_size(), 0);
+  const auto& warnings = result.info().warnings();
+  EXPECT_TRUE(std::any_of(warnings.begin(), warnings.end(),
+                          [](const auto& warning) { return warning.code() == 216; }));
+}
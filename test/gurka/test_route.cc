@@ -1,6 +1,7 @@
 #include "baldr/rapidjson_utils.h"
 #include "gurka.h"
 #include "test.h"
+#include "tyr/actor.h"
 #include "valhalla/worker.h"
 
 #include <boost/format.hpp>
@@ -1254,3 +1255,122 @@ TEST(StandAlone, HGVNoAccessPenalty) {
     }
   }
 }
+
+TEST(StandAlone, ConcurrentLegs) {
+  const std::string ascii_map = R"(
+    A----B----C----D
+    |    |    |    |
+    E----F----G----H
+    |    |    |    |
+    I----J----K----L
+  )";
+  const gurka::ways ways = {
+      {"ABCD", {{"highway", "primary"}}},
+      {"EFGH", {{"highway", "residential"}}},
+      {"IJKL", {{"highway", "secondary"}}},
+      {"AEI", {{"highway", "tertiary"}}},
+      {"BFJ", {{"highway", "residential"}}},
+      {"CG", {{"highway", "residential"}}},
+      {"GK", {{"highway", "service"}, {"oneway", "yes"}}},
+      {"DHL", {{"highway", "primary"}}},
+  };
+  const auto layout = gurka::detail::map_to_coordinates(ascii_map, 100);
+  auto map = gurka::buildtiles(layout, ways, {}, {}, VALHALLA_BUILD_DIR "test/data/concurrent_legs");
+  auto concurrent_map = map;
+  concurrent_map.config.put("thor.route.concurrency", 3);
+
+  // through locations keep their legs together, break through locations end a leg but not a part
+  for (const auto& types : std::vector<std::vector<std::string>>{
+           {"break", "break", "break", "break", "break"},
+           {"break", "through", "break", "break_through", "break"},
+           {"break", "via", "break", "through", "break"},
+       }) {
+    std::unordered_map<std::string, std::string> options;
+    for (size_t i = 0; i < types.size(); ++i) {
+      options["/locations/" + std::to_string(i) + "/type"] = types[i];
+    }
+    const std::vector<std::string> waypoints = {"A", "G", "L", "I", "D"};
+    auto expected = gurka::do_action(Options::route, map, waypoints, "auto", options);
+    auto result = gurka::do_action(Options::route, concurrent_map, waypoints, "auto", options);
+
+    ASSERT_EQ(result.trip().routes_size(), 1);
+    const auto& legs = result.trip().routes(0).legs();
+    const auto& expected_legs = expected.trip().routes(0).legs();
+    ASSERT_EQ(legs.size(), expected_legs.size());
+    for (int i = 0; i < legs.size(); ++i) {
+      EXPECT_EQ(legs.Get(i).shape(), expected_legs.Get(i).shape()) << i;
+      EXPECT_EQ(legs.Get(i).location_size(), expected_legs.Get(i).location_size()) << i;
+      ASSERT_EQ(legs.Get(i).node_size(), expected_legs.Get(i).node_size()) << i;
+      EXPECT_NEAR(legs.Get(i).node().rbegin()->cost().elapsed_cost().seconds(),
+                  expected_legs.Get(i).node().rbegin()->cost().elapsed_cost().seconds(), 0.01)
+          << i;
+    }
+    ASSERT_EQ(result.options().locations_size(), expected.options().locations_size());
+    for (int i = 0; i < result.options().locations_size(); ++i) {
+      EXPECT_EQ(result.options().locations(i).correlation().edges_size(),
+                expected.options().locations(i).correlation().edges_size())
+          << i;
+    }
+  }
+
+  // an interrupted request stops the other threads with it and the worker answers the next one
+  auto reader = test::make_clean_graphreader(concurrent_map.config.get_child("mjolnir"));
+  tyr::actor_t actor(concurrent_map.config, *reader, true);
+  std::vector<midgard::PointLL> lls;
+  for (const auto& node : {"A", "G", "L", "I", "D"}) {
+    lls.push_back(concurrent_map.nodes.at(node));
+  }
+  const auto request = gurka::detail::build_valhalla_request({"locations"}, {lls}, "auto");
+  const std::function<void()> interrupt = []() { throw std::runtime_error("interrupted"); };
+  EXPECT_ANY_THROW(actor.route(request, &interrupt));
+  Api api;
+  actor.route(request, nullptr, &api);
+  EXPECT_EQ(api.trip().routes(0).legs_size(), 4);
+}
+
+TEST(StandAlone, BatchRoutes) {
+  const std::string ascii_map = R"(
+    A----B----C----D
+    |    |    |    |
+    E----F----G----H
+    |    |    |    |
+    I----J----K----L
+  )";
+  const gurka::ways ways = {
+      {"ABCD", {{"highway", "primary"}}},
+      {"EFGH", {{"highway", "residential"}}},
+      {"IJKL", {{"highway", "secondary"}}},
+      {"AEI", {{"highway", "tertiary"}}},
+      {"BFJ", {{"highway", "residential"}}},
+      {"CG", {{"highway", "residential"}}},
+      {"GK", {{"highway", "service"}, {"oneway", "yes"}}},
+      {"DHL", {{"highway", "primary"}}},
+  };
+  const auto layout = gurka::detail::map_to_coordinates(ascii_map, 100);
+  auto map = gurka::buildtiles(layout, ways, {}, {}, VALHALLA_BUILD_DIR "test/data/batch_routes");
+
+  // every route of the batch costs the same as routing its two locations on their own
+  const std::vector<std::string> others = {"A", "D", "F", "I", "K", "L"};
+  for (const std::string batch : {"many_to_one", "one_to_many"}) {
+    const bool many_to_one = batch == "many_to_one";
+    std::vector<std::string> waypoints(others);
+    waypoints.insert(many_to_one ? waypoints.end() : waypoints.begin(), "G");
+    auto result = gurka::do_action(Options::route, map, waypoints, "auto", {{"/batch", batch}});
+
+    ASSERT_EQ(result.trip().routes_size(), others.size()) << batch;
+    EXPECT_EQ(gurka::detail::get_paths(result).size(), others.size()) << batch;
+    for (size_t i = 0; i < others.size(); ++i) {
+      const std::vector<std::string> pair =
+          many_to_one ? std::vector<std::string>{others[i], "G"}
+                      : std::vector<std::string>{"G", others[i]};
+      auto expected = gurka::do_action(Options::route, map, pair, "auto");
+      const auto& route = result.trip().routes(i);
+      ASSERT_EQ(route.legs_size(), 1) << batch << " " << others[i];
+      const auto& leg = route.legs(0);
+      const auto& expected_leg = expected.trip().routes(0).legs(0);
+      EXPECT_NEAR(leg.node().rbegin()->cost().elapsed_cost().seconds(),
+                  expected_leg.node().rbegin()->cost().elapsed_cost().seconds(), 0.01)
+          << batch << " " << others[i];
+    }
+  }
+}
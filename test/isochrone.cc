@@ -389,6 +389,44 @@ TEST(Isochrones, test_max_reserved_labels_count) {
   isochrone.Clear();
 }
 
+TEST(Isochrones, CachedGrid) {
+  loki_worker_t loki_worker(cfg);
+  GraphReader reader(cfg.get_child("mjolnir"));
+  boost::property_tree::ptree config;
+  config.put("isochrone.max_cached_grids", 2);
+  Isochrone isochrone(config);
+
+  auto expand = [&](const std::string& contours, const std::string& extra = "") {
+    Api request;
+    ParseApi(R"({"locations":[{"lat":52.078937,"lon":5.115321}],"costing":"auto","contours":[)" +
+                 contours + "]" + extra + "}",
+             Options::isochrone, request);
+    loki_worker.isochrones(request);
+    travel_mode_t mode;
+    auto mode_costing = CostFactory().CreateModeCosting(*request.mutable_options(), mode);
+    auto grid = isochrone.Expand(ExpansionType::forward, request, reader, mode_costing, mode);
+    isochrone.Clear();
+    loki_worker.cleanup();
+    return grid;
+  };
+
+  // other contours with the same largest one and other output are served from the cache
+  const auto grid = expand(R"({"time":10})");
+  EXPECT_EQ(expand(R"({"time":5},{"time":10})", R"(,"polygons":true,"denoise":0.5)"), grid);
+
+  // another largest contour or costing expands again, pushing out the least recently used grid
+  EXPECT_NE(expand(R"({"time":12})"), grid);
+  EXPECT_NE(expand(R"({"time":10})", R"(,"costing_options":{"auto":{"use_highways":0.1}})"), grid);
+  EXPECT_NE(expand(R"({"time":10})"), grid);
+
+  // departures within the same 15 minutes share a grid
+  const auto departure = R"(,"date_time":{"type":1,"value":"2024-01-01T08:)";
+  const auto timed = expand(R"({"time":10})", departure + std::string(R"(01"}})"));
+  EXPECT_NE(timed, grid);
+  EXPECT_EQ(expand(R"({"time":10})", departure + std::string(R"(14"}})")), timed);
+  EXPECT_NE(expand(R"({"time":10})", departure + std::string(R"(16"}})")), timed);
+}
+
 #ifdef ENABLE_GEOTIFF
 
 void check_raster_edges(size_t x, size_t y, uint16_t* data) {
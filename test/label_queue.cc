@@ -0,0 +1,162 @@
+#include "baldr/label_queue.h"
+#include "test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+using namespace valhalla;
+using namespace valhalla::baldr;
+
+namespace {
+
+struct simple_label {
+  float c;
+  float sortcost() const {
+    return c;
+  }
+};
+
+TEST(RadixHeapQueue, TestInvalidConstruction) {
+  std::vector<simple_label> edgelabels;
+  EXPECT_THROW(RadixHeapQueue<simple_label> queue(0, 10000, 0, &edgelabels), std::runtime_error)
+      << "Invalid bucket size not caught";
+  EXPECT_THROW(RadixHeapQueue<simple_label> queue(0, 0.0f, 1, &edgelabels), std::runtime_error)
+      << "Invalid cost range not caught";
+  EXPECT_THROW(to_label_queue_type("fibonacci_heap"), std::invalid_argument);
+}
+
+TEST(RadixHeapQueue, TestAddRemove) {
+  // there is no overflow bucket so costs way past the range come out in order too
+  std::vector<uint32_t> costs = {67,  325, 25,  466,   1000, 100005,
+                                 758, 167, 258, 16442, 278,  111111000};
+  std::vector<simple_label> edgelabels;
+  RadixHeapQueue<simple_label> queue(0, 10, 1, &edgelabels);
+  for (auto cost : costs) {
+    edgelabels.push_back({static_cast<float>(cost)});
+    queue.add(edgelabels.size() - 1);
+  }
+
+  std::sort(costs.begin(), costs.end());
+  for (auto expected : costs) {
+    const auto label = queue.pop();
+    ASSERT_NE(label, kInvalidLabel);
+    EXPECT_EQ(edgelabels[label].sortcost(), static_cast<float>(expected));
+  }
+  EXPECT_EQ(queue.pop(), kInvalidLabel);
+
+  // anything cheaper than what was popped last comes out next
+  edgelabels.push_back({5.f});
+  queue.add(edgelabels.size() - 1);
+  edgelabels.push_back({111112000.f});
+  queue.add(edgelabels.size() - 1);
+  EXPECT_EQ(queue.pop(), edgelabels.size() - 2);
+  EXPECT_EQ(queue.pop(), edgelabels.size() - 1);
+  EXPECT_EQ(queue.pop(), kInvalidLabel);
+}
+
+TEST(RadixHeapQueue, TestClear) {
+  std::vector<simple_label> edgelabels{{67}, {325}, {25}, {111111000}};
+  RadixHeapQueue<simple_label> queue(0, 10000, 1, &edgelabels);
+  for (uint32_t i = 0; i < edgelabels.size(); ++i) {
+    queue.add(i);
+  }
+  EXPECT_EQ(queue.pop(), 2);
+  queue.clear();
+  EXPECT_EQ(queue.pop(), kInvalidLabel);
+
+  // after a clear the queue starts over at the minimum cost
+  queue.add(0);
+  queue.add(2);
+  EXPECT_EQ(queue.pop(), 2);
+  EXPECT_EQ(queue.pop(), 0);
+}
+
+// Random expansion like a path algorithm does it, adding labels more expensive than the one popped
+// and decreasing some that are still queued. Returns the sequence of popped costs
+std::vector<float> Simulate(LabelQueue<simple_label>& queue,
+                            size_t loop_count,
+                            size_t expansion_size,
+                            size_t max_increment_cost,
+                            uint32_t bucketsize) {
+  std::vector<simple_label> costs;
+  queue.reuse(0, 1000, bucketsize, &costs);
+  std::unordered_set<uint32_t> added;
+  std::vector<float> popped;
+  std::mt19937 gen(42);
+
+  costs.push_back({10.f});
+  queue.add(0);
+  added.insert(0);
+  for (size_t i = 0; i < loop_count; i++) {
+    const auto label = queue.pop();
+    if (label == kInvalidLabel) {
+      break;
+    }
+
+    // must be the cheapest of the queued labels at the granularity of the buckets
+    const auto min_cost = costs[label].sortcost();
+    for (auto k : added) {
+      EXPECT_LE(std::floor(min_cost / bucketsize), std::floor(costs[k].sortcost() / bucketsize));
+    }
+    added.erase(label);
+    popped.push_back(min_cost);
+
+    for (size_t j = 0; j < expansion_size; j++) {
+      const auto newcost = std::floor(min_cost + 1 + test::rand01(gen) * max_increment_cost);
+      if (j % 2 == 0 && !added.empty()) {
+        const auto idx = *std::next(added.begin(), test::rand01(gen) * (added.size() - 1));
+        if (newcost < costs[idx].sortcost()) {
+          queue.decrease(idx, newcost);
+          costs[idx] = {newcost};
+        }
+      } else {
+        costs.push_back({newcost});
+        queue.add(costs.size() - 1);
+        added.insert(costs.size() - 1);
+      }
+    }
+  }
+
+  // drain it
+  for (auto label = queue.pop(); label != kInvalidLabel; label = queue.pop()) {
+    EXPECT_TRUE(added.erase(label));
+    popped.push_back(costs[label].sortcost());
+  }
+  EXPECT_TRUE(added.empty());
+  return popped;
+}
+
+TEST(LabelQueue, TestSimulation) {
+  for (const auto& [loops, expansion, increment, bucketsize] :
+       std::vector<std::tuple<size_t, size_t, size_t, uint32_t>>{{1000, 10, 1000, 1},
+                                                                 {222, 40, 100, 1},
+                                                                 {333, 60, 100, 5},
+                                                                 {2000, 8, 30000, 20}}) {
+    for (auto type : {LabelQueueType::kDoubleBucket, LabelQueueType::kRadixHeap}) {
+      LabelQueue<simple_label> queue(type);
+      auto popped = Simulate(queue, loops, expansion, increment, bucketsize);
+      EXPECT_GT(popped.size(), loops);
+
+      // nothing is ever added below the cost of the label being expanded
+      EXPECT_TRUE(std::is_sorted(popped.begin(), popped.end(), [&](float a, float b) {
+        return std::floor(a / bucketsize) < std::floor(b / bucketsize);
+      }));
+
+      // and the queues can be reused
+      queue.clear();
+      EXPECT_EQ(Simulate(queue, loops, expansion, increment, bucketsize).size(), popped.size());
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
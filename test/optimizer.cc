@@ -2,7 +2,11 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <cmath>
 #include <cstdint>
+#include <numeric>
+#include <random>
 #include <vector>
 
 using namespace std;
@@ -35,6 +39,87 @@ TEST(Optimizer, Basic) {
   TryOptimizer(11, costs, expected_order);
 }
 
+float TourCost(const uint32_t nlocs,
+               const std::vector<float>& costs,
+               const std::vector<uint32_t>& tour) {
+  float cost = 0;
+  for (uint32_t i = 0; i + 1 < nlocs; ++i) {
+    cost += costs[tour[i] * nlocs + tour[i + 1]];
+  }
+  return cost;
+}
+
+// asymmetric costs between random points, a bit more expensive one way
+std::vector<float> RandomCosts(const uint32_t nlocs) {
+  std::mt19937 generator(4242);
+  std::uniform_real_distribution<float> coordinate(0.f, 10000.f);
+  std::vector<std::pair<float, float>> points;
+  for (uint32_t i = 0; i < nlocs; ++i) {
+    points.emplace_back(coordinate(generator), coordinate(generator));
+  }
+  std::vector<float> costs(nlocs * nlocs);
+  for (uint32_t i = 0; i < nlocs; ++i) {
+    for (uint32_t j = 0; j < nlocs; ++j) {
+      const float d =
+          std::hypot(points[i].first - points[j].first, points[i].second - points[j].second);
+      costs[i * nlocs + j] = i < j ? d : d * 1.1f;
+    }
+  }
+  return costs;
+}
+
+TEST(Optimizer, LocalSearchBasic) {
+  std::vector<float> costs = {0,    3036, 707,  956,  318,  1934, 355,  1170, 1286, 3171, 2133,
+                              2978, 0,    2664, 3613, 3102, 2011, 3139, 3846, 1764, 2050, 1143,
+                              638,  2638, 0,    1295, 763,  1536, 800,  1528, 888,  2773, 1735,
+                              940,  3457, 1281, 0,    582,  2450, 630,  655,  1796, 3681, 2643,
+                              357,  3037, 708,  637,  0,    1935, 47,   851,  1286, 3171, 2133,
+                              1839, 2004, 1525, 2480, 1963, 0,    2000, 2713, 690,  2578, 1100,
+                              387,  3066, 737,  715,  77,   1964, 0,    928,  1316, 3201, 2163,
+                              1129, 3803, 1537, 682,  769,  2707, 819,  0,    2052, 3230, 2899,
+                              1214, 1750, 900,  1849, 1338, 634,  1375, 2082, 0,    1907, 846,
+                              3128, 2036, 2814, 3763, 3252, 2549, 3290, 3228, 1914, 0,    2010,
+                              2068, 1133, 1754, 2704, 2193, 1102, 2230, 2937, 854,  2000, 0};
+  Optimizer optimizer;
+  optimizer.Seed(111111);
+  auto order = optimizer.SolveLocalSearch(11, costs, 2, std::chrono::seconds(10));
+  // at least as good as annealing
+  EXPECT_LE(TourCost(11, costs, order), TourCost(11, costs, {0, 3, 7, 4, 6, 2, 8, 5, 9, 1, 10}));
+}
+
+TEST(Optimizer, LocalSearchManyLocations) {
+  const uint32_t nlocs = 120;
+  const auto costs = RandomCosts(nlocs);
+
+  Optimizer annealing;
+  annealing.Seed(111111);
+  const auto annealed = annealing.Solve(nlocs, costs);
+
+  for (const uint32_t concurrency : {1, 4}) {
+    Optimizer optimizer;
+    optimizer.Seed(111111);
+    auto order = optimizer.SolveLocalSearch(nlocs, costs, concurrency, std::chrono::seconds(10));
+
+    // visits every location once from the first to the last one
+    ASSERT_EQ(order.size(), nlocs);
+    EXPECT_EQ(order.front(), 0u);
+    EXPECT_EQ(order.back(), nlocs - 1);
+    auto sorted = order;
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<uint32_t> all(nlocs);
+    std::iota(all.begin(), all.end(), 0);
+    EXPECT_EQ(sorted, all);
+
+    EXPECT_LE(TourCost(nlocs, costs, order), TourCost(nlocs, costs, annealed)) << concurrency;
+  }
+
+  // no time at all still gives the locally optimal tour from the nearest neighbors
+  Optimizer optimizer;
+  auto order = optimizer.SolveLocalSearch(nlocs, costs, 1, std::chrono::milliseconds(0));
+  ASSERT_EQ(order.size(), nlocs);
+  EXPECT_LE(TourCost(nlocs, costs, order), TourCost(nlocs, costs, annealed) * 1.1f);
+}
+
 } // namespace
 
 int main(int argc, char* argv[]) {
@@ -5,6 +5,7 @@
 
 #include <boost/property_tree/ptree.hpp>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -127,6 +128,55 @@ TEST(RecoverShortcut, test_recover_shortcut_edges_cache) {
   recover(true);
 }
 
+TEST(RecoverShortcut, test_stored_shortcut_edges) {
+  GraphReader graphreader(conf.get_child("mjolnir"));
+  size_t total = 0;
+  for (const auto& level : TileHierarchy::levels()) {
+    // we dont get shortcuts on level 2 and up
+    if (level.level > 1)
+      continue;
+
+    for (const auto tileid : graphreader.GetTileSet(level.level)) {
+      auto tile = graphreader.GetGraphTile(tileid);
+      for (uint32_t j = 0; j < tile->header()->directededgecount(); ++j) {
+        const auto* edge = tile->directededge(j);
+        if (!edge->is_shortcut())
+          continue;
+
+        // the shortcut builder stored the edges of every shortcut
+        auto stored = tile->GetShortcutEdges(j);
+        ASSERT_FALSE(stored.empty()) << "No edges stored for shortcut " << j << " of " << tileid;
+        auto shortcutid = tileid;
+        shortcutid.set_id(j);
+        auto recovered = graphreader.RecoverShortcut(shortcutid);
+        EXPECT_TRUE(std::equal(stored.begin(), stored.end(), recovered.begin(), recovered.end()));
+
+        // and they follow the shape of the shortcut exactly
+        auto shortcut_shape = tile->edgeinfo(edge).shape();
+        if (!edge->forward())
+          std::reverse(shortcut_shape.begin(), shortcut_shape.end());
+        std::vector<PointLL> stored_shape;
+        for (auto edgeid : stored) {
+          auto edge_tile = graphreader.GetGraphTile(edgeid);
+          const auto* de = edge_tile->directededge(edgeid);
+          EXPECT_FALSE(de->is_shortcut());
+          auto de_shape = edge_tile->edgeinfo(de).shape();
+          if (!de->forward())
+            std::reverse(de_shape.begin(), de_shape.end());
+          stored_shape.insert(stored_shape.end(),
+                              de_shape.begin() + (stored_shape.empty() ? 0 : 1), de_shape.end());
+        }
+        ASSERT_EQ(shortcut_shape.size(), stored_shape.size());
+        for (size_t k = 0; k < shortcut_shape.size(); ++k) {
+          EXPECT_TRUE(shortcut_shape[k].ApproximatelyEqual(stored_shape[k]));
+        }
+        ++total;
+      }
+    }
+  }
+  EXPECT_GT(total, 0);
+}
+
 TEST(GetShortcut, check_false_negatives) {
   GraphReader reader(conf.get_child("mjolnir"));
 
@@ -741,6 +741,48 @@ TEST(UtilMidgard, TriangleContains) {
   EXPECT_FALSE(triangle_contains(a, b, c, PointLL{(c.x() + b.x()) / 2, (c.y() + b.y()) / 2}));
 }
 
+TEST(UtilMidgard, ProjectShape) {
+  // the polyline projection has to match projecting segment by segment, including which segment
+  // wins a tie, regardless of whether it was vectorized or not
+  std::mt19937 generator(17);
+  std::uniform_real_distribution<double> offset(-0.01, 0.01);
+  for (size_t count = 0; count < 40; ++count) {
+    PointLL p(13.4 + offset(generator), 52.5 + offset(generator));
+    std::vector<PointLL> shape;
+    for (size_t i = 0; i < count; ++i) {
+      // throw in some zero length segments and repeated points to make ties
+      if (i % 7 == 3)
+        shape.push_back(shape.back());
+      else if (i % 11 == 5)
+        shape.push_back(shape.front());
+      else
+        shape.emplace_back(13.4 + offset(generator), 52.5 + offset(generator));
+    }
+
+    projector_t projector(p);
+    double expected = std::numeric_limits<double>::max();
+    PointLL expected_point;
+    size_t expected_index = 0;
+    for (size_t i = 0; i + 1 < shape.size(); ++i) {
+      auto point = projector(shape[i], shape[i + 1]);
+      auto sq_distance = projector.approx.DistanceSquared(point);
+      if (sq_distance < expected) {
+        expected = sq_distance;
+        expected_point = point;
+        expected_index = i;
+      }
+    }
+
+    PointLL point;
+    size_t index = 0;
+    double sq_distance = projector(shape.data(), shape.size(), point, index);
+    EXPECT_DOUBLE_EQ(sq_distance, expected) << count;
+    EXPECT_DOUBLE_EQ(point.lng(), expected_point.lng()) << count;
+    EXPECT_DOUBLE_EQ(point.lat(), expected_point.lat()) << count;
+    EXPECT_EQ(index, expected_index) << count;
+  }
+}
+
 TEST(UtilMidgard, PolygonArea) {
   std::vector<PointLL> a{{1, 1}, {2, 2}, {3, 1}};
   {
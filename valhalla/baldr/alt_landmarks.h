@@ -0,0 +1,92 @@
+#pragma once
+
+#include <valhalla/baldr/graphid.h>
+#include <valhalla/midgard/sequence.h>
+
+#include <boost/property_tree/ptree_fwd.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace valhalla {
+namespace baldr {
+
+// Distance of a node a landmark can't reach or be reached from
+constexpr float kUnreachedLandmark = std::numeric_limits<float>::infinity();
+
+/**
+ * Read-only view of the landmark distances built by mjolnir for the ALT (A*, landmarks and the
+ * triangle inequality) heuristic. For a few landmarks spread over the periphery of every region
+ * it has the length of the shortest path from each landmark to every node of the road levels and
+ * from every node to each landmark, along the edges some mode may take in their direction. Any
+ * path from a to b is at least as long as d(L, b) - d(L, a) and d(a, L) - d(b, L) for every
+ * landmark L, which is a much better bound than the distance as the crow flies where the roads
+ * have to go around mountains, lakes or the sea. The file is mmapped.
+ */
+class AltLandmarks {
+public:
+  // What mjolnir builds
+  struct table_t {
+    // the tiles with their nodes in ascending order
+    std::vector<uint64_t> tiles;
+    // the index of the first node of each tile, one more than there are tiles
+    std::vector<uint64_t> tile_offsets;
+    // the nodes the landmarks are at
+    std::vector<uint64_t> landmarks;
+    // by node: the distances from every landmark followed by those to every landmark
+    std::vector<float> distances;
+  };
+
+  /**
+   * Maps a file written by Write.
+   * @param file  path of the file
+   */
+  explicit AltLandmarks(const std::string& file);
+
+  AltLandmarks(const AltLandmarks&) = delete;
+  AltLandmarks& operator=(const AltLandmarks&) = delete;
+
+  /**
+   * Writes the landmark distances.
+   * @param file   path of the file
+   * @param table  the landmarks and the distances of every node
+   */
+  static void Write(const std::string& file, const table_t& table);
+
+  /**
+   * Returns where the distances are kept, mjolnir.alt.file or alt.bin inside of the tile_dir.
+   * @param mjolnir  the mjolnir configuration
+   * @return the file, empty if neither is configured
+   */
+  static std::string FileName(const boost::property_tree::ptree& mjolnir);
+
+  uint32_t landmark_count() const {
+    return landmark_count_;
+  }
+
+  GraphId landmark(const uint32_t index) const {
+    return GraphId(landmarks_[index]);
+  }
+
+  /**
+   * Gets the distances of a node, the landmark_count() distances from the landmarks followed by
+   * the landmark_count() distances to them, kUnreachedLandmark where there is no path.
+   * @param node  the node
+   * @return the distances or nullptr if the node is not known
+   */
+  const float* distances(const GraphId& node) const;
+
+protected:
+  midgard::mem_map<char> memory_;
+  uint32_t landmark_count_;
+  uint64_t tile_count_;
+  const uint64_t* tiles_;
+  const uint64_t* tile_offsets_;
+  const uint64_t* landmarks_;
+  const float* distances_;
+};
+
+} // namespace baldr
+} // namespace valhalla
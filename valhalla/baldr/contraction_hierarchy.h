@@ -0,0 +1,176 @@
+#pragma once
+
+#include <valhalla/baldr/graphid.h>
+#include <valhalla/midgard/sequence.h>
+
+#include <boost/property_tree/ptree_fwd.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace valhalla {
+class Costing;
+namespace baldr {
+
+constexpr uint32_t kInvalidCHNode = std::numeric_limits<uint32_t>::max();
+
+// An arc of the contraction hierarchy, either an edge to edge transition of the graph or a
+// shortcut standing in for a sequence of them. The cost includes the transition and the edge
+// at the end of the arc. Restricted arcs pass an edge at the end of a complex restriction, the
+// hierarchy does not know whether the path before it is the one the restriction forbids.
+struct ch_arc_t {
+  uint32_t node;
+  float cost;
+  float secs;
+  uint32_t length : 31;
+  uint32_t restricted : 1;
+};
+
+// The cost of traversing the edge a node stands for
+struct ch_node_t {
+  float cost;
+  float secs;
+  uint32_t length;
+};
+
+/**
+ * Read-only view of a contraction hierarchy built by mjolnir for one costing with its default
+ * options. The hierarchy is edge based: every node is a directed edge of the graph, so turn
+ * costs and simple turn restrictions are part of the arcs between them, complex restrictions are
+ * only marked on the arcs that might break one. The nodes are ordered by their GraphId. Every
+ * node has the arcs to higher ranked nodes, forward for the search from the sources and backward
+ * for the search from the targets, so that an upward search from either end meets at the highest
+ * ranked node of the shortest path. The order the nodes were contracted in is kept as well for
+ * the searches that sweep down the whole hierarchy. The file is mmapped.
+ */
+class ContractionHierarchy {
+public:
+  /**
+   * Maps a file written by Write.
+   * @param file  path of the file
+   */
+  explicit ContractionHierarchy(const std::string& file);
+
+  ContractionHierarchy(const ContractionHierarchy&) = delete;
+  ContractionHierarchy& operator=(const ContractionHierarchy&) = delete;
+
+  /**
+   * Writes a contraction hierarchy.
+   * @param file              path of the file
+   * @param costing           Costing::Type the hierarchy was built for
+   * @param options           serialized costing options it was built with
+   * @param edges             edge ids of the nodes in ascending order
+   * @param nodes             costs of the nodes' edges
+   * @param forward_offsets   where each node's forward arcs start, one more than there are nodes
+   * @param forward           forward arcs to higher ranked nodes
+   * @param backward_offsets  where each node's backward arcs start, one more than there are nodes
+   * @param backward          backward arcs to higher ranked nodes
+   * @param order             the nodes from the highest ranked to the lowest
+   */
+  static void Write(const std::string& file,
+                    uint32_t costing,
+                    const std::string& options,
+                    const std::vector<uint64_t>& edges,
+                    const std::vector<ch_node_t>& nodes,
+                    const std::vector<uint64_t>& forward_offsets,
+                    const std::vector<ch_arc_t>& forward,
+                    const std::vector<uint64_t>& backward_offsets,
+                    const std::vector<ch_arc_t>& backward,
+                    const std::vector<uint32_t>& order);
+
+  /**
+   * Serializes the costing options that make a difference to the hierarchy so they can be
+   * compared to those of a request. Hierarchy limits only apply to the regular graph search.
+   * @param costing  the costing
+   * @return the options as bytes
+   */
+  static std::string SerializeOptions(const Costing& costing);
+
+  /**
+   * Returns the file name of the hierarchy of a costing within a directory.
+   * @param dir      the directory
+   * @param costing  the name of the costing
+   */
+  static std::string FileName(const std::string& dir, const std::string& costing);
+
+  /**
+   * Returns the directory the hierarchies are kept in, mjolnir.contraction_hierarchy.dir or the
+   * ch directory inside of the tile_dir.
+   * @param mjolnir  the mjolnir configuration
+   * @return the directory, empty if neither is configured
+   */
+  static std::string Directory(const boost::property_tree::ptree& mjolnir);
+
+  uint32_t costing() const {
+    return costing_;
+  }
+
+  /**
+   * @return the serialized costing options the hierarchy is exact for
+   */
+  std::string_view options() const {
+    return options_;
+  }
+
+  size_t size() const {
+    return node_count_;
+  }
+
+  /**
+   * Finds the node of a directed edge.
+   * @param edgeid  the directed edge
+   * @return the node or kInvalidCHNode if the edge is not in the hierarchy
+   */
+  uint32_t node(const GraphId& edgeid) const;
+
+  GraphId edgeid(const uint32_t node) const {
+    return GraphId(edges_[node]);
+  }
+
+  const ch_node_t& cost(const uint32_t node) const {
+    return nodes_[node];
+  }
+
+  const ch_arc_t* forward_begin(const uint32_t node) const {
+    return forward_ + forward_offsets_[node];
+  }
+
+  const ch_arc_t* forward_end(const uint32_t node) const {
+    return forward_ + forward_offsets_[node + 1];
+  }
+
+  const ch_arc_t* backward_begin(const uint32_t node) const {
+    return backward_ + backward_offsets_[node];
+  }
+
+  const ch_arc_t* backward_end(const uint32_t node) const {
+    return backward_ + backward_offsets_[node + 1];
+  }
+
+  /**
+   * @param rank  0 for the highest ranked node, size() - 1 for the lowest
+   * @return the node of the rank
+   */
+  uint32_t ranked(const size_t rank) const {
+    return order_[rank];
+  }
+
+protected:
+  midgard::mem_map<char> memory_;
+  uint32_t costing_;
+  std::string_view options_;
+  uint64_t node_count_;
+  const uint64_t* edges_;
+  const ch_node_t* nodes_;
+  const uint64_t* forward_offsets_;
+  const ch_arc_t* forward_;
+  const uint64_t* backward_offsets_;
+  const ch_arc_t* backward_;
+  const uint32_t* order_;
+};
+
+} // namespace baldr
+} // namespace valhalla
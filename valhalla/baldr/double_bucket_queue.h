@@ -20,9 +20,11 @@ using buckets_t = std::vector<bucket_t>;
  * implementation for performance. An "overflow" bucket is maintained to allow
  * reduced memory use. Costs outside the current bucket "range" get placed
  * into the overflow bucket and are moved into the low-level buckets as
- * needed. Each bucket stores label indexes into external data.
+ * needed. Each bucket stores label indexes into external data, which can be
+ * any random access container of labels like a std::pmr::vector.
  */
-template <typename label_t> class DoubleBucketQueue final {
+template <typename label_t, typename container_t = std::vector<label_t>>
+class DoubleBucketQueue final {
 public:
   /**
    * Default c-tor creates empty object that needs to be initialized with `reuse` method
@@ -45,7 +47,7 @@ public:
   DoubleBucketQueue(const float mincost,
                     const float range,
                     const uint32_t bucketsize,
-                    const std::vector<label_t>* labelcontainer) {
+                    const container_t* labelcontainer) {
     reuse(mincost, range, bucketsize, labelcontainer);
   }
 
@@ -67,7 +69,7 @@ public:
   void reuse(const float mincost,
              const float range,
              const uint32_t bucketsize,
-             const std::vector<label_t>* labelcontainer) {
+             const container_t* labelcontainer) {
     labelcontainer_ = labelcontainer;
     // We need at least a bucketsize of 1 or more
     if (bucketsize < 1) {
@@ -193,7 +195,7 @@ private:
   bucket_t overflowbucket_;
 
   // Access to a container of labels to get cost given the label index.
-  const std::vector<label_t>* labelcontainer_;
+  const container_t* labelcontainer_;
 
   /**
    * Returns the bucket given the cost.
@@ -468,6 +468,22 @@ public:
     return !tile_extract_->traffic_tiles.empty();
   }
 
+  /**
+   * The latest update of the live traffic, read from the header of every traffic tile.
+   * @return seconds since epoch, 0 without traffic tiles
+   */
+  uint64_t LastTrafficUpdate() const;
+
+  /**
+   * What identifies the build of the graph a tile was read from: the checksum and the latest
+   * changeset of the input data and the date the tile was made. Caches of results compare it to
+   * notice the tiles were rebuilt, the tile is read like any other so it changes once the reader
+   * would see the new data.
+   * @param  graphid  an id in the tile
+   * @return a hash of the build, 0 if the tile can't be read
+   */
+  uint64_t TileBuild(const GraphId& graphid);
+
   /**
    * Get a pointer to a graph tile object given a GraphId.
    * @param graphid  the graphid of the tile
@@ -39,6 +39,7 @@
 #include <iterator>
 #include <list>
 #include <memory>
+#include <vector>
 
 namespace valhalla {
 namespace baldr {
@@ -620,6 +621,35 @@ public:
                                            bool wheelchair,
                                            bool bicycle) const;
 
+  /**
+   * Get the next departure given the directed edge Id and the current time (seconds from
+   * midnight) with the schedules running on the day looked up beforehand, see GetActiveSchedules.
+   * @param   lineid            Transit Line Id
+   * @param   current_time      Current time (seconds from midnight).
+   * @param   active_schedules  Whether each schedule of this tile runs on the day.
+   * @param   wheelchair        Only find departures with wheelchair access if true
+   * @param   bicycle           Only find departures with bicycle access if true
+   * @return  Returns a pointer to the transit departure information.
+   *          Returns nullptr if no departures are found.
+   */
+  const TransitDeparture* GetNextDeparture(const uint32_t lineid,
+                                           const uint32_t current_time,
+                                           const std::vector<bool>& active_schedules,
+                                           bool wheelchair,
+                                           bool bicycle) const;
+
+  /**
+   * Get which of the transit schedules of this tile run on a day. Routing on one day checks the
+   * same schedules at every departure, a route keeps this per tile instead.
+   * @param   day               Days since the tile creation date.
+   * @param   dow               Day of week (see graphconstants.h)
+   * @param   date_before_tile  Is the date that was input before
+   *                            the tile creation date?
+   * @return  Returns whether each schedule is valid on the day, by schedule index.
+   */
+  std::vector<bool>
+  GetActiveSchedules(const uint32_t day, const uint32_t dow, bool date_before_tile) const;
+
   /**
    * Get the departure given the directed edge Id and tripid
    * @param   lineid  Transit Line Id
@@ -638,6 +668,14 @@ public:
    */
   std::unordered_map<uint32_t, TransitDeparture*> GetTransitDepartures() const;
 
+  /**
+   * Get the departures in this tile, sorted by line Id and then by departure time.
+   * @return  Returns an iterable collection of departures.
+   */
+  std::span<const TransitDeparture> GetDepartures() const {
+    return std::span<const TransitDeparture>{departures_, header_->departurecount()};
+  }
+
   /**
    * Get the stop onestop Ids in this tile.
    * @return  Returns a map of transit stops with onestop Ids as the key and
@@ -773,6 +811,14 @@ public:
    */
   std::span<LaneConnectivity> GetLaneConnectivity(const uint32_t idx) const;
 
+  /**
+   * Get the edges a shortcut supersedes, in the order they are traversed. Tiles built before the
+   * shortcut builder stored them don't have them.
+   * @param  idx  Index of the shortcut directed edge within the tile.
+   * @return  Returns the edges of the shortcut, empty if the tile does not have them.
+   */
+  std::span<const GraphId> GetShortcutEdges(const uint32_t idx) const;
+
   /**
    * Convenience method for use with costing to get the speed for an edge given the directed
    * edge and a time (seconds since start of the week). If the current speed of the edge
@@ -1035,6 +1081,15 @@ protected:
   // Number of bytes in lane connectivity data.
   std::size_t lane_connectivity_size_{};
 
+  // The shortcuts with their edges, sorted by their index, and where their edges start in
+  // shortcut_edges_ (one extra entry at the end)
+  const uint32_t* shortcut_indexes_{};
+  const uint32_t* shortcut_edges_begin_{};
+  uint32_t shortcut_count_{};
+
+  // The edges of the shortcuts
+  const GraphId* shortcut_edges_{};
+
   // Predicted speeds
   PredictedSpeeds predictedspeeds_;
 
@@ -1047,6 +1102,11 @@ protected:
   // Map of operator one stops in this tile.
   std::unordered_map<std::string, std::list<GraphId>> oper_one_stops;
 
+  // The departures of each transit line are sorted by schedule type and time, the first departure
+  // of each line Id (one extra entry at the end) and the first of its frequency departures
+  std::vector<uint32_t> line_departures_;
+  std::vector<uint32_t> line_frequencies_;
+
   // Pointer to live traffic data (can be nullptr if not active)
   TrafficTile traffic_tile{nullptr};
 
@@ -1099,6 +1159,20 @@ protected:
    */
   void AssociateOneStopIds(const GraphId& graphid);
 
+  /**
+   * Indexes the departures of each transit line so looking up a departure only searches the
+   * departures of its line.
+   */
+  void IndexDepartures();
+
+  // the next departure of a line at or after the current time on a schedule valid() accepts
+  template <typename schedule_check_t>
+  const TransitDeparture* FindNextDeparture(const uint32_t lineid,
+                                            const uint32_t current_time,
+                                            const schedule_check_t& valid,
+                                            bool wheelchair,
+                                            bool bicycle) const;
+
   /** Decrompresses tile bytes into the internal graphtile byte buffer
    * @param  graphid     the id of the tile to be decompressed
    * @param  compressed  the compressed bytes
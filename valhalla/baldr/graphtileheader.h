@@ -18,7 +18,7 @@ namespace baldr {
 // something to the tile simply subtract one from this number and add it
 // just before the empty_slots_ array below. NOTE that it can ONLY be an
 // offset in bytes and NOT a bitfield or union or anything of that sort
-constexpr size_t kEmptySlots = 11;
+constexpr size_t kEmptySlots = 10;
 
 // Maximum size of the version string (stored as a fixed size
 // character array so the GraphTileHeader size remains fixed).
@@ -536,6 +536,22 @@ public:
     lane_connectivity_offset_ = offset;
   }
 
+  /**
+   * Gets the offset to the edges of the shortcuts, 0 if the tile has none.
+   * @return  Returns the number of bytes to offset to the edges of the shortcuts.
+   */
+  uint32_t shortcut_edges_offset() const {
+    return shortcut_edges_offset_;
+  }
+
+  /**
+   * Sets the offset to the edges of the shortcuts.
+   * @param offset Offset in bytes to the start of the edges of the shortcuts.
+   */
+  void set_shortcut_edges_offset(const uint32_t offset) {
+    shortcut_edges_offset_ = offset;
+  }
+
   /**
    * Gets the number of  turn lanes in this tile.
    * @return  Returns the number of  turn lanes.
@@ -702,6 +718,9 @@ protected:
   // GraphTile data size in bytes
   uint32_t tile_size_ = 0;
 
+  // Offset to the edges each shortcut supersedes, 0 for tiles without them
+  uint32_t shortcut_edges_offset_ = 0;
+
   // Marks the end of this version of the tile with the rest of the slots
   // being available for growth. If you want to use one of the empty slots,
   // simply add a uint32_t some_offset_; just above empty_slots_ and decrease
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <valhalla/baldr/double_bucket_queue.h>
+#include <valhalla/baldr/radix_heap_queue.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace valhalla {
+namespace baldr {
+
+// The priority queue implementations a path algorithm can pick from
+enum class LabelQueueType : uint8_t { kDoubleBucket = 0, kRadixHeap = 1 };
+
+/**
+ * Parses the name of a priority queue implementation as used in the config.
+ * @param  name  "double_bucket" or "radix_heap"
+ * @return the queue type
+ */
+inline LabelQueueType to_label_queue_type(const std::string& name) {
+  if (name == "double_bucket") {
+    return LabelQueueType::kDoubleBucket;
+  }
+  if (name == "radix_heap") {
+    return LabelQueueType::kRadixHeap;
+  }
+  throw std::invalid_argument("Unknown label queue type: " + name);
+}
+
+/**
+ * Priority queue of label indexes that forwards to either a DoubleBucketQueue or a
+ * RadixHeapQueue so that the implementation can be chosen per algorithm at runtime.
+ * The interface is that of the DoubleBucketQueue.
+ */
+template <typename label_t, typename container_t = std::vector<label_t>> class LabelQueue final {
+public:
+  /**
+   * Default c-tor creates empty object that needs to be initialized with `reuse` method
+   * @param type  the implementation to use
+   */
+  explicit LabelQueue(const LabelQueueType type = LabelQueueType::kDoubleBucket) : type_(type) {
+  }
+
+  LabelQueue(LabelQueue&&) = default;
+  LabelQueue& operator=(LabelQueue&&) = default;
+  LabelQueue(const LabelQueue&) = delete;
+  LabelQueue& operator=(const LabelQueue&) = delete;
+
+  /**
+   * Switches the implementation, only to be done while the queue is empty.
+   * @param type  the implementation to use
+   */
+  void set_type(const LabelQueueType type) {
+    type_ = type;
+  }
+
+  LabelQueueType type() const {
+    return type_;
+  }
+
+  /**
+   * See DoubleBucketQueue::reuse
+   */
+  void reuse(const float mincost,
+             const float range,
+             const uint32_t bucketsize,
+             const container_t* labelcontainer) {
+    if (type_ == LabelQueueType::kRadixHeap) {
+      radix_heap_.reuse(mincost, range, bucketsize, labelcontainer);
+    } else {
+      double_bucket_.reuse(mincost, range, bucketsize, labelcontainer);
+    }
+  }
+
+  /**
+   * See DoubleBucketQueue::clear
+   */
+  void clear() {
+    if (type_ == LabelQueueType::kRadixHeap) {
+      radix_heap_.clear();
+    } else {
+      double_bucket_.clear();
+    }
+  }
+
+  /**
+   * See DoubleBucketQueue::add
+   */
+  void add(const uint32_t label) {
+    if (type_ == LabelQueueType::kRadixHeap) {
+      radix_heap_.add(label);
+    } else {
+      double_bucket_.add(label);
+    }
+  }
+
+  /**
+   * See DoubleBucketQueue::decrease
+   */
+  void decrease(const uint32_t label, const float newcost) {
+    if (type_ == LabelQueueType::kRadixHeap) {
+      radix_heap_.decrease(label, newcost);
+    } else {
+      double_bucket_.decrease(label, newcost);
+    }
+  }
+
+  /**
+   * See DoubleBucketQueue::pop
+   */
+  uint32_t pop() {
+    return type_ == LabelQueueType::kRadixHeap ? radix_heap_.pop() : double_bucket_.pop();
+  }
+
+private:
+  LabelQueueType type_;
+  DoubleBucketQueue<label_t, container_t> double_bucket_;
+  RadixHeapQueue<label_t, container_t> radix_heap_;
+};
+
+} // namespace baldr
+} // namespace valhalla
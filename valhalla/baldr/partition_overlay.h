@@ -0,0 +1,175 @@
+#pragma once
+
+#include <valhalla/baldr/graphid.h>
+#include <valhalla/midgard/sequence.h>
+
+#include <boost/property_tree/ptree_fwd.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace valhalla {
+namespace baldr {
+
+constexpr uint32_t kInvalidOverlayNode = std::numeric_limits<uint32_t>::max();
+
+// A possible transition from one edge to the next. Whether a costing takes it is only known once
+// the overlay is customized for it. U-turns are only taken where nothing else can be.
+struct overlay_arc_t {
+  uint32_t node : 31;
+  uint32_t uturn : 1;
+};
+
+// The same arc seen from its head: the node it comes from and its index among the forward arcs
+struct overlay_reverse_arc_t {
+  uint32_t node;
+  uint32_t arc;
+};
+
+/**
+ * Read-only view of the metric independent part of customizable route planning built by mjolnir:
+ * the edge based graph, where every node is a directed edge and every arc a transition from one
+ * edge to the next, and a nested partition of its nodes into cells on a few levels. Level 0 has
+ * the smallest cells, every cell of a level is contained in exactly one cell of the level above.
+ *
+ * The nodes of a cell that arcs from other cells lead to are its entries, those with arcs to
+ * other cells its exits. Once the overlay is customized for a costing, by computing the cost from
+ * every entry to every exit of every cell, a search only expands the graph within the cells of
+ * its end points and jumps across all the others. Nodes are ordered by their GraphId. The file is
+ * mmapped.
+ */
+class PartitionOverlay {
+public:
+  // What mjolnir builds, the file adds what can be derived from it
+  struct graph_t {
+    // edge ids of the nodes in ascending order
+    std::vector<uint64_t> edges;
+    // where each node's arcs start, one more than there are nodes
+    std::vector<uint64_t> arc_offsets;
+    std::vector<overlay_arc_t> arcs;
+    // how many cells there are on each level
+    std::vector<uint32_t> cell_counts;
+    // the cell of every node on every level, level by level
+    std::vector<uint32_t> cells;
+  };
+
+  /**
+   * Maps a file written by Write.
+   * @param file  path of the file
+   */
+  explicit PartitionOverlay(const std::string& file);
+
+  PartitionOverlay(const PartitionOverlay&) = delete;
+  PartitionOverlay& operator=(const PartitionOverlay&) = delete;
+
+  /**
+   * Writes the overlay along with the reverse arcs and the entries and exits of the cells.
+   * @param file   path of the file
+   * @param graph  the graph and its partition
+   */
+  static void Write(const std::string& file, const graph_t& graph);
+
+  /**
+   * Returns where the overlay is kept, mjolnir.overlay.file or overlay.bin inside of the tile_dir.
+   * @param mjolnir  the mjolnir configuration
+   * @return the file, empty if neither is configured
+   */
+  static std::string FileName(const boost::property_tree::ptree& mjolnir);
+
+  size_t size() const {
+    return node_count_;
+  }
+
+  uint32_t levels() const {
+    return level_count_;
+  }
+
+  /**
+   * Finds the node of a directed edge.
+   * @param edgeid  the directed edge
+   * @return the node or kInvalidOverlayNode if the edge is not in the overlay
+   */
+  uint32_t node(const GraphId& edgeid) const;
+
+  GraphId edgeid(const uint32_t node) const {
+    return GraphId(edges_[node]);
+  }
+
+  uint64_t arc_count() const {
+    return arc_offsets_[node_count_];
+  }
+
+  uint64_t arcs_begin(const uint32_t node) const {
+    return arc_offsets_[node];
+  }
+
+  uint64_t arcs_end(const uint32_t node) const {
+    return arc_offsets_[node + 1];
+  }
+
+  const overlay_arc_t& arc(const uint64_t index) const {
+    return arcs_[index];
+  }
+
+  std::span<const overlay_reverse_arc_t> reverse_arcs(const uint32_t node) const {
+    return {reverse_arcs_ + reverse_offsets_[node], reverse_arcs_ + reverse_offsets_[node + 1]};
+  }
+
+  uint32_t cell_count(const uint32_t level) const {
+    return cell_counts_[level];
+  }
+
+  uint32_t cell(const uint32_t level, const uint32_t node) const {
+    return cells_[level * node_count_ + node];
+  }
+
+  std::span<const uint32_t> entries(const uint32_t level, const uint32_t cell) const {
+    const auto* offsets = entry_offsets_ + level_offsets_[level];
+    return {entries_ + offsets[cell], entries_ + offsets[cell + 1]};
+  }
+
+  std::span<const uint32_t> exits(const uint32_t level, const uint32_t cell) const {
+    const auto* offsets = exit_offsets_ + level_offsets_[level];
+    return {exits_ + offsets[cell], exits_ + offsets[cell + 1]};
+  }
+
+  /**
+   * @return the position of the node among the entries of its cell or kInvalidOverlayNode
+   */
+  uint32_t entry_index(const uint32_t level, const uint32_t node) const {
+    return entry_index_[level * node_count_ + node];
+  }
+
+  /**
+   * @return the position of the node among the exits of its cell or kInvalidOverlayNode
+   */
+  uint32_t exit_index(const uint32_t level, const uint32_t node) const {
+    return exit_index_[level * node_count_ + node];
+  }
+
+protected:
+  midgard::mem_map<char> memory_;
+  uint32_t level_count_;
+  uint64_t node_count_;
+  const uint64_t* edges_;
+  const uint64_t* arc_offsets_;
+  const overlay_arc_t* arcs_;
+  const uint64_t* reverse_offsets_;
+  const overlay_reverse_arc_t* reverse_arcs_;
+  const uint32_t* cell_counts_;
+  const uint32_t* cells_;
+  const uint64_t* entry_offsets_;
+  const uint32_t* entries_;
+  const uint64_t* exit_offsets_;
+  const uint32_t* exits_;
+  const uint32_t* entry_index_;
+  const uint32_t* exit_index_;
+  // where the entry and exit offsets of each level start
+  std::vector<uint64_t> level_offsets_;
+};
+
+} // namespace baldr
+} // namespace valhalla
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <valhalla/baldr/graphconstants.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace valhalla {
+namespace baldr {
+
+/**
+ * Radix Heap Queue - a monotone priority queue with the same interface as the
+ * DoubleBucketQueue. Costs are quantized by the bucket size into integer keys
+ * and a label sits in the bucket of the highest bit in which its key differs
+ * from the key of the last popped label. That leaves 33 buckets whatever the
+ * range of costs, so there is no overflow bucket to re-bucket and no long run
+ * of empty buckets to step over. Each label moves down at most once per bit of
+ * its key. Like the DoubleBucketQueue costs below the last popped cost are
+ * treated as equal to it, and labels with the same key are popped last in,
+ * first out.
+ */
+template <typename label_t, typename container_t = std::vector<label_t>> class RadixHeapQueue final {
+public:
+  /**
+   * Default c-tor creates empty object that needs to be initialized with `reuse` method
+   */
+  RadixHeapQueue() {
+    reuse(0.f, 1.f, 1, nullptr);
+  }
+
+  /**
+   * Constructor given a minimum cost, a range of costs and a bucket size. The range
+   * is only validated to keep the interface of the DoubleBucketQueue, there is no
+   * overflow bucket here.
+   * @param mincost    Minimum cost.
+   * @param range      Cost range, must be larger than 0.
+   * @param bucketsize Bucket size (range of costs within same bucket).
+   *                   Must be an integer value.
+   * @param labelcontainer  Container of labels with sortcosts.
+   */
+  RadixHeapQueue(const float mincost,
+                 const float range,
+                 const uint32_t bucketsize,
+                 const container_t* labelcontainer) {
+    reuse(mincost, range, bucketsize, labelcontainer);
+  }
+
+  RadixHeapQueue(RadixHeapQueue&&) = default;
+  RadixHeapQueue& operator=(RadixHeapQueue&&) = default;
+  RadixHeapQueue(const RadixHeapQueue&) = delete;
+  RadixHeapQueue& operator=(const RadixHeapQueue&) = delete;
+
+  /**
+   * The same as c-tor, but without buffers reallocation. Before call this
+   * method you should clean up the current state (call `clear`).
+   * @param mincost    Minimum cost.
+   * @param range      Cost range, must be larger than 0.
+   * @param bucketsize Bucket size (range of costs within same bucket).
+   *                   Must be an integer value.
+   * @param labelcontainer  Container of labels with sortcosts.
+   */
+  void reuse(const float mincost,
+             const float range,
+             const uint32_t bucketsize,
+             const container_t* labelcontainer) {
+    labelcontainer_ = labelcontainer;
+    // We need at least a bucketsize of 1 or more
+    if (bucketsize < 1) {
+      throw std::runtime_error("Bucketsize must be 1 or greater");
+    }
+
+    // We need at least a bucketrange of something larger than 0
+    if (range <= 0.f) {
+      throw std::runtime_error("Bucketrange must be greater than 0");
+    }
+
+    inv_ = 1.0f / static_cast<float>(bucketsize);
+    last_ = 0;
+    minkey_ = last_ = key(mincost);
+  }
+
+  /**
+   * Clear all labels from the buckets, their memory is kept for the next search.
+   */
+  void clear() {
+    for (auto& bucket : buckets_) {
+      bucket.clear();
+    }
+    last_ = minkey_;
+  }
+
+  /**
+   * Adds a label index to the queue.
+   * @param   label  Label index to add to the queue.
+   */
+  void add(const uint32_t label) {
+    push(label, key((*labelcontainer_)[label].sortcost()));
+  }
+
+  /**
+   * The specified label index now has a smaller cost. Moves it to the bucket of the new
+   * cost if that is not the one it is already in. Must be called before the label's cost
+   * is changed in the container.
+   * @param  label        Label index to reorder.
+   * @param  newcost      New sort cost.
+   */
+  void decrease(const uint32_t label, const float newcost) {
+    const uint32_t newkey = key(newcost);
+    if (positions_[label].key != newkey) {
+      remove(label);
+      push(label, newkey);
+    }
+  }
+
+  /**
+   * Removes the lowest cost label index from the queue.
+   * @return  Returns the label index of the lowest cost label. Returns
+   *          kInvalidLabel if the queue is empty.
+   */
+  uint32_t pop() {
+    if (buckets_[0].empty() && !refill()) {
+      return baldr::kInvalidLabel;
+    }
+
+    const uint32_t label = buckets_[0].back();
+    buckets_[0].pop_back();
+    return label;
+  }
+
+private:
+  // Where a label is in the buckets and the key that put it there
+  struct position_t {
+    uint32_t key;
+    uint32_t index;
+  };
+
+  float inv_;      // 1/bucketsize (so we can avoid division)
+  uint32_t minkey_; // Key of the minimum cost the queue starts at
+  uint32_t last_;   // Key of the last popped label, all keys in the queue are at least this
+
+  // Bucket 0 holds the keys equal to last_, bucket i the keys whose highest bit
+  // differing from last_ is bit i - 1
+  std::array<std::vector<uint32_t>, std::numeric_limits<uint32_t>::digits + 1> buckets_;
+
+  // Indexed by label
+  std::vector<position_t> positions_;
+
+  // Access to a container of labels to get cost given the label index.
+  const container_t* labelcontainer_;
+
+  /**
+   * Quantizes a cost into a key, costs below the last popped cost get its key.
+   * @param  cost  Cost.
+   * @return Returns the key of the cost.
+   */
+  uint32_t key(const float cost) const {
+    const float scaled = cost * inv_;
+    const uint32_t k = scaled <= 0.f ? 0
+                       : scaled >= static_cast<float>(std::numeric_limits<uint32_t>::max())
+                           ? std::numeric_limits<uint32_t>::max()
+                           : static_cast<uint32_t>(scaled);
+    return std::max(k, last_);
+  }
+
+  /**
+   * Returns the bucket a key belongs in relative to the last popped key.
+   * @param  k  Key.
+   * @return Returns the index of the bucket.
+   */
+  size_t bucket(const uint32_t k) const {
+    return std::numeric_limits<uint32_t>::digits - std::countl_zero(k ^ last_);
+  }
+
+  void push(const uint32_t label, const uint32_t k) {
+    if (label >= positions_.size()) {
+      positions_.resize(label + 1);
+    }
+    auto& b = buckets_[bucket(k)];
+    positions_[label] = {k, static_cast<uint32_t>(b.size())};
+    b.push_back(label);
+  }
+
+  // Swaps the last label of the bucket into the place of the removed one
+  void remove(const uint32_t label) {
+    const auto position = positions_[label];
+    auto& b = buckets_[bucket(position.key)];
+    const uint32_t moved = b.back();
+    b[position.index] = moved;
+    positions_[moved].index = position.index;
+    b.pop_back();
+  }
+
+  /**
+   * Finds the lowest non-empty bucket, makes its minimum key the last popped key and
+   * spreads its labels over the buckets below it.
+   * @return  Returns false if the queue is empty.
+   */
+  bool refill() {
+    auto itr = std::find_if(buckets_.begin() + 1, buckets_.end(),
+                            [](const auto& b) { return !b.empty(); });
+    if (itr == buckets_.end()) {
+      return false;
+    }
+
+    uint32_t min = std::numeric_limits<uint32_t>::max();
+    for (const auto label : *itr) {
+      min = std::min(min, positions_[label].key);
+    }
+    last_ = min;
+
+    // every key now differs from last_ in a lower bit so none of them land in this bucket again
+    for (const auto label : *itr) {
+      auto& position = positions_[label];
+      auto& b = buckets_[bucket(position.key)];
+      position.index = static_cast<uint32_t>(b.size());
+      b.push_back(label);
+    }
+    itr->clear();
+    return true;
+  }
+};
+
+} // namespace baldr
+} // namespace valhalla
@@ -8,6 +8,19 @@
 namespace valhalla {
 namespace loki {
 
+/**
+ * A directed edge close to some input point
+ */
+struct EdgeCandidate {
+  baldr::GraphId id;
+  // the closest point along the edge to the input point
+  midgard::PointLL point;
+  // the distance in meters between the input point and the closest point
+  double distance;
+  // the ratio along the edge, in its direction, at which the closest point lies
+  double percent_along;
+};
+
 /**
  * Search class for finding locations within the route network
  */
@@ -36,6 +49,23 @@ public:
   void search(google::protobuf::RepeatedPtrField<Location>& locations,
               const sif::cost_ptr_t& costing);
 
+  /**
+   * Find the k edges closest to a point. Unlike search this is a bare snap, there are no
+   * reachability, heading, side of street or node snapping considerations and only one direction
+   * of each edge pair is returned. This makes it cheap enough for snapping large volumes of points.
+   *
+   * @param point          the position to snap
+   * @param k              the maximum number of edges to return
+   * @param search_cutoff  the maximum distance in meters an edge may be from the point
+   * @param costing        if provided, only edges that the costing allows are returned, otherwise
+   *                       any edge except for shortcuts
+   * @return up to k edges sorted by their distance to the point, closest first
+   */
+  std::vector<EdgeCandidate> nearest_edges(const midgard::PointLL& point,
+                                           size_t k,
+                                           float search_cutoff,
+                                           const sif::cost_ptr_t& costing = nullptr);
+
 private:
   baldr::GraphReader& reader_;
 
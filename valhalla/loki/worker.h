@@ -14,6 +14,8 @@
 
 #include <boost/property_tree/ptree.hpp>
 
+#include <istream>
+#include <ostream>
 #include <vector>
 
 namespace valhalla {
@@ -23,6 +25,26 @@ namespace loki {
 void run_service(const boost::property_tree::ptree& config);
 #endif
 
+/**
+ * Correlates a newline delimited json stream of locations and writes a newline delimited json stream
+ * of locate results in the same order. Locations are read and correlated in batches which are spread
+ * over several workers, only a bounded number of batches is held in memory at any time so the input
+ * can be arbitrarily large. Set mjolnir.global_synchronized_cache to let the workers share tiles
+ *
+ * @param config       the service config, one worker is created from it per thread
+ * @param request      locate request json without locations applied to every batch, eg costing
+ * @param input        one json location per line, eg {"lat":52.09,"lon":5.11}, blank lines skipped
+ * @param output       one json result per input line, an error object if the line could not be used
+ * @param concurrency  the number of batches correlated in parallel
+ * @param batch_size   the number of locations per batch
+ */
+void locate_stream(const boost::property_tree::ptree& config,
+                   const std::string& request,
+                   std::istream& input,
+                   std::ostream& output,
+                   size_t concurrency = 1,
+                   size_t batch_size = 1000);
+
 class loki_worker_t : public service_worker_t {
 public:
   loki_worker_t(const boost::property_tree::ptree& config,
@@ -35,6 +57,7 @@ public:
   virtual void cleanup() override;
 
   std::string locate(Api& request);
+  std::string locate_lines(Api& request);
   void route(Api& request);
   void matrix(Api& request);
   void isochrones(Api& request);
@@ -61,6 +84,7 @@ protected:
   void check_hierarchy_distance(Api& request);
 
   void init_locate(Api& request);
+  void correlate_locate(Api& request);
   void init_route(Api& request);
   void init_matrix(Api& request);
   void init_isochrones(Api& request);
@@ -110,6 +134,7 @@ protected:
   size_t max_elevation_shape;
   float min_resample;
   unsigned int max_alternates;
+  unsigned int max_profile_departures;
   bool allow_verbose;
   bool allow_hard_exclusions;
   float max_distance_disable_hierarchy_culling;
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace valhalla {
+namespace midgard {
+
+/**
+ * A monotonic memory resource whose lifetime is that of a worker and whose contents live only
+ * as long as a single request. Allocations are bumped out of large blocks and deallocation is a
+ * no-op, so allocating is a pointer increment on the hot path. When the request is done the
+ * worker calls release which rewinds the arena and keeps its blocks for the next request up to
+ * a high-water mark, the rest go back to the upstream resource. Everything allocated from the
+ * arena must be gone before release is called. Not thread-safe, there is one per worker.
+ */
+class request_arena_t : public std::pmr::memory_resource {
+public:
+  static constexpr size_t kDefaultBlockSize = 1024 * 1024;
+
+  /**
+   * @param max_retained_size  how many bytes of blocks to keep between requests
+   * @param block_size         the minimum size of the blocks requested from upstream
+   * @param upstream           where the blocks come from
+   */
+  explicit request_arena_t(size_t max_retained_size = 0,
+                           size_t block_size = kDefaultBlockSize,
+                           std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+      : upstream_(upstream), max_retained_size_(max_retained_size),
+        block_size_(std::max(block_size, alignof(std::max_align_t))), current_(0), offset_(0),
+        allocated_(0) {
+  }
+
+  request_arena_t(const request_arena_t&) = delete;
+  request_arena_t& operator=(const request_arena_t&) = delete;
+
+  ~request_arena_t() override {
+    for (const auto& block : blocks_) {
+      upstream_->deallocate(block.data, block.size, alignof(std::max_align_t));
+    }
+  }
+
+  /**
+   * Rewinds the arena so the next request starts from the first block again. Keeps the largest
+   * blocks as long as together they fit under the high-water mark and frees the others.
+   */
+  void release() {
+    std::sort(blocks_.begin(), blocks_.end(),
+              [](const block_t& a, const block_t& b) { return a.size > b.size; });
+    size_t retained = 0;
+    auto keep = std::partition(blocks_.begin(), blocks_.end(), [&](const block_t& block) {
+      if (retained + block.size > max_retained_size_) {
+        return false;
+      }
+      retained += block.size;
+      return true;
+    });
+    for (auto block = keep; block != blocks_.end(); ++block) {
+      upstream_->deallocate(block->data, block->size, alignof(std::max_align_t));
+    }
+    blocks_.erase(keep, blocks_.end());
+    current_ = 0;
+    offset_ = 0;
+    allocated_ = 0;
+  }
+
+  /**
+   * Changes the high-water mark, takes effect on the next release.
+   * @param max_retained_size  how many bytes of blocks to keep between requests
+   */
+  void set_max_retained_size(size_t max_retained_size) {
+    max_retained_size_ = max_retained_size;
+  }
+
+  size_t max_retained_size() const {
+    return max_retained_size_;
+  }
+
+  /**
+   * @return the bytes handed out since the last release
+   */
+  size_t allocated() const {
+    return allocated_;
+  }
+
+  /**
+   * @return the bytes held in blocks, whether or not they are in use
+   */
+  size_t reserved() const {
+    size_t total = 0;
+    for (const auto& block : blocks_) {
+      total += block.size;
+    }
+    return total;
+  }
+
+protected:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    // bump the offset in the current block if it fits
+    if (current_ < blocks_.size()) {
+      if (void* ptr = bump(blocks_[current_], bytes, alignment)) {
+        return ptr;
+      }
+    }
+
+    // otherwise take a free block that is large enough or get a new one from upstream. blocks
+    // before current_ are in use, the ones after it were kept from earlier requests
+    const size_t needed = bytes + std::max(alignment, alignof(std::max_align_t));
+    auto next = current_ < blocks_.size() ? current_ + 1 : current_;
+    auto free = std::find_if(blocks_.begin() + next, blocks_.end(),
+                             [needed](const block_t& block) { return block.size >= needed; });
+    if (free == blocks_.end()) {
+      const size_t size = std::max(block_size_, needed);
+      auto* data = static_cast<std::byte*>(upstream_->allocate(size, alignof(std::max_align_t)));
+      blocks_.push_back({data, size});
+      free = blocks_.end() - 1;
+    }
+    std::iter_swap(blocks_.begin() + next, free);
+    current_ = next;
+    offset_ = 0;
+    return bump(blocks_[current_], bytes, alignment);
+  }
+
+  void do_deallocate(void*, size_t, size_t) override {
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+private:
+  struct block_t {
+    std::byte* data;
+    size_t size;
+  };
+
+  // Carves an aligned allocation out of the rest of a block, nullptr if it does not fit
+  void* bump(const block_t& block, size_t bytes, size_t alignment) {
+    void* ptr = block.data + offset_;
+    size_t space = block.size - offset_;
+    if (!std::align(alignment, bytes, ptr, space)) {
+      return nullptr;
+    }
+    offset_ = block.size - space + bytes;
+    allocated_ += bytes;
+    return ptr;
+  }
+
+  std::pmr::memory_resource* upstream_;
+  size_t max_retained_size_;
+  size_t block_size_;
+  std::vector<block_t> blocks_; // the blocks in use come first, then the free ones
+  size_t current_;              // the block allocations are bumped out of
+  size_t offset_;               // the first free byte in the current block
+  size_t allocated_;
+};
+
+/**
+ * Empties a container and hands its memory back to the resource it came from, which is what has
+ * to happen to containers that outlive a request before the arena they allocate from is released.
+ * @param container  a container with a polymorphic allocator
+ */
+template <typename container_t> void release_memory(container_t& container) {
+  container_t(container.get_allocator()).swap(container);
+}
+
+} // namespace midgard
+} // namespace valhalla
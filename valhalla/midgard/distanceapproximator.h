@@ -63,6 +63,14 @@ public:
     return m_lng_scale_;
   }
 
+  /*
+   * Getter for meters per degree of lng
+   * @return the number of meters per degree of lng at this points latitude
+   */
+  typename PointT::first_type GetMetersPerLngDegree() const {
+    return m_per_lng_degree_;
+  }
+
   /**
    * Approximates the arc distance between the supplied position and the
    * current test point.  It uses the pythagorean theorem with meters
@@ -8,10 +8,15 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <exception>
 #include <functional>
 #include <limits>
 #include <list>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
 #include <vector>
 
 namespace valhalla {
@@ -44,7 +49,7 @@ public:
    */
   GriddedData(const AABB2<PointLL>& bounds, const float tilesize, const value_type& value)
       : Tiles<PointLL>(bounds, tilesize), max_value_(value),
-        data_(this->nrows_ * this->ncolumns_, value) {
+        data_(this->nrows_ * this->ncolumns_, value), extent_{this->ncolumns_, this->nrows_, -1, -1} {
   }
 
   /**
@@ -58,8 +63,19 @@ public:
   inline void SetIfLessThan(const int tile_id, const value_type& value) {
     if (tile_id >= 0 && static_cast<size_t>(tile_id) < data_.size()) {
       auto& current_value = data_[tile_id];
+      bool below_max = false;
       for (size_t i = 0; i < dimensions_t; ++i) {
         current_value[i] = std::min(value[i], current_value[i]);
+        below_max = below_max || value[i] < max_value_[i];
+      }
+      // keep track of the part of the grid that has to be looked at for contours
+      if (below_max) {
+        const int32_t row = tile_id / this->ncolumns_;
+        const int32_t col = tile_id - row * this->ncolumns_;
+        extent_[0] = std::min(extent_[0], col);
+        extent_[1] = std::min(extent_[1], row);
+        extent_[2] = std::max(extent_[2], col);
+        extent_[3] = std::max(extent_[3], row);
       }
     }
   }
@@ -94,16 +110,270 @@ public:
    * @param generalize           Generalization factor in meters. A special value
    *                             kOptimalGeneralization will let the method choose
    *                             an optimal generalization factor based on grid size.
+   * @param concurrency          number of threads tracing the contours, the contours are the
+   *                             same no matter how many
    *
    * @return contour line geometries with the larger intervals first (for rendering purposes)
    */
   contours_t GenerateContours(std::vector<contour_interval_t>& intervals,
                               const bool rings_only = false,
                               const float denoise = 1.f,
-                              const float generalize = 200.f) const {
+                              const float generalize = 200.f,
+                              const uint32_t concurrency = 1) const {
     // sort the contours first on the metric index then on the values with the bigger contours first
     std::sort(intervals.begin(), intervals.end(), std::greater<>());
 
+    // which metrics do we need contours for
+    auto _ = std::make_pair(intervals.cbegin(), intervals.cend());
+    std::vector<decltype(_)> metrics{std::move(_)};
+    for (auto interval = intervals.cbegin(); interval != intervals.cend(); ++interval) {
+      if (std::get<0>(*interval) != std::get<0>(*metrics.back().first)) {
+        metrics.back().second = interval;
+        metrics.emplace_back(interval, intervals.cend());
+      }
+    }
+
+    // only the cells with a corner in the extent touched by SetIfLessThan can have a contour,
+    // skipping the outer rim since its out of bounds
+    const int row_begin = std::max(1, extent_[1] - 1);
+    const int row_end = std::min(this->nrows_ - 1, extent_[3] + 1);
+    const int col_begin = std::max(1, extent_[0] - 1);
+    const int col_end = std::min(this->ncolumns_ - 1, extent_[2] + 1);
+
+    // the segments are traced in strips of rows and then joined per contour interval, both in
+    // parallel. the segments of an interval are joined in the order a single pass over the whole
+    // grid would have found them so the result does not depend on the concurrency
+    using segment_t = std::pair<PointLL, PointLL>;
+    using segments_t = std::vector<std::vector<segment_t>>;
+    const int rows = std::max(row_end - row_begin, 0);
+    const int strip_count =
+        concurrency > 1 ? std::max(std::min(static_cast<int>(concurrency) * 4, rows), 1) : 1;
+    const int strip_rows = (rows + strip_count - 1) / strip_count;
+    std::vector<segments_t> strips(strip_count, segments_t(intervals.size()));
+    ForEach(strip_count, concurrency, [&](const size_t strip) {
+      const int first_row = row_begin + static_cast<int>(strip) * strip_rows;
+      TraceStrip(intervals, metrics, first_row, std::min(row_end, first_row + strip_rows), col_begin,
+                 col_end, strips[strip]);
+    });
+
+    // If the generalization value equals kOptimalGeneralization then set
+    // the generalization factor to 1/4 of the grid size
+    float gen_factor = generalize;
+    if (generalize == kOptimalGeneralization) {
+      gen_factor = this->tilesize_ * 0.25f * kMetersPerDegreeLat;
+    }
+
+    // some info about the area the image covers
+    auto h = this->tilesize_ / 2;
+
+    // we need something to hold each iso-line
+    contours_t contours(intervals.size(), std::list<feature_t>{feature_t{}});
+
+    // for each contour
+    ForEach(intervals.size(), concurrency, [&](const size_t i) {
+      auto& collection = contours[i];
+      auto& contour = collection.front();
+
+      // and something to find them quickly
+      using contour_lookup_t = std::map<PointLL, typename feature_t::iterator>;
+      // store begins and ends of the segments separately not to loose segment orientation
+      contour_lookup_t begin_lookup;
+      contour_lookup_t end_lookup;
+      for (const auto& strip : strips) {
+        for (const auto& [from_pt, to_pt] : strip[i]) {
+          // see if we have anything to connect this segment to
+          typename contour_lookup_t::iterator end_lookup_it = end_lookup.find(from_pt);
+          typename contour_lookup_t::iterator begin_lookup_it = begin_lookup.find(to_pt);
+
+          if (end_lookup_it != end_lookup.end() && begin_lookup_it != begin_lookup.end()) {
+            // we want to merge two records
+            //   first_segment                               second_segment
+            // (... ------> from_pt) + (from_pt, to_pt) + (to_pt ------> ...)
+            auto first_segment = end_lookup_it->second;
+            auto second_segment = begin_lookup_it->second;
+            end_lookup.erase(end_lookup_it);
+            begin_lookup.erase(begin_lookup_it);
+
+            // this segment is now a ring
+            if (first_segment == second_segment) {
+              first_segment->push_back(first_segment->front());
+              continue;
+            }
+
+            end_lookup[second_segment->back()] = first_segment;
+            first_segment->splice(first_segment->end(), *second_segment);
+            contour.erase(second_segment);
+          } else if (end_lookup_it != end_lookup.end()) {
+            // (... ------> from_pt) + (from_pt, to_pt)
+            end_lookup_it->second->push_back(to_pt);
+            end_lookup.emplace(to_pt, end_lookup_it->second);
+            end_lookup.erase(end_lookup_it);
+          } else if (begin_lookup_it != begin_lookup.end()) {
+            // (from_pt, to_pt) + (to_pt ------> ...)
+            begin_lookup_it->second->push_front(from_pt);
+            begin_lookup.emplace(from_pt, begin_lookup_it->second);
+            begin_lookup.erase(begin_lookup_it);
+          } else {
+            // this is an orphan segment for now
+            contour.push_front(contour_t{from_pt, to_pt});
+            begin_lookup.emplace(from_pt, contour.begin());
+            end_lookup.emplace(to_pt, contour.begin());
+          }
+        }
+      }
+
+      // they only wanted rings
+      if (rings_only) {
+        contour.remove_if([](const contour_t& line) { return line.front() != line.back(); });
+      }
+      // sort them by area (maybe length would be sufficient?) biggest first
+      std::unordered_map<const contour_t*, typename PointLL::first_type> cache(contour.size());
+      std::for_each(contour.cbegin(), contour.cend(),
+                    [&cache](const contour_t& c) { cache[&c] = polygon_area(c); });
+      contour.sort([&cache](const contour_t& a, const contour_t& b) {
+        return std::abs(cache[&a]) > std::abs(cache[&b]);
+      });
+
+      // they only want the most significant ones!
+      if (denoise > 0.f) {
+        contour.remove_if([&cache, &contour, denoise](const contour_t& c) {
+          return std::abs(cache[&c] / cache[&contour.front()]) < denoise;
+        });
+      }
+      // clean up the lines
+      for (auto& line : contour) {
+        if (gen_factor > 0.f) {
+          Polyline2<PointLL>::Generalize(line, gen_factor, {}, /* avoid_self_intersections */ true);
+        }
+        // sampling the bottom left corner means everything is skewed, so unskew it
+        for (auto& coord : line) {
+          coord.first += h;
+          coord.second += h;
+        }
+      }
+      // remove points and lines
+      contour.remove_if([](const contour_t& line) { return line.size() < 4; });
+
+      // if they just wanted linestrings we need only one per feature
+      if (!rings_only) {
+        for (auto& linestring : contour) {
+          collection.push_back({std::move(linestring)});
+        }
+        collection.pop_front();
+      }
+    });
+
+    return contours;
+  }
+
+  /**
+   * Determine the smallest subgrid that contains all valid (i.e. non-max) values
+
+   * @return array with 4 elements: minimum column, minimum row, maximum column, maximum row
+   */
+  const std::array<int32_t, 4> MinExtent() const {
+    // minx, miny, maxx, maxy
+    std::array<int32_t, 4> box = {this->ncolumns_ / 2, this->nrows_ / 2, this->ncolumns_ / 2,
+                                  this->nrows_ / 2};
+
+    // nothing outside the extent was ever set
+    for (int32_t i = extent_[1]; i <= extent_[3]; ++i) {
+      for (int32_t j = extent_[0]; j <= extent_[2]; ++j) {
+        if (data_[this->TileId(j, i)][0] < max_value_[0] ||
+            data_[this->TileId(j, i)][1] < max_value_[1]) {
+          // pad by 1 row/column as a sanity check
+          box[0] = std::min(std::max(j - 1, 0), box[0]);
+          box[1] = std::min(std::max(i - 1, 0), box[1]);
+          // +1 extra because range is exclusive
+          box[2] = std::max(std::min(j + 2, this->ncolumns_ - 1), box[2]);
+          box[3] = std::max(std::min(i + 2, this->ncolumns_ - 1), box[3]);
+        }
+      }
+    }
+
+    return box;
+  }
+
+  /**
+   * The tiles that have been set to a value less than the max value in any dimension.
+   *
+   * @return array with 4 elements: minimum column, minimum row, maximum column, maximum row, all
+   *         inclusive. The minimums are greater than the maximums while no tile is set
+   */
+  const std::array<int32_t, 4>& Extent() const {
+    return extent_;
+  }
+
+protected:
+  using interval_range_t = std::pair<typename std::vector<contour_interval_t>::const_iterator,
+                                     typename std::vector<contour_interval_t>::const_iterator>;
+
+  /**
+   * Runs the work for every index below count, on up to concurrency threads including the calling
+   * one. The first exception thrown stops the work and is rethrown.
+   */
+  template <typename work_t>
+  static void ForEach(const size_t count, const uint32_t concurrency, const work_t& work) {
+    const size_t thread_count = std::min<size_t>(concurrency, count);
+    if (thread_count < 2) {
+      for (size_t i = 0; i < count; ++i) {
+        work(i);
+      }
+      return;
+    }
+
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&]() {
+      for (size_t i = next++; i < count; i = next++) {
+        try {
+          work(i);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(error_mutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+          next = count;
+        }
+      }
+    };
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < thread_count; ++t) {
+      threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  /**
+   * Finds the segments of every contour interval in the cells of some rows, in the order of the
+   * rows, the columns and the triangles of a cell.
+   *
+   * @param intervals  the contour intervals, sorted
+   * @param metrics    the range of intervals of each metric
+   * @param row_begin  the first row of cells
+   * @param row_end    one past the last row of cells
+   * @param col_begin  the first column of cells
+   * @param col_end    one past the last column of cells
+   * @param segments   the segments found for every interval, parallel to the intervals
+   */
+  void TraceStrip(const std::vector<contour_interval_t>& intervals,
+                  const std::vector<interval_range_t>& metrics,
+                  const int row_begin,
+                  const int row_end,
+                  const int col_begin,
+                  const int col_end,
+                  std::vector<std::vector<std::pair<PointLL, PointLL>>>& segments) const {
+    if (row_begin >= row_end || col_begin >= col_end) {
+      return;
+    }
+
     // Values at tile corners and center (0 element is center)
     int sh[5];
     typename PointLL::first_type s[5]; // Values at the tile corners and center
@@ -205,52 +475,44 @@ public:
         },
     };
 
-    // which metrics do we need contours for
-    auto _ = std::make_pair(intervals.cbegin(), intervals.cend());
-    std::vector<decltype(_)> metrics{std::move(_)};
-    for (auto interval = intervals.cbegin(); interval != intervals.cend(); ++interval) {
-      if (std::get<0>(*interval) != std::get<0>(*metrics.back().first)) {
-        metrics.back().second = interval;
-        metrics.emplace_back(interval, intervals.cend());
-      }
-    }
 
-    // we need something to hold each iso-line
-    contours_t contours(intervals.size(), std::list<feature_t>{feature_t{}});
-
-    // and something to find them quickly
-    using contour_lookup_t = std::map<PointLL, typename feature_t::iterator>;
-    // store begins and ends of the segments separately not to loose segment orientation
-    std::vector<contour_lookup_t> begin_lookups(intervals.size());
-    std::vector<contour_lookup_t> end_lookups(intervals.size());
-    // TODO: preallocate the lookups for each interval
+    // the lower and higher corner of every column in a row and the min and max corner of every cell
+    std::vector<float> low(col_end - col_begin + 1), high(low.size());
+    std::vector<float> row_min(col_end - col_begin), row_max(row_min.size());
 
     // For each metric we tracked
     for (const auto& metric : metrics) {
       size_t metric_index = std::get<0>(*metric.first);
+      const auto lowest = std::get<1>(*std::prev(metric.second));
+      const auto highest = std::get<1>(*metric.first);
+
+      // For each cell
+      for (int row = row_begin; row < row_end; ++row) {
+        // classify the cells of a whole row up front in plain loops the compiler vectorizes
+        const auto* corners = &data_[this->TileId(col_begin, row)];
+        for (size_t c = 0; c < low.size(); ++c) {
+          const auto cell_below = corners[c][metric_index];
+          const auto cell_above = corners[c + this->ncolumns_][metric_index];
+          low[c] = std::min(cell_below, cell_above);
+          high[c] = std::max(cell_below, cell_above);
+        }
+        for (size_t c = 0; c < row_min.size(); ++c) {
+          row_min[c] = std::min(low[c], low[c + 1]);
+          row_max[c] = std::max(high[c], high[c + 1]);
+        }
 
-      // For each cell, skipping the outer rim since its out of bounds
-      for (int row = 1; row < this->nrows_ - 1; ++row) {
-        for (int col = 1; col < this->ncolumns_ - 1; ++col) {
-          int tileid = this->TileId(col, row);
-          auto cell1 = data_[tileid][metric_index];
-          auto cell2 = data_[tileid + this->ncolumns_][metric_index];     // TileId(col,   row+1)];
-          auto cell3 = data_[tileid + 1][metric_index];                   // TileId(col+1, row)];
-          auto cell4 = data_[tileid + this->ncolumns_ + 1][metric_index]; // TileId(col+1, row+1)];
-          auto dmin = std::min(std::min(cell1, cell2), std::min(cell3, cell4));
-          auto dmax = std::max(std::max(cell1, cell2), std::max(cell3, cell4));
+        for (int col = col_begin; col < col_end; ++col) {
+          const auto dmin = row_min[col - col_begin];
+          const auto dmax = row_max[col - col_begin];
 
           // Continue if outside the range of contour values for this metric_index
-          if (dmax < std::get<1>(*std::prev(metric.second)) || dmin > std::get<1>(*metric.first)) {
+          if (dmax < lowest || dmin > highest) {
             continue;
           }
 
+          int tileid = this->TileId(col, row);
           // For each requested contour value
           for (size_t i = 0; i < intervals.size(); ++i) {
-            // some setup to process this contour
-            auto& begin_lookup = begin_lookups[i];
-            auto& end_lookup = end_lookups[i];
-            auto& contour = contours[i];
             auto contour_value = std::get<1>(intervals[i]);
 
             // we skip this contour if its interested in a different metric_index or its value
@@ -260,6 +522,7 @@ public:
               continue;
             }
 
+
             for (int m = 4; m > 0; m--) {
               int newtileid = tileid + tile_inc[m - 1];
               // Make sure the tile corner value is not set to the max_value
@@ -324,136 +587,17 @@ public:
                 std::swap(from_pt, to_pt);
               }
 
-              // see if we have anything to connect this segment to
-              typename contour_lookup_t::iterator end_lookup_it = end_lookup.find(from_pt);
-              typename contour_lookup_t::iterator begin_lookup_it = begin_lookup.find(to_pt);
-
-              if (end_lookup_it != end_lookup.end() && begin_lookup_it != begin_lookup.end()) {
-                // we want to merge two records
-                //   first_segment                               second_segment
-                // (... ------> from_pt) + (from_pt, to_pt) + (to_pt ------> ...)
-                auto first_segment = end_lookup_it->second;
-                auto second_segment = begin_lookup_it->second;
-                end_lookup.erase(end_lookup_it);
-                begin_lookup.erase(begin_lookup_it);
-
-                // this segment is now a ring
-                if (first_segment == second_segment) {
-                  first_segment->push_back(first_segment->front());
-                  continue;
-                }
-
-                end_lookup[second_segment->back()] = first_segment;
-                first_segment->splice(first_segment->end(), *second_segment);
-                contour.front().erase(second_segment);
-              } else if (end_lookup_it != end_lookup.end()) {
-                // (... ------> from_pt) + (from_pt, to_pt)
-                end_lookup_it->second->push_back(to_pt);
-                end_lookup.emplace(to_pt, end_lookup_it->second);
-                end_lookup.erase(end_lookup_it);
-              } else if (begin_lookup_it != begin_lookup.end()) {
-                // (from_pt, to_pt) + (to_pt ------> ...)
-                begin_lookup_it->second->push_front(from_pt);
-                begin_lookup.emplace(from_pt, begin_lookup_it->second);
-                begin_lookup.erase(begin_lookup_it);
-              } else {
-                // this is an orphan segment for now
-                contour.front().push_front(contour_t{from_pt, to_pt});
-                begin_lookup.emplace(from_pt, contour.front().begin());
-                end_lookup.emplace(to_pt, contour.front().begin());
-              }
+              segments[i].emplace_back(from_pt, to_pt);
             }
           } // Each contour
         }   // Each tile col
       }     // Each tile row
     }       // Each dimension of the grid
-
-    // If the generalization value equals kOptimalGeneralization then set
-    // the generalization factor to 1/4 of the grid size
-    float gen_factor = generalize;
-    if (generalize == kOptimalGeneralization) {
-      gen_factor = this->tilesize_ * 0.25f * kMetersPerDegreeLat;
-    }
-
-    // some info about the area the image covers
-    auto h = this->tilesize_ / 2;
-    // for each contour
-    for (auto& collection : contours) {
-      auto& contour = collection.front();
-      // they only wanted rings
-      if (rings_only) {
-        contour.remove_if([](const contour_t& line) { return line.front() != line.back(); });
-      }
-      // sort them by area (maybe length would be sufficient?) biggest first
-      std::unordered_map<const contour_t*, typename PointLL::first_type> cache(contour.size());
-      std::for_each(contour.cbegin(), contour.cend(),
-                    [&cache](const contour_t& c) { cache[&c] = polygon_area(c); });
-      contour.sort([&cache](const contour_t& a, const contour_t& b) {
-        return std::abs(cache[&a]) > std::abs(cache[&b]);
-      });
-
-      // they only want the most significant ones!
-      if (denoise > 0.f) {
-        contour.remove_if([&cache, &contour, denoise](const contour_t& c) {
-          return std::abs(cache[&c] / cache[&contour.front()]) < denoise;
-        });
-      }
-      // clean up the lines
-      for (auto& line : contour) {
-        if (gen_factor > 0.f) {
-          Polyline2<PointLL>::Generalize(line, gen_factor, {}, /* avoid_self_intersections */ true);
-        }
-        // sampling the bottom left corner means everything is skewed, so unskew it
-        for (auto& coord : line) {
-          coord.first += h;
-          coord.second += h;
-        }
-      }
-      // remove points and lines
-      contour.remove_if([](const contour_t& line) { return line.size() < 4; });
-
-      // if they just wanted linestrings we need only one per feature
-      if (!rings_only) {
-        for (auto& linestring : contour) {
-          collection.push_back({std::move(linestring)});
-        }
-        collection.pop_front();
-      }
-    }
-
-    return contours;
-  }
-
-  /**
-   * Determine the smallest subgrid that contains all valid (i.e. non-max) values
-
-   * @return array with 4 elements: minimum column, minimum row, maximum column, maximum row
-   */
-  const std::array<int32_t, 4> MinExtent() const {
-    // minx, miny, maxx, maxy
-    std::array<int32_t, 4> box = {this->ncolumns_ / 2, this->nrows_ / 2, this->ncolumns_ / 2,
-                                  this->nrows_ / 2};
-
-    for (int32_t i = 0; i < this->nrows_; ++i) {
-      for (int32_t j = 0; j < this->ncolumns_; ++j) {
-        if (data_[this->TileId(j, i)][0] < max_value_[0] ||
-            data_[this->TileId(j, i)][1] < max_value_[1]) {
-          // pad by 1 row/column as a sanity check
-          box[0] = std::min(std::max(j - 1, 0), box[0]);
-          box[1] = std::min(std::max(i - 1, 0), box[1]);
-          // +1 extra because range is exclusive
-          box[2] = std::max(std::min(j + 2, this->ncolumns_ - 1), box[2]);
-          box[3] = std::max(std::min(i + 2, this->ncolumns_ - 1), box[3]);
-        }
-      }
-    }
-
-    return box;
   }
 
-protected:
-  value_type max_value_;         // Maximum value stored in the tile
-  std::vector<value_type> data_; // Data value within each tile
+  value_type max_value_;          // Maximum value stored in the tile
+  std::vector<value_type> data_;  // Data value within each tile
+  std::array<int32_t, 4> extent_; // Tiles set below the maximum value, see Extent
 };
 
 } // namespace midgard
@@ -569,6 +569,20 @@ struct projector_t {
     return {u.first + bx * scale, u.second + by * scale};
   }
 
+  /**
+   * Projects onto every segment of a polyline and keeps the closest projection. This is the same
+   * as calling the segment operator above for each pair of consecutive points and keeping the first
+   * one with the smallest approx.DistanceSquared, but when the cpu supports AVX2 several segments
+   * are projected at once. Either way the results are the same up to floating point rounding.
+   * @param shape    pointer to the first point of the polyline
+   * @param count    the number of points in the polyline
+   * @param closest  set to the closest point on the polyline, untouched if count < 2
+   * @param index    set to the index of the segment containing the closest point
+   * @return the approximate squared distance in meters to the closest point or double max if the
+   *         polyline has no segments
+   */
+  double operator()(const PointLL* shape, size_t count, PointLL& closest, size_t& index) const;
+
   // critical data
   double lon_scale;
   double lat;
@@ -0,0 +1,26 @@
+#ifndef VALHALLA_MJOLNIR_ALTLANDMARKBUILDER_H
+#define VALHALLA_MJOLNIR_ALTLANDMARKBUILDER_H
+
+#include <boost/property_tree/ptree_fwd.hpp>
+
+namespace valhalla {
+namespace mjolnir {
+
+/**
+ * Class used to select mjolnir.alt.landmark_count landmarks on the road levels, spread over the
+ * regions of the graph by their size, and to store the distances from and to each of them for
+ * every node, which thor's A* searches use as a lower bound of the remaining distance.
+ */
+class AltLandmarkBuilder {
+public:
+  /**
+   * Build the landmark distances.
+   * @param pt  the config
+   */
+  static void Build(const boost::property_tree::ptree& pt);
+};
+
+} // namespace mjolnir
+} // namespace valhalla
+
+#endif // VALHALLA_MJOLNIR_ALTLANDMARKBUILDER_H
@@ -0,0 +1,26 @@
+#ifndef VALHALLA_MJOLNIR_CONTRACTIONHIERARCHYBUILDER_H
+#define VALHALLA_MJOLNIR_CONTRACTIONHIERARCHYBUILDER_H
+
+#include <boost/property_tree/ptree_fwd.hpp>
+
+namespace valhalla {
+namespace mjolnir {
+
+/**
+ * Class used to build the contraction hierarchies the many-to-many matrix runs on. There is one
+ * per costing listed in mjolnir.contraction_hierarchy.costings, each built for the default options
+ * of its costing from the finished tiles.
+ */
+class ContractionHierarchyBuilder {
+public:
+  /**
+   * Build the contraction hierarchies.
+   * @param pt  the config
+   */
+  static void Build(const boost::property_tree::ptree& pt);
+};
+
+} // namespace mjolnir
+} // namespace valhalla
+
+#endif // VALHALLA_MJOLNIR_CONTRACTIONHIERARCHYBUILDER_H
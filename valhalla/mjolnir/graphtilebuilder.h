@@ -21,6 +21,7 @@
 
 #include <cstdint>
 #include <list>
+#include <map>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -164,6 +165,14 @@ public:
    */
   void CopyLaneConnectivityFromTile(const baldr::graph_tile_ptr& tile, uint32_t edge_id);
 
+  /**
+   * Set the edges a shortcut supersedes, stored with the tile so recovering the shortcut is a
+   * lookup.
+   * @param  idx    Index of the shortcut directed edge.
+   * @param  edges  The superseded edges in the order they are traversed.
+   */
+  void SetShortcutEdges(const uint32_t idx, std::vector<baldr::GraphId>&& edges);
+
   /**
    * Add forward complex restriction.
    * @param  res  Complex restriction.
@@ -670,6 +679,9 @@ protected:
   // List of lane connectivity records.
   std::vector<baldr::LaneConnectivity> lane_connectivity_builder_;
 
+  // The superseded edges of each shortcut, by the index of the shortcut.
+  std::map<uint32_t, std::vector<baldr::GraphId>> shortcut_edges_builder_;
+
   // List of turn lanes.
   std::vector<baldr::TurnLanes> turnlanes_builder_;
 
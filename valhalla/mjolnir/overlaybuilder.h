@@ -0,0 +1,26 @@
+#ifndef VALHALLA_MJOLNIR_OVERLAYBUILDER_H
+#define VALHALLA_MJOLNIR_OVERLAYBUILDER_H
+
+#include <boost/property_tree/ptree_fwd.hpp>
+
+namespace valhalla {
+namespace mjolnir {
+
+/**
+ * Class used to build the metric independent part of customizable route planning: the edge based
+ * graph and a nested partition of it into cells of at most mjolnir.overlay.cell_sizes edges,
+ * which thor customizes for the costing of a request.
+ */
+class OverlayBuilder {
+public:
+  /**
+   * Build the partition overlay.
+   * @param pt  the config
+   */
+  static void Build(const boost::property_tree::ptree& pt);
+};
+
+} // namespace mjolnir
+} // namespace valhalla
+
+#endif // VALHALLA_MJOLNIR_OVERLAYBUILDER_H
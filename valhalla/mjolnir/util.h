@@ -37,7 +37,10 @@ enum class BuildStage : int8_t {
   kRestrictions = 12,
   kElevation = 13,
   kValidate = 14,
-  kCleanup = 15
+  kContract = 15,
+  kPartition = 16,
+  kAlt = 17,
+  kCleanup = 18
 };
 
 constexpr uint8_t kMinor = 1;
@@ -62,6 +65,9 @@ inline BuildStage string_to_buildstage(const std::string& s) {
        {"restrictions", BuildStage::kRestrictions},
        {"elevation", BuildStage::kElevation},
        {"validate", BuildStage::kValidate},
+       {"contract", BuildStage::kContract},
+       {"partition", BuildStage::kPartition},
+       {"alt", BuildStage::kAlt},
        {"cleanup", BuildStage::kCleanup}};
 
   auto i = stringToBuildStage.find(s);
@@ -86,6 +92,9 @@ inline std::string to_string(BuildStage stg) {
        {static_cast<int8_t>(BuildStage::kRestrictions), "restrictions"},
        {static_cast<int8_t>(BuildStage::kElevation), "elevation"},
        {static_cast<int8_t>(BuildStage::kValidate), "validate"},
+       {static_cast<int8_t>(BuildStage::kContract), "contract"},
+       {static_cast<int8_t>(BuildStage::kPartition), "partition"},
+       {static_cast<int8_t>(BuildStage::kAlt), "alt"},
        {static_cast<int8_t>(BuildStage::kCleanup), "cleanup"}};
 
   auto i = BuildStageStrings.find(static_cast<int8_t>(stg));
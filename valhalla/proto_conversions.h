@@ -570,6 +570,10 @@ bool Options_ExpansionAction_Enum_Parse(const std::string& action, Options::Acti
 const std::string& Expansion_EdgeStatus_Enum_Name(const Expansion_EdgeStatus status);
 bool Options_ReverseTimeTracking_Enum_Parse(const std::string& strategy,
                                             Options::ReverseTimeTracking* f);
+bool Options_TourOptimizer_Enum_Parse(const std::string& optimizer, Options::TourOptimizer* o);
+bool Options_RouteBatch_Enum_Parse(const std::string& batch, Options::RouteBatch* b);
+bool Options_MultimodalAlgorithm_Enum_Parse(const std::string& algorithm,
+                                            Options::MultimodalAlgorithm* a);
 
 const std::string_view TravelMode_Enum_Name(const TravelMode mode);
 std::pair<std::string, std::string>
@@ -994,6 +994,14 @@ public:
     return is_hgv_;
   }
 
+  /**
+   * Does the costing take edges against their direction of travel?
+   * @return  Returns whether oneways are ignored.
+   */
+  bool ignore_oneways() const {
+    return ignore_oneways_;
+  }
+
   /**
    * Get the wheelchair required flag.
    * @return  Returns true if wheelchair is required.
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <valhalla/sif/edgelabel.h>
 #include <valhalla/thor/bidirectional_astar.h>
 
+#include <span>
 #include <vector>
 
 namespace valhalla {
@@ -13,11 +15,55 @@ void filter_alternates_by_stretch(std::vector<CandidateConnection>& connections)
 bool validate_alternate_by_stretch(const std::vector<PathInfo>& optimal_path,
                                    const std::vector<PathInfo>& candidate_path);
 
-bool validate_alternate_by_sharing(std::vector<std::unordered_set<baldr::GraphId>>& shared_edgeids,
+bool validate_alternate_by_sharing(std::vector<std::vector<baldr::GraphId>>& shared_edgeids,
                                    const std::vector<std::vector<PathInfo>>& paths,
                                    const std::vector<PathInfo>& candidate_path,
                                    float at_most_shared);
 
 bool validate_alternate_by_local_optimality(const std::vector<PathInfo>& candidate_path);
+
+/**
+ * The labels of the paths chosen from the forward and reverse trees of a bidirectional search. A
+ * path through the trees follows the forward tree to its connection and the reverse tree from
+ * there, so two of them share everything from the first label they have in common back to the
+ * origin or on to the destination. Walking the labels of a candidate connection up to the chosen
+ * paths gives a lower bound of the length it shares with them without forming its path. The
+ * connections on the plateau of a chosen path, the stretch both trees have in common, meet it
+ * right away.
+ */
+class TreeSharing {
+public:
+  TreeSharing(std::span<const sif::BDEdgeLabel> forward_labels,
+              std::span<const sif::BDEdgeLabel> reverse_labels);
+
+  /**
+   * Adds the path of a chosen connection.
+   * @param  forward_idx  the forward label of the connection
+   * @param  reverse_idx  the reverse label of the connection
+   */
+  void add(const uint32_t forward_idx, const uint32_t reverse_idx);
+
+  /**
+   * Checks whether the path of a candidate connection shares more than at_most_shared of any chosen
+   * path on the labels alone. A candidate passing this still has to pass
+   * validate_alternate_by_sharing once its path is formed.
+   * @param  forward_idx     the forward label of the connection
+   * @param  reverse_idx     the reverse label of the connection
+   * @param  paths           the chosen paths, in the order they were added
+   * @param  at_most_shared  the sharing threshold
+   * @return true if the candidate can be rejected
+   */
+  bool shares_too_much(const uint32_t forward_idx,
+                       const uint32_t reverse_idx,
+                       const std::vector<std::vector<PathInfo>>& paths,
+                       const float at_most_shared) const;
+
+protected:
+  std::span<const sif::BDEdgeLabel> forward_labels_;
+  std::span<const sif::BDEdgeLabel> reverse_labels_;
+  // per chosen path whether each label is on it
+  std::vector<std::vector<bool>> on_forward_;
+  std::vector<std::vector<bool>> on_reverse_;
+};
 } // namespace thor
 } // namespace valhalla
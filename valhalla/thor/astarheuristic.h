@@ -1,12 +1,33 @@
 #ifndef VALHALLA_THOR_ASTARHEURISTIC_H_
 #define VALHALLA_THOR_ASTARHEURISTIC_H_
 
+#include <valhalla/baldr/alt_landmarks.h>
+#include <valhalla/baldr/graphid.h>
+#include <valhalla/baldr/graphreader.h>
 #include <valhalla/midgard/distanceapproximator.h>
 #include <valhalla/midgard/pointll.h>
+#include <valhalla/proto/common.pb.h>
+
+#include <algorithm>
+#include <vector>
 
 namespace valhalla {
 namespace thor {
 
+// Landmark distances are floats of up to the circumference of the earth, take off what rounding
+// them may have added to a bound
+constexpr float kLandmarkSlack = 4.f;
+
+/**
+ * Gets the nodes at both ends of the correlated edges of a location, the ones a path from or to
+ * the location has to go through.
+ * @param  reader    to get the edges
+ * @param  location  the correlated location
+ * @return the nodes
+ */
+std::vector<baldr::GraphId> correlated_nodes(baldr::GraphReader& reader,
+                                             const valhalla::Location& location);
+
 /**
  * Class to calculate A* cost heuristics based on distances of nodes from
  * a destination within the shortest path computation.
@@ -32,6 +53,52 @@ public:
   void Init(const midgard::PointLL& ll, const float factor) {
     distapprox_.SetTestPoint(ll);
     costfactor_ = factor;
+    landmarks_ = nullptr;
+    active_.clear();
+  }
+
+  /**
+   * Tightens the heuristic with landmark distances (ALT): the path to the destination is at least
+   * as long as the triangle inequality tells for every landmark. Has to be called after Init and
+   * only with costings that don't take edges against their direction, the distances only know
+   * the edges some mode may take in their direction.
+   * @param  landmarks  the landmark distances, nullptr to only use the distance as the crow flies
+   * @param  nodes      the nodes the destination is reached through, or the origin is left
+   *                    through for a reverse search
+   * @param  to_nodes   whether the heuristic estimates the path to the nodes or the path from them
+   */
+  void SetLandmarks(const baldr::AltLandmarks* landmarks,
+                    const std::vector<baldr::GraphId>& nodes,
+                    const bool to_nodes) {
+    landmarks_ = nullptr;
+    active_.clear();
+    if (!landmarks || nodes.empty()) {
+      return;
+    }
+    const uint32_t count = landmarks->landmark_count();
+    for (uint32_t l = 0; l < count; ++l) {
+      // the bound for any of the nodes: the closest to and the farthest from the landmark
+      float from = to_nodes ? baldr::kUnreachedLandmark : 0.f;
+      float to = to_nodes ? 0.f : baldr::kUnreachedLandmark;
+      bool known = true;
+      for (const auto& node : nodes) {
+        const float* distances = landmarks->distances(node);
+        if (!distances || distances[l] == baldr::kUnreachedLandmark ||
+            distances[count + l] == baldr::kUnreachedLandmark) {
+          known = false;
+          break;
+        }
+        from = to_nodes ? std::min(from, distances[l]) : std::max(from, distances[l]);
+        to = to_nodes ? std::max(to, distances[count + l]) : std::min(to, distances[count + l]);
+      }
+      if (known) {
+        active_.push_back({l, from, to});
+      }
+    }
+    if (!active_.empty()) {
+      landmarks_ = landmarks;
+      to_nodes_ = to_nodes;
+    }
   }
 
   /**
@@ -76,10 +143,70 @@ public:
     return dist * costfactor_;
   }
 
+  /**
+   * Get the A* heuristic given the current node and its lat,lng, using the landmark distances if
+   * there are any.
+   * @param   ll    Lat,lng of the node
+   * @param   node  the node
+   * @return  Returns an estimate of the cost to the destination.
+   *          For A* shortest path this MUST UNDERESTIMATE the true cost.
+   */
+  float Get(const midgard::PointLL& ll, const baldr::GraphId& node) const {
+    float dist;
+    return Get(ll, node, dist);
+  }
+
+  /**
+   * Get the A* heuristic given the current node and its lat,lng, using the landmark distances if
+   * there are any. Also return the distance as the crow flies via an argument.
+   * @param   ll    Lat,lng of the node
+   * @param   node  the node
+   * @param   dist  Distance (meters) to the destination as the crow flies.
+   * @return  Returns an estimate of the cost to the destination.
+   *          For A* shortest path this MUST UNDERESTIMATE the true cost.
+   */
+  float Get(const midgard::PointLL& ll, const baldr::GraphId& node, float& dist) const {
+    dist = sqrtf(distapprox_.DistanceSquared(ll));
+    return std::max(dist, LandmarkDistance(node)) * costfactor_;
+  }
+
 private:
+  // the lower bound of the path length the landmarks give, 0 if they know nothing about the node
+  float LandmarkDistance(const baldr::GraphId& node) const {
+    if (!landmarks_) {
+      return 0.f;
+    }
+    const float* distances = landmarks_->distances(node);
+    if (!distances) {
+      return 0.f;
+    }
+    const uint32_t count = landmarks_->landmark_count();
+    float bound = 0.f;
+    for (const auto& landmark : active_) {
+      const float from = distances[landmark.index];
+      const float to = distances[count + landmark.index];
+      if (from == baldr::kUnreachedLandmark || to == baldr::kUnreachedLandmark) {
+        continue;
+      }
+      bound = std::max(bound, to_nodes_ ? std::max(landmark.from - from, to - landmark.to)
+                                        : std::max(from - landmark.from, landmark.to - to));
+    }
+    return std::max(bound - kLandmarkSlack, 0.f);
+  }
+
+  // a landmark that knows all nodes of the destination with the distances it bounds the path by
+  struct active_landmark_t {
+    uint32_t index;
+    float from;
+    float to;
+  };
+
   midgard::DistanceApproximator<midgard::PointLL> distapprox_; // Distance approximation
   float costfactor_; // Cost factor - ensures the cost estimate
                      // underestimates the true cost.
+  const baldr::AltLandmarks* landmarks_ = nullptr;
+  std::vector<active_landmark_t> active_;
+  bool to_nodes_ = true;
 };
 
 } // namespace thor
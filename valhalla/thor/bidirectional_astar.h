@@ -1,16 +1,21 @@
 #ifndef VALHALLA_THOR_BIDIRECTIONAL_ASTAR_H_
 #define VALHALLA_THOR_BIDIRECTIONAL_ASTAR_H_
 
-#include <valhalla/baldr/double_bucket_queue.h>
+#include <valhalla/baldr/label_queue.h>
 #include <valhalla/baldr/time_info.h>
 #include <valhalla/sif/edgelabel.h>
 #include <valhalla/thor/astarheuristic.h>
 #include <valhalla/thor/edgestatus.h>
+#include <valhalla/thor/overlay.h>
 #include <valhalla/thor/pathalgorithm.h>
 
 #include <boost/property_tree/ptree.hpp>
 
 #include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace valhalla {
@@ -42,8 +47,10 @@ public:
   /**
    * Constructor.
    * @param config A config object of key, value pairs
+   * @param arena  Request arena to allocate the edge labels from, nullptr for the heap
    */
-  explicit BidirectionalAStar(const boost::property_tree::ptree& config = {});
+  explicit BidirectionalAStar(const boost::property_tree::ptree& config = {},
+                              std::pmr::memory_resource* arena = nullptr);
 
   /**
    * Destructor
@@ -82,6 +89,37 @@ public:
    */
   void Clear() override;
 
+  /**
+   * Drops the edge labels allocated from the request arena, must be called before the arena is
+   * released at the end of the request.
+   */
+  void ReleaseArena();
+
+  /**
+   * Routes without a time are looked up on the partition overlay instead if it has one.
+   * @param overlay  the searches on the overlay, nullptr for none
+   */
+  void set_overlay(OverlaySearch* overlay) {
+    overlay_ = overlay;
+  }
+
+  /**
+   * Sets the landmark distances the A* heuristic uses if bidirectional_astar.heuristic is alt.
+   * @param landmarks  the landmark distances, nullptr for none
+   */
+  void set_landmarks(const baldr::AltLandmarks* landmarks) {
+    landmarks_ = landmarks;
+  }
+
+  /**
+   * Sets the config of the graph reader for the thread which expands the reverse tree if
+   * bidirectional_astar.concurrency is 2, without it both trees expand on one thread.
+   * @param mjolnir  the mjolnir config
+   */
+  void set_reader_config(const boost::property_tree::ptree& mjolnir) {
+    reader_config_ = mjolnir;
+  }
+
 protected:
   // Access mode used by the costing method
   uint32_t access_mode_;
@@ -104,14 +142,23 @@ protected:
   float cost_diff_;
   AStarHeuristic astarheuristic_forward_;
   AStarHeuristic astarheuristic_reverse_;
+  // Landmark distances to tighten the heuristics with, if any and configured
+  const baldr::AltLandmarks* landmarks_;
+  bool use_landmarks_;
+
+  // Request arena the edge labels come from, if any
+  std::pmr::memory_resource* arena_;
+
+  // Partition overlay for routes that do not depend on the time, if any
+  OverlaySearch* overlay_;
 
   // Vector of edge labels (requires access by index).
-  std::vector<sif::BDEdgeLabel> edgelabels_forward_;
-  std::vector<sif::BDEdgeLabel> edgelabels_reverse_;
+  std::pmr::vector<sif::BDEdgeLabel> edgelabels_forward_;
+  std::pmr::vector<sif::BDEdgeLabel> edgelabels_reverse_;
 
   // Adjacency list - approximate double bucket sort
-  baldr::DoubleBucketQueue<sif::BDEdgeLabel> adjacencylist_forward_;
-  baldr::DoubleBucketQueue<sif::BDEdgeLabel> adjacencylist_reverse_;
+  baldr::LabelQueue<sif::BDEdgeLabel, std::pmr::vector<sif::BDEdgeLabel>> adjacencylist_forward_;
+  baldr::LabelQueue<sif::BDEdgeLabel, std::pmr::vector<sif::BDEdgeLabel>> adjacencylist_reverse_;
 
   // Edge status. Mark edges that are in adjacency list or settled.
   EdgeStatus edgestatus_forward_;
@@ -140,6 +187,34 @@ protected:
   // edge)
   bool pruning_disabled_at_origin_, pruning_disabled_at_destination_;
 
+  // Expand the forward and reverse trees at the same time on two threads for the routes longer
+  // than concurrency_min_distance_ meters, the reverse one with its own graph reader and time zone
+  // cache
+  uint32_t concurrency_;
+  float concurrency_min_distance_;
+  boost::property_tree::ptree reader_config_;
+  std::unique_ptr<baldr::GraphReader> reverse_reader_;
+  baldr::DateTime::tz_sys_info_cache_t reverse_tz_cache_;
+  bool concurrent_;
+
+  // While the trees expand concurrently a tree can't look at the edge status of the other one, the
+  // shortcuts each tree labeled or skipped during a round are handed to the other one in between
+  std::vector<std::pair<baldr::GraphId, EdgeSet>> round_shortcuts_forward_;
+  std::vector<std::pair<baldr::GraphId, EdgeSet>> round_shortcuts_reverse_;
+  std::unordered_map<baldr::GraphId, EdgeSet> shortcuts_forward_;
+  std::unordered_map<baldr::GraphId, EdgeSet> shortcuts_reverse_;
+
+  // What a tree did during a round of the concurrent expansion
+  struct expansion_round_t {
+    std::vector<uint32_t> settled; // the labels settled, connected to the other tree afterwards
+    float cost_threshold;          // the cost threshold when the round started
+    float other_sortcost;          // the sort cost the other tree was at when the round started
+    sif::BDEdgeLabel pred;         // the last label settled
+    bool exhausted;                // the adjacency list ran empty
+    bool done;                     // the cost threshold was exceeded
+    uint32_t expansions;           // the labels settled in all the rounds of this tree
+  };
+
   /**
    * Initialize the A* heuristic and adjacency lists for both the forward
    * and reverse search.
@@ -148,6 +223,54 @@ protected:
    */
   void Init(const midgard::PointLL& origll, const midgard::PointLL& destll);
 
+  /**
+   * Finds the path on the partition overlay.
+   * @param graphreader  to get the edges
+   * @param options      the request options
+   * @param origin       the origin location
+   * @param dest         the destination location
+   * @return the path, empty if the overlay can't tell
+   */
+  std::vector<std::vector<PathInfo>> OverlayPath(baldr::GraphReader& graphreader,
+                                                 const Options& options,
+                                                 const valhalla::Location& origin,
+                                                 const valhalla::Location& dest);
+
+  /**
+   * Expands both trees at the same time, the reverse one on a second thread, and connects them
+   * between the rounds of expansion.
+   * @param graphreader        to access graph data
+   * @param options            the request options
+   * @param origin             the origin location
+   * @param destination        the destination location
+   * @param forward_time_info  time tracking information about the start of the route
+   * @param reverse_time_info  time tracking information about the end of the route
+   * @param invariant          static date_time, dont offset the time as the path lengthens
+   * @return the paths found
+   */
+  std::vector<std::vector<PathInfo>> ExpandConcurrent(baldr::GraphReader& graphreader,
+                                                      const Options& options,
+                                                      valhalla::Location& origin,
+                                                      valhalla::Location& destination,
+                                                      const baldr::TimeInfo& forward_time_info,
+                                                      const baldr::TimeInfo& reverse_time_info,
+                                                      const bool invariant);
+
+  /**
+   * Settles and expands up to a round of labels of one tree without looking at the other one.
+   * @param graphreader      the graph reader of the thread
+   * @param round            the state of the round of this tree
+   * @param time_info        time tracking information about the start or end of the route
+   * @param invariant        static date_time, dont offset the time as the path lengthens
+   * @param round_interrupt  the interrupt of the request, null off the thread of the request
+   */
+  template <const ExpansionType expansion_direction>
+  void ExpandRound(baldr::GraphReader& graphreader,
+                   expansion_round_t& round,
+                   const baldr::TimeInfo& time_info,
+                   const bool invariant,
+                   const std::function<void()>* round_interrupt);
+
   /**
    * Expand from the node along the forward search path
    *
@@ -275,8 +398,8 @@ protected:
 //
 // If no restriction triggers, it returns true and the edge is allowed
 bool IsBridgingEdgeRestricted(baldr::GraphReader& graphreader,
-                              std::vector<sif::BDEdgeLabel>& edge_labels_fwd,
-                              std::vector<sif::BDEdgeLabel>& edge_labels_rev,
+                              std::pmr::vector<sif::BDEdgeLabel>& edge_labels_fwd,
+                              std::pmr::vector<sif::BDEdgeLabel>& edge_labels_rev,
                               const sif::BDEdgeLabel& fwd_pred,
                               const sif::BDEdgeLabel& rev_pred,
                               const sif::cost_ptr_t& costing);
@@ -0,0 +1,158 @@
+#ifndef VALHALLA_THOR_CHMATRIX_H_
+#define VALHALLA_THOR_CHMATRIX_H_
+
+#include <valhalla/baldr/contraction_hierarchy.h>
+#include <valhalla/baldr/graphreader.h>
+#include <valhalla/proto/options.pb.h>
+#include <valhalla/proto_conversions.h>
+#include <valhalla/sif/dynamiccost.h>
+#include <valhalla/thor/matrixalgorithm.h>
+
+#include <ankerl/unordered_dense.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace valhalla {
+namespace thor {
+
+/**
+ * Many-to-many matrix on the contraction hierarchies built by mjolnir. Every target runs an upward
+ * search on the backward arcs and leaves what it settles in per node buckets, then every source
+ * runs an upward search on the forward arcs and scans the buckets of the nodes it settles. The
+ * searches only ever go up the hierarchy, so they settle a few hundred nodes instead of
+ * expanding the graph between the locations.
+ *
+ * A hierarchy is exact for the default options of its costing without a time, other requests
+ * need one of the other matrix algorithms, see Supports. The arcs do not know about complex
+ * restrictions, a connection whose path passes the end of one is not found and SourceToTarget
+ * returns false so the request can be answered by one of the other matrices.
+ */
+class CHMatrix : public MatrixAlgorithm {
+public:
+  /**
+   * Maps the hierarchies found in a directory.
+   * @param config  A config object of key, value pairs
+   * @param dir     where mjolnir wrote the hierarchies, empty for none
+   */
+  CHMatrix(const boost::property_tree::ptree& config = {}, const std::string& dir = "");
+
+  /**
+   * Shares the hierarchies another matrix mapped.
+   * @param config  A config object of key, value pairs
+   * @param other   the matrix with the hierarchies
+   */
+  CHMatrix(const boost::property_tree::ptree& config, const CHMatrix& other);
+
+  /**
+   * Whether the request can be answered from a hierarchy: there is one for its costing, the
+   * costing options are the ones it was built for, there is no time, no live traffic and no shape
+   * is requested. Has to be called after set_has_time.
+   * @param request      the request
+   * @param graphreader  Graph reader to check for live traffic
+   * @param costing      the costing of the request
+   */
+  bool Supports(const Api& request,
+                baldr::GraphReader& graphreader,
+                const sif::DynamicCost& costing) const;
+
+  /**
+   * Forms a time distance matrix from the set of source locations
+   * to the set of target locations.
+   * @param  request               the full request
+   * @param  graphreader           Graph reader for accessing routing graph.
+   * @param  mode_costing          Costing methods.
+   * @param  mode                  Travel mode to use.
+   * @param  max_matrix_distance   Maximum arc-length distance for current mode.
+   * @return whether every connection was found
+   */
+  bool SourceToTarget(Api& request,
+                      baldr::GraphReader& graphreader,
+                      const sif::mode_costing_t& mode_costing,
+                      const sif::travel_mode_t mode,
+                      const float max_matrix_distance) override;
+
+  /**
+   * Clear the temporary information generated during time+distance
+   * matrix construction.
+   */
+  void Clear() override;
+
+  inline const std::string& name() override {
+    return MatrixAlgoToString(Matrix::ContractionHierarchy);
+  }
+
+protected:
+  /**
+   * Whether there is a hierarchy for the costing of a request that was built with its options.
+   * @param options  the request options
+   */
+  bool HasHierarchy(const Options& options) const;
+
+  // cost, time and distance from a source or to a target and whether the path passes the end of
+  // a complex restriction
+  struct search_label_t {
+    float cost;
+    float secs;
+    float length;
+    bool restricted;
+  };
+
+  // what a backward search left at a node
+  struct bucket_entry_t {
+    uint32_t node;
+    uint32_t target;
+    search_label_t label;
+  };
+
+  // a correlated edge of a location with the cost of the part of it that is on the path
+  struct seed_t {
+    uint32_t node;
+    float percent_along;
+    search_label_t label;
+  };
+
+  /**
+   * @return the correlated edges of the locations with where along them the locations are
+   */
+  static std::unordered_multimap<baldr::GraphId, double>
+  CorrelatedEdges(const google::protobuf::RepeatedPtrField<valhalla::Location>& locations);
+
+  /**
+   * Gets the nodes to start the searches of a location from.
+   * @param graphreader  to get the correlated edges
+   * @param location     the source or target
+   * @param others       the correlated edges of the other side
+   * @param forward      whether this is a source
+   */
+  std::vector<seed_t> Seeds(baldr::GraphReader& graphreader,
+                            const valhalla::Location& location,
+                            const std::unordered_multimap<baldr::GraphId, double>& others,
+                            const bool forward) const;
+
+  /**
+   * Runs an upward search from the seeds and calls back for every node settled.
+   */
+  template <typename settled_t>
+  void Search(const std::vector<seed_t>& seeds, const bool forward, const settled_t& settled);
+
+  std::unordered_map<Costing::Type, std::shared_ptr<const baldr::ContractionHierarchy>> hierarchies_;
+  const baldr::ContractionHierarchy* hierarchy_;
+  sif::cost_ptr_t costing_;
+
+  // the buckets of all targets, sorted by node
+  std::vector<bucket_entry_t> buckets_;
+  // where the entries of a node start in the buckets
+  ankerl::unordered_dense::map<uint32_t, uint32_t> bucket_index_;
+  // the labels of the current search
+  ankerl::unordered_dense::map<uint32_t, search_label_t> labels_;
+  std::vector<std::pair<float, uint32_t>> queue_;
+};
+
+} // namespace thor
+} // namespace valhalla
+
+#endif // VALHALLA_THOR_CHMATRIX_H_
@@ -1,7 +1,7 @@
 #ifndef VALHALLA_THOR_COSTMATRIX_H_
 #define VALHALLA_THOR_COSTMATRIX_H_
 
-#include <valhalla/baldr/double_bucket_queue.h>
+#include <valhalla/baldr/label_queue.h>
 #include <valhalla/baldr/graphid.h>
 #include <valhalla/baldr/graphreader.h>
 #include <valhalla/proto/common.pb.h>
@@ -15,7 +15,9 @@
 
 #include <cstdint>
 #include <memory>
+#include <memory_resource>
 #include <set>
+#include <utility>
 #include <vector>
 
 namespace valhalla {
@@ -84,8 +86,11 @@ public:
   /**
    * Default constructor. Most internal values are set when a query is made so
    * the constructor mainly just sets some internals to a default empty value.
+   * @param config  A config object of key, value pairs
+   * @param arena   Request arena to allocate the edge labels from, nullptr for the heap
    */
-  CostMatrix(const boost::property_tree::ptree& config = {});
+  CostMatrix(const boost::property_tree::ptree& config = {},
+             std::pmr::memory_resource* arena = nullptr);
 
   ~CostMatrix();
 
@@ -110,6 +115,12 @@ public:
    */
   void Clear() override;
 
+  /**
+   * Drops the edge labels allocated from the request arena, must be called before the arena is
+   * released at the end of the request.
+   */
+  void ReleaseArena();
+
   /**
    * Get the algorithm's name
    * @return the name of the algorithm
@@ -118,10 +129,48 @@ public:
     return MatrixAlgoToString(Matrix::CostMatrix);
   }
 
+  /**
+   * Sets the landmark distances the A* heuristics use if costmatrix.heuristic is alt.
+   * @param landmarks  the landmark distances, nullptr for none
+   */
+  void set_landmarks(const baldr::AltLandmarks* landmarks) {
+    landmarks_ = landmarks;
+  }
+
+  /**
+   * Sets the config of the graph readers for the threads which expand the searches of the sources
+   * and targets if costmatrix.concurrency is more than 1, without it they run on one thread.
+   * @param mjolnir  the mjolnir config
+   */
+  void set_reader_config(const boost::property_tree::ptree& mjolnir) {
+    reader_config_ = mjolnir;
+  }
+
 protected:
   uint32_t max_reserved_labels_count_;
   uint32_t max_reserved_locations_count_;
+  size_t max_reserved_edge_status_size_;
+  baldr::LabelQueueType queue_type_;
+  std::pmr::memory_resource* arena_;
   bool check_reverse_connection_;
+  // Landmark distances to tighten the heuristics with, if any and configured
+  const baldr::AltLandmarks* landmarks_;
+  bool use_landmarks_;
+
+  // Number of threads expanding the searches, whether they are right now and the graph readers
+  // of the threads other than the calling one
+  uint32_t concurrency_;
+  bool parallel_;
+  boost::property_tree::ptree reader_config_;
+  std::vector<std::unique_ptr<baldr::GraphReader>> readers_;
+
+  // What the search of a location changes for the other direction while the searches run in
+  // parallel: the edges it reached and the opposite locations it connected to with its label count
+  struct pending_t {
+    std::vector<uint64_t> reached;
+    std::vector<std::pair<uint32_t, size_t>> found;
+  };
+  std::array<std::vector<pending_t>, 2> pending_;
 
   // lower and upper bounds for the number of additional iterations per expansion once a connection
   // has been found
@@ -151,8 +200,10 @@ protected:
 
   // Adjacency lists, EdgeLabels, EdgeStatus, and hierarchy limits for each location
   std::array<std::vector<std::vector<valhalla::HierarchyLimits>>, 2> hierarchy_limits_;
-  std::array<std::vector<baldr::DoubleBucketQueue<sif::BDEdgeLabel>>, 2> adjacency_;
-  std::array<std::vector<std::vector<sif::BDEdgeLabel>>, 2> edgelabel_;
+  std::array<std::vector<baldr::LabelQueue<sif::BDEdgeLabel, std::pmr::vector<sif::BDEdgeLabel>>>,
+             2>
+      adjacency_;
+  std::array<std::pmr::vector<std::pmr::vector<sif::BDEdgeLabel>>, 2> edgelabel_;
   std::array<std::vector<EdgeStatus>, 2> edgestatus_;
 
   // A* heuristics for both trees and each location
@@ -226,6 +277,40 @@ protected:
             const bool FORWARD = expansion_direction == MatrixExpansionType::forward>
   void UpdateStatus(const uint32_t source, const uint32_t target);
 
+  /**
+   * Removes an opposite location from the unfound connections of a location and limits its
+   * remaining expansion once they are all found.
+   * @param  is_fwd       whether the location is a source
+   * @param  index        the location index
+   * @param  opp_index    the opposite location index
+   * @param  label_count  the edge label count of both searches
+   */
+  void UpdateLocationStatus(const bool is_fwd,
+                            const uint32_t index,
+                            const uint32_t opp_index,
+                            const size_t label_count);
+
+  /**
+   * Stops the search of an exhausted location and of the opposite locations it was the last
+   * unfound connection of.
+   * @param  is_fwd  whether the location is a source
+   * @param  index   the location index
+   */
+  void FinishLocation(const bool is_fwd, const uint32_t index);
+
+  /**
+   * Expands the searches until all of them are done with the ones of each direction spread over
+   * costmatrix.concurrency threads.
+   * @param  graphreader  the graph reader of the calling thread
+   * @param  options      the request options
+   * @param  time_infos   the time info objects for the sources
+   * @param  invariant    whether time is invariant
+   */
+  void ExpandParallel(baldr::GraphReader& graphreader,
+                      const valhalla::Options& options,
+                      const std::vector<baldr::TimeInfo>& time_infos,
+                      const bool invariant);
+
   /**
    * Sets the source/origin locations. Search expands forward from these
    * locations.
@@ -296,12 +381,15 @@ protected:
    * the search towards the closest target/source.
    *
    * @param loc_idx  either the source or target index
+   * @param node     the current edge's end node
    * @param node_ll  the current edge's end node's lat/lon
    * @returns The heuristic for the closest target/source of the passed node
    */
   template <const MatrixExpansionType expansion_direction,
             const bool FORWARD = expansion_direction == MatrixExpansionType::forward>
-  float GetAstarHeuristic(const uint32_t loc_idx, const midgard::PointLL& node_ll) const;
+  float GetAstarHeuristic(const uint32_t loc_idx,
+                          const baldr::GraphId& node,
+                          const midgard::PointLL& node_ll) const;
 
 private:
   class ReachedMap;
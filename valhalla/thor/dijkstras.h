@@ -1,7 +1,7 @@
 #ifndef VALHALLA_THOR_Dijkstras_H_
 #define VALHALLA_THOR_Dijkstras_H_
 
-#include <valhalla/baldr/double_bucket_queue.h>
+#include <valhalla/baldr/label_queue.h>
 #include <valhalla/baldr/graphid.h>
 #include <valhalla/baldr/graphreader.h>
 #include <valhalla/baldr/time_info.h>
@@ -15,6 +15,7 @@
 #include <boost/property_tree/ptree.hpp>
 
 #include <cstdint>
+#include <memory_resource>
 #include <unordered_map>
 #include <vector>
 
@@ -35,8 +36,10 @@ public:
   /**
    * Constructor.
    * @param config A config object of key, value pairs
+   * @param arena  Request arena to allocate the edge labels from, nullptr for the heap
    */
-  explicit Dijkstras(const boost::property_tree::ptree& config = {});
+  explicit Dijkstras(const boost::property_tree::ptree& config = {},
+                     std::pmr::memory_resource* arena = nullptr);
 
   Dijkstras(const Dijkstras&) = delete;
   Dijkstras& operator=(const Dijkstras&) = delete;
@@ -49,6 +52,12 @@ public:
    */
   virtual void Clear();
 
+  /**
+   * Drops the edge labels allocated from the request arena, must be called before the arena is
+   * released at the end of the request.
+   */
+  void ReleaseArena();
+
   /**
    * Compute the best first graph traversal from a list locations
    * @param expansion_type  What type of expansion should be run
@@ -142,21 +151,26 @@ protected:
   std::string origin_date_time_;
   std::unordered_map<std::string, uint32_t> operators_;
   std::unordered_set<uint32_t> processed_tiles_;
+  // the transit schedules of each tile running on the day of the route, by tile Id
+  std::unordered_map<uint32_t, std::vector<bool>> active_schedules_;
 
   // Current costing mode
   sif::cost_ptr_t costing_;
 
+  // Request arena the edge labels come from, if any
+  std::pmr::memory_resource* arena_;
+
   // Vector of edge labels (requires access by index).
-  std::vector<sif::BDEdgeLabel> bdedgelabels_;
-  std::vector<sif::MMEdgeLabel> mmedgelabels_;
+  std::pmr::vector<sif::BDEdgeLabel> bdedgelabels_;
+  std::pmr::vector<sif::MMEdgeLabel> mmedgelabels_;
   uint32_t max_reserved_labels_count_;
 
   // if `true` clean reserved memory for edge labels
   bool clear_reserved_memory_;
 
   // Adjacency list - approximate double bucket sort
-  baldr::DoubleBucketQueue<sif::BDEdgeLabel> adjacencylist_;
-  baldr::DoubleBucketQueue<sif::MMEdgeLabel> mmadjacencylist_;
+  baldr::LabelQueue<sif::BDEdgeLabel, decltype(bdedgelabels_)> adjacencylist_;
+  baldr::LabelQueue<sif::MMEdgeLabel, decltype(mmedgelabels_)> mmadjacencylist_;
 
   // Edge status. Mark edges that are in adjacency list or settled.
   EdgeStatus edgestatus_;
@@ -181,7 +195,7 @@ protected:
    */
   template <typename label_container_t>
   void Initialize(label_container_t& labels,
-                  baldr::DoubleBucketQueue<typename label_container_t::value_type>& queue,
+                  baldr::LabelQueue<typename label_container_t::value_type, label_container_t>& queue,
                   const uint32_t bucketsize);
 
   /**
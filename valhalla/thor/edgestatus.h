@@ -3,7 +3,12 @@
 #include <valhalla/baldr/graphid.h>
 #include <valhalla/baldr/graphtile.h>
 
-#include <unordered_map>
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 // handy macro for shifting the 7bit path index value so that it can be or'd with the tile/level id
 #define SHIFT_path_id(x) (static_cast<uint32_t>(x) << 25u)
@@ -11,6 +16,11 @@
 namespace valhalla {
 namespace thor {
 
+// Default number of bytes of edge status arrays a search direction keeps between requests
+constexpr size_t kDefaultEdgeStatusPoolSize = 8 * 1024 * 1024;
+// Default number of bytes of edge status arrays all the search trees of a CostMatrix keep together
+constexpr size_t kDefaultMatrixEdgeStatusPoolSize = 32 * 1024 * 1024;
+
 // Edge label status
 enum class EdgeSet : uint8_t {
   kUnreachedOrReset = 0, // Unreached - not yet encountered in search _or_ encountered but
@@ -51,11 +61,17 @@ struct EdgeStatusInfo {
  * edges within arrays for each tile. This allows the path algorithms to get
  * a pointer to the first edge status and iterate that pointer over sequential
  * edges. This reduces the number of map lookups.
+ *
+ * The arrays are found through a flat open addressing table keyed by tile (and path id) so
+ * that a lookup is a multiply and usually a single probe into contiguous memory. When
+ * cleared the arrays can be kept in a pool, up to a configurable amount of memory, and
+ * handed out again to the next search so that repeated requests neither go back to the
+ * allocator nor fault in fresh pages for every tile they touch.
  */
 class EdgeStatus {
 public:
   /**
-   * Default constructor.
+   * Default constructor. Arrays are freed on clear, see set_max_pool_size to keep them.
    */
   EdgeStatus() = default;
 
@@ -63,25 +79,64 @@ public:
   // forbid copying
   EdgeStatus(const EdgeStatus&) = delete;
   EdgeStatus& operator=(const EdgeStatus&) = delete;
-  EdgeStatus(EdgeStatus&&) = default;
-  EdgeStatus& operator=(EdgeStatus&&) = default;
+  EdgeStatus(EdgeStatus&& other) noexcept {
+    swap(other);
+  }
+  EdgeStatus& operator=(EdgeStatus&& other) noexcept {
+    swap(other);
+    return *this;
+  }
 
   /**
    * Destructor. Delete any allocated EdgeStatusInfo arrays.
    */
   ~EdgeStatus() {
+    max_pool_size_ = 0;
     clear();
   }
 
   /**
-   * Clear the EdgeStatusInfo arrays and the edge status map.
+   * Exchanges the arrays, the table and the pool with another EdgeStatus.
+   * @param  other  the EdgeStatus to swap with
+   */
+  void swap(EdgeStatus& other) noexcept {
+    std::swap(slots_, other.slots_);
+    std::swap(shift_, other.shift_);
+    std::swap(size_, other.size_);
+    std::swap(pool_, other.pool_);
+    std::swap(pool_size_, other.pool_size_);
+    std::swap(max_pool_size_, other.max_pool_size_);
+  }
+
+  /**
+   * Sets how many bytes worth of arrays are kept around after a clear so they can be reused by
+   * the next search. Anything above the new limit is freed right away.
+   * @param  bytes  the maximum size of the pool in bytes, 0 disables pooling
+   */
+  void set_max_pool_size(size_t bytes) {
+    max_pool_size_ = bytes;
+    while (pool_size_ > max_pool_size_) {
+      pool_size_ -= pool_.back().capacity * sizeof(EdgeStatusInfo);
+      delete[] pool_.back().array;
+      pool_.pop_back();
+    }
+  }
+
+  /**
+   * Clear the EdgeStatusInfo arrays and the edge status map. Arrays go back to the pool
+   * for reuse as long as it has room for them.
    */
   void clear() {
-    // Delete any allocated arrays for tiles within the map.
-    for (auto& iter : edgestatus_) {
-      delete[] iter.second;
+    if (size_ > 0) {
+      for (auto& slot : slots_) {
+        if (slot.array) {
+          recycle(slot);
+          slot = {};
+        }
+      }
+      size_ = 0;
     }
-    edgestatus_.clear();
+    set_max_pool_size(max_pool_size_);
   }
 
   /**
@@ -98,17 +153,7 @@ public:
            const uint32_t index,
            const baldr::graph_tile_ptr& tile,
            const uint8_t path_id = 0) {
-    assert(path_id <= baldr::kMaxMultiPathId);
-    auto p = edgestatus_.find(edgeid.tile_value() | SHIFT_path_id(path_id));
-    if (p != edgestatus_.end()) {
-      p->second[edgeid.id()] = {set, index};
-    } else {
-      // Tile is not in the map. Add an array of EdgeStatusInfo, sized to
-      // the number of directed edges in the specified tile.
-      auto inserted = edgestatus_.emplace(edgeid.tile_value() | SHIFT_path_id(path_id),
-                                          new EdgeStatusInfo[tile->header()->directededgecount()]);
-      inserted.first->second[edgeid.id()] = {set, index};
-    }
+    *GetPtr(edgeid, tile, path_id) = {set, index};
   }
 
   /**
@@ -121,9 +166,9 @@ public:
    */
   void Update(const baldr::GraphId& edgeid, const EdgeSet set, const uint8_t path_id = 0) {
     assert(path_id <= baldr::kMaxMultiPathId);
-    const auto p = edgestatus_.find(edgeid.tile_value() | SHIFT_path_id(path_id));
-    if (p != edgestatus_.end()) {
-      p->second[edgeid.id()].set_ = static_cast<uint32_t>(set);
+    const auto* slot = find(edgeid.tile_value() | SHIFT_path_id(path_id));
+    if (slot) {
+      slot->array[edgeid.id()].set_ = static_cast<uint32_t>(set);
     } else {
       throw std::runtime_error("EdgeStatus Update on edge not previously set");
     }
@@ -138,8 +183,8 @@ public:
    */
   EdgeStatusInfo Get(const baldr::GraphId& edgeid, const uint8_t path_id = 0) const {
     assert(path_id <= baldr::kMaxMultiPathId);
-    const auto p = edgestatus_.find(edgeid.tile_value() | SHIFT_path_id(path_id));
-    return (p == edgestatus_.end()) ? EdgeStatusInfo() : p->second[edgeid.id()];
+    const auto* slot = find(edgeid.tile_value() | SHIFT_path_id(path_id));
+    return slot ? slot->array[edgeid.id()] : EdgeStatusInfo();
   }
 
   /**
@@ -155,23 +200,123 @@ public:
   EdgeStatusInfo*
   GetPtr(const baldr::GraphId& edgeid, const baldr::graph_tile_ptr& tile, const uint8_t path_id = 0) {
     assert(path_id <= baldr::kMaxMultiPathId);
-    const auto p = edgestatus_.find(edgeid.tile_value() | SHIFT_path_id(path_id));
-    if (p != edgestatus_.end()) {
-      return &p->second[edgeid.id()];
-    } else {
-      // Tile is not in the map. Add an array of EdgeStatusInfo, sized to
-      // the number of directed edges in the specified tile.
-      auto inserted = edgestatus_.emplace(edgeid.tile_value() | SHIFT_path_id(path_id),
-                                          new EdgeStatusInfo[tile->header()->directededgecount()]);
-      return &(inserted.first->second)[edgeid.id()];
+    const uint32_t key = edgeid.tile_value() | SHIFT_path_id(path_id);
+    if (slots_.empty()) {
+      grow();
+    }
+    auto* slot = probe(key);
+    if (!slot->array) {
+      // Tile is not in the table yet. Make room for it if need be and add an array of
+      // EdgeStatusInfo, sized to the number of directed edges in the specified tile.
+      if ((size_ + 1) * 2 > slots_.size()) {
+        grow();
+        slot = probe(key);
+      }
+      allocate(*slot, tile->header()->directededgecount());
+      slot->key = key;
+      ++size_;
     }
+    return &slot->array[edgeid.id()];
   }
 
 private:
-  // Edge status - keys are the tile Ids (level and tile Id) and the
-  // values are dynamically allocated arrays of EdgeStatusInfo (sized
-  // based on the directed edge count within the tile).
-  std::unordered_map<uint32_t, EdgeStatusInfo*> edgestatus_;
+  // A tile entry in the table, empty if it has no array
+  struct slot_t {
+    uint32_t key = 0;
+    uint32_t capacity = 0;
+    EdgeStatusInfo* array = nullptr;
+  };
+
+  // Fibonacci hashing spreads the sequential tile ids across the table
+  size_t bucket(const uint32_t key) const {
+    return (static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> shift_;
+  }
+
+  // Linear probing for the slot of the key or the empty slot where it would go, the table must not
+  // be empty
+  slot_t* probe(const uint32_t key) {
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = bucket(key);; i = (i + 1) & mask) {
+      auto& slot = slots_[i];
+      if (!slot.array || slot.key == key) {
+        return &slot;
+      }
+    }
+  }
+
+  // The slot of the key or nullptr if it has none
+  const slot_t* find(const uint32_t key) const {
+    if (slots_.empty()) {
+      return nullptr;
+    }
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = bucket(key);; i = (i + 1) & mask) {
+      const auto& slot = slots_[i];
+      if (!slot.array) {
+        return nullptr;
+      }
+      if (slot.key == key) {
+        return &slot;
+      }
+    }
+  }
+
+  // Doubles the table, keeping it at most half full, and puts the existing arrays in their new spots
+  void grow() {
+    std::vector<slot_t> old(std::max<size_t>(slots_.size() * 2, kMinSlots));
+    old.swap(slots_);
+    shift_ = 64 - static_cast<uint32_t>(std::countr_zero(slots_.size()));
+    for (const auto& slot : old) {
+      if (slot.array) {
+        *probe(slot.key) = slot;
+      }
+    }
+  }
+
+  // Gives the slot the smallest pooled array that fits or a new one if none does
+  void allocate(slot_t& slot, const uint32_t count) {
+    auto best = pool_.end();
+    for (auto itr = pool_.begin(); itr != pool_.end(); ++itr) {
+      if (itr->capacity >= count && (best == pool_.end() || itr->capacity < best->capacity)) {
+        best = itr;
+      }
+    }
+    if (best == pool_.end()) {
+      slot.capacity = count;
+      slot.array = new EdgeStatusInfo[count];
+      return;
+    }
+    slot = *best;
+    pool_size_ -= best->capacity * sizeof(EdgeStatusInfo);
+    *best = pool_.back();
+    pool_.pop_back();
+    std::fill_n(slot.array, count, EdgeStatusInfo());
+  }
+
+  // Keeps the slot's array for the next search if it fits in the pool, otherwise frees it
+  void recycle(const slot_t& slot) {
+    const size_t bytes = slot.capacity * sizeof(EdgeStatusInfo);
+    if (pool_size_ + bytes <= max_pool_size_) {
+      pool_.push_back(slot);
+      pool_size_ += bytes;
+    } else {
+      delete[] slot.array;
+    }
+  }
+
+  static constexpr size_t kMinSlots = 16;
+
+  // Edge status - open addressing table of tile Ids (level, tile Id and path id) and their
+  // dynamically allocated arrays of EdgeStatusInfo (sized based on the directed edge count
+  // within the tile). The size is a power of 2 and at most half of it is in use
+  std::vector<slot_t> slots_;
+  uint32_t shift_ = 64;
+  size_t size_ = 0;
+
+  // Arrays that were cleared and can be reused, along with their total size in bytes
+  std::vector<slot_t> pool_;
+  size_t pool_size_ = 0;
+  size_t max_pool_size_ = 0;
 };
 
 } // namespace thor
@@ -8,7 +8,9 @@
 #include <valhalla/thor/dijkstras.h>
 
 #include <cstdint>
+#include <list>
 #include <memory>
+#include <string>
 
 namespace valhalla {
 namespace thor {
@@ -23,8 +25,10 @@ public:
   /**
    * Constructor.
    * @param config A config object of key, value pairs
+   * @param arena  Request arena to allocate the edge labels from, nullptr for the heap
    */
-  explicit Isochrone(const boost::property_tree::ptree& config = {});
+  explicit Isochrone(const boost::property_tree::ptree& config = {},
+                     std::pmr::memory_resource* arena = nullptr);
 
   /**
    * Destructor
@@ -38,6 +42,11 @@ public:
    * so it can be output as polygons. Multiple locations are allowed as the
    * origins - within some reasonable distance from each other.
    *
+   * With isochrone.max_cached_grids the grids of isochrone requests are kept by their snapped
+   * locations, costing, largest contours and departure time bucket, so requests that only differ
+   * in the other contours or the output are served without expanding again. They are dropped when
+   * the tiles are rebuilt, see GraphReader::TileBuild.
+   *
    * @param expansion_type  Which type of expansion to do, forward/reverse/mulitmodal
    * @param api             The request response containing the locations to seed the expansion
    * @param reader          Graph reader to provide access to graph primitives
@@ -86,6 +95,33 @@ protected:
   std::shared_ptr<midgard::GriddedData<2>> isotile_;
   expansion_callback_t inner_expansion_callback_;
 
+  size_t max_cached_grids_;
+  uint32_t cache_time_bucket_; // seconds
+
+  struct cached_grid_t {
+    size_t hash;
+    std::string key;
+    std::shared_ptr<const midgard::GriddedData<2>> grid;
+  };
+  // most recently used first
+  std::list<cached_grid_t> grids_;
+  // the build of the tiles the cached grids were expanded on, read from the same tile every time
+  baldr::GraphId build_tile_;
+  uint64_t tileset_build_;
+
+  /**
+   * The key of the grid of a request in the cache.
+   * @param  expansion_type  Which type of expansion to do
+   * @param  api             The request
+   * @param  reader          Graph reader, for the time zones of the locations
+   * @param  costing         The costing of the expansion
+   * @return the key, empty if the grid should not be cached
+   */
+  std::string CacheKey(const ExpansionType& expansion_type,
+                       const valhalla::Api& api,
+                       baldr::GraphReader& reader,
+                       const sif::DynamicCost& costing);
+
   /**
    * Constructs the isotile - 2-D gridded data containing the time
    * to get to each lat,lng tile.
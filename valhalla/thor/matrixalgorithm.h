@@ -136,28 +136,14 @@ public:
     expansion_callback_ = expansion_callback;
   }
 
-protected:
-  const std::function<void()>* interrupt_;
-
-  // whether time was specified
-  bool has_time_;
-
-  // Indicates whether to allow access into a not-thru region.
-  bool not_thru_pruning_;
-
-  // for tracking the expansion of the algorithm visually
-  expansion_callback_t expansion_callback_;
-
-  uint32_t max_reserved_labels_count_;
-  // prune path if path_distance exceeds this
-  uint32_t max_expansion_distance_;
-
-  // if `true` clean reserved memory for edge labels
-  bool clear_reserved_memory_;
-
-  // on first pass, resizes all PBF sequences and defaults to 0 or ""
-  inline static void
-  reserve_pbf_arrays(valhalla::Matrix& matrix, size_t size, bool verbose, uint32_t pass = 0) {
+  // on first pass, resizes all PBF sequences and defaults to 0 or "". Every string is an allocation
+  // of its own, callers that know the date_times or shapes aren't written can leave them empty
+  inline static void reserve_pbf_arrays(valhalla::Matrix& matrix,
+                                        size_t size,
+                                        bool verbose,
+                                        uint32_t pass = 0,
+                                        bool date_times = true,
+                                        bool shapes = true) {
     if (pass == 0) {
       matrix.mutable_from_indices()->Resize(size, 0U);
       matrix.mutable_to_indices()->Resize(size, 0U);
@@ -165,19 +151,21 @@ protected:
       matrix.mutable_times()->Resize(size, 0U);
       matrix.mutable_second_pass()->Resize(size, false);
       // repeated strings don't support Resize()
-      matrix.mutable_date_times()->Reserve(size);
-      matrix.mutable_time_zone_offsets()->Reserve(size);
-      matrix.mutable_time_zone_names()->Reserve(size);
-      matrix.mutable_shapes()->Reserve(size);
-      for (size_t i = 0; i < size; i++) {
-        auto* date_time = matrix.mutable_date_times()->Add();
-        *date_time = "";
-        auto* time_zone_offset = matrix.mutable_time_zone_offsets()->Add();
-        *time_zone_offset = "";
-        auto* time_zone_name = matrix.mutable_time_zone_names()->Add();
-        *time_zone_name = "";
-        auto* shape = matrix.mutable_shapes()->Add();
-        *shape = "";
+      if (date_times) {
+        matrix.mutable_date_times()->Reserve(size);
+        matrix.mutable_time_zone_offsets()->Reserve(size);
+        matrix.mutable_time_zone_names()->Reserve(size);
+        for (size_t i = 0; i < size; i++) {
+          matrix.mutable_date_times()->Add();
+          matrix.mutable_time_zone_offsets()->Add();
+          matrix.mutable_time_zone_names()->Add();
+        }
+      }
+      if (shapes) {
+        matrix.mutable_shapes()->Reserve(size);
+        for (size_t i = 0; i < size; i++) {
+          matrix.mutable_shapes()->Add();
+        }
       }
       if (verbose) {
         // fill with sentinel values meaning "no data"
@@ -190,6 +178,25 @@ protected:
       }
     }
   }
+
+protected:
+  const std::function<void()>* interrupt_;
+
+  // whether time was specified
+  bool has_time_;
+
+  // Indicates whether to allow access into a not-thru region.
+  bool not_thru_pruning_;
+
+  // for tracking the expansion of the algorithm visually
+  expansion_callback_t expansion_callback_;
+
+  uint32_t max_reserved_labels_count_;
+  // prune path if path_distance exceeds this
+  uint32_t max_expansion_distance_;
+
+  // if `true` clean reserved memory for edge labels
+  bool clear_reserved_memory_;
 };
 
 // Structure to hold information about each destination.
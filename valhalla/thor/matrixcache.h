@@ -0,0 +1,166 @@
+#ifndef VALHALLA_THOR_MATRIXCACHE_H_
+#define VALHALLA_THOR_MATRIXCACHE_H_
+
+#include <valhalla/baldr/datetime.h>
+#include <valhalla/baldr/graphreader.h>
+#include <valhalla/midgard/util.h>
+#include <valhalla/proto/api.pb.h>
+#include <valhalla/sif/dynamiccost.h>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace valhalla {
+namespace thor {
+
+/**
+ * Keeps the connections of earlier matrix requests, so a request overlapping them, like the same
+ * depots and mostly the same stops every minute, only computes the rows and columns of the
+ * connections it doesn't have.
+ *
+ * A connection is kept by the snapped edges of its source and target with the bucket of
+ * thor.matrix_cache.time_bucket minutes their date_time falls in, and by the costing and the
+ * options the matrix depends on. The keys are looked up by their hashes but compared in full.
+ * Requests with shapes, matrix_locations or departure profiles don't use the cache and connections
+ * that needed a second pass are not kept. The least recently used connections go once there are
+ * more than thor.matrix_cache.max_connections.
+ *
+ * Everything is dropped when the tiles are rebuilt, see GraphReader::TileBuild, and, for costings
+ * using live traffic, when a traffic tile got a newer update. Reading the update of every traffic
+ * tile takes a while on a large extract, so it is done at most every
+ * thor.matrix_cache.traffic_check_interval milliseconds.
+ */
+class MatrixCache {
+public:
+  /**
+   * Constructor.
+   * @param config  the thor config
+   */
+  explicit MatrixCache(const boost::property_tree::ptree& config = {});
+
+  /**
+   * Fills the connections of the request the cache has into its matrix and remembers the keys of
+   * its locations for Put.
+   * @param  request  the request with its locations correlated
+   * @param  reader   Graph reader to check the tiles and the traffic
+   * @param  costing  the costing of the request
+   * @return whether each connection was filled, row-ordered, empty if the request can't use the
+   *         cache
+   */
+  std::vector<bool> Get(Api& request, baldr::GraphReader& reader, const sif::DynamicCost& costing);
+
+  /**
+   * Keeps the connections of the request last passed to Get, computed by it or a part of it.
+   * @param  part     the request computing the connections
+   * @param  sources  the index in the request of each source of the part
+   * @param  targets  the index in the request of each target of the part
+   */
+  void Put(const Api& part,
+           const std::vector<uint32_t>& sources,
+           const std::vector<uint32_t>& targets);
+
+  size_t size() const {
+    return connections_.size();
+  }
+
+protected:
+  // the bytes of the context of a request or of a location with their hash, shared by all the
+  // connections of the request
+  struct key_part_t {
+    std::shared_ptr<const std::string> bytes;
+    size_t hash = 0;
+    bool operator==(const key_part_t& other) const {
+      return hash == other.hash && (bytes == other.bytes || *bytes == *other.bytes);
+    }
+  };
+
+  // the context of the request and the source and target of a connection
+  struct key_t {
+    key_part_t context;
+    key_part_t source;
+    key_part_t target;
+    bool operator==(const key_t& other) const {
+      return context == other.context && source == other.source && target == other.target;
+    }
+  };
+  struct key_hash_t {
+    size_t operator()(const key_t& key) const {
+      size_t seed = key.context.hash;
+      midgard::hash_combine(seed, key.source.hash);
+      midgard::hash_combine(seed, key.target.hash);
+      return seed;
+    }
+  };
+
+  static key_part_t MakeKeyPart(std::string bytes) {
+    const auto hash = std::hash<std::string>{}(bytes);
+    return {std::make_shared<const std::string>(std::move(bytes)), hash};
+  }
+
+  // what the serializers need of a connection. The date_time is not kept, other departures of
+  // the same bucket arrive at other times, it is made again from the departure of the request
+  struct connection_t {
+    key_t key;
+    Matrix::Algorithm algorithm;
+    float time;
+    uint32_t distance;
+    bool timed;               // whether it had a date_time
+    bool from_target;         // whether the date_time was offset from the target
+    float date_time_offset;   // the seconds the date_time was offset by
+    uint64_t time_zone_index; // the time zone of the date_time
+    // only for verbose requests
+    float begin_heading;
+    float end_heading;
+    double begin_lat;
+    double begin_lon;
+    double end_lat;
+    double end_lon;
+  };
+
+  // the date_time of a location with "current" resolved and its time zone
+  struct departure_t {
+    std::string date_time;
+    uint64_t time_zone_index;
+  };
+
+  // the snapped edges of the location and the time bucket of its date_time
+  key_part_t LocationKey(const valhalla::Location& location,
+                         baldr::GraphReader& reader,
+                         departure_t& departure);
+
+  size_t max_connections_;
+  uint32_t time_bucket_; // seconds
+  std::chrono::milliseconds traffic_check_interval_;
+
+  // most recently used first
+  std::list<connection_t> connections_;
+  std::unordered_map<key_t, std::list<connection_t>::iterator, key_hash_t> index_;
+
+  // the keys of the request last passed to Get
+  key_part_t context_;
+  std::vector<key_part_t> source_keys_;
+  std::vector<key_part_t> target_keys_;
+  std::vector<departure_t> source_departures_;
+  std::vector<departure_t> target_departures_;
+  bool verbose_;
+
+  // the build of the tiles and the last traffic update of the cached connections. The build is
+  // read from the same tile every time, the tiles of one build can be made on different days
+  baldr::GraphId build_tile_;
+  uint64_t tileset_build_;
+  uint64_t traffic_last_update_;
+  std::chrono::steady_clock::time_point traffic_last_check_;
+  baldr::DateTime::tz_sys_info_cache_t tz_cache_;
+};
+
+} // namespace thor
+} // namespace valhalla
+
+#endif // VALHALLA_THOR_MATRIXCACHE_H_
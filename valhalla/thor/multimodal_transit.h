@@ -89,6 +89,8 @@ protected:
   std::string origin_date_time_;
   std::unordered_map<std::string, uint32_t> operators_;
   std::unordered_set<uint32_t> processed_tiles_;
+  // the transit schedules of each tile running on the day of the route, by tile Id
+  std::unordered_map<uint32_t, std::vector<bool>> active_schedules_;
 
   // A* heuristic
   AStarHeuristic astarheuristic_;
@@ -1,7 +1,9 @@
 #ifndef VALHALLA_THOR_OPTIMIZER_H_
 #define VALHALLA_THOR_OPTIMIZER_H_
 
+#include <chrono>
 #include <cstdint>
+#include <mutex>
 #include <random>
 #include <vector>
 
@@ -48,6 +50,25 @@ public:
    */
   std::vector<uint32_t> Solve(const uint32_t count, const std::vector<float>& costs);
 
+  /**
+   * Optimize the tour like Solve with an iterated local search instead of annealing, which finds
+   * better tours faster for a lot of locations. The tour starts from the nearest neighbor tour and
+   * is improved by 2-opt and Or-opt moves until none of them gains anything, then a random
+   * segment swap kicks it out of that local optimum and it is improved again. The threads kick
+   * the best tour any of them found with their own random swaps until the time budget is spent or
+   * kicks stop improving it.
+   * @param  count        Number of locations.
+   * @param  costs        2-D cost matrix.
+   * @param  concurrency  Number of threads searching.
+   * @param  time_budget  How long to search for.
+   * @return Returns the tour as an updated order of locations visited to
+   *         complete the tour.
+   */
+  std::vector<uint32_t> SolveLocalSearch(const uint32_t count,
+                                         const std::vector<float>& costs,
+                                         const uint32_t concurrency,
+                                         const std::chrono::milliseconds time_budget);
+
   /**
    * Seed the random number generator. This is used by tests to create a
    * repeatable sequence.
@@ -107,6 +128,82 @@ protected:
    */
   float TourCost(const std::vector<float>& costs, const std::vector<uint32_t>& tour) const;
 
+  /**
+   * Get the tour that always goes on to the cheapest location not visited yet.
+   * @param  costs  2-D cost matrix.
+   * @return Returns the tour.
+   */
+  std::vector<uint32_t> NearestNeighborTour(const std::vector<float>& costs) const;
+
+  // the best tour the threads of a local search found so far and how many kicks in a row did not
+  // improve it
+  struct shared_tour_t {
+    std::mutex mutex;
+    std::vector<uint32_t> tour;
+    float cost;
+    uint32_t stale;
+  };
+
+  /**
+   * Kicks the best tour and improves it again until the deadline or until kicks stop improving it.
+   * @param  costs     2-D cost matrix.
+   * @param  best      The best tour of all threads.
+   * @param  seed      Seed for the kicks.
+   * @param  deadline  When to stop.
+   */
+  void IteratedLocalSearch(const std::vector<float>& costs,
+                           shared_tour_t& best,
+                           const uint64_t seed,
+                           const std::chrono::steady_clock::time_point deadline) const;
+
+  /**
+   * Applies 2-opt and Or-opt moves to a tour until none of them makes it cheaper.
+   * @param  costs  2-D cost matrix.
+   * @param  tour   The tour to improve.
+   */
+  void LocalSearch(const std::vector<float>& costs, std::vector<uint32_t>& tour) const;
+
+  /**
+   * Reverses the parts of the tour that get cheaper reversed. The costs are asymmetric so the
+   * cost of a reversed part is taken from the costs up to every position of the tour in both
+   * directions.
+   * @param  costs     2-D cost matrix.
+   * @param  tour      The tour to improve.
+   * @param  forward   The cost of the tour up to every position.
+   * @param  backward  The cost of the tour reversed up to every position.
+   * @return Returns true if the tour got cheaper.
+   */
+  bool TwoOpt(const std::vector<float>& costs,
+              std::vector<uint32_t>& tour,
+              std::vector<double>& forward,
+              std::vector<double>& backward) const;
+
+  /**
+   * Moves runs of up to 3 locations to wherever in the tour they are cheaper, as they are or
+   * reversed.
+   * @param  costs     2-D cost matrix.
+   * @param  tour      The tour to improve.
+   * @param  forward   The cost of the tour up to every position.
+   * @param  backward  The cost of the tour reversed up to every position.
+   * @return Returns true if the tour got cheaper.
+   */
+  bool OrOpt(const std::vector<float>& costs,
+             std::vector<uint32_t>& tour,
+             std::vector<double>& forward,
+             std::vector<double>& backward) const;
+
+  /**
+   * Sets the cost of the tour up to every position in both directions.
+   * @param  costs     2-D cost matrix.
+   * @param  tour      The tour.
+   * @param  forward   The cost of the tour up to every position.
+   * @param  backward  The cost of the tour reversed up to every position.
+   */
+  void PrefixCosts(const std::vector<float>& costs,
+                   const std::vector<uint32_t>& tour,
+                   std::vector<double>& forward,
+                   std::vector<double>& backward) const;
+
   // ------------------------ Convenience methods (inline) ---------------- //
 
   /**
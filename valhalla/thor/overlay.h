@@ -0,0 +1,302 @@
+#ifndef VALHALLA_THOR_OVERLAY_H_
+#define VALHALLA_THOR_OVERLAY_H_
+
+#include <valhalla/baldr/graphid.h>
+#include <valhalla/baldr/graphreader.h>
+#include <valhalla/baldr/partition_overlay.h>
+#include <valhalla/proto/options.pb.h>
+#include <valhalla/sif/dynamiccost.h>
+
+#include <ankerl/unordered_dense.h>
+#include <boost/property_tree/ptree.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace valhalla {
+namespace thor {
+
+constexpr float kOverlayUnreached = std::numeric_limits<float>::max();
+
+// Cost, time and distance of an edge, a transition or a path through a cell, and whether it passes
+// an edge at the end of a complex restriction
+struct overlay_cost_t {
+  float cost;
+  float secs;
+  float length;
+  bool restricted = false;
+
+  overlay_cost_t operator+(const overlay_cost_t& other) const {
+    return {cost + other.cost, secs + other.secs, length + other.length,
+            restricted || other.restricted};
+  }
+
+  bool reachable() const {
+    return cost != kOverlayUnreached;
+  }
+};
+
+constexpr overlay_cost_t kOverlayUnreachedCost{kOverlayUnreached, 0, 0};
+
+/**
+ * The partition overlay customized for a costing: what every edge and every transition costs and
+ * the cheapest path from every entry to every exit of every cell. Customizing the overlay for the
+ * options of a request takes a pass over the whole graph, the cells of a level are done in
+ * parallel, and is exact for them as long as they do not depend on the time. Complex restrictions
+ * are not modeled, the costs only tell whether a path passes the last edge of one.
+ */
+class OverlayMetric {
+public:
+  /**
+   * Customizes the overlay for a costing.
+   * @param overlay      the overlay
+   * @param reader       to get the edges from
+   * @param costing      the costing with the options of the request
+   * @param concurrency  how many threads compute the costs through the cells
+   */
+  static std::shared_ptr<const OverlayMetric> Customize(const baldr::PartitionOverlay& overlay,
+                                                        baldr::GraphReader& reader,
+                                                        const sif::DynamicCost& costing,
+                                                        uint32_t concurrency = 1);
+
+  /**
+   * @return the cost of the edge of a node, unreached if the costing has no access
+   */
+  const overlay_cost_t& node(const uint32_t node) const {
+    return nodes_[node];
+  }
+
+  /**
+   * @return the cost of a transition without the edge it leads to, unreached if not allowed
+   */
+  const overlay_cost_t& arc(const uint64_t arc) const {
+    return arcs_[arc];
+  }
+
+  /**
+   * @return the cost of the cheapest path within a cell from the end of one of its entries to the
+   *         end of one of its exits
+   */
+  const overlay_cost_t&
+  clique(const uint32_t level, const uint32_t cell, const uint32_t entry, const uint32_t exit) const {
+    return cliques_[level][clique_offsets_[level][cell] + entry * exit_counts_[level][cell] + exit];
+  }
+
+protected:
+  std::vector<overlay_cost_t> nodes_;
+  std::vector<overlay_cost_t> arcs_;
+  std::vector<std::vector<uint64_t>> clique_offsets_;
+  std::vector<std::vector<uint32_t>> exit_counts_;
+  std::vector<std::vector<overlay_cost_t>> cliques_;
+};
+
+// A node to start a search from with the cost of the part of its edge that is on the path
+struct overlay_seed_t {
+  uint32_t node;
+  float percent_along;
+  overlay_cost_t cost;
+};
+
+/**
+ * Queries on a partition overlay. A search expands the regular graph within the cells that contain
+ * one of its end points and uses the customized costs through every other cell on the highest
+ * level it can, so it only settles the nodes near the locations and the entries and exits of the
+ * cells in between. Customizations are cached by a hash of the costing options. With a reader
+ * config they are made on a thread of their own, the requests with options that are not customized
+ * yet take the regular searches in the meantime instead of waiting for the whole graph to be done.
+ * The searches of all workers of a process share the mapped overlay and the cached customizations
+ * of a file, each worker customizes what none of them has yet.
+ */
+class OverlaySearch {
+public:
+  /**
+   * Maps the overlay mjolnir wrote, if there is one.
+   * @param config  the thor config
+   * @param file    the overlay file
+   */
+  OverlaySearch(const boost::property_tree::ptree& config = {}, const std::string& file = "");
+
+  /**
+   * Sets the config of the graph reader customizations in the background read the edges with.
+   * Without one they are made on the thread of the request.
+   * @param mjolnir  the mjolnir config
+   */
+  void set_reader_config(const boost::property_tree::ptree& mjolnir) {
+    reader_config_ = mjolnir;
+  }
+
+  /**
+   * @return whether there is an overlay
+   */
+  bool available() const {
+    return overlay_ != nullptr;
+  }
+
+  /**
+   * Whether the overlay answers requests with a costing exactly. Customizations do not depend on
+   * the time or on live traffic, so callers still have to check the request has no time.
+   * @param reader   to know about live traffic
+   * @param costing  the costing of the request
+   */
+  bool Supports(baldr::GraphReader& reader, const sif::DynamicCost& costing) const;
+
+  /**
+   * Whether the customization for the costing of a request is at hand. Customizing in the
+   * background, one that is not gets started unless another one is under way, and the request is
+   * to take the regular searches. Customizing on the thread of the request it always is.
+   * @param options  the request options
+   * @param reader   to get the edges from
+   * @param costing  the costing with the options of the request
+   */
+  bool Ready(const Options& options, baldr::GraphReader& reader, const sif::DynamicCost& costing);
+
+  /**
+   * Gets the customization of the overlay for the costing of a request, customizing it if it is
+   * not cached.
+   * @param options  the request options
+   * @param reader   to get the edges from
+   * @param costing  the costing with the options of the request
+   */
+  std::shared_ptr<const OverlayMetric>
+  Metric(const Options& options, baldr::GraphReader& reader, const sif::DynamicCost& costing);
+
+  /**
+   * Gets the nodes to start a search from for the correlated edges of a location.
+   * @param reader    to get the edges
+   * @param costing   the costing
+   * @param metric    the customized overlay
+   * @param location  the location
+   * @param forward   whether it is a source or a target
+   */
+  std::vector<overlay_seed_t> Seeds(baldr::GraphReader& reader,
+                                    const sif::DynamicCost& costing,
+                                    const OverlayMetric& metric,
+                                    const valhalla::Location& location,
+                                    const bool forward) const;
+
+  /**
+   * Finds the cheapest path between two locations.
+   * @param metric   the customized overlay
+   * @param sources  the seeds of the origin
+   * @param targets  the seeds of the destination
+   * @return the edges of the path, empty if there is none or it passes the last edge of a complex
+   *         restriction, which only the regular searches can tell is allowed
+   */
+  std::vector<baldr::GraphId> Route(const OverlayMetric& metric,
+                                    const std::vector<overlay_seed_t>& sources,
+                                    const std::vector<overlay_seed_t>& targets);
+
+  /**
+   * Finds the cheapest paths from a source to all targets.
+   * @param metric   the customized overlay
+   * @param source   the seeds of the source
+   * @param targets  the seeds of every target
+   * @return the costs to every target, unreached for those there is no path to, restricted for
+   *         those whose path passes the last edge of a complex restriction
+   */
+  std::vector<overlay_cost_t> OneToMany(const OverlayMetric& metric,
+                                        const std::vector<overlay_seed_t>& source,
+                                        const std::vector<std::vector<overlay_seed_t>>& targets);
+
+  /**
+   * Set a callback that will throw when the search should be aborted.
+   */
+  void set_interrupt(const std::function<void()>* interrupt) {
+    interrupt_ = interrupt;
+  }
+
+  /**
+   * Clear the temporary information of the searches.
+   */
+  void Clear();
+
+protected:
+  // how a node was reached: from which node and whether through a cell or along an arc
+  struct label_t {
+    overlay_cost_t cost;
+    uint32_t pred;
+    int8_t level;
+  };
+
+  struct direction_t {
+    ankerl::unordered_dense::map<uint32_t, label_t> labels;
+    std::vector<std::pair<float, uint32_t>> queue;
+  };
+
+  // restricts the search to the regular graph within the cells of the seeds
+  void Pin(const std::vector<overlay_seed_t>& seeds);
+
+  // the level of the cells the search jumps across at a node, 0 for the regular graph
+  uint32_t QueryLevel(uint32_t node) const;
+
+  // pops the cheapest label that is still current, returns false once there is none
+  bool Pop(direction_t& direction, uint32_t& node, label_t& label);
+
+  template <bool forward, typename relax_t>
+  void Expand(const OverlayMetric& metric, uint32_t node, const label_t& label, const relax_t& relax);
+
+  // appends the nodes after from up to and including to along a path through a cell
+  void Unpack(const OverlayMetric& metric,
+              uint32_t level,
+              uint32_t from,
+              uint32_t to,
+              std::vector<uint32_t>& nodes) const;
+
+  struct cached_metric_t {
+    size_t hash;
+    std::string key;
+    std::shared_ptr<const OverlayMetric> metric;
+  };
+
+  // the overlay of a file and its customizations, shared by the searches of all workers
+  struct shared_t {
+    // waits for the customization under way, if any
+    ~shared_t();
+
+    // the cached customization of the key, nullptr if there is none
+    std::shared_ptr<const OverlayMetric> Cached(const std::string& key, const size_t hash);
+
+    // caches a customization, dropping the least recently used beyond max_cached_metrics
+    void Cache(std::string key, const size_t hash, std::shared_ptr<const OverlayMetric> metric);
+
+    std::unique_ptr<baldr::PartitionOverlay> overlay;
+    size_t max_cached_metrics;
+    // most recently used first
+    std::list<cached_metric_t> metrics;
+    std::mutex metrics_mutex;
+    // only touched by the search that set customizing
+    std::thread customizer;
+    std::atomic<bool> customizing{false};
+  };
+
+  // the shared state of a file, mapping the overlay if no search has it yet, nullptr if the file
+  // can't be used
+  static std::shared_ptr<shared_t> Share(const std::string& file, size_t max_cached_metrics);
+
+  std::shared_ptr<shared_t> shared_;
+  // the overlay of the shared state, nullptr if there is none
+  const baldr::PartitionOverlay* overlay_;
+  uint32_t concurrency_;
+  size_t max_cached_metrics_;
+  bool customize_in_background_;
+  boost::property_tree::ptree reader_config_;
+
+  // cells with a seed in them, by level
+  std::vector<std::vector<uint32_t>> pinned_;
+  direction_t forward_;
+  direction_t reverse_;
+  const std::function<void()>* interrupt_;
+};
+
+} // namespace thor
+} // namespace valhalla
+
+#endif // VALHALLA_THOR_OVERLAY_H_
@@ -0,0 +1,79 @@
+#ifndef VALHALLA_THOR_OVERLAYMATRIX_H_
+#define VALHALLA_THOR_OVERLAYMATRIX_H_
+
+#include <valhalla/baldr/graphreader.h>
+#include <valhalla/proto/options.pb.h>
+#include <valhalla/proto_conversions.h>
+#include <valhalla/sif/dynamiccost.h>
+#include <valhalla/thor/matrixalgorithm.h>
+#include <valhalla/thor/overlay.h>
+
+#include <string>
+
+namespace valhalla {
+namespace thor {
+
+/**
+ * Many-to-many matrix on the partition overlay built by mjolnir. The overlay is customized for the
+ * costing options of the request, or the customization is taken from the cache, and every source
+ * runs one search that jumps across the cells without a location in them until it has found all
+ * targets.
+ *
+ * Unlike the contraction hierarchies this works for any costing options, but still not with a
+ * time or live traffic, see Supports.
+ */
+class OverlayMatrix : public MatrixAlgorithm {
+public:
+  /**
+   * Constructor.
+   * @param config   A config object of key, value pairs
+   * @param overlay  the searches on the overlay, shared with the routes of the worker
+   */
+  OverlayMatrix(const boost::property_tree::ptree& config, OverlaySearch& overlay);
+
+  /**
+   * Whether the request can be answered on the overlay: there is one customized for its costing
+   * options, there is no time or live traffic and no shape is requested. Has to be called after
+   * set_has_time.
+   * @param request      the request
+   * @param graphreader  to know about live traffic
+   * @param costing      the costing of the request
+   */
+  bool Supports(const Api& request,
+                baldr::GraphReader& graphreader,
+                const sif::DynamicCost& costing) const;
+
+  /**
+   * Forms a time distance matrix from the set of source locations
+   * to the set of target locations.
+   * @param  request               the full request
+   * @param  graphreader           Graph reader for accessing routing graph.
+   * @param  mode_costing          Costing methods.
+   * @param  mode                  Travel mode to use.
+   * @param  max_matrix_distance   Maximum arc-length distance for current mode.
+   * @return whether every connection was found
+   */
+  bool SourceToTarget(Api& request,
+                      baldr::GraphReader& graphreader,
+                      const sif::mode_costing_t& mode_costing,
+                      const sif::travel_mode_t mode,
+                      const float max_matrix_distance) override;
+
+  /**
+   * Clear the temporary information generated during time+distance
+   * matrix construction.
+   */
+  void Clear() override;
+
+  inline const std::string& name() override {
+    return MatrixAlgoToString(Matrix::Overlay);
+  }
+
+protected:
+  OverlaySearch& overlay_;
+};
+
+} // namespace thor
+} // namespace valhalla
+
+#endif // VALHALLA_THOR_OVERLAYMATRIX_H_
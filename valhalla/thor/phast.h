@@ -0,0 +1,104 @@
+#ifndef VALHALLA_THOR_PHAST_H_
+#define VALHALLA_THOR_PHAST_H_
+
+#include <valhalla/baldr/contraction_hierarchy.h>
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace valhalla {
+namespace thor {
+
+// how many sources one sweep goes down the hierarchy for, one bit each of a restricted mask
+constexpr uint32_t kPhastLanes = 8;
+
+constexpr float kPhastUnreached = std::numeric_limits<float>::infinity();
+
+// cost, time and distance from every source of a sweep to a node, a lane per source. Whether the
+// paths pass the end of a complex restriction is kept apart in a bit per lane, see PhastSweep::Run
+struct alignas(32) phast_label_t {
+  float cost[kPhastLanes];
+  float secs[kPhastLanes];
+  float length[kPhastLanes];
+};
+
+// a node to start from with the cost, time and distance of getting onto it
+struct phast_seed_t {
+  uint32_t node;
+  float cost;
+  float secs;
+  float length;
+};
+
+/**
+ * One to all searches on a contraction hierarchy (PHAST). An upward search from the seeds of every
+ * source settles the few nodes above them, then a single pass over all nodes from the highest
+ * ranked to the lowest relaxes the arcs coming down into each. The nodes and their arcs are laid
+ * out in that order so the pass reads memory front to back, and the labels of up to kPhastLanes
+ * sources sit next to each other so every arc is relaxed for all of them at once, with AVX where
+ * the CPU has it.
+ */
+class PhastSweep {
+public:
+  /**
+   * Lays out the nodes of a hierarchy in the order they are swept.
+   * @param hierarchy  the hierarchy, has to outlive the sweep
+   */
+  explicit PhastSweep(const baldr::ContractionHierarchy& hierarchy);
+
+  /**
+   * Computes the cost from up to kPhastLanes sources to every node, or from every node to up to
+   * kPhastLanes targets. Forward labels are the cost up to the end of a node's edge, backward
+   * labels the cost from the end of it.
+   * @param seeds       the seeds of every source or target, a lane each
+   * @param forward     whether the seeds are sources
+   * @param labels      resized to the number of nodes and filled by position, see position
+   * @param restricted  same for whether the path of a lane passes the end of a complex
+   *                    restriction, the bit of the lane is set if so
+   * @param interrupt   called now and then to abort the sweep by throwing
+   */
+  void Run(const std::vector<std::vector<phast_seed_t>>& seeds,
+           const bool forward,
+           std::vector<phast_label_t>& labels,
+           std::vector<uint8_t>& restricted,
+           const std::function<void()>* interrupt = nullptr) const;
+
+  /**
+   * @return where the label of a node is in the labels of a sweep
+   */
+  uint32_t position(const uint32_t node) const {
+    return position_[node];
+  }
+
+  size_t size() const {
+    return position_.size();
+  }
+
+protected:
+  // an arc to a higher ranked node, by the position of that node
+  struct arc_t {
+    uint32_t node : 31;
+    uint32_t restricted : 1;
+    float cost;
+    float secs;
+    float length;
+  };
+
+  // the arcs to higher ranked nodes of every position in one direction
+  struct arcs_t {
+    std::vector<uint64_t> offsets;
+    std::vector<arc_t> arcs;
+  };
+
+  std::vector<uint32_t> position_;
+  arcs_t forward_;
+  arcs_t backward_;
+};
+
+} // namespace thor
+} // namespace valhalla
+
+#endif // VALHALLA_THOR_PHAST_H_
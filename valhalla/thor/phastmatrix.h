@@ -0,0 +1,108 @@
+#ifndef VALHALLA_THOR_PHASTMATRIX_H_
+#define VALHALLA_THOR_PHASTMATRIX_H_
+
+#include <valhalla/baldr/graphreader.h>
+#include <valhalla/proto/api.pb.h>
+#include <valhalla/proto_conversions.h>
+#include <valhalla/sif/dynamiccost.h>
+#include <valhalla/thor/chmatrix.h>
+#include <valhalla/thor/phast.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace valhalla {
+namespace thor {
+
+/**
+ * Many-to-many matrix on the contraction hierarchies that sweeps the whole hierarchy for every
+ * kPhastLanes locations of the smaller side, see PhastSweep, and reads off the costs to the other
+ * side. A sweep costs the same no matter how many locations the other side has, so it only pays
+ * off against the bucket scans of CHMatrix with a lot of them, see thor.phast.min_locations.
+ *
+ * The same sweep answers how much of the network can be reached from the locations of an
+ * isochrone request within every contour.
+ */
+class PhastMatrix : public CHMatrix {
+public:
+  /**
+   * Sweeps the hierarchies of another matrix.
+   * @param config  the thor config
+   * @param other   the matrix with the hierarchies
+   */
+  PhastMatrix(const boost::property_tree::ptree& config, const CHMatrix& other);
+
+  /**
+   * Whether CHMatrix supports the request and it has at least thor.phast.min_locations sources or
+   * targets. Has to be called after set_has_time.
+   * @param request      the request
+   * @param graphreader  Graph reader to check for live traffic
+   * @param costing      the costing of the request
+   */
+  bool Supports(const Api& request,
+                baldr::GraphReader& graphreader,
+                const sif::DynamicCost& costing) const;
+
+  /**
+   * Forms a time distance matrix from the set of source locations
+   * to the set of target locations.
+   * @param  request               the full request
+   * @param  graphreader           Graph reader for accessing routing graph.
+   * @param  mode_costing          Costing methods.
+   * @param  mode                  Travel mode to use.
+   * @param  max_matrix_distance   Maximum arc-length distance for current mode.
+   * @return whether every connection was found
+   */
+  bool SourceToTarget(Api& request,
+                      baldr::GraphReader& graphreader,
+                      const sif::mode_costing_t& mode_costing,
+                      const sif::travel_mode_t mode,
+                      const float max_matrix_distance) override;
+
+  /**
+   * Adds the number and the length of the directed edges that can be traversed completely from
+   * the locations of an isochrone request, or to them in reverse, within every contour to the
+   * isochrone of the request. Complex restrictions are not applied, an edge only reachable by
+   * breaking one is counted as well.
+   * @param  request       the isochrone request
+   * @param  graphreader   Graph reader for accessing routing graph.
+   * @param  mode_costing  Costing methods.
+   * @param  mode          Travel mode to use.
+   * @return false if there is no hierarchy for the request and nothing was added
+   */
+  bool Accessibility(Api& request,
+                     baldr::GraphReader& graphreader,
+                     const sif::mode_costing_t& mode_costing,
+                     const sif::travel_mode_t mode);
+
+  /**
+   * Clear the temporary information generated during time+distance
+   * matrix construction.
+   */
+  void Clear() override;
+
+  inline const std::string& name() override {
+    return MatrixAlgoToString(Matrix::Phast);
+  }
+
+protected:
+  // sets up the hierarchy, the costing and the sweep for a request
+  void Prepare(const Options& options,
+               const sif::mode_costing_t& mode_costing,
+               const sif::travel_mode_t mode);
+
+  uint32_t min_locations_;
+  // the layouts of the hierarchies, made the first time they are needed
+  std::unordered_map<Costing::Type, std::unique_ptr<PhastSweep>> sweeps_;
+  const PhastSweep* sweep_;
+  std::vector<phast_label_t> labels_;
+  std::vector<uint8_t> restricted_;
+};
+
+} // namespace thor
+} // namespace valhalla
+
+#endif // VALHALLA_THOR_PHASTMATRIX_H_
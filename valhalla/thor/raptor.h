@@ -0,0 +1,291 @@
+#ifndef VALHALLA_THOR_RAPTOR_H_
+#define VALHALLA_THOR_RAPTOR_H_
+
+#include <valhalla/baldr/graphid.h>
+#include <valhalla/baldr/graphreader.h>
+#include <valhalla/baldr/transitdeparture.h>
+#include <valhalla/proto/api.pb.h>
+#include <valhalla/sif/dynamiccost.h>
+#include <valhalla/thor/dijkstras.h>
+#include <valhalla/thor/pathalgorithm.h>
+#include <valhalla/thor/pathinfo.h>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace valhalla {
+namespace thor {
+
+/**
+ * The scheduled transit of a set of transit tiles on one service day in flat arrays. The trips
+ * that run along the same transit edges without overtaking each other form a route, the stop
+ * times of its trips are stored one trip after the other so scanning a route reads them in order.
+ */
+struct TransitTimetable {
+  struct route_t {
+    uint32_t first_stop; // index of its first stop in route_stops and route_edges
+    uint32_t stop_count;
+    uint32_t first_trip; // index of its first trip in trips, sorted by departure
+    uint32_t trip_count;
+  };
+  struct trip_t {
+    uint32_t tripid;
+    uint32_t first_time; // index of its first stop time in stop_times and departures
+    uint32_t shift;      // seconds after the departures of the frequency it is an instance of
+  };
+  struct stop_time_t {
+    uint32_t arrival;
+    uint32_t departure;
+  };
+  struct transfer_t {
+    uint32_t to_stop;
+    baldr::GraphId to_station;  // the platform connection from the stop to its station
+    baldr::GraphId to_platform; // the platform connection from the station to the other stop
+  };
+  struct route_stop_t {
+    uint32_t route;
+    uint32_t position;
+  };
+
+  /**
+   * Builds the timetable of the departures of the tiles running on the date.
+   * @param  reader      Graph reader for accessing the transit tiles.
+   * @param  tile_ids    The transit tiles to read the departures of.
+   * @param  date        Days from the pivot date.
+   * @param  dow         Day of week mask of the date.
+   * @param  wheelchair  Only keep the wheelchair accessible departures.
+   * @param  bicycle     Only keep the departures allowing bicycles.
+   */
+  static std::shared_ptr<const TransitTimetable> Build(baldr::GraphReader& reader,
+                                                       const std::vector<baldr::GraphId>& tile_ids,
+                                                       const uint32_t date,
+                                                       const uint32_t dow,
+                                                       const bool wheelchair,
+                                                       const bool bicycle);
+
+  // the platform node of each stop and the stop of each platform node
+  std::vector<baldr::GraphId> stops;
+  std::unordered_map<baldr::GraphId, uint32_t> stop_index;
+  // the routes serving each stop and their position there, stop_routes_begin has one extra entry
+  std::vector<uint32_t> stop_routes_begin;
+  std::vector<route_stop_t> stop_routes;
+  // the stops within the same station each stop can walk to, transfers_begin has one extra entry
+  std::vector<uint32_t> transfers_begin;
+  std::vector<transfer_t> transfers;
+
+  std::vector<route_t> routes;
+  std::vector<uint32_t> route_stops;
+  std::vector<baldr::GraphId> route_edges; // the transit edge leaving each route stop
+  std::vector<trip_t> trips;
+  std::vector<stop_time_t> stop_times;
+  std::vector<const baldr::TransitDeparture*> departures; // the departure of each stop time
+
+  // the transit tiles the departures point into
+  std::vector<baldr::graph_tile_ptr> tiles;
+};
+
+/**
+ * Walks from a location to the transit stops around it, or from them to the location in reverse,
+ * for the access and egress of Raptor.
+ */
+class TransitWalk : public Dijkstras {
+public:
+  /**
+   * Constructor.
+   * @param config  the thor config
+   */
+  explicit TransitWalk(const boost::property_tree::ptree& config = {});
+
+  /**
+   * Walks at most max_distance meters from the location, or to it in reverse.
+   * @param  expansion_type  forward from an origin or reverse from a destination
+   * @param  location        the location to walk from or to
+   * @param  timetable       the stops to find
+   * @param  reader          Graph reader for accessing routing graph.
+   * @param  mode_costing    Costing methods.
+   * @param  max_distance    the farthest to walk in meters
+   * @param  destination     walking forward, the destination to walk to directly if close enough
+   */
+  void Walk(const ExpansionType expansion_type,
+            valhalla::Location& location,
+            const TransitTimetable& timetable,
+            baldr::GraphReader& reader,
+            const sif::mode_costing_t& mode_costing,
+            const uint32_t max_distance,
+            const valhalla::Location* destination = nullptr);
+
+  /**
+   * Forms the walk to or from the label.
+   * @param  label   the label reaching a stop or the destination
+   * @return the labels of the path edges from its start to its end
+   */
+  std::vector<uint32_t> Labels(const uint32_t label) const;
+
+  const sif::BDEdgeLabel& label(const uint32_t index) const {
+    return bdedgelabels_[index];
+  }
+
+  // the label reaching each stop in walking distance
+  const std::unordered_map<uint32_t, uint32_t>& stops() const {
+    return stops_;
+  }
+
+  // the label walking to the destination directly and the part of its edge past the destination
+  uint32_t destination_label() const {
+    return destination_label_;
+  }
+  const sif::Cost& destination_remainder() const {
+    return destination_remainder_;
+  }
+
+  /**
+   * Resets internal state before the next call
+   */
+  virtual void Clear() override;
+
+protected:
+  virtual void ExpandingNode(baldr::GraphReader&,
+                             baldr::graph_tile_ptr,
+                             const baldr::NodeInfo*,
+                             const sif::EdgeLabel&,
+                             const sif::EdgeLabel*) override {
+  }
+
+  // Records the stops and the destination, walks no further than a stop or max_distance_
+  virtual ExpansionRecommendation ShouldExpand(baldr::GraphReader& reader,
+                                               const sif::EdgeLabel& pred,
+                                               const ExpansionType route_type) override;
+
+  virtual void GetExpansionHints(uint32_t& bucket_count,
+                                 uint32_t& edge_label_reservation) const override;
+
+  const TransitTimetable* timetable_;
+  uint32_t max_distance_;
+  bool forward_;
+  std::unordered_map<uint32_t, uint32_t> stops_;
+  // the cost from the destination to the end of each of its edges
+  std::unordered_map<baldr::GraphId, sif::Cost> destinations_;
+  uint32_t destination_label_;
+  sif::Cost destination_remainder_;
+};
+
+/**
+ * Round based public transit routing (RAPTOR, Delling et al.) over a TransitTimetable. Round k
+ * scans every route serving a stop improved in round k - 1 once, so a round costs a pass over the
+ * stop times of those routes instead of a time dependent expansion of the transit graph. The
+ * arrivals of each round are the best with k boardings, which makes the result the Pareto set of
+ * arrival time and transfers. Access and egress walk the pedestrian graph with a TransitWalk from
+ * the origin and to the destination.
+ *
+ * The timetable of the transit tiles around the origin and destination is built for the service
+ * day of the request and kept for the next request with the same tiles, day and accessibility.
+ */
+class Raptor : public PathAlgorithm {
+public:
+  /**
+   * Constructor.
+   * @param config  the thor config
+   */
+  explicit Raptor(const boost::property_tree::ptree& config = {});
+
+  /**
+   * Finds the transit paths between the origin and the destination.
+   * @param  origin        Origin location, needs a date_time
+   * @param  dest          Destination location
+   * @param  graphreader   Graph reader for accessing routing graph.
+   * @param  mode_costing  Costing methods, pedestrian and transit are used.
+   * @param  mode          Travel mode from the origin.
+   * @param  options       The request options.
+   * @return the cheapest path first, followed by up to options.alternates() paths trading arrival
+   *         time for fewer transfers
+   */
+  std::vector<std::vector<PathInfo>>
+  GetBestPath(valhalla::Location& origin,
+              valhalla::Location& dest,
+              baldr::GraphReader& graphreader,
+              const sif::mode_costing_t& mode_costing,
+              const sif::TravelMode mode,
+              const Options& options = Options::default_instance()) override;
+
+  /**
+   * Returns the name of the algorithm
+   * @return the name of the algorithm
+   */
+  virtual const char* name() const override {
+    return "raptor";
+  }
+
+  /**
+   * Clear the temporary information generated during path construction.
+   */
+  void Clear() override;
+
+protected:
+  // the arrival at a stop in a round and the ride getting there
+  struct arrival_t {
+    uint32_t time;
+    uint32_t route;
+    uint32_t trip;
+    uint32_t board;  // position of the boarding stop on the route
+    uint32_t alight; // position of this stop on the route
+  };
+  // the earliest time to board at a stop in a round and how it was reached
+  struct ready_t {
+    uint32_t time;
+    uint32_t from;     // the stop of the arrival, or the access label in round 0
+    uint32_t transfer; // the transfer walked from that stop, kInvalidLabel if there was none
+  };
+  // the best arrival at the destination in a round
+  struct journey_t {
+    uint32_t round;
+    uint32_t stop; // the stop walked to the destination from, kInvalidLabel when walking only
+  };
+
+  // builds or reuses the timetable of the tiles around the origin and destination
+  void LoadTimetable(const valhalla::Location& origin,
+                     const valhalla::Location& dest,
+                     baldr::GraphReader& graphreader,
+                     const sif::cost_ptr_t& tc);
+
+  // the seconds to walk a transfer
+  uint32_t TransferTime(const uint32_t transfer,
+                        baldr::GraphReader& graphreader,
+                        const sif::cost_ptr_t& pc);
+
+  // forms the path of a journey with its walks, rides and transfers
+  std::vector<PathInfo> FormPath(const journey_t& journey,
+                                 baldr::GraphReader& graphreader,
+                                 const sif::cost_ptr_t& pc,
+                                 const sif::cost_ptr_t& tc) const;
+
+  uint32_t max_rounds_;
+  uint32_t start_time_;
+
+  std::shared_ptr<const TransitTimetable> timetable_;
+  std::vector<baldr::GraphId> timetable_tiles_;
+  uint32_t timetable_date_;
+  uint32_t timetable_dow_;
+  bool timetable_wheelchair_;
+  bool timetable_bicycle_;
+
+  TransitWalk access_;
+  TransitWalk egress_;
+
+  // per round and stop, round r of stop s at r * stops + s
+  std::vector<arrival_t> arrivals_;
+  std::vector<ready_t> readies_;
+  std::vector<uint32_t> best_arrival_;
+  std::vector<uint32_t> best_ready_;
+  std::vector<uint32_t> transfer_times_;
+  std::vector<bool> excluded_stops_;
+  std::vector<bool> excluded_routes_;
+};
+
+} // namespace thor
+} // namespace valhalla
+
+#endif // VALHALLA_THOR_RAPTOR_H_
@@ -0,0 +1,133 @@
+#ifndef VALHALLA_THOR_ROUTETREE_H_
+#define VALHALLA_THOR_ROUTETREE_H_
+
+#include <valhalla/baldr/graphid.h>
+#include <valhalla/baldr/graphreader.h>
+#include <valhalla/proto/api.pb.h>
+#include <valhalla/sif/dynamiccost.h>
+#include <valhalla/thor/dijkstras.h>
+#include <valhalla/thor/pathinfo.h>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace valhalla {
+namespace thor {
+
+/**
+ * Routes a batch of locations to one shared location, or from it to them, with a single shortest
+ * path tree. A reverse tree grows from a shared destination and a forward tree from a shared
+ * origin until it has settled the candidate edges of every other location, then the path of each
+ * of them is walked back along the labels and recosted. N routes cost one expansion and N walks
+ * instead of N searches.
+ *
+ * The tree stops at thor.route_tree.max_stretch times the distance to the farthest location and
+ * leaves out the locations farther than thor.route_tree.max_distance from the shared one. Those,
+ * the locations the tree did not reach and the ones on the edge of the shared location but behind
+ * it get an empty path and have to be routed on their own.
+ */
+class RouteTree : public Dijkstras {
+public:
+  /**
+   * Constructor.
+   * @param config  the thor config
+   */
+  explicit RouteTree(const boost::property_tree::ptree& config = {});
+
+  /**
+   * Finds the path between the shared location and every other location.
+   * @param  expansion_type  forward from a shared origin or reverse from a shared destination
+   * @param  shared          the location all paths start or end at
+   * @param  others          the locations at the other end of the paths
+   * @param  options         the request options
+   * @param  reader          Graph reader for accessing routing graph.
+   * @param  mode_costing    Costing methods.
+   * @param  mode            Travel mode to use.
+   * @return one path per other location from the origin to the destination, empty if the tree
+   *         did not find it
+   */
+  std::vector<std::vector<PathInfo>>
+  Paths(const ExpansionType expansion_type,
+        valhalla::Location& shared,
+        const google::protobuf::RepeatedPtrField<valhalla::Location>& others,
+        const Options& options,
+        baldr::GraphReader& reader,
+        const sif::mode_costing_t& mode_costing,
+        const sif::TravelMode mode);
+
+  /**
+   * Resets internal state before the next call
+   */
+  virtual void Clear() override;
+
+protected:
+  virtual void ExpandingNode(baldr::GraphReader&,
+                             baldr::graph_tile_ptr,
+                             const baldr::NodeInfo*,
+                             const sif::EdgeLabel&,
+                             const sif::EdgeLabel*) override {
+  }
+
+  /**
+   * Checks whether the settled edge is a candidate edge of another location and stops the tree
+   * once every location has its path or the tree grew too far.
+   */
+  virtual ExpansionRecommendation ShouldExpand(baldr::GraphReader& reader,
+                                               const sif::EdgeLabel& pred,
+                                               const ExpansionType route_type) override;
+
+  virtual void GetExpansionHints(uint32_t& bucket_count,
+                                 uint32_t& edge_label_reservation) const override;
+
+  // the cost from or to the other location through the label of one of its candidate edges, false
+  // if the label can't reach it
+  bool CostThrough(const sif::BDEdgeLabel& label,
+                   const valhalla::PathEdge& candidate,
+                   float& cost) const;
+
+  // walks the labels back from the best candidate of another location and recosts its path
+  std::vector<PathInfo> FormPath(const valhalla::Location& other,
+                                 const uint32_t other_index,
+                                 const Options& options,
+                                 baldr::GraphReader& reader,
+                                 const baldr::TimeInfo& time_info) const;
+
+  float max_distance_;
+  float max_stretch_;
+
+  // the locations at the other ends of the paths waiting on the tree to settle their edges
+  struct target_t {
+    uint32_t pending;    // candidate edges not yet settled
+    float best_cost;     // cheapest cost through a settled candidate
+    float max_edge_cost; // the most a partial candidate edge can take off a label
+    uint32_t best_label; // the label of the best candidate
+    int best_candidate;  // the index of the best candidate of the location
+    bool done;           // no candidate can get cheaper anymore
+  };
+  std::vector<target_t> targets_;
+  uint32_t remaining_;
+  // the best cost of a location plus its max_edge_cost, once the tree settles labels past it the
+  // location is done
+  std::priority_queue<std::pair<float, uint32_t>,
+                      std::vector<std::pair<float, uint32_t>>,
+                      std::greater<std::pair<float, uint32_t>>>
+      bounds_;
+  // the location and candidate index of every candidate edge, keyed by the edge the tree settles
+  std::unordered_map<uint64_t, std::vector<std::pair<uint32_t, int>>> target_edges_;
+  // the percent along and the score of the shared location on each of its edges
+  std::unordered_map<uint64_t, std::pair<float, float>> shared_edges_;
+  const google::protobuf::RepeatedPtrField<valhalla::Location>* others_;
+  bool forward_;
+  float max_path_distance_;
+};
+
+} // namespace thor
+} // namespace valhalla
+
+#endif // VALHALLA_THOR_ROUTETREE_H_
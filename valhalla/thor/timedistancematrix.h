@@ -1,10 +1,11 @@
 #ifndef VALHALLA_THOR_TIMEDISTANCEMATRIX_H_
 #define VALHALLA_THOR_TIMEDISTANCEMATRIX_H_
 
-#include <valhalla/baldr/double_bucket_queue.h>
+#include <valhalla/baldr/label_queue.h>
 #include <valhalla/baldr/graphid.h>
 #include <valhalla/baldr/graphreader.h>
 #include <valhalla/exceptions.h>
+#include <valhalla/midgard/arena.h>
 #include <valhalla/proto_conversions.h>
 #include <valhalla/sif/dynamiccost.h>
 #include <valhalla/sif/edgelabel.h>
@@ -13,6 +14,8 @@
 #include <valhalla/thor/pathalgorithm.h>
 
 #include <cstdint>
+#include <memory>
+#include <memory_resource>
 #include <unordered_map>
 #include <vector>
 
@@ -25,8 +28,11 @@ public:
   /**
    * Default constructor. Most internal values are set when a query is made so
    * the constructor mainly just sets some internals to a default empty value.
+   * @param config  A config object of key, value pairs
+   * @param arena   Request arena to allocate the edge labels from, nullptr for the heap
    */
-  TimeDistanceMatrix(const boost::property_tree::ptree& config = {});
+  TimeDistanceMatrix(const boost::property_tree::ptree& config = {},
+                     std::pmr::memory_resource* arena = nullptr);
 
   /**
    * Forms a time distance matrix from the set of source locations
@@ -56,6 +62,21 @@ public:
 
     const bool forward_search =
         request.options().sources().size() <= request.options().targets().size();
+    // a profile answers every departure from the date_time of the sources, which needs a time
+    // dependent forward search
+    const auto date_time_type = request.options().date_time_type();
+    profile_ = request.options().profile_departures() > 1;
+    if (profile_ && (!has_time_ || !forward_search || date_time_type == Options::arrive_by ||
+                     date_time_type == Options::invariant)) {
+      add_warning(request, 217);
+      profile_ = false;
+    }
+    if (profile_) {
+      const auto size = request.options().sources().size() * request.options().targets().size() *
+                        request.options().profile_departures();
+      request.mutable_matrix()->mutable_profile_times()->Resize(size, kMaxCost);
+      request.mutable_matrix()->mutable_profile_distances()->Resize(size, 0U);
+    }
     if (forward_search) {
       return ComputeMatrix<ExpansionType::forward>(request, graphreader, max_matrix_distance);
     } else {
@@ -69,15 +90,36 @@ public:
    */
   inline void Clear() override {
     auto reservation = clear_reserved_memory_ ? 0 : max_reserved_labels_count_;
-    if (edgelabels_.size() > reservation) {
+    if (!arena_ && edgelabels_.size() > reservation) {
       edgelabels_.resize(reservation);
       edgelabels_.shrink_to_fit();
     }
     reset();
     destinations_.clear();
     dest_edges_.clear();
+    if (clear_reserved_memory_) {
+      label_lanes_ = {};
+    }
+    for (auto& worker : workers_) {
+      worker->Clear();
+    }
+    for (auto& reader : readers_) {
+      if (reader->OverCommitted()) {
+        reader->Trim();
+      }
+    }
   };
 
+  /**
+   * Drops the edge labels allocated from the request arena, must be called before the arena is
+   * released at the end of the request.
+   */
+  inline void ReleaseArena() {
+    if (arena_) {
+      midgard::release_memory(edgelabels_);
+    }
+  }
+
   /**
    * Get the algorithm's name
    * @return the name of the algorithm
@@ -86,6 +128,15 @@ public:
     return MatrixAlgoToString(Matrix::TimeDistanceMatrix);
   }
 
+  /**
+   * Sets the config of the graph readers for the threads which search from the origins if
+   * timedistancematrix.concurrency is more than 1, without it they run on one thread.
+   * @param mjolnir  the mjolnir config
+   */
+  void set_reader_config(const boost::property_tree::ptree& mjolnir) {
+    reader_config_ = mjolnir;
+  }
+
 protected:
   // Number of destinations that have been found and settled (least cost path
   // computed).
@@ -106,11 +157,14 @@ protected:
   // has a vector of indexes into the destinations vector
   std::unordered_map<uint64_t, std::vector<uint32_t>> dest_edges_;
 
+  // Request arena the edge labels come from, if any
+  std::pmr::memory_resource* arena_;
+
   // Vector of edge labels (requires access by index).
-  std::vector<sif::EdgeLabel> edgelabels_;
+  std::pmr::vector<sif::EdgeLabel> edgelabels_;
 
   // Adjacency list - approximate double bucket sort
-  baldr::DoubleBucketQueue<sif::EdgeLabel> adjacencylist_;
+  baldr::LabelQueue<sif::EdgeLabel, std::pmr::vector<sif::EdgeLabel>> adjacencylist_;
 
   // Edge status. Mark edges that are in adjacency list or settled.
   EdgeStatus edgestatus_;
@@ -120,6 +174,34 @@ protected:
   // when doing timezone differencing a timezone cache speeds up the computation
   baldr::DateTime::tz_sys_info_cache_t tz_cache_;
 
+  // Number of threads searching from the origins, the labels, edge status and destinations of the
+  // threads other than the calling one and their graph readers
+  uint32_t concurrency_;
+  boost::property_tree::ptree worker_config_;
+  boost::property_tree::ptree reader_config_;
+  std::vector<std::unique_ptr<TimeDistanceMatrix>> workers_;
+  std::vector<std::unique_ptr<baldr::GraphReader>> readers_;
+
+  // the cost and distance to the end of the edge of a label, or to a destination, for one
+  // departure of a profile and the time the edge was entered at
+  struct profile_lane_t {
+    sif::Cost cost;
+    uint32_t distance;
+    float start_secs;
+  };
+
+  // Whether the request asks for a profile, how many of its departures one search answers, the
+  // departures of the current search and their lanes of every edge label and destination, at
+  // label * departures + departure
+  bool profile_;
+  uint32_t profile_lanes_;
+  std::vector<baldr::TimeInfo> departures_;
+  std::vector<profile_lane_t> label_lanes_;
+  std::vector<profile_lane_t> dest_lanes_;
+  // the lanes of the edge being relaxed and the times at the node it is relaxed from
+  std::vector<profile_lane_t> edge_lanes_;
+  std::vector<baldr::TimeInfo> node_times_;
+
   /**
    * Reset all origin-specific information
    */
@@ -137,6 +219,8 @@ protected:
 
     // Clear the edge status flags
     edgestatus_.clear();
+
+    label_lanes_.clear();
   };
 
   /**
@@ -147,6 +231,83 @@ protected:
             const bool FORWARD = expansion_direction == ExpansionType::forward>
   bool ComputeMatrix(Api& request, baldr::GraphReader& graphreader, const float max_matrix_distance);
 
+  /**
+   * Searches from one origin and fills in its row or column of the matrix, with the labels and
+   * destinations of this instance.
+   * @param  options              the request options
+   * @param  matrix               the matrix to fill in
+   * @param  graphreader          Graph reader for accessing routing graph.
+   * @param  origin_index         the index of the source or target to search from
+   * @param  time_info            the time info of the origin
+   * @param  max_matrix_distance  Maximum arc-length distance for current mode.
+   * @param  invariant            Whether invariant time was requested.
+   * @param  matrix_locations     Count of locations that must be found.
+   */
+  template <const ExpansionType expansion_direction,
+            const bool FORWARD = expansion_direction == ExpansionType::forward>
+  void ComputeOrigin(const valhalla::Options& options,
+                     valhalla::Matrix& matrix,
+                     baldr::GraphReader& graphreader,
+                     const int origin_index,
+                     const baldr::TimeInfo& time_info,
+                     const float max_matrix_distance,
+                     const bool invariant,
+                     const uint32_t matrix_locations);
+
+  /**
+   * Searches forward from one source for every departure of the profile of the request and fills
+   * in the profile of its row of the matrix, the first departure also fills in the row itself.
+   * Every departure is a lane of cost and distance on each edge label that is relaxed at the time
+   * of that departure, so the piecewise travel times from the speed buckets are followed for all
+   * of them in one expansion. A label is queued by the least of its lanes that got cheaper and
+   * reopened when any of them does, the cheapest lane decides its predecessor. Up to
+   * thor.timedistancematrix.profile_lanes departures share a search, more take several.
+   * @param  options              the request options
+   * @param  matrix               the matrix to fill in
+   * @param  graphreader          Graph reader for accessing routing graph.
+   * @param  origin_index         the index of the source to search from
+   * @param  time_info            the time info of the source
+   * @param  max_matrix_distance  Maximum arc-length distance for current mode.
+   */
+  void ComputeProfile(const valhalla::Options& options,
+                      valhalla::Matrix& matrix,
+                      baldr::GraphReader& graphreader,
+                      const int origin_index,
+                      const baldr::TimeInfo& time_info,
+                      const float max_matrix_distance);
+
+  /**
+   * Relaxes the edges leaving a node for every lane of the predecessor, immediately expands from
+   * the end node of any transition edge like Expand.
+   * @param  graphreader      Graph tile reader.
+   * @param  node             Graph Id of the node being expanded.
+   * @param  pred_idx         Predecessor index into the EdgeLabel list.
+   * @param  from_transition  True if this method is called from a transition edge.
+   */
+  void ExpandProfile(baldr::GraphReader& graphreader,
+                     const baldr::GraphId& node,
+                     const uint32_t pred_idx,
+                     const bool from_transition);
+
+  /**
+   * Updates the lanes of the destinations along the edge of a label that is expanded.
+   * @param  origin        Location of the origin.
+   * @param  locations     List of locations.
+   * @param  destinations  Vector of destination indexes along this edge.
+   * @param  reader        Graph reader for accessing routing graph.
+   * @param  pred_idx      Index of the label of the edge.
+   * @param  edge_ids      the edges the destinations were reached on, by destination
+   * @return the cost past which no departure gets cheaper to any destination, once every
+   *         departure reached all of them
+   */
+  float
+  UpdateProfileDestinations(const valhalla::Location& origin,
+                            const google::protobuf::RepeatedPtrField<valhalla::Location>& locations,
+                            const std::vector<uint32_t>& destinations,
+                            baldr::GraphReader& reader,
+                            const uint32_t pred_idx,
+                            std::unordered_map<uint32_t, baldr::GraphId>& edge_ids);
+
   /**
    * Expand from the node along the forward search path. Immediately expands
    * from the end node of any transition edge (so no transition edges are added
@@ -260,13 +421,15 @@ protected:
   /**
    * Form a time/distance matrix from the results.
    *
-   * @param request   The full request object
+   * @param options   The request options
+   * @param matrix    The matrix to fill in
    * @param reader    GraphReader instance
    * @param origin_dt The origin's date_time string
    * @param origin_tz The origin's timezone index
    * @param pred_id   The destination edge's GraphId
    */
-  void FormTimeDistanceMatrix(Api& request,
+  void FormTimeDistanceMatrix(const valhalla::Options& options,
+                              valhalla::Matrix& matrix,
                               baldr::GraphReader& reader,
                               const bool forward,
                               const uint32_t origin_index,
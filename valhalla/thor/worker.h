@@ -1,6 +1,7 @@
 #ifndef __VALHALLA_THOR_SERVICE_H__
 #define __VALHALLA_THOR_SERVICE_H__
 
+#include <valhalla/baldr/alt_landmarks.h>
 #include <valhalla/baldr/attributes_controller.h>
 #include <valhalla/baldr/graphreader.h>
 #include <valhalla/exceptions.h>
@@ -11,17 +12,26 @@
 #include <valhalla/sif/costfactory.h>
 #include <valhalla/thor/bidirectional_astar.h>
 #include <valhalla/thor/centroid.h>
+#include <valhalla/thor/chmatrix.h>
 #include <valhalla/thor/costmatrix.h>
 #include <valhalla/thor/isochrone.h>
+#include <valhalla/thor/matrixcache.h>
 #include <valhalla/thor/multimodal_astar.h>
 #include <valhalla/thor/multimodal_transit.h>
+#include <valhalla/thor/overlay.h>
+#include <valhalla/thor/overlaymatrix.h>
+#include <valhalla/thor/phastmatrix.h>
+#include <valhalla/thor/raptor.h>
+#include <valhalla/thor/routetree.h>
 #include <valhalla/thor/timedistancebssmatrix.h>
 #include <valhalla/thor/timedistancematrix.h>
 #include <valhalla/thor/unidirectional_astar.h>
 #include <valhalla/worker.h>
 
-#include <boost/property_tree/ptree_fwd.hpp>
+#include <boost/property_tree/ptree.hpp>
 
+#include <chrono>
+#include <memory>
 #include <tuple>
 #include <vector>
 
@@ -76,6 +86,10 @@ protected:
                                           Api& request);
   thor::MatrixAlgorithm*
   get_matrix_algorithm(Api& request, const bool has_time, const std::string& costing);
+  // computes the matrix of the request with the algorithm that suits it
+  void compute_matrix(Api& request, const std::string& costing);
+  // computes a CostMatrix too large for thor.costmatrix.max_block_locations block by block
+  void costmatrix_blocks(Api& request, const float max_matrix_distance);
   void route_match(Api& request);
   /**
    * Returns the results of the map match where the first float is the normalized
@@ -88,6 +102,8 @@ protected:
 
   void path_arrive_by(Api& api, const std::string& costing);
   void path_depart_at(Api& api, const std::string& costing);
+  bool path_depart_at_concurrently(Api& api, const std::string& costing);
+  void path_batch(Api& api, const std::string& costing);
   void parse_measurements(const Api& request);
   std::string parse_costing(const Api& request);
 
@@ -110,10 +126,17 @@ protected:
   sif::CostFactory factory;
   sif::mode_costing_t mode_costing;
 
+  // Searches on the partition overlay, shared by routes and matrices
+  OverlaySearch overlay_;
+
+  // Landmark distances for the ALT heuristics, if mjolnir built them
+  std::unique_ptr<baldr::AltLandmarks> alt_landmarks_;
+
   // Path algorithms (TODO - perhaps use a map?))
   BidirectionalAStar bidir_astar;
   MultimodalAStar multimodal_astar;
   MultiModalPathAlgorithm multi_modal_transit;
+  Raptor raptor;
   TimeDepForward timedep_forward;
   TimeDepReverse timedep_reverse;
 
@@ -121,13 +144,25 @@ protected:
   CostMatrix costmatrix_;
   TimeDistanceMatrix time_distance_matrix_;
   TimeDistanceBSSMatrix time_distance_bss_matrix_;
+  CHMatrix ch_matrix_;
+  PhastMatrix phast_matrix_;
+  OverlayMatrix overlay_matrix_;
+  // the connections of earlier matrix requests, see thor.matrix_cache
+  MatrixCache matrix_cache_;
 
   Isochrone isochrone_gen;
+  // one shortest path tree for the routes of a batch
+  RouteTree route_tree_;
   std::shared_ptr<meili::MapMatcher> matcher;
   float max_timedep_distance;
   std::unordered_map<std::string, float> max_matrix_distance;
   SOURCE_TO_TARGET_ALGORITHM source_to_target_algorithm;
   bool costmatrix_allow_second_pass;
+  uint32_t costmatrix_max_block_locations;
+  uint32_t isochrone_concurrency;
+  uint32_t optimizer_concurrency;
+  uint32_t route_concurrency;
+  std::chrono::milliseconds optimizer_time_budget;
   std::shared_ptr<baldr::GraphReader> reader;
   meili::MapMatcherFactory matcher_factory;
   baldr::AttributesController controller;
@@ -143,6 +178,18 @@ protected:
   double min_linear_cost_factor;
   uint64_t max_linear_cost_edges;
 
+  // The path algorithms, costing and graph reader of a thread other than the calling one which
+  // routes the legs between break locations of a route, see thor.route.concurrency
+  struct leg_worker_t {
+    explicit leg_worker_t(const boost::property_tree::ptree& config);
+    BidirectionalAStar bidir_astar;
+    TimeDepForward timedep_forward;
+    baldr::GraphReader reader;
+    sif::mode_costing_t mode_costing;
+  };
+  boost::property_tree::ptree leg_worker_config_;
+  std::vector<std::unique_ptr<leg_worker_t>> leg_workers_;
+
 private:
   std::string service_name() const override {
     return "thor";
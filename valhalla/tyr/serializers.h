@@ -40,10 +40,12 @@ std::string serializeMatrix(Api& request);
  *
  * @param grid_contours    the contours generated from the grid
  * @param colors           the #ABC123 hex string color used in geojson fill color
+ * @param concurrency      number of threads generating the contours
  */
 std::string serializeIsochrones(Api& request,
                                 std::vector<midgard::GriddedData<2>::contour_interval_t>& intervals,
-                                const std::shared_ptr<const midgard::GriddedData<2>>& isogrid);
+                                const std::shared_ptr<const midgard::GriddedData<2>>& isogrid,
+                                const uint32_t concurrency = 1);
 /**
  * Write GeoJSON from expansion pbf
  */
@@ -70,6 +72,15 @@ std::string serializeHeight(const Api& request,
  */
 std::string serializeLocate(const Api& request, baldr::GraphReader& reader);
 
+/**
+ * Same as above but as newline delimited json, one object per location and line, so that the output
+ * of consecutive requests can simply be concatenated
+ *
+ * @param request      The original request with correlated locations
+ * @param reader       A graph reader to get at each correlated points info
+ */
+std::string serializeLocateLines(const Api& request, baldr::GraphReader& reader);
+
 /**
  * Turn a list of locations into a list of locations with a bool that says whether transit tiles are
  * near by
@@ -1,6 +1,7 @@
 #ifndef __VALHALLA_WORKER_H__
 #define __VALHALLA_WORKER_H__
 #include <valhalla/exceptions.h>
+#include <valhalla/midgard/arena.h>
 #include <valhalla/midgard/util.h>
 #include <valhalla/proto/api.pb.h>
 #include <valhalla/sif/dynamiccost.h>
@@ -92,6 +93,7 @@ const content_type PBF_MIME{"Content-type", "application/x-protobuf"};
 const content_type GPX_MIME{"Content-type", "application/gpx+xml;charset=utf-8"};
 const content_type TIFF_MIME("Content-type", "image/tiff");
 const content_type MVT_MIME("Content-type", "application/vnd.mapbox-vector-tile");
+const content_type BINARY_MIME("Content-type", "application/octet-stream");
 } // namespace worker
 
 prime_server::worker_t::result_t
@@ -104,7 +106,11 @@ to_response(const std::string& data,
 struct statsd_client_t;
 class service_worker_t {
 public:
-  service_worker_t(const boost::property_tree::ptree& config);
+  /**
+   * @param config          the full configuration
+   * @param max_arena_size  how much of the request arena to keep between requests
+   */
+  service_worker_t(const boost::property_tree::ptree& config, size_t max_arena_size = 0);
 
   virtual ~service_worker_t();
 
@@ -128,7 +134,8 @@ public:
 
   /**
    * After forwarding the completed work on, this is called to reset any internal state, deallocate
-   * any memory to stay within limits or purge any staged metrics
+   * any memory to stay within limits or purge any staged metrics. This releases the request arena
+   * so derived workers have to drop whatever they allocated from it before calling it.
    */
   virtual void cleanup();
 
@@ -167,6 +174,8 @@ protected:
 
   const std::function<void()>* interrupt;
   std::unique_ptr<statsd_client_t> statsd_client;
+  // memory that only lives as long as the current request, released in cleanup
+  midgard::request_arena_t arena;
 };
 } // namespace valhalla
 